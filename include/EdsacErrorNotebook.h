@@ -14,23 +14,45 @@ extern "C" {
 #endif // _cplusplus
 
 // includes
+#include <stdbool.h>
 #include <glib.h>
 #include <gtk/gtk.h>
+#include <time.h>
 
 // type of link or tab
 typedef enum {
     RACK,
     CHASSIS,
     VALVE,
-    ALL
+    ALL,
+    SEARCH, // full text search of error descriptions
+    FILTER,  // a filter expression (see filter.h)
+    NODE_SET // several chassis at once
 } ClickableType;
 
+// how far back a tab goes. Relative ranges are worked out again every time the tab is refreshed
+typedef enum {
+    TIME_ALL,       // everything
+    TIME_LAST_HOUR,
+    TIME_LAST_DAY,  // the last 24 hours
+    TIME_TODAY,     // since midnight
+    TIME_SHIFT,     // since the last shift change
+    TIME_BETWEEN    // since and until
+} TimeRange;
+
+#define DEFAULT_TIME_RANGE TIME_LAST_DAY
+
 // information about a link
 typedef struct {
     ClickableType type;
     unsigned int rack_num;
     unsigned int chassis_num;
     int valve_num; // negative signifies that this is unspecified
+    const char *text; // SEARCH: what to search for. FILTER: the expression. NODE_SET: from node_set_text (sql.h).
+                      // Interned (g_intern_string) so it can be compared by pointer
+    TimeRange time_range;
+    time_t since;  // TIME_BETWEEN only: errors received at or after this. 0 for no lower bound
+    time_t until;  // TIME_BETWEEN only: errors received before this. 0 for no upper bound
 } Clickable;
 
 // GObject init
@@ -66,7 +88,12 @@ EdsacErrorNotebook *edsac_error_notebook_new(void);
 void edsac_error_notebook_update(EdsacErrorNotebook *self);
 int edsac_error_notebook_get_error_count(EdsacErrorNotebook *self);
 void edsac_error_notebook_show_page(EdsacErrorNotebook *self, const Clickable *data);
+// switch to the overview page (see heatmap.h)
+void edsac_error_notebook_show_dashboard(EdsacErrorNotebook *self);
+bool edsac_error_notebook_showing_dashboard(EdsacErrorNotebook *self);
 void edsac_error_notebook_close_node(EdsacErrorNotebook *self, const unsigned int rack_no, const unsigned int chassis_no);
+// change how far back the current tab goes
+void edsac_error_notebook_set_time_range(EdsacErrorNotebook *self, const TimeRange time_range);
 
 // boilerplate public methods
 EdsacErrorNotebook *edsac_error_notebook_construct(GType object_type);
@@ -0,0 +1,82 @@
+/*
+ * Copyright 2017
+ * GPL3 Licensed
+ * alerts.h
+ * Rules checked against every received error which raise a desktop notification, a bell or a banner
+ *
+ * Rules are groups of mothership.conf named "alert" followed by a name for the rule:
+ *   [alert Rack 0 valves]
+ *   rack=0
+ *   type=valve
+ *   action=notify,banner
+ *
+ *   [alert Noisy chassis]
+ *   count=20
+ *   seconds=60
+ *   action=bell
+ * rack and chassis limit a rule to one rack or chassis number (any if left out). type is a list of valve (hardware
+ * errors about a valve), hardware (other hardware errors) and software (any if left out). A rule fires when count
+ * (default 1) matching errors arrive from one chassis within seconds (default 60), and not again for that chassis
+ * until seconds after it last fired. action is a list of notify, bell and banner (default notify).
+ *
+ * Rules are indexed by rack, chassis and type so checking an error costs time in proportion to the rules which could
+ * match it. Each chassis a rule has seen errors from has a ring of ALERT_BUCKETS counters covering its window.
+ */
+
+#ifndef ALERTS_H
+#define ALERTS_H
+
+// link properly with C++
+#ifdef _cplusplus
+extern "C" {
+#endif // _cplusplus
+
+// includes
+#include <stdbool.h>
+#include <time.h>
+#include <glib.h>
+#include <edsac_representation.h> // libedsacnetworking
+
+// the window of a rate rule is counted in this many slices so it slides in steps of seconds / ALERT_BUCKETS
+#define ALERT_BUCKETS 8
+
+// what a rule does when it fires. Several may be combined
+typedef enum {
+    ALERT_NOTIFY = 1, // desktop notification
+    ALERT_BELL = 2,
+    ALERT_BANNER = 4  // stays at the top of the window until dismissed
+} AlertAction;
+
+// a rule firing
+typedef struct {
+    char *rule;         // name of the rule
+    unsigned int actions; // AlertActions
+    unsigned int rack_no;
+    unsigned int chassis_no;
+    int valve_no;       // of the error which made it fire. Negative if it has none
+    guint count;        // errors within the rule's window
+    time_t time;
+    char *description;  // of the error which made it fire
+} Alert;
+
+// declarations
+
+// replace the rules with those in the key file at path. A missing file has no rules. Returns false (and keeps the
+// old rules) if a rule isn't valid
+bool alerts_load_rules(const char *path);
+void alerts_clear_rules(void);
+// number of rules loaded
+guint alerts_rule_count(void);
+
+// check a received error against the rules. Alerts which fire are queued for alerts_take
+void alerts_check(const MessageType type, const unsigned int rack_no, const unsigned int chassis_no, const int valve_no,
+    const time_t recv_time, const char *description);
+
+// GList of the Alerts fired since the last call, oldest first. Free with g_list_free_full(alerts, free_alert)
+GList *alerts_take(void);
+void free_alert(gpointer alert);
+
+#ifdef _cplusplus
+}
+#endif // _cplusplus
+#endif // ALERTS_H
@@ -0,0 +1,65 @@
+/*
+ * Copyright 2017
+ * GPL3 Licensed
+ * archive.h
+ * Cold storage of old errors in compressed archive files
+ */
+
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+// link properly with C++
+#ifdef _cplusplus
+extern "C" {
+#endif // _cplusplus
+
+// includes
+#include <stdbool.h>
+#include <time.h>
+#include <glib.h>
+#include "EdsacErrorNotebook.h"
+#include "sql.h"
+
+// an error read back out of an archive
+typedef struct {
+    time_t recv_time;
+    unsigned int rack_no;
+    unsigned int chassis_no;
+    int valve_no;
+    bool enabled;
+    bool acked;              // always false from archives written before acknowledgements were archived
+    const char *description; // owned by the archive reader. Only valid during the callback
+    guint description_id;    // rows with the same description have the same id (within one archive)
+} ArchiveRow;
+
+// called for each row in an archive. Return false to stop reading
+typedef bool (*archive_row_func_t)(const ArchiveRow *row, gpointer user_data);
+
+// declarations
+
+// move errors received before cutoff out of the database into a new archive file at path.
+// Returns the number of errors archived or -1 on failure (in which case the database is unchanged)
+gint64 archive_errors_before(const char *path, const time_t cutoff);
+
+// stream every row of the archive at path through func, oldest first. Memory use does not depend on the archive size
+// (apart from the table of distinct descriptions). Returns success
+bool archive_foreach(const char *path, archive_row_func_t func, gpointer user_data);
+
+// put the errors in an archive back into the database. Errors for nodes no longer in the database are skipped.
+// Returns the number of errors imported or -1 on failure
+gint64 archive_import(const char *path);
+
+// search an archive without importing it. Returns a GList of SearchResults (with an id of -1) for errors matching
+// search whose description contains text (case insensitive). text may be NULL to match everything
+GList *archive_search(const char *path, const Clickable *search, const char *text);
+
+// archive_search without collecting the results: calls func on each match, oldest first, so memory use does not
+// depend on the number of matches. enabled is the error's own state when it was archived. Returns the number of
+// matches visited or -1 on failure
+gint64 archive_search_foreach(const char *path, const Clickable *search, const char *text, error_row_func_t func,
+    gpointer user_data);
+
+#ifdef _cplusplus
+}
+#endif // _cplusplus
+#endif // ARCHIVE_H
@@ -0,0 +1,70 @@
+/*
+ * Copyright 2017
+ * GPL3 Licensed
+ * clickable.h
+ * What a Clickable covers: its time range, the locations it matches and the members of node sets. Shared by the
+ * database and the in-memory models without either depending on the other
+ */
+
+#ifndef CLICKABLE_H
+#define CLICKABLE_H
+
+// link properly with C++
+#ifdef _cplusplus
+extern "C" {
+#endif // _cplusplus
+
+// includes
+#include <stdbool.h>
+#include <time.h>
+#include <glib.h>
+#include "EdsacErrorNotebook.h"
+
+typedef struct {
+    char *message;
+    time_t recv_time;
+    unsigned int rack_no;
+    unsigned int chassis_no;
+    int valve_no;
+    bool enabled;
+    bool acked;
+    int id;
+} SearchResult;
+
+typedef struct {
+    unsigned int rack_no;
+    unsigned int chassis_no;
+} NodeIdentifier;
+
+// hash table key for a node. IPv4 addresses limit rack and chassis numbers to a byte each so this never collides in
+// practice
+#define NODE_KEY(rack_no, chassis_no) GUINT_TO_POINTER((((rack_no) & 0xFFFF) << 16) | ((chassis_no) & 0xFFFF))
+
+// declarations
+
+void free_search_result(gpointer res);
+
+// allocate a SearchResult for an error. message is the time of the error followed by description
+SearchResult *new_search_result(const time_t recv_time, const char *description, const unsigned int rack_no,
+    const unsigned int chassis_no, const int valve_no, const bool enabled, const int id);
+
+// the times [since, until) which search covers as of now. 0 means unbounded
+void clickable_time_bounds(const Clickable *search, const time_t now, time_t *since, time_t *until);
+
+// does an error from this location belong on the tab described by search? Ignores the time range
+bool clickable_matches(const Clickable *search, const unsigned int rack_no, const unsigned int chassis_no, const int valve_no);
+
+// read the hours at which shifts change (for TIME_SHIFT) from the [shifts] group of the key file at path.
+// A missing file is not an error. Returns false if the file could not be parsed or the hours are invalid
+bool load_shift_changes(const char *path);
+
+// NODE_SET Clickables name their nodes with text like "1.2,1.5,3.0" (rack.chassis in order)
+// interned text for a GSList of NodeIdentifiers in any order. Duplicates are ignored. NULL if the list is empty
+const char *node_set_text(GSList *nodes);
+// GArray of the NodeIdentifiers named by interned text. Parsed once and kept. NULL if the text isn't valid
+const GArray *node_set_members(const char *text);
+
+#ifdef _cplusplus
+}
+#endif // _cplusplus
+#endif // CLICKABLE_H
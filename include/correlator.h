@@ -0,0 +1,58 @@
+/*
+ * Copyright 2017
+ * GPL3 Licensed
+ * correlator.h
+ * Spots errors from many chassis (or valves) of one rack at nearly the same time, such as after a power dip
+ *
+ * Each rack has a sliding window of its errors from the last CORRELATION_WINDOW seconds. When the window holds
+ * errors from at least CORRELATION_MIN_CHASSIS chassis or CORRELATION_MIN_VALVES valves a rack event starts. Every
+ * error in the window belongs to it, as does every later error while the window still meets the threshold.
+ */
+
+#ifndef CORRELATOR_H
+#define CORRELATOR_H
+
+// link properly with C++
+#ifdef _cplusplus
+extern "C" {
+#endif // _cplusplus
+
+// includes
+#include <stdbool.h>
+#include <time.h>
+#include <glib.h>
+
+// seconds (the resolution of recv_time) between the first and last errors of a window
+#define CORRELATION_WINDOW 1
+#define CORRELATION_MIN_CHASSIS 3
+#define CORRELATION_MIN_VALVES 10
+// errors kept in a rack's window. The oldest are dropped beyond this
+#define CORRELATION_MAX_WINDOW 4096
+
+// what has changed about a rack's event
+typedef struct {
+    unsigned int rack_no;
+    gint64 event_id;    // as given to correlator_set_event_id. 0 for a new event
+    time_t start_time;  // of the event's first error
+    time_t end_time;    // of the event's last error
+    guint chassis_count; // distinct chassis in the window
+    guint valve_count;  // distinct valves in the window
+    GArray *error_ids;  // gint64 ids of errors newly part of the event. Free with g_array_unref
+} RackEventUpdate;
+
+// declarations
+
+// forget every window
+void correlator_clear(void);
+
+// add an error (with database id error_id). Returns true and fills in update if it belongs to a rack event
+bool correlator_add(const unsigned int rack_no, const unsigned int chassis_no, const int valve_no, const time_t recv_time,
+    const gint64 error_id, RackEventUpdate *update);
+
+// record where a new event was stored, for the updates which follow
+void correlator_set_event_id(const unsigned int rack_no, const gint64 event_id);
+
+#ifdef _cplusplus
+}
+#endif // _cplusplus
+#endif // CORRELATOR_H
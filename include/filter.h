@@ -0,0 +1,69 @@
+/*
+ * Copyright 2017
+ * GPL3 Licensed
+ * filter.h
+ * Saved filters: a small expression language for choosing errors, compiled to SQL and to an in-memory predicate
+ *
+ * An expression is a list of terms separated by spaces. An error must satisfy every term:
+ *   rack=4-7          rack number in a set. Sets are numbers and ranges separated by commas e.g. 1,3,10-12
+ *   chassis=SET       chassis number in a set
+ *   valve=SET         valve number in a set (errors without a valve never match)
+ *   template=ID       message template id (see template.h). Several may be given separated by commas
+ *   type=hardware     hardware, software or other. Several may be given separated by commas
+ *   enabled           leave out disabled errors and errors from disabled nodes even when disabled items are shown
+ */
+
+#ifndef FILTER_H
+#define FILTER_H
+
+// link properly with C++
+#ifdef _cplusplus
+extern "C" {
+#endif // _cplusplus
+
+// includes
+#include <stdbool.h>
+#include <glib.h>
+#include <sqlite3.h>
+
+// a parsed expression
+typedef struct _Filter Filter;
+
+// a named expression saved in the filters file
+typedef struct {
+    char *name;
+    char *expression;
+} SavedFilter;
+
+// declarations
+
+// parse expression. Returns NULL and sets *error_message (free with g_free) if it isn't valid
+Filter *filter_parse(const char *expression, char **error_message);
+void filter_free(Filter *filter);
+
+// parsed filter for an interned expression (see Clickable.text). Parsed once and kept. NULL if it isn't valid
+const Filter *filter_get(const char *expression);
+
+// does the filter leave out disabled items whatever the View menu says?
+bool filter_enabled_only(const Filter *filter);
+
+// does an error match? Ignores enabled (see filter_enabled_only)
+bool filter_matches(const Filter *filter, const unsigned int rack_no, const unsigned int chassis_no, const int valve_no,
+    const char *description);
+
+// SQL condition over the errors and nodes tables using parameters first_param onwards. Free with g_free
+char *filter_sql(const Filter *filter, const int first_param);
+// bind the parameters used by filter_sql
+bool filter_bind(const Filter *filter, sqlite3_stmt *statement, const int first_param);
+
+// GList of SavedFilters from the key file at path, in the order they were saved. A missing file has no filters
+GList *saved_filters_load(const char *path);
+void free_saved_filter(gpointer saved_filter);
+// add or replace the filter called name. Returns success
+bool saved_filter_store(const char *path, const char *name, const char *expression);
+bool saved_filter_remove(const char *path, const char *name);
+
+#ifdef _cplusplus
+}
+#endif // _cplusplus
+#endif // FILTER_H
@@ -0,0 +1,33 @@
+/*
+ * Copyright 2017
+ * GPL3 Licensed
+ * heatmap.h
+ * Overview of every node drawn as a grid (a row per rack, a column per chassis) coloured by recent errors
+ */
+
+#ifndef HEATMAP_H
+#define HEATMAP_H
+
+// link properly with C++
+#ifdef _cplusplus
+extern "C" {
+#endif // _cplusplus
+
+// includes
+#include <gtk/gtk.h>
+
+// called when a node's cell is clicked
+typedef void (*heatmap_click_t)(const unsigned int rack_no, const unsigned int chassis_no, gpointer user_data);
+
+// declarations
+
+// new heatmap widget. Reads node_activity.h so it never queries the database
+GtkWidget *heatmap_new(heatmap_click_t on_click, gpointer user_data);
+
+// redraw if anything has changed since the heatmap was last drawn
+void heatmap_update(GtkWidget *heatmap);
+
+#ifdef _cplusplus
+}
+#endif // _cplusplus
+#endif // HEATMAP_H
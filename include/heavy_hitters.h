@@ -0,0 +1,56 @@
+/*
+ * Copyright 2017
+ * GPL3 Licensed
+ * heavy_hitters.h
+ * The valves and nodes sending the most errors recently, counted in bounded memory as errors arrive
+ *
+ * Each minute has a Space-Saving summary of HEAVY_HITTERS_CAPACITY counters for valves and another for nodes.
+ * Anything sending more than 1/HEAVY_HITTERS_CAPACITY of a minute's errors is guaranteed to be counted.
+ */
+
+#ifndef HEAVY_HITTERS_H
+#define HEAVY_HITTERS_H
+
+// link properly with C++
+#ifdef _cplusplus
+extern "C" {
+#endif // _cplusplus
+
+// includes
+#include <stdbool.h>
+#include <time.h>
+#include <glib.h>
+
+// how far back "recently" goes
+#define HEAVY_HITTERS_MINUTES 15
+// counters in each minute's summary
+#define HEAVY_HITTERS_CAPACITY 64
+
+typedef struct {
+    unsigned int rack_no;
+    unsigned int chassis_no;
+    int valve_no;   // -1 for a node
+    guint count;    // errors counted. Over by at most error
+    guint error;
+} HeavyHitter;
+
+// declarations
+
+void heavy_hitters_clear(void);
+// forget a node and its valves
+void heavy_hitters_remove_node(const unsigned int rack_no, const unsigned int chassis_no);
+// count errors received at recv_time. valve_no is negative for errors not about a valve
+void heavy_hitters_add(const unsigned int rack_no, const unsigned int chassis_no, const int valve_no, const guint count,
+    const time_t recv_time);
+
+// GArray of up to n HeavyHitters for valves (or for nodes if !valves_not_nodes) over the last HEAVY_HITTERS_MINUTES minutes, busiest first.
+// Free with g_array_unref
+GArray *heavy_hitters_top(const bool valves_not_nodes, const guint n, const time_t now);
+
+// changes whenever anything is counted or forgotten
+guint heavy_hitters_version(void);
+
+#ifdef _cplusplus
+}
+#endif // _cplusplus
+#endif // HEAVY_HITTERS_H
@@ -0,0 +1,54 @@
+/*
+ * Copyright 2017
+ * GPL3 Licensed
+ * hot_tier.h
+ * Bounded in-memory copy of the most recent errors so that recent history can be searched without the database
+ */
+
+#ifndef HOT_TIER_H
+#define HOT_TIER_H
+
+// link properly with C++
+#ifdef _cplusplus
+extern "C" {
+#endif // _cplusplus
+
+// includes
+#include <stdbool.h>
+#include <time.h>
+#include <glib.h>
+#include "EdsacErrorNotebook.h"
+
+#define HOT_TIER_DEFAULT_CAPACITY 65536
+
+// declarations
+
+// make an empty hot tier holding up to capacity errors. 0 disables the hot tier. Safe to call again to resize
+void hot_tier_init(const guint capacity);
+void hot_tier_free(void);
+bool hot_tier_enabled(void);
+
+// every error in the database with an id greater than this is in the hot tier
+gint64 hot_tier_floor(void);
+void hot_tier_set_floor(const gint64 floor);
+
+// keep the hot tier up to date with the database. Errors must be added in order of id
+void hot_tier_add(const gint64 id, const time_t recv_time, const unsigned int rack_no, const unsigned int chassis_no,
+    const int valve_no, const bool enabled, const bool acked, const char *description);
+void hot_tier_set_error_enabled(const gint64 id, const bool enabled);
+void hot_tier_set_error_acked(const gint64 id, const bool acked);
+// every error matching search whatever its state, as set_errors_enabled (sql.h) does. Not for SEARCH
+void hot_tier_set_enabled_matching(const Clickable *search, const bool enabled);
+void hot_tier_set_node_enabled(const unsigned int rack_no, const unsigned int chassis_no, const bool enabled);
+void hot_tier_remove_node(const unsigned int rack_no, const unsigned int chassis_no);
+void hot_tier_remove_before(const time_t cutoff, const gint64 max_id);
+void hot_tier_clear(void);
+
+// GList of SearchResults for errors in the hot tier matching search, ordered by time
+GList *hot_tier_search(const Clickable *search, const bool show_disabled, const bool show_acked);
+int hot_tier_count(const Clickable *search, const bool show_disabled, const bool show_acked);
+
+#ifdef _cplusplus
+}
+#endif // _cplusplus
+#endif // HOT_TIER_H
@@ -0,0 +1,52 @@
+/*
+ * Copyright 2017
+ * GPL3 Licensed
+ * ingest.h
+ * Moves received messages from the server's buffer into the database
+ */
+
+#ifndef INGEST_H
+#define INGEST_H
+
+// link properly with C++
+#ifdef _cplusplus
+extern "C" {
+#endif // _cplusplus
+
+// includes
+#include <stdbool.h>
+#include <glib.h>
+#include <edsac_server.h> // libedsacnetworking
+#include "priority.h"
+
+// more messages than this in one drain means we are falling behind, so low priority errors are coalesced
+#define INGEST_OVERLOAD 1000
+// rows of low priority errors from one valve (or node) with one message template stored from an overloaded drain.
+// Past this each node's other low priority errors share one row
+#define INGEST_LOW_BUDGET 200
+
+// where ingest_drain gets received messages from: NULL when there are no more
+typedef BufferItem *(*ingest_read_func_t)(void);
+
+// called by ingest_drain once the most urgent errors are in the database, before the rest are stored
+typedef void (*ingest_stored_func_t)(gpointer user_data);
+
+// declarations
+
+// open the journal under prefix and put anything in it which didn't make it into the database last time into the
+// database. Must be called after init_database. Returns false if the journal could not be used (ingest still works)
+bool ingest_init(const char *prefix);
+void ingest_shutdown(void);
+
+// read messages with func instead of read_message from libedsacnetworking (for tests). NULL goes back to read_message
+void ingest_set_reader(ingest_read_func_t func);
+
+// move everything waiting in the server's buffer into the database, most urgent first. Returns true if anything was
+// received, setting *highest (if highest isn't NULL) to the priority of the most urgent. If any were PRIORITY_HIGH
+// they are committed first and then urgent_stored (if not NULL) is called with user_data
+bool ingest_drain(Priority *highest, ingest_stored_func_t urgent_stored, gpointer user_data);
+
+#ifdef _cplusplus
+}
+#endif // _cplusplus
+#endif // INGEST_H
@@ -0,0 +1,46 @@
+/*
+ * Copyright 2017
+ * GPL3 Licensed
+ * journal.h
+ * Append-only journal of received messages written before they go into the database
+ */
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+// link properly with C++
+#ifdef _cplusplus
+extern "C" {
+#endif // _cplusplus
+
+// includes
+#include <stdbool.h>
+#include <glib.h>
+#include <edsac_server.h> // libedsacnetworking
+
+// called for each record replayed from the journal. item is freed afterwards
+typedef void (*journal_replay_func_t)(const BufferItem *item, const guint64 seq, gpointer user_data);
+
+// declarations
+
+// open (or create) the journal at path. Sequence numbers carry on from the larger of the last record in the file and
+// last_applied. Returns success
+bool journal_open(const char *path, const guint64 last_applied);
+void journal_close(void);
+
+// append a message to the journal. Returns its sequence number or 0 on failure
+guint64 journal_append(const BufferItem *item);
+
+// wait for everything appended so far to reach the disk
+bool journal_sync(void);
+
+// everything up to and including seq is safely in the database so its space may be reused
+void journal_checkpoint(const guint64 seq);
+
+// call func for each record with a sequence number greater than after, oldest first. Returns the number of records
+guint64 journal_replay(const guint64 after, journal_replay_func_t func, gpointer user_data);
+
+#ifdef _cplusplus
+}
+#endif // _cplusplus
+#endif // JOURNAL_H
@@ -0,0 +1,71 @@
+/*
+ * Copyright 2017
+ * GPL3 Licensed
+ * liveness.h
+ * Whether each node is up, worked out from the server's connected list and from the errors it sends
+ */
+
+#ifndef LIVENESS_H
+#define LIVENESS_H
+
+// link properly with C++
+#ifdef _cplusplus
+extern "C" {
+#endif // _cplusplus
+
+// includes
+#include <stdbool.h>
+#include <time.h>
+#include <glib.h>
+
+// a node which isn't connected and hasn't sent anything for this long is down
+#define LIVENESS_STALE_SECONDS (2 * 60)
+// seconds between polls of the server's connected list
+#define LIVENESS_INTERVAL 30
+
+typedef enum {
+    LIVENESS_UNKNOWN, // not polled for long enough to tell
+    LIVENESS_UP,
+    LIVENESS_DOWN
+} LivenessState;
+
+// a node going up or down
+typedef struct {
+    unsigned int rack_no;
+    unsigned int chassis_no;
+    bool up;
+    time_t time;
+    LivenessState previous; // before the change (see liveness_revert)
+} LivenessChange;
+
+// declarations
+
+// forget every node
+void liveness_clear(void);
+
+// keep up to date with the database. A new node is given LIVENESS_STALE_SECONDS from now to show up
+void liveness_set_node(const unsigned int rack_no, const unsigned int chassis_no, const time_t now);
+void liveness_remove_node(const unsigned int rack_no, const unsigned int chassis_no);
+
+// something was received from a node. Ignored if the node is unknown
+void liveness_seen(const unsigned int rack_no, const unsigned int chassis_no, const time_t recv_time);
+
+// a poll: call liveness_connected for every node in the server's connected list then liveness_check.
+// Returns a GArray of the LivenessChanges since the last poll (free with g_array_unref)
+void liveness_connected(const unsigned int rack_no, const unsigned int chassis_no);
+GArray *liveness_check(const time_t now);
+
+// the changes from liveness_check couldn't be stored: put the nodes back in their previous states so that the next
+// check reports them again
+void liveness_revert(const GArray *changes);
+
+// state as of the last poll. *last_seen (if not NULL) is set to when something was last received (0 for never)
+LivenessState liveness_state(const unsigned int rack_no, const unsigned int chassis_no, time_t *last_seen);
+
+// changes whenever a node goes up or down or is added or removed
+guint liveness_version(void);
+
+#ifdef _cplusplus
+}
+#endif // _cplusplus
+#endif // LIVENESS_H
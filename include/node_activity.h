@@ -0,0 +1,52 @@
+/*
+ * Copyright 2017
+ * GPL3 Licensed
+ * node_activity.h
+ * Per node counts of recent errors, kept up to date as errors arrive so that overviews never query the database
+ */
+
+#ifndef NODE_ACTIVITY_H
+#define NODE_ACTIVITY_H
+
+// link properly with C++
+#ifdef _cplusplus
+extern "C" {
+#endif // _cplusplus
+
+// includes
+#include <stdbool.h>
+#include <time.h>
+#include <glib.h>
+
+// how far back "recent" goes
+#define NODE_ACTIVITY_MINUTES 15
+
+typedef struct {
+    unsigned int rack_no;
+    unsigned int chassis_no;
+    bool enabled;
+    guint recent; // errors received in the last NODE_ACTIVITY_MINUTES minutes
+} NodeActivity;
+
+// declarations
+
+// forget every node
+void node_activity_clear(void);
+
+// keep up to date with the database
+void node_activity_set_node(const unsigned int rack_no, const unsigned int chassis_no, const bool enabled);
+void node_activity_remove_node(const unsigned int rack_no, const unsigned int chassis_no);
+void node_activity_clear_errors(void);
+// count errors from a node received at recv_time. Ignored if the node is unknown or the time is not recent
+void node_activity_add(const unsigned int rack_no, const unsigned int chassis_no, const guint count, const time_t recv_time);
+
+// GArray of NodeActivity for every node as of now, ordered by rack then chassis. Free with g_array_unref
+GArray *node_activity_snapshot(const time_t now);
+
+// changes whenever anything is added, removed or changed
+guint node_activity_version(void);
+
+#ifdef _cplusplus
+}
+#endif // _cplusplus
+#endif // NODE_ACTIVITY_H
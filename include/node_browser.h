@@ -0,0 +1,41 @@
+/*
+ * Copyright 2017
+ * GPL3 Licensed
+ * node_browser.h
+ * Side panel listing every node with its status, searchable by typing and with actions on several nodes at once
+ */
+
+#ifndef NODE_BROWSER_H
+#define NODE_BROWSER_H
+
+// link properly with C++
+#ifdef _cplusplus
+extern "C" {
+#endif // _cplusplus
+
+// includes
+#include <gtk/gtk.h>
+
+typedef enum {
+    NODE_BROWSER_SHOW,
+    NODE_BROWSER_ENABLE,  // every selected node in one go
+    NODE_BROWSER_DISABLE,
+    NODE_BROWSER_DELETE,
+    NODE_BROWSER_HISTORY // connection history of the first selected node
+} NodeBrowserAction;
+
+// called with a GSList of the NodeIdentifiers (sql.h) selected in the browser, in order. Never empty
+typedef void (*node_browser_action_t)(const NodeBrowserAction action, GSList *nodes, gpointer user_data);
+
+// declarations
+
+// new node browser. Reads node_activity.h so it never queries the database
+GtkWidget *node_browser_new(node_browser_action_t on_action, gpointer user_data);
+
+// bring the list up to date if anything has changed
+void node_browser_update(GtkWidget *browser);
+
+#ifdef _cplusplus
+}
+#endif // _cplusplus
+#endif // NODE_BROWSER_H
@@ -0,0 +1,62 @@
+/*
+ * Copyright 2017
+ * GPL3 Licensed
+ * priority.h
+ * How urgent received errors are, and a queue which hands out the most urgent first
+ *
+ * By default valve failures are high priority, other hardware errors normal and software errors low. The priority
+ * group of mothership.conf can override this with filter expressions (see filter.h) separated by semicolons:
+ *   [priority]
+ *   high=rack=3 type=software;template=12
+ *   low=type=hardware valve=100-200
+ * Rules for high are tried first, then normal, then low. Errors matching none of them keep their default.
+ */
+
+#ifndef PRIORITY_H
+#define PRIORITY_H
+
+// link properly with C++
+#ifdef _cplusplus
+extern "C" {
+#endif // _cplusplus
+
+// includes
+#include <stdbool.h>
+#include <glib.h>
+#include <edsac_representation.h> // libedsacnetworking
+
+typedef enum {
+    PRIORITY_LOW,
+    PRIORITY_NORMAL,
+    PRIORITY_HIGH
+} Priority;
+
+#define PRIORITY_LEVELS 3
+
+// FIFO within each priority
+typedef struct _PriorityQueue PriorityQueue;
+
+// declarations
+
+// replace the rules with those in the key file at path. A missing file or group leaves no rules. Returns false (and
+// keeps the old rules) if a rule isn't a valid filter expression
+bool priority_load_rules(const char *path);
+void priority_clear_rules(void);
+
+// priority of a decoded error (see decode_error in sql.h)
+Priority priority_classify(const MessageType type, const unsigned int rack_no, const unsigned int chassis_no,
+    const int valve_no, const char *description);
+
+PriorityQueue *priority_queue_new(void);
+// free_func is called on anything left in the queue. It may be NULL
+void priority_queue_free(PriorityQueue *queue, GDestroyNotify free_func);
+void priority_queue_push(PriorityQueue *queue, gpointer data, const Priority priority);
+// the oldest of the most urgent items, or NULL if the queue is empty. priority may be NULL
+gpointer priority_queue_pop(PriorityQueue *queue, Priority *priority);
+guint priority_queue_length(const PriorityQueue *queue);
+guint priority_queue_length_at(const PriorityQueue *queue, const Priority priority);
+
+#ifdef _cplusplus
+}
+#endif // _cplusplus
+#endif // PRIORITY_H
@@ -15,31 +15,114 @@ extern "C" {
 
 // includes
 #include <stdbool.h>
+#include <time.h>
 #include <edsac_server.h> // libedsacnetworking
 #include "EdsacErrorNotebook.h"
+#include "clickable.h"
+#include "filter.h"
 #include <glib.h>
 
+// how SQLite should trade durability and memory for speed. See README.md
 typedef struct {
-    char *message;
-    unsigned int rack_no;
-    unsigned int chassis_no;
-    int valve_no;
-    bool enabled;
-    int id;
-} SearchResult;
+    int cache_size_kib;     // size of the page cache
+    gint64 mmap_size;       // bytes of the database file to access with memory mapped I/O. 0 disables
+    bool temp_store_memory; // keep temporary tables and indices in memory instead of in files
+    char synchronous[8];    // OFF, NORMAL or FULL
+    char journal_mode[9];   // DELETE, TRUNCATE or WAL
+} StorageProfile;
+
+#define DEFAULT_STORAGE_PROFILE "balanced"
 
+// errors from many chassis of one rack at once (see correlator.h). The errors are linked in rack_event_errors
 typedef struct {
+    gint64 id;
     unsigned int rack_no;
-    unsigned int chassis_no;
-} NodeIdentifier;
+    time_t start_time;
+    time_t end_time;    // of the last error. Inclusive
+    unsigned int chassis_count;
+    unsigned int valve_count;
+    unsigned int error_count;
+} RackEvent;
+
+// a node's connection history summed over a time range (see node_uptime)
+typedef struct {
+    time_t since;
+    time_t until;
+    bool known;             // false if there are no changes before until
+    bool up;                // at until
+    guint64 up_seconds;
+    guint64 down_seconds;   // time before the first change counts as neither
+    unsigned int flaps;     // times it went down
+} NodeUptime;
+
+// how many errors have a message template (see template.h)
+typedef struct {
+    gint64 id;
+    char *text;
+    unsigned int count;
+} TemplateCount;
+
+// called for each row by foreach_error_before. Return false to stop
+typedef bool (*error_row_func_t)(const time_t recv_time, const unsigned int rack_no, const unsigned int chassis_no,
+    const int valve_no, const bool enabled, const bool acked, const char *description, gpointer user_data);
+
+// called as a backup progresses. remaining and total are in database pages
+typedef void (*backup_progress_t)(const int remaining, const int total, gpointer user_data);
 
 // declarations
 bool check_mac_address(const char* str);
 
-void free_search_result(gpointer res);
-
 void init_database(const char* path);
 void close_database(void);
+// open an existing database which another mothership (e.g. one running --headless) is writing to. Nothing is written
+// to the file. The hot tier isn't used, and the in-memory state is only updated by reload_database_state. Returns
+// false if it can't be opened or hasn't been upgraded to this version yet
+bool init_database_read_only(const char *path);
+// just the read-only connection of init_database_read_only, for tools which only query the database
+bool open_database_read_only(const char *path);
+bool database_read_only(void);
+// has anything been committed to the database by another connection since the last reload_database_state?
+bool database_changed(void);
+// reload the node list, recent activity and unacknowledged counts from the database
+bool reload_database_state(void);
+
+// copy the live database to dest_path a few pages at a time so that other users of the database are not blocked.
+// Blocks until the backup is complete so should be run in its own thread. progress may be NULL. Returns success
+bool backup_database(const char *dest_path, backup_progress_t progress, gpointer user_data);
+
+// set profile to the named preset ("safe", "balanced" or "fast"). Returns false if there is no such preset
+bool storage_profile_preset(const char *name, StorageProfile *profile);
+
+// override fields of profile with those set in the [storage] group of the key file at path.
+// A missing file is not an error. Returns false if the file could not be parsed or a value is invalid
+bool storage_profile_load(const char *path, StorageProfile *profile);
+
+// apply profile to the open database
+bool apply_storage_profile(const StorageProfile *profile);
+
+// update the statistics used by the query planner. Cheap when little has changed so it can be run regularly
+bool optimize_database(void);
+
+// sequence number of the last journal record in the database. -1 on error
+gint64 get_journal_applied(void);
+// should be in the same batch as the errors from the journal. Forgets the set_journal_stored records up to seq
+bool set_journal_applied(const gint64 seq);
+// the journal record seq is in the database although the applied sequence number hasn't reached it yet (urgent errors
+// committed ahead of the rest of their drain, see ingest.c). Should be in the same batch as its error
+bool set_journal_stored(const gint64 seq);
+// set of the sequence numbers (gint64 *) recorded by set_journal_stored since the last set_journal_applied. NULL on
+// error. Free with g_hash_table_destroy
+GHashTable *get_journal_stored(void);
+
+// group the writes between these calls into one transaction. Batches can be nested and are safe to use from any thread.
+// Writes from other threads while a batch is open become part of the batch. If the outermost end_batch can't commit
+// (e.g. a reader held the database for longer than the busy timeout) the batch is rolled back, the in-memory state
+// is reloaded from the database and it returns false
+void begin_batch(void);
+bool end_batch(void);
+// something in the open batch failed: the outermost end_batch rolls the whole batch back (as if it couldn't commit)
+// instead of committing it. Nested end_batch calls return false from then on
+void fail_batch(void);
 
 // get the fields we want out of the IP v4 address (xxx.xxx.rack_no.chassis_no)
 NodeIdentifier *parse_ip_address(const struct in_addr *address);
@@ -47,15 +130,63 @@ NodeIdentifier *parse_ip_address(const struct in_addr *address);
 // only effects things which search on clickables
 void set_show_disabled(bool new_val);
 bool get_show_disabled(void);
+// acknowledged errors are left out unless this is set
+void set_show_acked(bool new_val);
+bool get_show_acked(void);
 
 bool add_node(const unsigned int rack_no, const unsigned int chassis_no, const bool enabled);
 bool remove_node(const unsigned int rack_no, const unsigned int chassis_no);
 bool node_exists(const unsigned int rack_no, const unsigned int chassis_no);
 
 bool add_error(const BufferItem *error);
+// add_error for an error replayed from the journal after a crash. Stale ones don't reach the overview, top offenders
+// or correlator
+bool replay_error(const BufferItem *error);
+// what add_error would store for error: its node, valve (negative if none) and description. description is
+// overwritten. Returns false for message types which aren't stored
+bool decode_error(const BufferItem *error, NodeIdentifier *node, int *valve_no, GString *description);
+// one poll of liveness.h: connected is the GSList of struct sockaddr_in from get_connected_list(). Nodes which have
+// gone down get a "Node not connected" error, all in one transaction
+bool update_liveness(GSList *connected, const time_t now);
+
+// uptime over since to until from the connection history, without the errors table. A since of 0 gives the running
+// totals since the node's first recorded change
+bool node_uptime(const unsigned int rack_no, const unsigned int chassis_no, const time_t since, const time_t until,
+    NodeUptime *uptime);
+// GList of the node's newest connection changes (LivenessChanges), oldest first. Free with g_list_free_full(., g_free)
+GList *node_connection_history(const unsigned int rack_no, const unsigned int chassis_no, const unsigned int limit);
 bool add_error_decoded(const uint32_t rack_no, const uint32_t chassis_no, const int valve_no, const time_t recv_time, const char *msg);
+// add_error_decoded for count errors stored as one row, e.g. repeats coalesced by an overloaded ingest. The error
+// rates, overview and top offenders count all of them
+bool add_error_repeated(const uint32_t rack_no, const uint32_t chassis_no, const int valve_no, const time_t recv_time,
+    const char *msg, const guint count);
 bool remove_all_errors(void);
 
+// add_error_decoded for an error which has been in the database before (e.g. from an archive). It is not counted in
+// error_rollup again and doesn't reach the overview, top offenders or correlator. An acknowledged error comes back
+// acknowledged, but who acknowledged it and when are not kept
+bool restore_error(const uint32_t rack_no, const uint32_t chassis_no, const int valve_no, const time_t recv_time, const char *msg,
+    const bool enabled, const bool acked);
+
+// calls func on each error received before cutoff, oldest first. Returns the largest error id visited (0 if none) or -1 on failure
+gint64 foreach_error_before(const time_t cutoff, error_row_func_t func, gpointer user_data);
+
+// calls func on each error received in [since, until) (0 is unbounded) which matches filter, oldest first. Disabled
+// errors are included unless the filter says enabled. The rows are read a chunk at a time so memory use doesn't grow
+// with the number of rows and a writer is never kept waiting for long. Errors which arrive while it runs aren't
+// visited. Returns the number of rows visited or -1 on failure
+gint64 foreach_error_matching(const Filter *filter, const time_t since, const time_t until, error_row_func_t func,
+    gpointer user_data);
+
+// changes whenever errors are enabled or disabled
+guint errors_enabled_version(void);
+
+// remove errors received before cutoff with an id no larger than max_id
+bool remove_errors_before(const time_t cutoff, const gint64 max_id);
+
+// can SEARCH Clickables be used? (was sqlite built with FTS5?)
+bool search_index_available(void);
+
 // returns a GList of SearchResults
 GList *search_clickable(const Clickable *search);
 
@@ -71,9 +202,44 @@ GSList *list_nodes(void);
 bool node_toggle_disabled(const unsigned long int rack_no, const unsigned long int chassis_no);
 bool error_toggle_disabled(const uintptr_t id);
 
+// bulk changes, each made with one UPDATE whatever the View menu says about disabled items. Return the number of errors
+// or nodes changed or -1 on error
+// every error matching search (within its time range)
+int set_errors_enabled(const Clickable *search, const bool enabled);
+// errors chosen by id (a GArray of gint64)
+int set_error_ids_enabled(const GArray *ids, const bool enabled);
+// every node in search: ALL, RACK, CHASSIS (or VALVE's chassis) or NODE_SET
+int set_nodes_enabled(const Clickable *search, const bool enabled);
+
+// acknowledge (or un-acknowledge) errors in one transaction, keeping unacked.h up to date. user is recorded with the
+// time and may be NULL when un-acknowledging. Return the number of errors changed or -1 on error
+int set_errors_acked(const Clickable *search, const bool acked, const char *user);
+int set_error_ids_acked(const GArray *ids, const bool acked, const char *user);
+// who acknowledged an error and when. *user must be freed with g_free. false if it isn't acknowledged
+bool error_ack_info(const gint64 id, time_t *ack_time, char **user);
+
 // -1 on error
 int count_clickable(const Clickable *search);
 
+// errors per bucket of bucket_seconds for num_buckets buckets, the last of which contains until, read from the rollup
+// table rather than errors. Counts disabled errors from enabled nodes. Returns false on error or if the rollup can't
+// answer for this type of Clickable (SEARCH and FILTER)
+bool rollup_clickable(const Clickable *search, const time_t until, const unsigned int bucket_seconds,
+    const unsigned int num_buckets, guint *counts);
+
+// merge old per minute counts into hourly counts and old hourly counts into daily counts
+bool compact_rollup(const time_t now);
+
+// GList of the newest limit RackEvents, newest first. Free with g_list_free_full(events, g_free). NULL on error too
+GList *get_rack_events(const unsigned int limit);
+// changes whenever a rack event is stored or removed
+guint rack_events_version(void);
+
+// GList of TemplateCounts for the limit commonest templates among errors received since, commonest first.
+// Counts disabled errors too. Free with g_list_free_full(counts, free_template_count). NULL on error too
+GList *count_templates(const time_t since, const unsigned int limit);
+void free_template_count(gpointer count);
+
 #ifdef _cplusplus
 }
 #endif // _cplusplus
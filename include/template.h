@@ -0,0 +1,34 @@
+/*
+ * Copyright 2017
+ * GPL3 Licensed
+ * template.h
+ * Message templates: error descriptions with their numbers masked so that errors differing only by a voltage, a
+ * counter or an address are grouped together
+ *
+ * A number is a run of digits or a hex number (0x1f, or a word of hex digits containing at least one digit such
+ * as 3a9c). Each is replaced by '#': "Hardware Error: 3.3V on 0x1f" becomes "Hardware Error: #.#V on #".
+ */
+
+#ifndef TEMPLATE_H
+#define TEMPLATE_H
+
+// link properly with C++
+#ifdef _cplusplus
+extern "C" {
+#endif // _cplusplus
+
+// includes
+#include <glib.h>
+
+// declarations
+
+// description with its numbers masked. Free with g_free
+char *template_text(const char *description);
+
+// id of description's template: a 63 bit FNV-1a hash of template_text(description). Always positive
+gint64 template_id(const char *description);
+
+#ifdef _cplusplus
+}
+#endif // _cplusplus
+#endif // TEMPLATE_H
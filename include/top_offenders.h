@@ -0,0 +1,37 @@
+/*
+ * Copyright 2017
+ * GPL3 Licensed
+ * top_offenders.h
+ * Panel listing the valves and nodes sending the most errors recently (see heavy_hitters.h) and the latest rack
+ * events (see correlator.h)
+ */
+
+#ifndef TOP_OFFENDERS_H
+#define TOP_OFFENDERS_H
+
+// link properly with C++
+#ifdef _cplusplus
+extern "C" {
+#endif // _cplusplus
+
+// includes
+#include <gtk/gtk.h>
+#include "EdsacErrorNotebook.h"
+
+// rows in each list
+#define TOP_OFFENDERS_ROWS 10
+
+// called with the errors to show when a row is activated
+typedef void (*top_offenders_click_t)(const Clickable *link, gpointer user_data);
+
+// declarations
+
+GtkWidget *top_offenders_new(top_offenders_click_t on_click, gpointer user_data);
+
+// refill the lists if anything has changed since they were last filled
+void top_offenders_update(GtkWidget *top_offenders);
+
+#ifdef _cplusplus
+}
+#endif // _cplusplus
+#endif // TOP_OFFENDERS_H
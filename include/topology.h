@@ -0,0 +1,45 @@
+/*
+ * Copyright 2017
+ * GPL3 Licensed
+ * topology.h
+ * Every node (rack and chassis) and whether it is enabled, kept in memory so that menus and checks don't query the
+ * database. Loaded by init_database and kept up to date by add_node, remove_node and node_toggle_disabled
+ */
+
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+// link properly with C++
+#ifdef _cplusplus
+extern "C" {
+#endif // _cplusplus
+
+// includes
+#include <stdbool.h>
+#include <glib.h>
+
+typedef struct {
+    unsigned int rack_no;
+    unsigned int chassis_no;
+    bool enabled;
+} TopologyNode;
+
+// declarations
+
+// forget every node
+void topology_clear(void);
+
+// add a node or change whether it is enabled
+void topology_set_node(const unsigned int rack_no, const unsigned int chassis_no, const bool enabled);
+void topology_remove_node(const unsigned int rack_no, const unsigned int chassis_no);
+
+// is there such a node? If so *enabled (if not NULL) is set to whether it is enabled
+bool topology_node_exists(const unsigned int rack_no, const unsigned int chassis_no, bool *enabled);
+
+// GArray of TopologyNodes ordered by rack then chassis. Free with g_array_unref
+GArray *topology_nodes(void);
+
+#ifdef _cplusplus
+}
+#endif // _cplusplus
+#endif // TOPOLOGY_H
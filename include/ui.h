@@ -21,6 +21,17 @@ int start_ui(int *argc, char ***argv, gpointer timer_id);
 
 void gui_update(gpointer g_idle_id);
 
+// refresh the error count in the status bar (e.g. after the current tab was filtered)
+void update_bar(void);
+
+// bring the Nodes menu in line with the topology after it was reloaded from the database (see reload_database_state
+// in sql.h). Only the nodes which changed are patched. Call from the GTK thread
+void refresh_nodes_menu(void);
+
+// start a backup of the database to the backups directory in the background. Its progress is shown in the status bar
+// (only the outcome is printed when headless). Call from the main thread
+void start_backup(void);
+
 #ifdef _cplusplus
 }
 #endif // _cplusplus
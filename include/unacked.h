@@ -0,0 +1,39 @@
+/*
+ * Copyright 2017
+ * GPL3 Licensed
+ * unacked.h
+ * Per node and per valve counts of unacknowledged errors, kept up to date as errors arrive and are acknowledged so
+ * that tabs never have to count them in the database
+ */
+
+#ifndef UNACKED_H
+#define UNACKED_H
+
+// link properly with C++
+#ifdef _cplusplus
+extern "C" {
+#endif // _cplusplus
+
+// includes
+#include <stdbool.h>
+#include <glib.h>
+#include "EdsacErrorNotebook.h"
+
+// declarations
+
+// forget every count
+void unacked_clear(void);
+
+// keep up to date with the database. count is negative for errors which were acknowledged or removed. valve_no is
+// negative for errors without a valve
+void unacked_add(const unsigned int rack_no, const unsigned int chassis_no, const int valve_no, const gint64 count);
+void unacked_remove_node(const unsigned int rack_no, const unsigned int chassis_no);
+
+// unacknowledged errors for the tab described by search, however long ago they were received and whether or not they
+// are disabled. -1 for SEARCH and FILTER, which can't be answered from counts
+gint64 unacked_count(const Clickable *search);
+
+#ifdef _cplusplus
+}
+#endif // _cplusplus
+#endif // UNACKED_H
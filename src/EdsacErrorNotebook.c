@@ -15,11 +15,37 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <pthread.h>
+#include <time.h>
 #include "sql.h"
 #include "ui.h"
+#include "unacked.h"
+#include "heatmap.h"
+#include "top_offenders.h"
+
+// error rate sparklines in tab labels: errors per minute over the last half hour
+#define SPARKLINE_BUCKETS 30
+#define SPARKLINE_BUCKET_SECONDS 60
+#define SPARKLINE_WIDTH 60
+#define SPARKLINE_HEIGHT 16
+
+// what the description menu's bulk items do
+typedef enum {
+    BULK_DISABLE,
+    BULK_ENABLE,
+    BULK_ACK,
+    BULK_UNACK
+} BulkChange;
 
 // declarations
 
+// rows loaded into a tab from the database. Shared with filter jobs so it is reference counted
+typedef struct {
+    GPtrArray *results; // SearchResults
+    gchar **folded;     // casefolded text of each row. Only touched by the filter thread, which fills it in as needed
+    gint refs;          // only access atomically
+    gint newest_job;    // generation of the newest filter job on these rows. Older jobs give up. Only access atomically
+} TabRows;
+
 // context for an open tab
 typedef struct _LinkyTextBuffer {
     Clickable description;  // information about what this is a list of
@@ -28,14 +54,43 @@ typedef struct _LinkyTextBuffer {
     GSList *clickables;     // Clickables *within the text buffer* we need to free
     gint page_id;           // the gtknotebook page id
     GString *title;         // The string for the tab's title
+    TabRows *rows;          // what was last loaded from the database
+    GtkEntry *filter_entry; // narrows down the rows shown
+    gchar *filter;          // casefolded filter which matches was made with. NULL if there isn't one
+    GArray *matches;        // indices into matched_rows of the rows matching filter
+    TabRows *matched_rows;  // the rows matches was made from. Until the filter catches up with a refresh these are
+                            // still the ones shown rather than rows
+    guint filter_generation; // of the newest filter job for this tab. Results from older jobs are thrown away
+    GtkWidget *sparkline;   // in the tab label
+    GtkWidget *unacked;     // count of unacknowledged errors in the tab label
+    guint rate[SPARKLINE_BUCKETS]; // errors in each bucket, oldest first
+    bool rate_valid;        // false if the rollup can't describe this tab (or failed)
 } LinkyBuffer;
 
+// filtering a tab's rows in the filter thread
+typedef struct {
+    EdsacErrorNotebook *notebook; // holds a reference
+    LinkyBuffer *tab;       // might have been closed by the time the job is done
+    guint generation;
+    TabRows *rows;          // holds a reference
+    GArray *candidates;     // indices into rows to check. NULL to check all of them
+    gchar *needle;          // casefolded
+    GArray *matches;        // the result
+} FilterJob;
+
 // private object data
 typedef struct _EdsacErrorNotebookPrivate {
     GSList *open_tabs_list; // list of open tabs (LinkyBuffers)
+    GtkWidget *dashboard;   // overview page. Not in open_tabs_list and can't be closed
+    GtkWidget *heatmap;     // on the dashboard
+    GtkWidget *top_offenders; // on the dashboard
 } EdsacErrorNotebookPrivate;
 
 static gpointer edsac_error_notebook_parent_class = NULL;
+
+// filter jobs run one at a time in order. Only touched by the gui thread
+static GThreadPool *filter_pool = NULL;
+static guint next_filter_generation = 1;
 #define EDSAC_ERROR_NOTEBOOK_GET_PRIVATE(_o) (G_TYPE_INSTANCE_GET_PRIVATE((_o), EDSAC_TYPE_ERROR_NOTEBOOK, EdsacErrorNotebookPrivate))
 
 /**** local function declarations ****/
@@ -51,25 +106,40 @@ static void free_g_string(gpointer g_string);
 static void free_linky_buffer(LinkyBuffer *linky_buffer);
 static void add_link(size_t start_pos, size_t end_pos, GtkTextBuffer *buffer, Clickable* data);
 static void update_tab(gpointer data, gpointer unused);
+static void set_title(LinkyBuffer *linky_buffer);
+static void show_rows(LinkyBuffer *linky_buffer);
+static void start_filter_job(EdsacErrorNotebook *self, LinkyBuffer *linky_buffer, gchar *needle, GArray *candidates);
+static void tab_rows_unref(TabRows *rows);
+static void clear_filter(LinkyBuffer *linky_buffer);
 static notebook_page_id_t add_new_page_to_notebook(EdsacErrorNotebook *self, const Clickable *data);
 static void close_tab(EdsacErrorNotebook *self, GSList *tab_in_list);
 
 // GTK
 static GtkWidget *new_text_view(void);
 static GtkWidget *put_in_scroll(GtkWidget *thing);
-static GtkWidget *tab_label(const char *msg, GtkWidget *contents);
+static GtkWidget *tab_label(LinkyBuffer *linky_buffer, GtkWidget *contents);
+static void update_sparkline(LinkyBuffer *linky_buffer);
+static void update_unacked(LinkyBuffer *linky_buffer);
 static GtkWidget *get_parent(const GtkWidget *child);
 
 // Signal Handlers
 static void close_button_handler(GtkWidget *button, GdkEvent *event, GtkWidget *contents);
 static void link_clicked(const GtkTextTag *tag, const GtkTextView *parent, const GdkEvent *event, const GtkTextIter *iter, Clickable *data);
-static void desc_clicked(const GtkTextTag *tag, const GtkTextView *parent, const GdkEvent *event, const GtkTextIter *iter, const gpointer error_id);
+static void desc_clicked(GtkTextTag *tag, const GtkTextView *parent, const GdkEvent *event, const GtkTextIter *iter, const gpointer error_id);
 static void disable_click(const uintptr_t id);
+static void matching_click(GtkMenuItem *menu_item, gpointer change);
+static void ids_click(GtkMenuItem *menu_item, gpointer change);
+static void filter_changed(GtkSearchEntry *entry, LinkyBuffer *linky_buffer);
+static gboolean draw_sparkline(GtkWidget *widget, cairo_t *cr, LinkyBuffer *linky_buffer);
+static void dashboard_clicked(const unsigned int rack_no, const unsigned int chassis_no, gpointer data);
+static void offender_clicked(const Clickable *link, gpointer data);
 
 /**** Public Methods ****/
 // update data to be in line with the database
 void edsac_error_notebook_update(EdsacErrorNotebook *self) {
     g_slist_foreach(self->priv->open_tabs_list, update_tab, NULL);
+    heatmap_update(self->priv->heatmap);
+    top_offenders_update(self->priv->top_offenders);
 }
 
 // get the error count for the currently displayed page
@@ -91,6 +161,12 @@ int edsac_error_notebook_get_error_count(EdsacErrorNotebook *self) {
     } 
 
     LinkyBuffer *linky_buffer = (LinkyBuffer *) result->data;
+
+    // only the rows which pass the filter are shown
+    if (NULL != linky_buffer->filter) {
+        return (int) linky_buffer->matches->len;
+    }
+
     return count_clickable(&linky_buffer->description);
 }
 
@@ -113,6 +189,17 @@ void edsac_error_notebook_show_page(EdsacErrorNotebook *self, const Clickable *d
     add_new_page_to_notebook(self, data);
 }
 
+void edsac_error_notebook_show_dashboard(EdsacErrorNotebook *self) {
+    assert(NULL != self);
+    gtk_notebook_set_current_page(GTK_NOTEBOOK(self), gtk_notebook_page_num(GTK_NOTEBOOK(self), self->priv->dashboard));
+}
+
+bool edsac_error_notebook_showing_dashboard(EdsacErrorNotebook *self) {
+    assert(NULL != self);
+    const gint current_page = gtk_notebook_get_current_page(GTK_NOTEBOOK(self));
+    return (-1 != current_page) && (current_page == gtk_notebook_page_num(GTK_NOTEBOOK(self), self->priv->dashboard));
+}
+
 void edsac_error_notebook_close_node(EdsacErrorNotebook *self, const unsigned int rack_no, const unsigned int chassis_no) {
     if (NULL == self)
         return;
@@ -123,7 +210,8 @@ void edsac_error_notebook_close_node(EdsacErrorNotebook *self, const unsigned in
         if (NULL == linky_buffer)
             return;
 
-        if (linky_buffer->description.rack_num == rack_no) {
+        const ClickableType type = linky_buffer->description.type;
+        if ((SEARCH != type) && (FILTER != type) && (NODE_SET != type) && (linky_buffer->description.rack_num == rack_no)) {
             if (linky_buffer->description.chassis_num == chassis_no) {
                 // this tab needs closing
                 close_tab(self, item);
@@ -139,21 +227,28 @@ void edsac_error_notebook_close_node(EdsacErrorNotebook *self, const unsigned in
     }
 }
 
-// add a new page to the notebook
-static notebook_page_id_t add_new_page_to_notebook(EdsacErrorNotebook *self, const Clickable *data) {
-    if ((NULL == self) || (NULL == data)) {
-        return NULL;
+void edsac_error_notebook_set_time_range(EdsacErrorNotebook *self, const TimeRange time_range) {
+    assert(NULL != self);
+
+    const gint current_page = gtk_notebook_get_current_page(GTK_NOTEBOOK(self));
+    GSList *result = g_slist_find_custom(self->priv->open_tabs_list, (gconstpointer) &current_page, open_tabs_list_search_by_id);
+    if (NULL == result) {
+        return;
     }
 
-    GtkNotebook *notebook = &self->parent_instance;
+    LinkyBuffer *linky_buffer = result->data;
+    linky_buffer->description.time_range = time_range;
+    set_title(linky_buffer);
 
-    // LinkyBuffer to describe the notebook
-    LinkyBuffer *linky_buffer = new_linky_buffer(data);
-    assert(NULL != linky_buffer);
+    GtkWidget *page = gtk_notebook_get_nth_page(GTK_NOTEBOOK(self), current_page);
+    gtk_notebook_set_tab_label(GTK_NOTEBOOK(self), page, tab_label(linky_buffer, page));
 
-    // Heading for the new tab
-    linky_buffer->title = g_string_new(NULL);
-    assert(NULL != linky_buffer->title);
+    update_tab(linky_buffer, NULL);
+}
+
+// sets the title of a tab from its description
+static void set_title(LinkyBuffer *linky_buffer) {
+    const Clickable *data = &linky_buffer->description;
 
     switch(data->type) {
         case ALL:
@@ -168,10 +263,60 @@ static notebook_page_id_t add_new_page_to_notebook(EdsacErrorNotebook *self, con
         case VALVE:
             g_string_printf(linky_buffer->title, "Rack %i, Chassis %i, Valve: %i", data->rack_num, data->chassis_num, data->valve_num);
             break;
+        case SEARCH:
+            g_string_printf(linky_buffer->title, "Search: %s", data->text);
+            break;
+        case FILTER:
+            g_string_printf(linky_buffer->title, "Filter: %s", data->text);
+            break;
+        case NODE_SET: {
+            const GArray *members = node_set_members(data->text);
+            const guint len = (NULL == members) ? 0 : members->len;
+            g_string_printf(linky_buffer->title, "%u Chassis: %s", len, data->text);
+            break;
+        }
         default:
             g_string_printf(linky_buffer->title, "(Unknown)");
     }
 
+    switch (data->time_range) {
+        case TIME_LAST_HOUR:
+            g_string_append(linky_buffer->title, " (last hour)");
+            break;
+        case TIME_LAST_DAY:
+            g_string_append(linky_buffer->title, " (24h)");
+            break;
+        case TIME_TODAY:
+            g_string_append(linky_buffer->title, " (today)");
+            break;
+        case TIME_SHIFT:
+            g_string_append(linky_buffer->title, " (this shift)");
+            break;
+        case TIME_BETWEEN:
+            g_string_append(linky_buffer->title, " (range)");
+            break;
+        default: // TIME_ALL
+            break;
+    }
+}
+
+// add a new page to the notebook
+static notebook_page_id_t add_new_page_to_notebook(EdsacErrorNotebook *self, const Clickable *data) {
+    if ((NULL == self) || (NULL == data)) {
+        return NULL;
+    }
+
+    GtkNotebook *notebook = &self->parent_instance;
+
+    // LinkyBuffer to describe the notebook
+    LinkyBuffer *linky_buffer = new_linky_buffer(data);
+    assert(NULL != linky_buffer);
+
+    // Heading for the new tab
+    linky_buffer->title = g_string_new(NULL);
+    assert(NULL != linky_buffer->title);
+    set_title(linky_buffer);
+
     GtkWidget *msg = new_text_view(); 
     assert(NULL != msg);
 
@@ -180,7 +325,19 @@ static notebook_page_id_t add_new_page_to_notebook(EdsacErrorNotebook *self, con
     GtkWidget *scroll = put_in_scroll(msg);
     assert(NULL != scroll);
 
-    gint index = gtk_notebook_append_page(notebook, scroll, tab_label(linky_buffer->title->str, scroll));
+    // filter bar above the errors
+    GtkWidget *filter = gtk_search_entry_new();
+    assert(NULL != filter);
+    gtk_entry_set_placeholder_text(GTK_ENTRY(filter), "Filter this tab");
+    linky_buffer->filter_entry = GTK_ENTRY(filter);
+    g_signal_connect(G_OBJECT(filter), "search-changed", G_CALLBACK(filter_changed), linky_buffer);
+
+    GtkWidget *page_box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 0);
+    assert(NULL != page_box);
+    gtk_box_pack_start(GTK_BOX(page_box), filter, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(page_box), scroll, TRUE, TRUE, 0);
+
+    gint index = gtk_notebook_append_page(notebook, page_box, tab_label(linky_buffer, page_box));
     assert(-1 != index);
     linky_buffer->page_id = index;
 
@@ -227,8 +384,8 @@ static void close_tab(EdsacErrorNotebook *self, GSList *tab_in_list) {
     // free the linky buffer
     free_linky_buffer(tab_page_desc);
 
-    // close the window if the last page is closed
-    if (0 == gtk_notebook_get_n_pages(GTK_NOTEBOOK(self))) {
+    // close the window if the last page is closed (the overview page doesn't count)
+    if (NULL == self->priv->open_tabs_list) {
         GtkWidget *toplevel = gtk_widget_get_toplevel(GTK_WIDGET(self));
         if (gtk_widget_is_toplevel(toplevel)) { // docs recommend this extra check https://developer.gnome.org/gtk3/stable/GtkWidget.html#gtk-widget-get-toplevel
             GtkWindow *window = GTK_WINDOW(toplevel);
@@ -262,6 +419,12 @@ static void free_linky_buffer(LinkyBuffer *linky_buffer) {
 
     free_g_string(linky_buffer->title);
 
+    if (NULL != linky_buffer->rows) {
+        g_atomic_int_set(&linky_buffer->rows->newest_job, 0); // stop any filter jobs
+    }
+    tab_rows_unref(linky_buffer->rows);
+    clear_filter(linky_buffer);
+
     g_free(linky_buffer);
 }
 
@@ -270,7 +433,11 @@ static bool clickable_compare(const Clickable *a, const Clickable *b) {
     assert(NULL != a);
     assert(NULL != b);
 
-    if (a->type != b->type) {
+    if ((a->type != b->type) || (a->time_range != b->time_range)) {
+        return false;
+    }
+
+    if ((TIME_BETWEEN == a->time_range) && ((a->since != b->since) || (a->until != b->until))) {
         return false;
     }
 
@@ -278,6 +445,11 @@ static bool clickable_compare(const Clickable *a, const Clickable *b) {
         return true;
     }
 
+    // search strings, filter expressions and node sets are interned
+    if ((SEARCH == a->type) || (FILTER == a->type) || (NODE_SET == a->type)) {
+        return a->text == b->text;
+    }
+
     const bool rack_num = (a->rack_num == b->rack_num);
     if ((RACK == a->type) && rack_num) {
         return true;
@@ -343,6 +515,15 @@ static LinkyBuffer *new_linky_buffer(const Clickable *desc) {
     linky_buffer->g_string_list = NULL;
     linky_buffer->clickables = NULL;
     linky_buffer->page_id = -1;
+    linky_buffer->rows = NULL;
+    linky_buffer->filter_entry = NULL;
+    linky_buffer->filter = NULL;
+    linky_buffer->matches = NULL;
+    linky_buffer->matched_rows = NULL;
+    linky_buffer->filter_generation = 0;
+    linky_buffer->sparkline = NULL;
+    linky_buffer->unacked = NULL;
+    linky_buffer->rate_valid = false;
     linky_buffer->buffer = gtk_text_buffer_new(NULL);
     assert(NULL != linky_buffer->buffer);
 
@@ -392,14 +573,16 @@ static void append_linky_text_buffer(LinkyBuffer *linky_buffer, SearchResult *da
     
     gtk_text_buffer_insert(linky_buffer->buffer, &buffer_end, message->str, (gint) message->len);
 
-    // clickable objects to describe the links in this row
+    // clickable objects to describe the links in this row. They cover the same time as this tab
     Clickable *rack_data = malloc(sizeof(Clickable));
     assert(NULL != rack_data);
+    memcpy(rack_data, &linky_buffer->description, sizeof(Clickable));
     rack_data->type = RACK;
     rack_data->rack_num = data->rack_no;
 
     Clickable *chassis_data = malloc(sizeof(Clickable));
     assert(NULL != chassis_data);
+    memcpy(chassis_data, &linky_buffer->description, sizeof(Clickable));
     chassis_data->type = CHASSIS;
     chassis_data->rack_num = data->rack_no;
     chassis_data->chassis_num = data->chassis_no;
@@ -408,6 +591,7 @@ static void append_linky_text_buffer(LinkyBuffer *linky_buffer, SearchResult *da
     if (data->valve_no >= 0) {
         valve_data = malloc(sizeof(Clickable));
         assert(NULL != valve_data);
+        memcpy(valve_data, &linky_buffer->description, sizeof(Clickable));
         valve_data->type = VALVE;
         valve_data->rack_num = data->rack_no;
         valve_data->chassis_num = data->chassis_no;
@@ -427,15 +611,22 @@ static void append_linky_text_buffer(LinkyBuffer *linky_buffer, SearchResult *da
     gtk_text_buffer_get_iter_at_offset(linky_buffer->buffer, &start, (gint) valve_end);
     gtk_text_buffer_get_end_iter(linky_buffer->buffer, &end);
 
-    GtkTextTag *description = NULL;
+    GtkTextTag *description = gtk_text_buffer_create_tag(linky_buffer->buffer, NULL, NULL);
+    assert(NULL != description);
     // grey out disabled items
     if (!data->enabled) {
-        description = gtk_text_buffer_create_tag(linky_buffer->buffer, NULL,
-            "foreground", "grey", NULL);
-    } else {
-        description = gtk_text_buffer_create_tag(linky_buffer->buffer, NULL, NULL);
+        g_object_set(G_OBJECT(description), "foreground", "grey", NULL);
+    }
+    // and slant acknowledged ones
+    if (data->acked) {
+        g_object_set(G_OBJECT(description), "style", PANGO_STYLE_ITALIC, NULL);
     }
     g_signal_connect(G_OBJECT(description), "event", G_CALLBACK(desc_clicked), (gpointer) ((uintptr_t) data->id));
+    // what the description's menu acts on
+    g_object_set_data(G_OBJECT(description), "tab", linky_buffer);
+    g_object_set_data(G_OBJECT(description), "chassis", chassis_data);
+    g_object_set_data(G_OBJECT(description), "valve", valve_data);
+    g_object_set_data(G_OBJECT(description), "acked", GINT_TO_POINTER(data->acked));
     gtk_text_buffer_apply_tag(linky_buffer->buffer, description, &start, &end);
 
     // links to other pages
@@ -481,23 +672,105 @@ static gint open_tabs_list_compare_by_desc(gconstpointer a, gconstpointer b) {
     return ret;
 }
 
-static void insert_search_result(gpointer data, gpointer user_data) {
-    if ((NULL == data) || (NULL == user_data)) {
+static TabRows *tab_rows_new(GList *results) {
+    TabRows *rows = g_malloc(sizeof(TabRows));
+    assert(NULL != rows);
+
+    rows->results = g_ptr_array_new_full(g_list_length(results), free_search_result);
+    assert(NULL != rows->results);
+    for (GList *item = results; NULL != item; item = item->next) {
+        g_ptr_array_add(rows->results, item->data);
+    }
+    g_list_free(results); // the SearchResults now belong to rows->results
+
+    rows->folded = g_new0(gchar *, rows->results->len);
+    rows->refs = 1;
+    rows->newest_job = 0;
+
+    return rows;
+}
+
+static TabRows *tab_rows_ref(TabRows *rows) {
+    assert(NULL != rows);
+    g_atomic_int_inc(&rows->refs);
+    return rows;
+}
+
+static void tab_rows_unref(TabRows *rows) {
+    if (NULL == rows) {
         return;
     }
 
-    SearchResult *res = (SearchResult *) data;
-    LinkyBuffer *linky_buffer = (LinkyBuffer *) user_data;
+    if (g_atomic_int_dec_and_test(&rows->refs)) {
+        for (guint i = 0; i < rows->results->len; i++) {
+            g_free(rows->folded[i]);
+        }
+        g_free(rows->folded);
+        g_ptr_array_unref(rows->results);
+        g_free(rows);
+    }
+}
+
+// forget the current filter results
+static void clear_filter(LinkyBuffer *linky_buffer) {
+    g_free(linky_buffer->filter);
+    linky_buffer->filter = NULL;
+    if (NULL != linky_buffer->matches) {
+        g_array_unref(linky_buffer->matches);
+        linky_buffer->matches = NULL;
+    }
+    tab_rows_unref(linky_buffer->matched_rows);
+    linky_buffer->matched_rows = NULL;
+}
+
+// casefolded filter typed into the tab's filter bar. NULL if there isn't one
+static gchar *current_needle(const LinkyBuffer *linky_buffer) {
+    if (NULL == linky_buffer->filter_entry) {
+        return NULL;
+    }
+
+    const char *text = gtk_entry_get_text(linky_buffer->filter_entry);
+    if ((NULL == text) || ('\0' == *text)) {
+        return NULL;
+    }
 
-    append_linky_text_buffer(linky_buffer, res);
+    return g_utf8_casefold(text, -1);
 }
 
 static void update_tab(gpointer data, __attribute__((unused)) gpointer unused) {
     assert(NULL != data);
     LinkyBuffer *linky_buffer = (LinkyBuffer *) data;
 
-    // query the database
-    GList *results = search_clickable(&linky_buffer->description);
+    // query the database. Filter jobs on the old rows are pointless now
+    if (NULL != linky_buffer->rows) {
+        g_atomic_int_set(&linky_buffer->rows->newest_job, 0);
+    }
+    tab_rows_unref(linky_buffer->rows);
+    linky_buffer->rows = tab_rows_new(search_clickable(&linky_buffer->description));
+    update_sparkline(linky_buffer);
+    update_unacked(linky_buffer);
+
+    // filter the new rows in the background. What is shown now (and the old filter results which describe it, for
+    // the bulk actions and the status bar) stays until that is done
+    gchar *needle = current_needle(linky_buffer);
+    if (NULL != needle) {
+        EdsacErrorNotebook *self = EDSAC_ERROR_NOTEBOOK(gtk_widget_get_ancestor(GTK_WIDGET(linky_buffer->filter_entry), EDSAC_TYPE_ERROR_NOTEBOOK));
+        if (NULL != self) {
+            start_filter_job(self, linky_buffer, needle, NULL);
+            return;
+        }
+        g_free(needle);
+    }
+
+    // don't let an older filter job replace this
+    linky_buffer->filter_generation = next_filter_generation++;
+    clear_filter(linky_buffer);
+    show_rows(linky_buffer);
+}
+
+// show the rows of linky_buffer which match its filter (all of them if there isn't a filter)
+static void show_rows(LinkyBuffer *linky_buffer) {
+    assert(NULL != linky_buffer);
 
     // clear stuff already in the buffer
     GtkTextIter start;
@@ -512,7 +785,135 @@ static void update_tab(gpointer data, __attribute__((unused)) gpointer unused) {
     g_slist_free_full(linky_buffer->clickables, g_free);
     linky_buffer->clickables = NULL;
 
-    g_list_foreach(results, insert_search_result, (gpointer) linky_buffer);
+    if (NULL == linky_buffer->rows) {
+        return;
+    }
+
+    if (NULL != linky_buffer->filter) {
+        GPtrArray *results = linky_buffer->matched_rows->results;
+        for (guint i = 0; i < linky_buffer->matches->len; i++) {
+            append_linky_text_buffer(linky_buffer, g_ptr_array_index(results, g_array_index(linky_buffer->matches, guint, i)));
+        }
+    } else {
+        GPtrArray *results = linky_buffer->rows->results;
+        for (guint i = 0; i < results->len; i++) {
+            append_linky_text_buffer(linky_buffer, g_ptr_array_index(results, i));
+        }
+    }
+}
+
+/**** Filtering ****/
+// the text of a row as it is shown, so that what is filtered on is what the user sees
+static gchar *row_text(const SearchResult *res) {
+    GString *text = g_string_new(NULL);
+    assert(NULL != text);
+
+    g_string_printf(text, "Rack: %i, Chassis: %i, ", res->rack_no, res->chassis_no);
+    if (res->valve_no >= 0) {
+        g_string_append_printf(text, "Valve: %i: ", res->valve_no);
+    }
+    g_string_append(text, res->message);
+
+    gchar *folded = g_utf8_casefold(text->str, (gssize) text->len);
+    g_string_free(text, TRUE);
+    return folded;
+}
+
+static void free_filter_job(FilterJob *job) {
+    g_object_unref(job->notebook);
+    tab_rows_unref(job->rows);
+    if (NULL != job->candidates) {
+        g_array_unref(job->candidates);
+    }
+    if (NULL != job->matches) {
+        g_array_unref(job->matches);
+    }
+    g_free(job->needle);
+    g_free(job);
+}
+
+// called in the gui thread once a filter job is done
+static gboolean filter_done(gpointer data) {
+    FilterJob *job = data;
+    assert(NULL != job);
+
+    // throw away results for closed tabs and results which have been overtaken
+    LinkyBuffer *linky_buffer = job->tab;
+    if ((NULL == g_slist_find(job->notebook->priv->open_tabs_list, linky_buffer))
+            || (job->generation != linky_buffer->filter_generation) || (job->rows != linky_buffer->rows)) {
+        free_filter_job(job);
+        return G_SOURCE_REMOVE;
+    }
+
+    clear_filter(linky_buffer);
+    linky_buffer->filter = job->needle;
+    job->needle = NULL;
+    linky_buffer->matches = job->matches;
+    job->matches = NULL;
+    linky_buffer->matched_rows = tab_rows_ref(job->rows);
+
+    show_rows(linky_buffer);
+    if (gtk_notebook_get_current_page(GTK_NOTEBOOK(job->notebook)) == linky_buffer->page_id) {
+        update_bar();
+    }
+
+    free_filter_job(job);
+    return G_SOURCE_REMOVE;
+}
+
+// runs in the filter thread
+static void filter_thread(gpointer data, __attribute__((unused)) gpointer unused) {
+    FilterJob *job = data;
+    assert(NULL != job);
+
+    const guint num_rows = job->rows->results->len;
+    const guint num_candidates = (NULL == job->candidates) ? num_rows : job->candidates->len;
+    job->matches = g_array_sized_new(FALSE, FALSE, sizeof(guint), num_candidates);
+    assert(NULL != job->matches);
+
+    for (guint i = 0; i < num_candidates; i++) {
+        // stop early if the user has typed something else. The gui thread ignores the result anyway
+        if ((0 == (i % 4096)) && ((gint) job->generation != g_atomic_int_get(&job->rows->newest_job))) {
+            break;
+        }
+
+        const guint row = (NULL == job->candidates) ? i : g_array_index(job->candidates, guint, i);
+        if (NULL == job->rows->folded[row]) {
+            job->rows->folded[row] = row_text(g_ptr_array_index(job->rows->results, row));
+        }
+
+        if (NULL != strstr(job->rows->folded[row], job->needle)) {
+            g_array_append_val(job->matches, row);
+        }
+    }
+
+    g_idle_add(filter_done, job);
+}
+
+// filter the rows of linky_buffer for needle in the background. Takes ownership of needle and candidates
+static void start_filter_job(EdsacErrorNotebook *self, LinkyBuffer *linky_buffer, gchar *needle, GArray *candidates) {
+    assert(NULL != self);
+    assert(NULL != linky_buffer);
+    assert(NULL != needle);
+
+    if (NULL == filter_pool) {
+        filter_pool = g_thread_pool_new(filter_thread, NULL, 1, FALSE, NULL);
+        assert(NULL != filter_pool);
+    }
+
+    FilterJob *job = g_malloc0(sizeof(FilterJob));
+    assert(NULL != job);
+    job->notebook = g_object_ref(self);
+    job->tab = linky_buffer;
+    job->rows = tab_rows_ref(linky_buffer->rows);
+    job->candidates = candidates;
+    job->needle = needle;
+
+    job->generation = next_filter_generation++;
+    linky_buffer->filter_generation = job->generation;
+    g_atomic_int_set(&linky_buffer->rows->newest_job, (gint) job->generation);
+
+    assert(TRUE == g_thread_pool_push(filter_pool, job, NULL));
 }
 
 
@@ -528,24 +929,212 @@ static void link_clicked(__attribute__((unused)) const GtkTextTag *tag, const Gt
         assert(NULL != data);
         assert(NULL != parent);
         // work up the tree to the notebook
-        GtkWidget *text_view = GTK_WIDGET(parent);
-        GtkWidget *scrolled_window = get_parent(text_view);
-        EdsacErrorNotebook *notebook = EDSAC_ERROR_NOTEBOOK(get_parent(scrolled_window));
+        EdsacErrorNotebook *notebook = EDSAC_ERROR_NOTEBOOK(gtk_widget_get_ancestor(GTK_WIDGET(parent), EDSAC_TYPE_ERROR_NOTEBOOK));
 
         edsac_error_notebook_show_page(notebook, data);
     }
 }
 
+// handler for typing in a tab's filter bar
+static void filter_changed(GtkSearchEntry *entry, LinkyBuffer *linky_buffer) {
+    assert(NULL != entry);
+    assert(NULL != linky_buffer);
+
+    EdsacErrorNotebook *self = EDSAC_ERROR_NOTEBOOK(gtk_widget_get_ancestor(GTK_WIDGET(entry), EDSAC_TYPE_ERROR_NOTEBOOK));
+    if ((NULL == self) || (NULL == linky_buffer->rows)) {
+        return;
+    }
+
+    gchar *needle = current_needle(linky_buffer);
+    if (NULL == needle) {
+        // not filtering any more
+        g_atomic_int_set(&linky_buffer->rows->newest_job, 0);
+        clear_filter(linky_buffer);
+        linky_buffer->filter_generation = next_filter_generation++;
+        show_rows(linky_buffer);
+        update_bar();
+        return;
+    }
+
+    // anything matching the new filter also matched the old one if the old one is part of it, so only those rows need
+    // checking. Unless the old results are for rows which have since been refreshed
+    GArray *candidates = NULL;
+    if ((NULL != linky_buffer->filter) && (linky_buffer->matched_rows == linky_buffer->rows)
+            && (NULL != strstr(needle, linky_buffer->filter))) {
+        candidates = g_array_sized_new(FALSE, FALSE, sizeof(guint), linky_buffer->matches->len);
+        assert(NULL != candidates);
+        g_array_append_vals(candidates, linky_buffer->matches->data, linky_buffer->matches->len);
+    }
+
+    start_filter_job(self, linky_buffer, needle, candidates);
+}
+
+// draws a tab's error rate: one bar per bucket, oldest on the left, scaled to the busiest bucket
+static gboolean draw_sparkline(GtkWidget *widget, cairo_t *cr, LinkyBuffer *linky_buffer) {
+    assert(NULL != widget);
+    assert(NULL != linky_buffer);
+
+    if (!linky_buffer->rate_valid) {
+        return FALSE;
+    }
+
+    guint max = 1;
+    for (size_t i = 0; i < SPARKLINE_BUCKETS; i++) {
+        max = MAX(max, linky_buffer->rate[i]);
+    }
+
+    const double width = gtk_widget_get_allocated_width(widget);
+    const double height = gtk_widget_get_allocated_height(widget);
+    const double bar_width = width / SPARKLINE_BUCKETS;
+
+    // the same colour as the text
+    GdkRGBA colour;
+    GtkStyleContext *style = gtk_widget_get_style_context(widget);
+    gtk_style_context_get_color(style, gtk_style_context_get_state(style), &colour);
+    gdk_cairo_set_source_rgba(cr, &colour);
+
+    for (size_t i = 0; i < SPARKLINE_BUCKETS; i++) {
+        if (0 == linky_buffer->rate[i]) {
+            continue;
+        }
+        const double bar_height = MAX(1.0, height * linky_buffer->rate[i] / max);
+        cairo_rectangle(cr, (double) i * bar_width, height - bar_height, MAX(1.0, bar_width - 1.0), bar_height);
+    }
+    cairo_fill(cr);
+
+    return FALSE;
+}
+
+// open the tab for a node clicked on in the overview
+static void dashboard_clicked(const unsigned int rack_no, const unsigned int chassis_no, gpointer data) {
+    EdsacErrorNotebook *self = data;
+    assert(NULL != self);
+
+    Clickable node;
+    memset(&node, 0, sizeof(node));
+    node.type = CHASSIS;
+    node.rack_num = rack_no;
+    node.chassis_num = chassis_no;
+    node.time_range = DEFAULT_TIME_RANGE;
+    edsac_error_notebook_show_page(self, &node);
+}
+
+// open the tab for a row of the top offenders panel
+static void offender_clicked(const Clickable *link, gpointer data) {
+    EdsacErrorNotebook *self = data;
+    assert(NULL != self);
+    edsac_error_notebook_show_page(self, link);
+}
+
 static void disable_click(const uintptr_t id) {
     error_toggle_disabled(id);
     gui_update(NULL);
 }
 
+// make a bulk change to every error matching search
+static int change_matching(const Clickable *search, const BulkChange change) {
+    switch (change) {
+        case BULK_ENABLE:
+        case BULK_DISABLE:
+            return set_errors_enabled(search, BULK_ENABLE == change);
+        case BULK_ACK:
+        case BULK_UNACK:
+            return set_errors_acked(search, BULK_ACK == change, g_get_user_name());
+        default:
+            assert(false);
+            return -1;
+    }
+}
+
+// make a bulk change to errors chosen by id
+static int change_ids(const GArray *ids, const BulkChange change) {
+    switch (change) {
+        case BULK_ENABLE:
+        case BULK_DISABLE:
+            return set_error_ids_enabled(ids, BULK_ENABLE == change);
+        case BULK_ACK:
+        case BULK_UNACK:
+            return set_error_ids_acked(ids, BULK_ACK == change, g_get_user_name());
+        default:
+            assert(false);
+            return -1;
+    }
+}
+
+// changes every error matching the menu item's Clickable (see matching_menu_item) in one go
+static void matching_click(GtkMenuItem *menu_item, gpointer change) {
+    const Clickable *search = g_object_get_data(G_OBJECT(menu_item), "search");
+    assert(NULL != search);
+
+    if (change_matching(search, (BulkChange) GPOINTER_TO_INT(change)) < 0) {
+        puts("Error changing errors");
+    }
+    gui_update(NULL);
+}
+
+// changes the errors whose ids are attached to the menu item (see ids_menu_item) in one go
+static void ids_click(GtkMenuItem *menu_item, gpointer change) {
+    const GArray *ids = g_object_get_data(G_OBJECT(menu_item), "ids");
+    assert(NULL != ids);
+
+    if (change_ids(ids, (BulkChange) GPOINTER_TO_INT(change)) < 0) {
+        puts("Error changing errors");
+    }
+    gui_update(NULL);
+}
+
+static void free_ids(gpointer ids) {
+    g_array_unref(ids);
+}
+
+// menu item changing every error matching search. search is copied because a tab's Clickables are freed when it is refreshed
+static GtkWidget *matching_menu_item(const char *label, const Clickable *search, const BulkChange change) {
+    GtkWidget *menu_item = gtk_menu_item_new_with_label(label);
+    assert(NULL != menu_item);
+
+    Clickable *copy = g_malloc(sizeof(Clickable));
+    assert(NULL != copy);
+    memcpy(copy, search, sizeof(Clickable));
+    g_object_set_data_full(G_OBJECT(menu_item), "search", copy, g_free);
+    g_signal_connect(G_OBJECT(menu_item), "activate", G_CALLBACK(matching_click), GINT_TO_POINTER(change));
+
+    return menu_item;
+}
+
+// menu item changing the errors in ids (a GArray of gint64), which it takes
+static GtkWidget *ids_menu_item(const char *label, GArray *ids, const BulkChange change) {
+    GtkWidget *menu_item = gtk_menu_item_new_with_label(label);
+    assert(NULL != menu_item);
+
+    g_object_set_data_full(G_OBJECT(menu_item), "ids", ids, free_ids);
+    g_signal_connect(G_OBJECT(menu_item), "activate", G_CALLBACK(ids_click), GINT_TO_POINTER(change));
+
+    return menu_item;
+}
+
+// ids of the errors shown in a tab whose filter bar is in use, as they are now
+static GArray *shown_ids(const LinkyBuffer *linky_buffer) {
+    GArray *ids = g_array_sized_new(FALSE, FALSE, sizeof(gint64), linky_buffer->matches->len);
+    assert(NULL != ids);
+    for (guint i = 0; i < linky_buffer->matches->len; i++) {
+        const SearchResult *res = g_ptr_array_index(linky_buffer->matched_rows->results, g_array_index(linky_buffer->matches, guint, i));
+        const gint64 id = res->id;
+        g_array_append_val(ids, id);
+    }
+
+    return ids;
+}
+
 // handler for when a description is clicked
-static void desc_clicked(__attribute((unused)) const GtkTextTag *tag , __attribute__((unused)) const GtkTextView *parent, const GdkEvent *event,
+static void desc_clicked(GtkTextTag *tag , __attribute__((unused)) const GtkTextView *parent, const GdkEvent *event,
         __attribute__((unused)) const GtkTextIter *iter, const gpointer error_id) {
     assert(NULL != event);
 
+    // everything in the menu changes the database
+    if (database_read_only()) {
+        return;
+    }
+
     // was it a click?
     GdkEventButton *event_btn = (GdkEventButton *) event;
     if (event->type == GDK_BUTTON_PRESS && event_btn->button == 1) { // left click. Not using right click because TextView already has a context menu that we can't remove
@@ -559,6 +1148,62 @@ static void desc_clicked(__attribute((unused)) const GtkTextTag *tag , __attribu
         g_signal_connect_swapped(G_OBJECT(menu_item), "activate", G_CALLBACK(disable_click), error_id);
 
         gtk_menu_shell_append(GTK_MENU_SHELL(menu), menu_item);
+
+        // acknowledging this error, and who did it if it already is
+        const gint64 id = (gint64) ((uintptr_t) error_id);
+        GArray *this_id = g_array_sized_new(FALSE, FALSE, sizeof(gint64), 1);
+        assert(NULL != this_id);
+        g_array_append_val(this_id, id);
+        if (GPOINTER_TO_INT(g_object_get_data(G_OBJECT(tag), "acked"))) {
+            gtk_menu_shell_append(GTK_MENU_SHELL(menu), ids_menu_item("Un-acknowledge", this_id, BULK_UNACK));
+
+            time_t ack_time = 0;
+            char *user = NULL;
+            if (error_ack_info(id, &ack_time, &user)) {
+                char time_str[64];
+                strftime(time_str, sizeof(time_str), "%c", localtime(&ack_time));
+                gchar *label = g_strdup_printf("Acknowledged by %s at %s", user, time_str);
+                GtkWidget *info = gtk_menu_item_new_with_label(label);
+                assert(NULL != info);
+                gtk_widget_set_sensitive(info, FALSE);
+                gtk_menu_shell_append(GTK_MENU_SHELL(menu), info);
+                g_free(label);
+                g_free(user);
+            }
+        } else {
+            gtk_menu_shell_append(GTK_MENU_SHELL(menu), ids_menu_item("Acknowledge", this_id, BULK_ACK));
+        }
+
+        // everything from this error's valve or node, whenever it was received
+        const Clickable *valve_data = g_object_get_data(G_OBJECT(tag), "valve");
+        const Clickable *chassis_data = g_object_get_data(G_OBJECT(tag), "chassis");
+        Clickable source;
+        if (NULL != valve_data) {
+            memcpy(&source, valve_data, sizeof(source));
+            source.time_range = TIME_ALL;
+            gtk_menu_shell_append(GTK_MENU_SHELL(menu), matching_menu_item("Disable All From This Valve", &source, BULK_DISABLE));
+        }
+        if (NULL != chassis_data) {
+            memcpy(&source, chassis_data, sizeof(source));
+            source.time_range = TIME_ALL;
+            gtk_menu_shell_append(GTK_MENU_SHELL(menu), matching_menu_item("Disable All From This Node", &source, BULK_DISABLE));
+        }
+
+        // everything in the tab. Only the rows left by the filter bar if it is in use
+        const LinkyBuffer *linky_buffer = g_object_get_data(G_OBJECT(tag), "tab");
+        if (NULL != linky_buffer) {
+            gtk_menu_shell_append(GTK_MENU_SHELL(menu), gtk_separator_menu_item_new());
+            if (NULL != linky_buffer->filter) {
+                gtk_menu_shell_append(GTK_MENU_SHELL(menu), ids_menu_item("Disable All Shown", shown_ids(linky_buffer), BULK_DISABLE));
+                gtk_menu_shell_append(GTK_MENU_SHELL(menu), ids_menu_item("Enable All Shown", shown_ids(linky_buffer), BULK_ENABLE));
+                gtk_menu_shell_append(GTK_MENU_SHELL(menu), ids_menu_item("Acknowledge All Shown", shown_ids(linky_buffer), BULK_ACK));
+            } else {
+                gtk_menu_shell_append(GTK_MENU_SHELL(menu), matching_menu_item("Disable All In This Tab", &linky_buffer->description, BULK_DISABLE));
+                gtk_menu_shell_append(GTK_MENU_SHELL(menu), matching_menu_item("Enable All In This Tab", &linky_buffer->description, BULK_ENABLE));
+                gtk_menu_shell_append(GTK_MENU_SHELL(menu), matching_menu_item("Acknowledge All In This Tab", &linky_buffer->description, BULK_ACK));
+            }
+        }
+
         gtk_widget_show_all(menu);
         gtk_menu_popup_at_pointer(GTK_MENU(menu), event); 
     }
@@ -617,15 +1262,62 @@ static GtkWidget *put_in_scroll(GtkWidget *thing) {
     return scroll;
 }
 
+// reload a tab's error rate from the rollup
+static void update_sparkline(LinkyBuffer *linky_buffer) {
+    assert(NULL != linky_buffer);
+
+    linky_buffer->rate_valid = rollup_clickable(&linky_buffer->description, time(NULL), SPARKLINE_BUCKET_SECONDS,
+        SPARKLINE_BUCKETS, linky_buffer->rate);
+
+    if (NULL != linky_buffer->sparkline) {
+        gtk_widget_queue_draw(linky_buffer->sparkline);
+    }
+}
+
+// show a tab's unacknowledged errors from the counters in unacked.h. Hidden if there are none or they can't describe the tab
+static void update_unacked(LinkyBuffer *linky_buffer) {
+    assert(NULL != linky_buffer);
+    if (NULL == linky_buffer->unacked) {
+        return;
+    }
+
+    const gint64 count = unacked_count(&linky_buffer->description);
+    if (count <= 0) {
+        gtk_widget_hide(linky_buffer->unacked);
+        return;
+    }
+
+    gchar *text = g_strdup_printf("%" G_GINT64_FORMAT, count);
+    gtk_label_set_text(GTK_LABEL(linky_buffer->unacked), text);
+    g_free(text);
+    gtk_widget_show(linky_buffer->unacked);
+}
+
 // creates the widget used to label a tab
-static GtkWidget *tab_label(const char *msg, GtkWidget *contents) {
-    assert(NULL != msg);
+static GtkWidget *tab_label(LinkyBuffer *linky_buffer, GtkWidget *contents) {
+    assert(NULL != linky_buffer);
     assert(NULL != contents);
 
     // text - using a status bar so that the style matches
     //GtkWidget *text = gtk_label_new(msg);
     GtkWidget *text = gtk_statusbar_new();
-    gtk_statusbar_push(GTK_STATUSBAR(text), 0, msg);
+    gtk_statusbar_push(GTK_STATUSBAR(text), 0, linky_buffer->title->str);
+
+    // error rate. Replaces the one in any previous label
+    GtkWidget *sparkline = gtk_drawing_area_new();
+    assert(NULL != sparkline);
+    gtk_widget_set_size_request(sparkline, SPARKLINE_WIDTH, SPARKLINE_HEIGHT);
+    gtk_widget_set_valign(sparkline, GTK_ALIGN_CENTER);
+    gtk_widget_set_tooltip_text(sparkline, "Errors per minute over the last half hour");
+    g_signal_connect(G_OBJECT(sparkline), "draw", G_CALLBACK(draw_sparkline), linky_buffer);
+    linky_buffer->sparkline = sparkline;
+
+    // unacknowledged errors. Replaces the one in any previous label
+    GtkWidget *unacked = gtk_label_new(NULL);
+    assert(NULL != unacked);
+    gtk_widget_set_tooltip_text(unacked, "Unacknowledged errors");
+    gtk_widget_set_no_show_all(unacked, TRUE);
+    linky_buffer->unacked = unacked;
 
     // close button
     GtkWidget *close = gtk_button_new_from_icon_name("window-close", GTK_ICON_SIZE_BUTTON);
@@ -634,6 +1326,8 @@ static GtkWidget *tab_label(const char *msg, GtkWidget *contents) {
     // container
     GtkWidget *box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 1);
     gtk_box_pack_start(GTK_BOX(box), text, TRUE, TRUE, 0);
+    gtk_box_pack_start(GTK_BOX(box), sparkline, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(box), unacked, FALSE, FALSE, 0);
     gtk_box_pack_start(GTK_BOX(box), close, FALSE, FALSE, 0);
 
     // put it in a frame so we get boarders
@@ -686,9 +1380,27 @@ static void edsac_error_notebook_instance_init(EdsacErrorNotebook *self) {
 
     self->priv->open_tabs_list = NULL; // empty slist
 
+    // overview first so that it stays on the left
+    self->priv->heatmap = heatmap_new(dashboard_clicked, self);
+    assert(NULL != self->priv->heatmap);
+    self->priv->top_offenders = top_offenders_new(offender_clicked, self);
+    assert(NULL != self->priv->top_offenders);
+    self->priv->dashboard = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 0);
+    assert(NULL != self->priv->dashboard);
+    gtk_box_pack_start(GTK_BOX(self->priv->dashboard), self->priv->heatmap, TRUE, TRUE, 0);
+    GtkWidget *offenders_scroll = put_in_scroll(self->priv->top_offenders);
+    gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(offenders_scroll), GTK_POLICY_NEVER, GTK_POLICY_AUTOMATIC);
+    gtk_scrolled_window_set_min_content_width(GTK_SCROLLED_WINDOW(offenders_scroll), 300);
+    gtk_box_pack_start(GTK_BOX(self->priv->dashboard), offenders_scroll, FALSE, FALSE, 0);
+    gint index = gtk_notebook_append_page(&self->parent_instance, self->priv->dashboard, gtk_label_new("Overview"));
+    assert(-1 != index);
+    gtk_widget_show_all(self->priv->dashboard);
+
     Clickable *all_desc = malloc(sizeof(Clickable));
     assert(NULL != all_desc);
+    memset(all_desc, 0, sizeof(Clickable));
     all_desc->type = ALL;
+    all_desc->time_range = DEFAULT_TIME_RANGE; // so that start up doesn't load the whole history
 
     LinkyBuffer *all = (LinkyBuffer *) add_new_page_to_notebook(self, all_desc);
     assert(NULL != all);
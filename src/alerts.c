@@ -0,0 +1,373 @@
+/*
+ * Copyright 2017
+ * GPL3 Licensed
+ * alerts.c
+ * Rules checked against every received error which raise a desktop notification, a bell or a banner
+ */
+
+// includes
+#include "config.h"
+#include "alerts.h"
+#include "clickable.h"
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+// rules are indexed by rack, chassis and type. ANY stands for a rule which doesn't limit the rack or chassis
+#define ANY 0x1FF
+#define INDEX_KEY(rack_no, chassis_no, type) GUINT_TO_POINTER((((rack_no) & 0x1FF) << 11) | (((chassis_no) & 0x1FF) << 2) | (type))
+
+// alerts waiting for alerts_take. The oldest are dropped past this (e.g. with no window to show them)
+#define ALERT_PENDING_LIMIT 256
+
+#define GROUP_PREFIX "alert "
+
+// kinds of error a rule can be limited to, as bits of AlertRule.types
+typedef enum {
+    TYPE_VALVE,
+    TYPE_HARDWARE,
+    TYPE_SOFTWARE,
+    NUM_TYPES
+} AlertType;
+
+static const char *type_names[NUM_TYPES] = {"valve", "hardware", "software"};
+
+// errors from one chassis matching one rule
+typedef struct {
+    guint buckets[ALERT_BUCKETS]; // a ring. buckets[newest % ALERT_BUCKETS] is the newest
+    gint64 newest;  // slot (time / slot width) of the newest bucket
+    bool fired;
+    time_t fired_time;
+} AlertCounter;
+
+typedef struct {
+    char *name;
+    int rack_no;        // ANY if not limited
+    int chassis_no;
+    unsigned int types; // bits of AlertType
+    unsigned int actions;
+    guint count;
+    guint seconds;
+    GHashTable *counters; // NODE_KEY -> AlertCounter
+} AlertRule;
+
+static GMutex alerts_lock; // protects everything below
+static GPtrArray *rules = NULL; // AlertRules
+static GHashTable *rule_index = NULL; // INDEX_KEY -> GPtrArray of AlertRules (owned by rules)
+static GQueue pending = G_QUEUE_INIT; // Alerts
+
+// functions
+
+static void free_rule(gpointer data) {
+    AlertRule *rule = data;
+    g_free(rule->name);
+    g_hash_table_destroy(rule->counters);
+    g_free(rule);
+}
+
+static void free_rule_list(gpointer list) {
+    g_ptr_array_unref(list);
+}
+
+void free_alert(gpointer data) {
+    Alert *alert = data;
+    g_free(alert->rule);
+    g_free(alert->description);
+    g_free(alert);
+}
+
+// read an optional number from min to max from a rule's group. false if it is there but isn't valid
+static bool rule_number(GKeyFile *key_file, const char *group, const char *key, const gint min, const gint max, gint *value) {
+    if (!g_key_file_has_key(key_file, group, key, NULL)) {
+        return true;
+    }
+
+    GError *error = NULL;
+    const gint number = g_key_file_get_integer(key_file, group, key, &error);
+    if ((NULL != error) || (number < min) || (number > max)) {
+        if (NULL != error) {
+            g_error_free(error);
+        }
+        return false;
+    }
+
+    *value = number;
+    return true;
+}
+
+// read an optional list of names from a rule's group as bits (1 << index in names). false if a name isn't known
+static bool rule_names(GKeyFile *key_file, const char *group, const char *key, const char **names, const int num_names,
+        unsigned int *bits) {
+    gsize len = 0;
+    gchar **list = g_key_file_get_string_list(key_file, group, key, &len, NULL);
+    if (NULL == list) {
+        return true;
+    }
+
+    bool ret = true;
+    unsigned int read = 0;
+    for (gsize i = 0; ret && (i < len); i++) {
+        gchar *name = g_strstrip(list[i]);
+        ret = false;
+        for (int n = 0; n < num_names; n++) {
+            if (0 == strcmp(name, names[n])) {
+                read |= 1u << n;
+                ret = true;
+            }
+        }
+    }
+    g_strfreev(list);
+
+    if (ret && (0 != read)) {
+        *bits = read;
+    }
+    return ret;
+}
+
+// a rule from its group in key_file. NULL if it isn't valid
+static AlertRule *parse_rule(GKeyFile *key_file, const char *group) {
+    static const char *action_names[] = {"notify", "bell", "banner"};
+
+    gint rack_no = ANY;
+    gint chassis_no = ANY;
+    gint count = 1;
+    gint seconds = 60;
+    unsigned int types = (1u << NUM_TYPES) - 1;
+    unsigned int actions = ALERT_NOTIFY;
+
+    if (!rule_number(key_file, group, "rack", 0, 255, &rack_no)
+            || !rule_number(key_file, group, "chassis", 0, 255, &chassis_no)
+            || !rule_number(key_file, group, "count", 1, G_MAXINT, &count)
+            || !rule_number(key_file, group, "seconds", 1, G_MAXINT, &seconds)
+            || !rule_names(key_file, group, "type", type_names, NUM_TYPES, &types)
+            || !rule_names(key_file, group, "action", action_names, (int) G_N_ELEMENTS(action_names), &actions)) {
+        return NULL;
+    }
+
+    AlertRule *rule = g_malloc(sizeof(AlertRule));
+    assert(NULL != rule);
+    rule->name = g_strdup(group + strlen(GROUP_PREFIX));
+    rule->rack_no = rack_no;
+    rule->chassis_no = chassis_no;
+    rule->types = types;
+    rule->actions = actions;
+    rule->count = (guint) count;
+    rule->seconds = (guint) seconds;
+    rule->counters = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+    assert(NULL != rule->counters);
+
+    return rule;
+}
+
+// index rules by every rack, chassis and type they can match
+static GHashTable *index_rules(const GPtrArray *new_rules) {
+    GHashTable *index = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, free_rule_list);
+    assert(NULL != index);
+
+    for (guint i = 0; i < new_rules->len; i++) {
+        AlertRule *rule = g_ptr_array_index(new_rules, i);
+        for (unsigned int type = 0; type < NUM_TYPES; type++) {
+            if (0 == (rule->types & (1u << type))) {
+                continue;
+            }
+
+            gpointer key = INDEX_KEY((unsigned int) rule->rack_no, (unsigned int) rule->chassis_no, type);
+            GPtrArray *list = g_hash_table_lookup(index, key);
+            if (NULL == list) {
+                list = g_ptr_array_new();
+                assert(NULL != list);
+                g_hash_table_insert(index, key, list);
+            }
+            g_ptr_array_add(list, rule);
+        }
+    }
+
+    return index;
+}
+
+// swap in new rules (or none if NULL)
+static void replace_rules(GPtrArray *new_rules) {
+    GHashTable *new_index = (NULL == new_rules) ? NULL : index_rules(new_rules);
+
+    g_mutex_lock(&alerts_lock);
+    GPtrArray *old_rules = rules;
+    GHashTable *old_index = rule_index;
+    rules = new_rules;
+    rule_index = new_index;
+    g_mutex_unlock(&alerts_lock);
+
+    if (NULL != old_index) {
+        g_hash_table_destroy(old_index);
+    }
+    if (NULL != old_rules) {
+        g_ptr_array_unref(old_rules);
+    }
+}
+
+void alerts_clear_rules(void) {
+    replace_rules(NULL);
+}
+
+bool alerts_load_rules(const char *path) {
+    assert(NULL != path);
+
+    if (0 != access(path, F_OK)) {
+        alerts_clear_rules();
+        return true; // no config file: no rules
+    }
+
+    GKeyFile *key_file = g_key_file_new();
+    assert(NULL != key_file);
+    g_key_file_set_list_separator(key_file, ',');
+
+    GError *error = NULL;
+    if (!g_key_file_load_from_file(key_file, path, G_KEY_FILE_NONE, &error)) {
+        fprintf(stderr, "Unable to read %s: %s\n", path, error->message);
+        g_error_free(error);
+        g_key_file_free(key_file);
+        return false;
+    }
+
+    bool ret = true;
+    GPtrArray *new_rules = g_ptr_array_new_with_free_func(free_rule);
+    assert(NULL != new_rules);
+    gchar **groups = g_key_file_get_groups(key_file, NULL);
+    for (gsize i = 0; ret && (NULL != groups[i]); i++) {
+        if (!g_str_has_prefix(groups[i], GROUP_PREFIX)) {
+            continue;
+        }
+
+        AlertRule *rule = parse_rule(key_file, groups[i]);
+        if (NULL == rule) {
+            fprintf(stderr, "%s: alert rule [%s] isn't valid\n", path, groups[i]);
+            ret = false;
+        } else {
+            g_ptr_array_add(new_rules, rule);
+        }
+    }
+    g_strfreev(groups);
+    g_key_file_free(key_file);
+
+    if (ret) {
+        replace_rules(new_rules);
+    } else {
+        g_ptr_array_unref(new_rules);
+    }
+    return ret;
+}
+
+guint alerts_rule_count(void) {
+    g_mutex_lock(&alerts_lock);
+    const guint count = (NULL == rules) ? 0 : rules->len;
+    g_mutex_unlock(&alerts_lock);
+
+    return count;
+}
+
+// count an error at slot in counter's ring. Returns the errors in the window ending at the newest slot
+static guint count_error(AlertCounter *counter, const gint64 slot) {
+    if (slot > counter->newest) {
+        // clear the buckets the window has moved past
+        const gint64 moved = MIN(slot - counter->newest, ALERT_BUCKETS);
+        for (gint64 i = 1; i <= moved; i++) {
+            counter->buckets[(counter->newest + i) % ALERT_BUCKETS] = 0;
+        }
+        counter->newest = slot;
+    }
+
+    // errors older than the window aren't counted
+    if (slot > counter->newest - ALERT_BUCKETS) {
+        counter->buckets[slot % ALERT_BUCKETS]++;
+    }
+
+    guint total = 0;
+    for (int i = 0; i < ALERT_BUCKETS; i++) {
+        total += counter->buckets[i];
+    }
+    return total;
+}
+
+// call with alerts_lock held
+static void check_rule(AlertRule *rule, const unsigned int rack_no, const unsigned int chassis_no, const int valve_no,
+        const time_t recv_time, const char *description) {
+    // the window is ALERT_BUCKETS slots of at least a second
+    const gint64 slot_seconds = MAX(1, (rule->seconds + ALERT_BUCKETS - 1) / ALERT_BUCKETS);
+    const gint64 slot = recv_time / slot_seconds;
+
+    AlertCounter *counter = g_hash_table_lookup(rule->counters, NODE_KEY(rack_no, chassis_no));
+    if (NULL == counter) {
+        counter = g_malloc0(sizeof(AlertCounter));
+        assert(NULL != counter);
+        counter->newest = slot;
+        g_hash_table_insert(rule->counters, NODE_KEY(rack_no, chassis_no), counter);
+    }
+
+    const guint count = count_error(counter, slot);
+    if ((count < rule->count) || (counter->fired && (recv_time < counter->fired_time + rule->seconds))) {
+        return;
+    }
+    counter->fired = true;
+    counter->fired_time = recv_time;
+
+    Alert *alert = g_malloc(sizeof(Alert));
+    assert(NULL != alert);
+    alert->rule = g_strdup(rule->name);
+    alert->actions = rule->actions;
+    alert->rack_no = rack_no;
+    alert->chassis_no = chassis_no;
+    alert->valve_no = valve_no;
+    alert->count = count;
+    alert->time = recv_time;
+    alert->description = g_strdup(description);
+
+    g_queue_push_tail(&pending, alert);
+    if (pending.length > ALERT_PENDING_LIMIT) {
+        free_alert(g_queue_pop_head(&pending));
+    }
+}
+
+void alerts_check(const MessageType type, const unsigned int rack_no, const unsigned int chassis_no, const int valve_no,
+        const time_t recv_time, const char *description) {
+    assert(NULL != description);
+
+    unsigned int alert_type = NUM_TYPES;
+    switch (type) {
+        case HARD_ERROR_VALVE:
+            alert_type = TYPE_VALVE;
+            break;
+        case HARD_ERROR_OTHER:
+            alert_type = TYPE_HARDWARE;
+            break;
+        case SOFT_ERROR:
+            alert_type = TYPE_SOFTWARE;
+            break;
+        default:
+            return;
+    }
+
+    g_mutex_lock(&alerts_lock);
+    if (NULL != rule_index) {
+        // rules for this node, its rack, its chassis number in any rack and everywhere
+        const unsigned int racks[2] = {rack_no, ANY};
+        const unsigned int chassis[2] = {chassis_no, ANY};
+        for (int r = 0; r < 2; r++) {
+            for (int c = 0; c < 2; c++) {
+                const GPtrArray *list = g_hash_table_lookup(rule_index, INDEX_KEY(racks[r], chassis[c], alert_type));
+                for (guint i = 0; (NULL != list) && (i < list->len); i++) {
+                    check_rule(g_ptr_array_index(list, i), rack_no, chassis_no, valve_no, recv_time, description);
+                }
+            }
+        }
+    }
+    g_mutex_unlock(&alerts_lock);
+}
+
+GList *alerts_take(void) {
+    g_mutex_lock(&alerts_lock);
+    GList *alerts = pending.head;
+    g_queue_init(&pending);
+    g_mutex_unlock(&alerts_lock);
+
+    return alerts;
+}
@@ -0,0 +1,653 @@
+/*
+ * Copyright 2017
+ * GPL3 Licensed
+ * archive.c
+ * Cold storage of old errors in compressed archive files
+ *
+ * An archive is a gzip stream holding ARCHIVE_MAGIC, a version byte and then blocks of up to ARCHIVE_BLOCK_ROWS errors:
+ *     varint number of rows (0 marks the end of the archive)
+ *     varint number of descriptions first used in this block, then each of them as a varint length and the bytes
+ *     each column as a varint length in bytes followed by the column
+ * The columns are (in order) receive time as a zigzag varint delta from the previous row, rack number (varint),
+ * chassis number (varint), valve number (zigzag varint), enabled (one byte each), description as a varint index
+ * into the descriptions seen so far in the archive and acknowledged (one byte each). Version 1 archives don't have the
+ * acknowledged column: their errors are read as unacknowledged.
+ */
+
+// includes
+#include "config.h"
+#include "archive.h"
+#include "sql.h"
+#include "filter.h"
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <gio/gio.h>
+
+#define ARCHIVE_MAGIC "EDSACARC"
+#define ARCHIVE_MAGIC_LEN 8
+#define ARCHIVE_VERSION 2
+#define ARCHIVE_VERSION_UNACKED 1 // the oldest version we can read, from before acknowledgements were archived
+#define ARCHIVE_BLOCK_ROWS 4096
+#define ARCHIVE_MAX_CHUNK (64 * 1024 * 1024) // refuse to allocate more than this for one column (corrupt archive)
+#define IMPORT_BATCH_ROWS 10000 // rows imported per transaction
+
+typedef enum {
+    COLUMN_TIME,
+    COLUMN_RACK,
+    COLUMN_CHASSIS,
+    COLUMN_VALVE,
+    COLUMN_ENABLED,
+    COLUMN_DESCRIPTION,
+    COLUMN_ACKED,
+    NUM_COLUMNS
+} ArchiveColumn;
+
+// state while writing an archive
+typedef struct {
+    GOutputStream *out;             // compressed stream to the file
+    GHashTable *descriptions;       // description -> index + 1 (so that NULL means not seen)
+    guint num_descriptions;
+    time_t last_time;               // receive time of the previous row
+    guint rows;                     // rows in the current block
+    guint new_descriptions;         // descriptions first seen in the current block
+    GByteArray *description_table;  // the new descriptions
+    GByteArray *columns[NUM_COLUMNS];
+    gint64 total_rows;
+    bool failed;
+} ArchiveWriter;
+
+// state while searching an archive
+typedef struct {
+    const Clickable *search;
+    const Filter *filter; // FILTER searches only
+    time_t since;       // time range of search. 0 for unbounded
+    time_t until;
+    gchar *text;        // casefolded. NULL matches everything
+    GArray *matches;    // gint8 per description id: 0 unknown, 1 doesn't match, 2 matches
+    error_row_func_t func; // called for each matching row
+    gpointer user_data;
+    gint64 rows;        // matching rows so far
+} ArchiveSearch;
+
+// state while importing an archive
+typedef struct {
+    gint64 rows;
+    unsigned int rows_in_batch;
+    bool batch_open; // restore_error can fail before the batch holds any rows
+} ArchiveImport;
+
+// functions
+
+// zigzag encoding keeps small negative numbers small
+static guint64 zigzag_encode(const gint64 value) {
+    return (((guint64) value) << 1) ^ ((guint64) (value >> 63));
+}
+
+static gint64 zigzag_decode(const guint64 value) {
+    return ((gint64) (value >> 1)) ^ (-((gint64) (value & 1)));
+}
+
+// append value as a little endian base 128 varint
+static void put_varint(GByteArray *array, guint64 value) {
+    assert(NULL != array);
+
+    guint8 byte = 0;
+    while (value >= 0x80) {
+        byte = (guint8) ((value & 0x7F) | 0x80);
+        g_byte_array_append(array, &byte, 1);
+        value >>= 7;
+    }
+    byte = (guint8) value;
+    g_byte_array_append(array, &byte, 1);
+}
+
+// read a varint out of a buffer, advancing pos. Returns false if it runs off the end
+static bool get_varint(const guint8 **pos, const guint8 *end, guint64 *value) {
+    guint64 result = 0;
+    for (unsigned int shift = 0; shift < 64; shift += 7) {
+        if (*pos >= end) {
+            return false;
+        }
+
+        const guint8 byte = **pos;
+        *pos += 1;
+        result |= ((guint64) (byte & 0x7F)) << shift;
+
+        if (0 == (byte & 0x80)) {
+            *value = result;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// read a varint straight out of the (buffered) stream
+static bool read_stream_varint(GDataInputStream *in, guint64 *value) {
+    guint64 result = 0;
+    for (unsigned int shift = 0; shift < 64; shift += 7) {
+        GError *error = NULL;
+        const guchar byte = g_data_input_stream_read_byte(in, NULL, &error);
+        if (NULL != error) {
+            g_error_free(error);
+            return false;
+        }
+
+        result |= ((guint64) (byte & 0x7F)) << shift;
+
+        if (0 == (byte & 0x80)) {
+            *value = result;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// read a varint length and then that many bytes. The result is nul terminated. NULL on failure
+static guint8 *read_chunk(GDataInputStream *in, gsize *len_out) {
+    guint64 len = 0;
+    if (!read_stream_varint(in, &len) || (len > ARCHIVE_MAX_CHUNK)) {
+        return NULL;
+    }
+
+    guint8 *chunk = g_malloc((gsize) len + 1);
+    assert(NULL != chunk);
+
+    gsize bytes_read = 0;
+    if (!g_input_stream_read_all(G_INPUT_STREAM(in), chunk, (gsize) len, &bytes_read, NULL, NULL) || (bytes_read != len)) {
+        g_free(chunk);
+        return NULL;
+    }
+    chunk[len] = '\0';
+
+    if (NULL != len_out) {
+        *len_out = (gsize) len;
+    }
+    return chunk;
+}
+
+// write out the current block (if there is anything in it)
+static bool write_block(ArchiveWriter *writer) {
+    assert(NULL != writer);
+
+    if (0 == writer->rows) {
+        return true;
+    }
+
+    GByteArray *block = g_byte_array_new();
+    assert(NULL != block);
+
+    put_varint(block, writer->rows);
+    put_varint(block, writer->new_descriptions);
+    g_byte_array_append(block, writer->description_table->data, writer->description_table->len);
+    for (int column = 0; column < NUM_COLUMNS; column++) {
+        put_varint(block, writer->columns[column]->len);
+        g_byte_array_append(block, writer->columns[column]->data, writer->columns[column]->len);
+    }
+
+    GError *error = NULL;
+    const bool ret = g_output_stream_write_all(writer->out, block->data, block->len, NULL, NULL, &error);
+    if (!ret) {
+        fprintf(stderr, "Error writing archive: %s\n", error->message);
+        g_error_free(error);
+    }
+    g_byte_array_unref(block);
+
+    // start a new block
+    writer->rows = 0;
+    writer->new_descriptions = 0;
+    g_byte_array_set_size(writer->description_table, 0);
+    for (int column = 0; column < NUM_COLUMNS; column++) {
+        g_byte_array_set_size(writer->columns[column], 0);
+    }
+
+    return ret;
+}
+
+// implements error_row_func_t to add a row to the archive
+static bool write_row(const time_t recv_time, const unsigned int rack_no, const unsigned int chassis_no,
+        const int valve_no, const bool enabled, const bool acked, const char *description, gpointer user_data) {
+    assert(NULL != description);
+    assert(NULL != user_data);
+    ArchiveWriter *writer = user_data;
+
+    put_varint(writer->columns[COLUMN_TIME], zigzag_encode((gint64) (recv_time - writer->last_time)));
+    writer->last_time = recv_time;
+
+    put_varint(writer->columns[COLUMN_RACK], rack_no);
+    put_varint(writer->columns[COLUMN_CHASSIS], chassis_no);
+    put_varint(writer->columns[COLUMN_VALVE], zigzag_encode(valve_no));
+
+    const guint8 enabled_byte = enabled ? 1 : 0;
+    g_byte_array_append(writer->columns[COLUMN_ENABLED], &enabled_byte, 1);
+
+    guint index = GPOINTER_TO_UINT(g_hash_table_lookup(writer->descriptions, description));
+    if (0 == index) {
+        // first time we have seen this description
+        writer->num_descriptions += 1;
+        index = writer->num_descriptions;
+        g_hash_table_insert(writer->descriptions, g_strdup(description), GUINT_TO_POINTER(index));
+
+        const size_t len = strlen(description);
+        put_varint(writer->description_table, len);
+        g_byte_array_append(writer->description_table, (const guint8 *) description, (guint) len);
+        writer->new_descriptions += 1;
+    }
+    put_varint(writer->columns[COLUMN_DESCRIPTION], index - 1);
+
+    const guint8 acked_byte = acked ? 1 : 0;
+    g_byte_array_append(writer->columns[COLUMN_ACKED], &acked_byte, 1);
+
+    writer->rows += 1;
+    writer->total_rows += 1;
+
+    if (writer->rows >= ARCHIVE_BLOCK_ROWS) {
+        if (!write_block(writer)) {
+            writer->failed = true;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+gint64 archive_errors_before(const char *path, const time_t cutoff) {
+    assert(NULL != path);
+
+    // archives are never overwritten
+    GError *error = NULL;
+    GFile *file = g_file_new_for_path(path);
+    assert(NULL != file);
+    GFileOutputStream *file_stream = g_file_create(file, G_FILE_CREATE_PRIVATE, NULL, &error);
+    if (NULL == file_stream) {
+        fprintf(stderr, "Unable to create archive %s: %s\n", path, error->message);
+        g_error_free(error);
+        g_object_unref(file);
+        return -1;
+    }
+
+    ArchiveWriter writer;
+    memset(&writer, 0, sizeof(writer));
+
+    GZlibCompressor *compressor = g_zlib_compressor_new(G_ZLIB_COMPRESSOR_FORMAT_GZIP, -1);
+    assert(NULL != compressor);
+    writer.out = g_converter_output_stream_new(G_OUTPUT_STREAM(file_stream), G_CONVERTER(compressor));
+    assert(NULL != writer.out);
+    g_object_unref(compressor);
+    g_object_unref(file_stream); // owned by writer.out now
+
+    writer.descriptions = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    assert(NULL != writer.descriptions);
+    writer.description_table = g_byte_array_new();
+    assert(NULL != writer.description_table);
+    for (int column = 0; column < NUM_COLUMNS; column++) {
+        writer.columns[column] = g_byte_array_new();
+        assert(NULL != writer.columns[column]);
+    }
+
+    // header
+    const guint8 version = ARCHIVE_VERSION;
+    bool ok = g_output_stream_write_all(writer.out, ARCHIVE_MAGIC, ARCHIVE_MAGIC_LEN, NULL, NULL, NULL);
+    ok = ok && g_output_stream_write_all(writer.out, &version, 1, NULL, NULL, NULL);
+
+    // errors enabled or disabled while they are read would be archived in their old state
+    const guint enabled_version = errors_enabled_version();
+
+    gint64 max_id = -1;
+    if (ok) {
+        max_id = foreach_error_before(cutoff, write_row, &writer);
+        ok = (max_id >= 0) && !writer.failed && write_block(&writer);
+    }
+
+    // end of archive
+    const guint8 end_marker = 0;
+    ok = ok && g_output_stream_write_all(writer.out, &end_marker, 1, NULL, NULL, NULL);
+
+    if (ok) {
+        ok = g_output_stream_close(writer.out, NULL, &error);
+        if (!ok) {
+            fprintf(stderr, "Error closing archive %s: %s\n", path, error->message);
+            g_error_free(error);
+        }
+    } else {
+        g_output_stream_close(writer.out, NULL, NULL);
+    }
+
+    // hold the database from here until the errors are removed so nothing can change them in between
+    begin_batch();
+    if (ok && (errors_enabled_version() != enabled_version)) {
+        fprintf(stderr, "Errors were enabled or disabled while archiving to %s. Nothing was archived\n", path);
+        ok = false;
+    }
+
+    g_object_unref(writer.out);
+    g_hash_table_unref(writer.descriptions);
+    g_byte_array_unref(writer.description_table);
+    for (int column = 0; column < NUM_COLUMNS; column++) {
+        g_byte_array_unref(writer.columns[column]);
+    }
+
+    // don't leave broken or empty archives lying around
+    if (!ok || (0 == writer.total_rows)) {
+        g_file_delete(file, NULL, NULL);
+    }
+    g_object_unref(file);
+
+    if (!ok) {
+        end_batch();
+        return -1;
+    }
+
+    // only remove the errors once they are safely in the archive
+    const bool removed = (0 == writer.total_rows) || remove_errors_before(cutoff, max_id);
+    if (!end_batch() || !removed) {
+        fprintf(stderr, "Errors were archived to %s but could not be removed from the database\n", path);
+        return -1;
+    }
+
+    return writer.total_rows;
+}
+
+// decode one block's columns, calling func for each row. Columns which the archive's version doesn't have are NULL.
+// Returns false if the block is corrupt
+static bool decode_block(const guint64 rows, guint8 * const *columns, const gsize *lengths, const GPtrArray *descriptions,
+        time_t *last_time, archive_row_func_t func, gpointer user_data, bool *stop) {
+    const guint8 *pos[NUM_COLUMNS];
+    const guint8 *end[NUM_COLUMNS];
+    for (int column = 0; column < NUM_COLUMNS; column++) {
+        pos[column] = columns[column];
+        end[column] = columns[column] + lengths[column];
+    }
+
+    for (guint64 i = 0; i < rows; i++) {
+        guint64 time_delta = 0;
+        guint64 rack_no = 0;
+        guint64 chassis_no = 0;
+        guint64 valve_no = 0;
+        guint64 description_id = 0;
+
+        if (!get_varint(&pos[COLUMN_TIME], end[COLUMN_TIME], &time_delta)
+                || !get_varint(&pos[COLUMN_RACK], end[COLUMN_RACK], &rack_no)
+                || !get_varint(&pos[COLUMN_CHASSIS], end[COLUMN_CHASSIS], &chassis_no)
+                || !get_varint(&pos[COLUMN_VALVE], end[COLUMN_VALVE], &valve_no)
+                || !get_varint(&pos[COLUMN_DESCRIPTION], end[COLUMN_DESCRIPTION], &description_id)
+                || (pos[COLUMN_ENABLED] >= end[COLUMN_ENABLED])
+                || ((NULL != columns[COLUMN_ACKED]) && (pos[COLUMN_ACKED] >= end[COLUMN_ACKED]))
+                || (description_id >= descriptions->len)) {
+            return false;
+        }
+
+        *last_time += (time_t) zigzag_decode(time_delta);
+
+        ArchiveRow row;
+        row.recv_time = *last_time;
+        row.rack_no = (unsigned int) rack_no;
+        row.chassis_no = (unsigned int) chassis_no;
+        row.valve_no = (int) zigzag_decode(valve_no);
+        row.enabled = (0 != *pos[COLUMN_ENABLED]);
+        pos[COLUMN_ENABLED] += 1;
+        row.acked = (NULL != columns[COLUMN_ACKED]) && (0 != *pos[COLUMN_ACKED]);
+        if (NULL != columns[COLUMN_ACKED]) {
+            pos[COLUMN_ACKED] += 1;
+        }
+        row.description = g_ptr_array_index(descriptions, description_id);
+        row.description_id = (guint) description_id;
+
+        if (!func(&row, user_data)) {
+            *stop = true;
+            return true;
+        }
+    }
+
+    return true;
+}
+
+// read the blocks following the header of an archive of the given version
+static bool read_blocks(GDataInputStream *in, const guint8 version, archive_row_func_t func, gpointer user_data) {
+    GPtrArray *descriptions = g_ptr_array_new_with_free_func(g_free);
+    assert(NULL != descriptions);
+
+    time_t last_time = 0;
+    bool ret = true;
+    bool stop = false;
+
+    while (ret && !stop) {
+        guint64 rows = 0;
+        if (!read_stream_varint(in, &rows)) {
+            ret = false;
+            break;
+        }
+
+        if (0 == rows) {
+            break; // end of archive
+        }
+
+        guint64 new_descriptions = 0;
+        ret = read_stream_varint(in, &new_descriptions);
+        for (guint64 i = 0; ret && (i < new_descriptions); i++) {
+            guint8 *description = read_chunk(in, NULL);
+            if (NULL == description) {
+                ret = false;
+            } else {
+                g_ptr_array_add(descriptions, description);
+            }
+        }
+
+        guint8 *columns[NUM_COLUMNS];
+        gsize lengths[NUM_COLUMNS];
+        memset(columns, 0, sizeof(columns));
+        memset(lengths, 0, sizeof(lengths));
+        const int num_columns = (ARCHIVE_VERSION_UNACKED == version) ? COLUMN_ACKED : NUM_COLUMNS;
+        for (int column = 0; ret && (column < num_columns); column++) {
+            columns[column] = read_chunk(in, &lengths[column]);
+            ret = (NULL != columns[column]);
+        }
+
+        if (ret) {
+            ret = decode_block(rows, columns, lengths, descriptions, &last_time, func, user_data, &stop);
+        }
+
+        for (int column = 0; column < NUM_COLUMNS; column++) {
+            g_free(columns[column]);
+        }
+    }
+
+    g_ptr_array_unref(descriptions);
+    return ret;
+}
+
+bool archive_foreach(const char *path, archive_row_func_t func, gpointer user_data) {
+    assert(NULL != path);
+    assert(NULL != func);
+
+    GError *error = NULL;
+    GFile *file = g_file_new_for_path(path);
+    assert(NULL != file);
+    GFileInputStream *file_stream = g_file_read(file, NULL, &error);
+    g_object_unref(file);
+    if (NULL == file_stream) {
+        fprintf(stderr, "Unable to open archive %s: %s\n", path, error->message);
+        g_error_free(error);
+        return false;
+    }
+
+    GZlibDecompressor *decompressor = g_zlib_decompressor_new(G_ZLIB_COMPRESSOR_FORMAT_GZIP);
+    assert(NULL != decompressor);
+    GInputStream *decompressed = g_converter_input_stream_new(G_INPUT_STREAM(file_stream), G_CONVERTER(decompressor));
+    assert(NULL != decompressed);
+    g_object_unref(decompressor);
+    g_object_unref(file_stream);
+
+    // buffered so that reading varints a byte at a time is cheap
+    GDataInputStream *in = g_data_input_stream_new(decompressed);
+    assert(NULL != in);
+    g_object_unref(decompressed);
+
+    // check the header
+    char magic[ARCHIVE_MAGIC_LEN + 1] = {0};
+    gsize bytes_read = 0;
+    bool ret = g_input_stream_read_all(G_INPUT_STREAM(in), magic, sizeof(magic), &bytes_read, NULL, NULL);
+    const guint8 version = (guint8) magic[ARCHIVE_MAGIC_LEN];
+    ret = ret && (sizeof(magic) == bytes_read) && (0 == memcmp(magic, ARCHIVE_MAGIC, ARCHIVE_MAGIC_LEN))
+        && ((ARCHIVE_VERSION == version) || (ARCHIVE_VERSION_UNACKED == version));
+
+    if (!ret) {
+        fprintf(stderr, "%s is not an archive this version understands\n", path);
+    } else {
+        ret = read_blocks(in, version, func, user_data);
+        if (!ret) {
+            fprintf(stderr, "Archive %s is corrupt\n", path);
+        }
+    }
+
+    g_object_unref(in);
+    return ret;
+}
+
+// implements archive_row_func_t to put a row back in the database
+static bool import_row(const ArchiveRow *row, gpointer user_data) {
+    assert(NULL != row);
+    assert(NULL != user_data);
+    ArchiveImport *import = user_data;
+
+    if (!import->batch_open) {
+        begin_batch();
+        import->batch_open = true;
+    }
+
+    // errors for nodes not in the database are silently dropped by restore_error
+    if (!restore_error(row->rack_no, row->chassis_no, row->valve_no, row->recv_time, row->description, row->enabled,
+            row->acked)) {
+        return false;
+    }
+
+    import->rows += 1;
+    import->rows_in_batch += 1;
+
+    if (import->rows_in_batch >= IMPORT_BATCH_ROWS) {
+        import->rows_in_batch = 0;
+        import->batch_open = false;
+        return end_batch();
+    }
+
+    return true;
+}
+
+gint64 archive_import(const char *path) {
+    assert(NULL != path);
+
+    ArchiveImport import;
+    import.rows = 0;
+    import.rows_in_batch = 0;
+    import.batch_open = false;
+
+    bool ret = archive_foreach(path, import_row, &import);
+
+    // a batch which went wrong part way through is rolled back rather than committed
+    if (import.batch_open) {
+        if (!ret) {
+            fail_batch();
+        }
+        ret &= end_batch();
+    }
+
+    if (!ret) {
+        return -1;
+    }
+    return import.rows;
+}
+
+// does the row's description contain the search text? Cached by description
+static bool description_matches(ArchiveSearch *state, const ArchiveRow *row) {
+    if (NULL == state->text) {
+        return true;
+    }
+
+    if (row->description_id >= state->matches->len) {
+        g_array_set_size(state->matches, row->description_id + 1); // new elements are cleared to 0 (unknown)
+    }
+
+    gint8 *match = &g_array_index(state->matches, gint8, row->description_id);
+    if (0 == *match) {
+        gchar *folded = g_utf8_casefold(row->description, -1);
+        assert(NULL != folded);
+        *match = (NULL != strstr(folded, state->text)) ? 2 : 1;
+        g_free(folded);
+    }
+
+    return 2 == *match;
+}
+
+// does the row belong to the search's tab?
+static bool row_matches(const ArchiveSearch *state, const ArchiveRow *row) {
+    if (FILTER != state->search->type) {
+        return clickable_matches(state->search, row->rack_no, row->chassis_no, row->valve_no);
+    }
+
+    return (NULL != state->filter) && (row->enabled || !filter_enabled_only(state->filter))
+        && filter_matches(state->filter, row->rack_no, row->chassis_no, row->valve_no, row->description);
+}
+
+// implements archive_row_func_t to pass matching rows on
+static bool search_row(const ArchiveRow *row, gpointer user_data) {
+    assert(NULL != row);
+    assert(NULL != user_data);
+    ArchiveSearch *state = user_data;
+
+    if ((row->recv_time >= state->since) && ((0 == state->until) || (row->recv_time < state->until))
+            && row_matches(state, row) && description_matches(state, row)) {
+        state->rows += 1;
+        return state->func(row->recv_time, row->rack_no, row->chassis_no, row->valve_no, row->enabled, row->acked,
+            row->description, state->user_data);
+    }
+
+    return true;
+}
+
+gint64 archive_search_foreach(const char *path, const Clickable *search, const char *text, error_row_func_t func,
+        gpointer user_data) {
+    assert(NULL != path);
+    assert(NULL != search);
+    assert(NULL != func);
+
+    ArchiveSearch state;
+    state.search = search;
+    state.filter = (FILTER == search->type) ? filter_get(search->text) : NULL;
+    clickable_time_bounds(search, time(NULL), &state.since, &state.until);
+    state.text = (NULL == text) ? NULL : g_utf8_casefold(text, -1);
+    state.matches = g_array_sized_new(FALSE, TRUE, sizeof(gint8), 0);
+    assert(NULL != state.matches);
+    state.func = func;
+    state.user_data = user_data;
+    state.rows = 0;
+
+    const bool ret = archive_foreach(path, search_row, &state);
+
+    g_free(state.text);
+    g_array_unref(state.matches);
+
+    return ret ? state.rows : -1;
+}
+
+// implements error_row_func_t to collect the results of archive_search. user_data is the GList ** to prepend to
+static bool collect_row(const time_t recv_time, const unsigned int rack_no, const unsigned int chassis_no,
+        const int valve_no, const bool enabled, const bool acked, const char *description, gpointer user_data) {
+    GList **results = user_data;
+    SearchResult *res = new_search_result(recv_time, description, rack_no, chassis_no, valve_no, enabled, -1);
+    res->acked = acked;
+    *results = g_list_prepend(*results, res);
+    return true;
+}
+
+GList *archive_search(const char *path, const Clickable *search, const char *text) {
+    GList *results = NULL;
+    if (archive_search_foreach(path, search, text, collect_row, &results) < 0) {
+        g_list_free_full(results, free_search_result);
+        return NULL;
+    }
+
+    // prepended for speed
+    return g_list_reverse(results);
+}
@@ -0,0 +1,306 @@
+/*
+ * Copyright 2017
+ * GPL3 Licensed
+ * clickable.c
+ * What a Clickable covers: its time range, the locations it matches and the members of node sets
+ */
+
+// includes
+#include "config.h"
+#include "clickable.h"
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// hours of the day (local time) at which shifts change, in order
+static int shift_changes[24] = {8, 20};
+static gsize num_shift_changes = 2;
+
+static GHashTable *node_sets = NULL; // interned text -> GArray of NodeIdentifiers. Invalid texts map to NULL
+static GMutex node_sets_lock;        // protects node_sets
+
+// functions
+
+bool load_shift_changes(const char *path) {
+    assert(NULL != path);
+
+    if (0 != access(path, F_OK)) {
+        return true; // no config file: keep the defaults
+    }
+
+    GKeyFile *key_file = g_key_file_new();
+    assert(NULL != key_file);
+
+    GError *error = NULL;
+    if (!g_key_file_load_from_file(key_file, path, G_KEY_FILE_NONE, &error)) {
+        fprintf(stderr, "Unable to read %s: %s\n", path, error->message);
+        g_error_free(error);
+        g_key_file_free(key_file);
+        return false;
+    }
+
+    bool ret = true;
+    gsize len = 0;
+    gint *hours = g_key_file_get_integer_list(key_file, "shifts", "changes", &len, NULL);
+    if (NULL != hours) {
+        // must be in order and in range
+        for (gsize i = 0; i < len; i++) {
+            if ((hours[i] < 0) || (hours[i] > 23) || ((i > 0) && (hours[i] <= hours[i - 1]))) {
+                ret = false;
+            }
+        }
+
+        if (ret && (len > 0)) {
+            memcpy(shift_changes, hours, len * sizeof(hours[0]));
+            num_shift_changes = len;
+        } else {
+            fprintf(stderr, "%s: shift changes should be hours from 0 to 23 in increasing order\n", path);
+            ret = false;
+        }
+        g_free(hours);
+    }
+
+    g_key_file_free(key_file);
+    return ret;
+}
+
+SearchResult *new_search_result(const time_t recv_time, const char *description, const unsigned int rack_no,
+        const unsigned int chassis_no, const int valve_no, const bool enabled, const int id) {
+    assert(NULL != description);
+
+    SearchResult *res = malloc(sizeof(SearchResult));
+    assert(NULL != res);
+
+    struct tm *time = localtime(&recv_time);
+    assert(NULL != time);
+    char *time_str = asctime(time);
+    assert(NULL != time_str);
+
+    GString *msg = g_string_new(time_str);
+    assert(NULL != msg);
+
+    // remove the year and newline from the time string
+    g_string_truncate(msg, msg->len - 5);
+
+    g_string_append(msg, description);
+    res->message = g_string_free(msg, FALSE);
+
+    res->recv_time = recv_time;
+    res->rack_no = rack_no;
+    res->chassis_no = chassis_no;
+    res->valve_no = valve_no;
+    res->enabled = enabled;
+    res->acked = false;
+    res->id = id;
+
+    return res;
+}
+
+void free_search_result(gpointer res) {
+    if (NULL == res) {
+        return;
+    }
+
+    SearchResult *result = (SearchResult *) res;
+    
+    g_free(result->message);
+    g_free(result);
+}
+
+void clickable_time_bounds(const Clickable *search, const time_t now, time_t *since, time_t *until) {
+    assert(NULL != search);
+    assert(NULL != since);
+    assert(NULL != until);
+
+    *since = 0;
+    *until = 0;
+
+    struct tm local;
+    switch (search->time_range) {
+        case TIME_ALL:
+            break;
+        case TIME_LAST_HOUR:
+            *since = now - 60 * 60;
+            break;
+        case TIME_LAST_DAY:
+            *since = now - 24 * 60 * 60;
+            break;
+        case TIME_TODAY:
+            assert(NULL != localtime_r(&now, &local));
+            local.tm_hour = 0;
+            local.tm_min = 0;
+            local.tm_sec = 0;
+            local.tm_isdst = -1;
+            *since = mktime(&local);
+            break;
+        case TIME_SHIFT: {
+            assert(NULL != localtime_r(&now, &local));
+
+            // the latest shift change no later than now. Before the first one today it was yesterday's last one
+            int hour = -1;
+            for (gsize i = 0; i < num_shift_changes; i++) {
+                if (shift_changes[i] <= local.tm_hour) {
+                    hour = shift_changes[i];
+                }
+            }
+            if (-1 == hour) {
+                hour = shift_changes[num_shift_changes - 1];
+                local.tm_mday -= 1; // mktime sorts out the month
+            }
+
+            local.tm_hour = hour;
+            local.tm_min = 0;
+            local.tm_sec = 0;
+            local.tm_isdst = -1;
+            *since = mktime(&local);
+            break;
+        }
+        case TIME_BETWEEN:
+            *since = search->since;
+            *until = search->until;
+            break;
+        default:
+            break;
+    }
+}
+
+// Implements GCompareFunc for NodeIdentifiers
+static gint compare_node_identifiers(gconstpointer a, gconstpointer b) {
+    const NodeIdentifier *A = a;
+    const NodeIdentifier *B = b;
+
+    if (A->rack_no != B->rack_no) {
+        return (A->rack_no < B->rack_no) ? -1 : 1;
+    }
+    return (A->chassis_no < B->chassis_no) ? -1 : (A->chassis_no > B->chassis_no);
+}
+
+const char *node_set_text(GSList *nodes) {
+    GArray *members = g_array_new(FALSE, FALSE, sizeof(NodeIdentifier));
+    assert(NULL != members);
+    for (GSList *item = nodes; NULL != item; item = item->next) {
+        assert(NULL != item->data);
+        g_array_append_vals(members, item->data, 1);
+    }
+    g_array_sort(members, compare_node_identifiers);
+
+    GString *text = g_string_new(NULL);
+    assert(NULL != text);
+    for (guint i = 0; i < members->len; i++) {
+        const NodeIdentifier *member = &g_array_index(members, NodeIdentifier, i);
+        if ((i > 0) && (0 == compare_node_identifiers(member - 1, member))) {
+            continue; // duplicate
+        }
+        g_string_append_printf(text, "%s%u.%u", (0 == text->len) ? "" : ",", member->rack_no, member->chassis_no);
+    }
+    g_array_unref(members);
+
+    const char *ret = (0 == text->len) ? NULL : g_intern_string(text->str);
+    g_string_free(text, TRUE);
+
+    return ret;
+}
+
+// parse a number at *str and move *str past it
+static bool parse_node_number(const char **str, unsigned int *number) {
+    if (!g_ascii_isdigit(**str)) {
+        return false;
+    }
+
+    gchar *end = NULL;
+    const guint64 value = g_ascii_strtoull(*str, &end, 10);
+    *str = end;
+    *number = (unsigned int) value;
+
+    return value <= G_MAXUINT;
+}
+
+static void free_node_set(gpointer members) {
+    if (NULL != members) {
+        g_array_unref(members);
+    }
+}
+
+// GArray of NodeIdentifiers. NULL if the text isn't valid
+static GArray *parse_node_set(const char *text) {
+    GArray *members = g_array_new(FALSE, FALSE, sizeof(NodeIdentifier));
+    assert(NULL != members);
+
+    gchar **pairs = g_strsplit(text, ",", -1);
+    assert(NULL != pairs);
+    bool valid = (NULL != *pairs);
+    for (gchar **pair = pairs; valid && (NULL != *pair); pair++) {
+        NodeIdentifier member = {0, 0};
+        const char *str = *pair;
+        valid = parse_node_number(&str, &member.rack_no) && ('.' == *str);
+        if (valid) {
+            str++;
+            valid = parse_node_number(&str, &member.chassis_no) && ('\0' == *str);
+        }
+        if (valid) {
+            g_array_append_val(members, member);
+        }
+    }
+    g_strfreev(pairs);
+
+    if (!valid) {
+        g_array_unref(members);
+        return NULL;
+    }
+
+    return members;
+}
+
+const GArray *node_set_members(const char *text) {
+    if (NULL == text) {
+        return NULL;
+    }
+
+    g_mutex_lock(&node_sets_lock);
+
+    if (NULL == node_sets) {
+        node_sets = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, free_node_set);
+        assert(NULL != node_sets);
+    }
+
+    gpointer members = NULL;
+    if (!g_hash_table_lookup_extended(node_sets, text, NULL, &members)) {
+        members = parse_node_set(text);
+        if (NULL == members) {
+            fprintf(stderr, "Bad node set \"%s\"\n", text);
+        }
+        g_hash_table_insert(node_sets, (gpointer) text, members);
+    }
+
+    g_mutex_unlock(&node_sets_lock);
+    return members;
+}
+
+bool clickable_matches(const Clickable *search, const unsigned int rack_no, const unsigned int chassis_no, const int valve_no) {
+    assert(NULL != search);
+
+    switch (search->type) {
+        case ALL:
+            return true;
+        case RACK:
+            return search->rack_num == rack_no;
+        case CHASSIS:
+            return (search->rack_num == rack_no) && (search->chassis_num == chassis_no);
+        case VALVE:
+            return (search->rack_num == rack_no) && (search->chassis_num == chassis_no) && (search->valve_num == valve_no);
+        case NODE_SET: {
+            const GArray *members = node_set_members(search->text);
+            for (guint i = 0; (NULL != members) && (i < members->len); i++) {
+                const NodeIdentifier *member = &g_array_index(members, NodeIdentifier, i);
+                if ((member->rack_no == rack_no) && (member->chassis_no == chassis_no)) {
+                    return true;
+                }
+            }
+            return false;
+        }
+        default:
+            return false;
+    }
+}
@@ -0,0 +1,188 @@
+/*
+ * Copyright 2017
+ * GPL3 Licensed
+ * correlator.c
+ * Spots errors from many chassis (or valves) of one rack at nearly the same time, such as after a power dip
+ *
+ * Errors which are already part of an event are always the oldest in a window (an event takes everything in the
+ * window and then each new error while it lasts) so the errors to add when an event starts are found by walking
+ * back from the newest. Each error is added to the window, linked and dropped once, which keeps the work per error
+ * constant on average.
+ */
+
+// includes
+#include "config.h"
+#include "correlator.h"
+#include <assert.h>
+
+#define VALVE_KEY(chassis_no, valve_no) GUINT_TO_POINTER((((chassis_no) & 0xFFFF) << 16) | ((guint) (valve_no) & 0xFFFF))
+
+typedef struct {
+    gint64 error_id;
+    unsigned int chassis_no;
+    int valve_no;
+    time_t recv_time;
+    bool linked;    // part of an event
+} WindowEntry;
+
+typedef struct {
+    GQueue entries;         // WindowEntries, oldest first
+    GHashTable *chassis;    // chassis_no -> errors from it in the window
+    GHashTable *valves;     // VALVE_KEY -> errors from it in the window
+    bool open;              // an event is in progress
+    gint64 event_id;        // of the event in progress. 0 until correlator_set_event_id
+    time_t start_time;      // of the event in progress
+} RackWindow;
+
+static GMutex correlator_lock; // protects windows
+static GHashTable *windows = NULL; // rack_no -> RackWindow
+
+// functions
+
+static void free_rack_window(gpointer data) {
+    RackWindow *window = data;
+    while (!g_queue_is_empty(&window->entries)) {
+        g_free(g_queue_pop_head(&window->entries));
+    }
+    g_hash_table_destroy(window->chassis);
+    g_hash_table_destroy(window->valves);
+    g_free(window);
+}
+
+// call with correlator_lock held
+static RackWindow *get_window(const unsigned int rack_no) {
+    if (NULL == windows) {
+        windows = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, free_rack_window);
+        assert(NULL != windows);
+    }
+
+    RackWindow *window = g_hash_table_lookup(windows, GUINT_TO_POINTER(rack_no));
+    if (NULL == window) {
+        window = g_malloc0(sizeof(RackWindow));
+        assert(NULL != window);
+        g_queue_init(&window->entries);
+        window->chassis = g_hash_table_new(g_direct_hash, g_direct_equal);
+        window->valves = g_hash_table_new(g_direct_hash, g_direct_equal);
+        assert((NULL != window->chassis) && (NULL != window->valves));
+        g_hash_table_insert(windows, GUINT_TO_POINTER(rack_no), window);
+    }
+
+    return window;
+}
+
+static void count_add(GHashTable *counts, gpointer key) {
+    const guint count = GPOINTER_TO_UINT(g_hash_table_lookup(counts, key));
+    g_hash_table_insert(counts, key, GUINT_TO_POINTER(count + 1));
+}
+
+static void count_remove(GHashTable *counts, gpointer key) {
+    const guint count = GPOINTER_TO_UINT(g_hash_table_lookup(counts, key));
+    assert(count > 0);
+    if (1 == count) {
+        g_hash_table_remove(counts, key);
+    } else {
+        g_hash_table_insert(counts, key, GUINT_TO_POINTER(count - 1));
+    }
+}
+
+static void push_entry(RackWindow *window, WindowEntry *entry) {
+    g_queue_push_tail(&window->entries, entry);
+    count_add(window->chassis, GUINT_TO_POINTER(entry->chassis_no));
+    if (entry->valve_no >= 0) {
+        count_add(window->valves, VALVE_KEY(entry->chassis_no, entry->valve_no));
+    }
+}
+
+static void pop_entry(RackWindow *window) {
+    WindowEntry *entry = g_queue_pop_head(&window->entries);
+    assert(NULL != entry);
+    count_remove(window->chassis, GUINT_TO_POINTER(entry->chassis_no));
+    if (entry->valve_no >= 0) {
+        count_remove(window->valves, VALVE_KEY(entry->chassis_no, entry->valve_no));
+    }
+    g_free(entry);
+}
+
+void correlator_clear(void) {
+    g_mutex_lock(&correlator_lock);
+    if (NULL != windows) {
+        g_hash_table_destroy(windows);
+        windows = NULL;
+    }
+    g_mutex_unlock(&correlator_lock);
+}
+
+bool correlator_add(const unsigned int rack_no, const unsigned int chassis_no, const int valve_no, const time_t recv_time,
+        const gint64 error_id, RackEventUpdate *update) {
+    assert(NULL != update);
+
+    WindowEntry *entry = g_malloc(sizeof(WindowEntry));
+    assert(NULL != entry);
+    entry->error_id = error_id;
+    entry->chassis_no = chassis_no;
+    entry->valve_no = valve_no;
+    entry->recv_time = recv_time;
+    entry->linked = false;
+
+    g_mutex_lock(&correlator_lock);
+
+    RackWindow *window = get_window(rack_no);
+
+    // slide the window
+    const WindowEntry *oldest = NULL;
+    while ((NULL != (oldest = g_queue_peek_head(&window->entries)))
+            && ((oldest->recv_time < recv_time - CORRELATION_WINDOW) || (window->entries.length >= CORRELATION_MAX_WINDOW))) {
+        pop_entry(window);
+    }
+    push_entry(window, entry);
+
+    if ((g_hash_table_size(window->chassis) < CORRELATION_MIN_CHASSIS)
+            && (g_hash_table_size(window->valves) < CORRELATION_MIN_VALVES)) {
+        // any event is over
+        window->open = false;
+        window->event_id = 0;
+        g_mutex_unlock(&correlator_lock);
+        return false;
+    }
+
+    update->error_ids = g_array_new(FALSE, FALSE, sizeof(gint64));
+    assert(NULL != update->error_ids);
+
+    if (window->open) {
+        entry->linked = true;
+        g_array_append_val(update->error_ids, entry->error_id);
+    } else {
+        // a new event takes every error in the window not already part of one
+        window->open = true;
+        window->event_id = 0;
+        window->start_time = recv_time;
+        for (GList *item = window->entries.tail; NULL != item; item = item->prev) {
+            WindowEntry *unlinked = item->data;
+            if (unlinked->linked) {
+                break;
+            }
+            unlinked->linked = true;
+            g_array_append_val(update->error_ids, unlinked->error_id);
+            window->start_time = MIN(window->start_time, unlinked->recv_time);
+        }
+    }
+
+    update->rack_no = rack_no;
+    update->event_id = window->event_id;
+    update->start_time = window->start_time;
+    update->end_time = recv_time;
+    update->chassis_count = g_hash_table_size(window->chassis);
+    update->valve_count = g_hash_table_size(window->valves);
+
+    g_mutex_unlock(&correlator_lock);
+    return true;
+}
+
+void correlator_set_event_id(const unsigned int rack_no, const gint64 event_id) {
+    g_mutex_lock(&correlator_lock);
+    RackWindow *window = get_window(rack_no);
+    if (window->open) {
+        window->event_id = event_id;
+    }
+    g_mutex_unlock(&correlator_lock);
+}
@@ -0,0 +1,471 @@
+/*
+ * Copyright 2017
+ * GPL3 Licensed
+ * filter.c
+ * Saved filters: a small expression language for choosing errors, compiled to SQL and to an in-memory predicate
+ */
+
+// includes
+#include "config.h"
+#include "filter.h"
+#include "template.h"
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define FILTERS_GROUP "filters"
+
+// error types (bit mask)
+#define TYPE_HARDWARE 1
+#define TYPE_SOFTWARE 2
+#define TYPE_OTHER 4
+
+#define HARDWARE_PREFIX "Hardware Error"
+#define SOFTWARE_PREFIX "Software Error"
+
+typedef enum {
+    FIELD_RACK,
+    FIELD_CHASSIS,
+    FIELD_VALVE,
+    FIELD_TEMPLATE
+} FilterField;
+
+// inclusive
+typedef struct {
+    gint64 low;
+    gint64 high;
+} FilterRange;
+
+// the field must be in one of the ranges
+typedef struct {
+    FilterField field;
+    GArray *ranges; // of FilterRange
+} FilterSet;
+
+struct _Filter {
+    GPtrArray *sets;    // of FilterSet. All must match
+    guint types;        // TYPE_ bit mask. 0 for any type
+    bool enabled_only;
+};
+
+// parsed filters by interned expression. Invalid expressions map to NULL
+static GHashTable *registry = NULL;
+static GMutex registry_lock;
+
+static const char * const field_columns[] = {"nodes.rack_no", "nodes.chassis_no", "errors.valve_no", "errors.template_id"};
+
+// functions
+
+static void free_filter_set(gpointer data) {
+    FilterSet *set = data;
+    g_array_unref(set->ranges);
+    g_free(set);
+}
+
+void filter_free(Filter *filter) {
+    if (NULL == filter) {
+        return;
+    }
+
+    g_ptr_array_unref(filter->sets);
+    g_free(filter);
+}
+
+// parse a set of numbers and ranges like 1,3,10-12
+static GArray *parse_set(const char *text, char **error_message) {
+    GArray *ranges = g_array_new(FALSE, FALSE, sizeof(FilterRange));
+    assert(NULL != ranges);
+
+    gchar **items = g_strsplit(text, ",", -1);
+    assert(NULL != items);
+    for (gchar **item = items; NULL != *item; item++) {
+        FilterRange range;
+        gchar *end = *item;
+
+        bool valid = g_ascii_isdigit(*end);
+        if (valid) {
+            range.low = g_ascii_strtoll(*item, &end, 10);
+            range.high = range.low;
+            if ('-' == *end) {
+                const gchar *high = end + 1;
+                valid = g_ascii_isdigit(*high);
+                if (valid) {
+                    range.high = g_ascii_strtoll(high, &end, 10);
+                }
+            }
+        }
+
+        if (!valid || ('\0' != *end) || (range.low > range.high)) {
+            *error_message = g_strdup_printf("\"%s\" should be a number or a range like 4-7", *item);
+            g_strfreev(items);
+            g_array_unref(ranges);
+            return NULL;
+        }
+
+        g_array_append_val(ranges, range);
+    }
+    g_strfreev(items);
+
+    return ranges;
+}
+
+static bool parse_types(const char *text, guint *types, char **error_message) {
+    gchar **names = g_strsplit(text, ",", -1);
+    assert(NULL != names);
+
+    bool ret = true;
+    for (gchar **name = names; ret && (NULL != *name); name++) {
+        if (0 == g_ascii_strcasecmp(*name, "hardware")) {
+            *types |= TYPE_HARDWARE;
+        } else if (0 == g_ascii_strcasecmp(*name, "software")) {
+            *types |= TYPE_SOFTWARE;
+        } else if (0 == g_ascii_strcasecmp(*name, "other")) {
+            *types |= TYPE_OTHER;
+        } else {
+            *error_message = g_strdup_printf("unknown error type \"%s\": use hardware, software or other", *name);
+            ret = false;
+        }
+    }
+
+    g_strfreev(names);
+    return ret;
+}
+
+Filter *filter_parse(const char *expression, char **error_message) {
+    assert(NULL != expression);
+    assert(NULL != error_message);
+    *error_message = NULL;
+
+    Filter *filter = g_malloc0(sizeof(Filter));
+    assert(NULL != filter);
+    filter->sets = g_ptr_array_new_with_free_func(free_filter_set);
+
+    gchar **terms = g_strsplit_set(expression, " \t\n", -1);
+    assert(NULL != terms);
+    for (gchar **term = terms; (NULL != *term) && (NULL == *error_message); term++) {
+        if ('\0' == **term) {
+            continue; // more than one space
+        }
+
+        if (0 == g_ascii_strcasecmp(*term, "enabled")) {
+            filter->enabled_only = true;
+            continue;
+        }
+
+        gchar *value = strchr(*term, '=');
+        if (NULL == value) {
+            *error_message = g_strdup_printf("\"%s\" should look like rack=4-7", *term);
+            break;
+        }
+        *value = '\0';
+        value += 1;
+
+        if (0 == g_ascii_strcasecmp(*term, "type")) {
+            parse_types(value, &filter->types, error_message);
+            continue;
+        }
+
+        FilterField field = FIELD_RACK;
+        if (0 == g_ascii_strcasecmp(*term, "rack")) {
+            field = FIELD_RACK;
+        } else if (0 == g_ascii_strcasecmp(*term, "chassis")) {
+            field = FIELD_CHASSIS;
+        } else if (0 == g_ascii_strcasecmp(*term, "valve")) {
+            field = FIELD_VALVE;
+        } else if (0 == g_ascii_strcasecmp(*term, "template")) {
+            field = FIELD_TEMPLATE;
+        } else {
+            *error_message = g_strdup_printf("unknown field \"%s\": use rack, chassis, valve, template or type", *term);
+            break;
+        }
+
+        GArray *ranges = parse_set(value, error_message);
+        if (NULL != ranges) {
+            FilterSet *set = g_malloc(sizeof(FilterSet));
+            assert(NULL != set);
+            set->field = field;
+            set->ranges = ranges;
+            g_ptr_array_add(filter->sets, set);
+        }
+    }
+    g_strfreev(terms);
+
+    if (NULL != *error_message) {
+        filter_free(filter);
+        return NULL;
+    }
+
+    return filter;
+}
+
+const Filter *filter_get(const char *expression) {
+    if (NULL == expression) {
+        return NULL;
+    }
+
+    g_mutex_lock(&registry_lock);
+
+    if (NULL == registry) {
+        registry = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, (GDestroyNotify) filter_free);
+        assert(NULL != registry);
+    }
+
+    gpointer filter = NULL;
+    if (!g_hash_table_lookup_extended(registry, expression, NULL, &filter)) {
+        char *error_message = NULL;
+        filter = filter_parse(expression, &error_message);
+        if (NULL == filter) {
+            fprintf(stderr, "Bad filter \"%s\": %s\n", expression, error_message);
+            g_free(error_message);
+        }
+        g_hash_table_insert(registry, (gpointer) expression, filter);
+    }
+
+    g_mutex_unlock(&registry_lock);
+    return filter;
+}
+
+bool filter_enabled_only(const Filter *filter) {
+    assert(NULL != filter);
+    return filter->enabled_only;
+}
+
+static guint description_type(const char *description) {
+    if (g_str_has_prefix(description, HARDWARE_PREFIX)) {
+        return TYPE_HARDWARE;
+    } else if (g_str_has_prefix(description, SOFTWARE_PREFIX)) {
+        return TYPE_SOFTWARE;
+    }
+    return TYPE_OTHER;
+}
+
+bool filter_matches(const Filter *filter, const unsigned int rack_no, const unsigned int chassis_no, const int valve_no,
+        const char *description) {
+    assert(NULL != filter);
+    assert(NULL != description);
+
+    if ((0 != filter->types) && (0 == (filter->types & description_type(description)))) {
+        return false;
+    }
+
+    for (guint i = 0; i < filter->sets->len; i++) {
+        const FilterSet *set = g_ptr_array_index(filter->sets, i);
+
+        gint64 value = 0;
+        switch (set->field) {
+            case FIELD_RACK:
+                value = rack_no;
+                break;
+            case FIELD_CHASSIS:
+                value = chassis_no;
+                break;
+            case FIELD_VALVE:
+                if (valve_no < 0) {
+                    return false; // no valve
+                }
+                value = valve_no;
+                break;
+            case FIELD_TEMPLATE:
+                value = template_id(description);
+                break;
+        }
+
+        bool found = false;
+        for (guint j = 0; !found && (j < set->ranges->len); j++) {
+            const FilterRange *range = &g_array_index(set->ranges, FilterRange, j);
+            found = (value >= range->low) && (value <= range->high);
+        }
+        if (!found) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+char *filter_sql(const Filter *filter, const int first_param) {
+    assert(NULL != filter);
+
+    GString *sql = g_string_new("1");
+    assert(NULL != sql);
+    int param = first_param;
+
+    // BETWEEN can use an index, unlike a function of the column
+    for (guint i = 0; i < filter->sets->len; i++) {
+        const FilterSet *set = g_ptr_array_index(filter->sets, i);
+
+        g_string_append(sql, " AND (");
+        for (guint j = 0; j < set->ranges->len; j++) {
+            g_string_append_printf(sql, "%s%s BETWEEN ?%i AND ?%i", (0 == j) ? "" : " OR ", field_columns[set->field],
+                param, param + 1);
+            param += 2;
+        }
+        g_string_append_c(sql, ')');
+    }
+
+    if (0 != filter->types) {
+        g_string_append(sql, " AND (0");
+        if (filter->types & TYPE_HARDWARE) {
+            g_string_append_printf(sql, " OR errors.description LIKE ?%i", param++);
+        }
+        if (filter->types & TYPE_SOFTWARE) {
+            g_string_append_printf(sql, " OR errors.description LIKE ?%i", param++);
+        }
+        if (filter->types & TYPE_OTHER) {
+            g_string_append_printf(sql, " OR NOT (errors.description LIKE ?%i OR errors.description LIKE ?%i)", param, param + 1);
+            param += 2;
+        }
+        g_string_append_c(sql, ')');
+    }
+
+    return g_string_free(sql, FALSE);
+}
+
+bool filter_bind(const Filter *filter, sqlite3_stmt *statement, const int first_param) {
+    assert(NULL != filter);
+    assert(NULL != statement);
+
+    // the same order as filter_sql
+    int param = first_param;
+    bool ret = true;
+
+    for (guint i = 0; i < filter->sets->len; i++) {
+        const FilterSet *set = g_ptr_array_index(filter->sets, i);
+        for (guint j = 0; j < set->ranges->len; j++) {
+            const FilterRange *range = &g_array_index(set->ranges, FilterRange, j);
+            ret &= (SQLITE_OK == sqlite3_bind_int64(statement, param++, range->low));
+            ret &= (SQLITE_OK == sqlite3_bind_int64(statement, param++, range->high));
+        }
+    }
+
+    if (filter->types & TYPE_HARDWARE) {
+        ret &= (SQLITE_OK == sqlite3_bind_text(statement, param++, HARDWARE_PREFIX "%", -1, SQLITE_STATIC));
+    }
+    if (filter->types & TYPE_SOFTWARE) {
+        ret &= (SQLITE_OK == sqlite3_bind_text(statement, param++, SOFTWARE_PREFIX "%", -1, SQLITE_STATIC));
+    }
+    if (filter->types & TYPE_OTHER) {
+        ret &= (SQLITE_OK == sqlite3_bind_text(statement, param++, HARDWARE_PREFIX "%", -1, SQLITE_STATIC));
+        ret &= (SQLITE_OK == sqlite3_bind_text(statement, param++, SOFTWARE_PREFIX "%", -1, SQLITE_STATIC));
+    }
+
+    return ret;
+}
+
+void free_saved_filter(gpointer saved_filter) {
+    if (NULL == saved_filter) {
+        return;
+    }
+
+    SavedFilter *filter = saved_filter;
+    g_free(filter->name);
+    g_free(filter->expression);
+    g_free(filter);
+}
+
+// the filters file. NULL if it couldn't be read. A missing file is empty
+static GKeyFile *load_filters_file(const char *path) {
+    GKeyFile *key_file = g_key_file_new();
+    assert(NULL != key_file);
+
+    if (0 != access(path, F_OK)) {
+        return key_file;
+    }
+
+    GError *error = NULL;
+    if (!g_key_file_load_from_file(key_file, path, G_KEY_FILE_KEEP_COMMENTS, &error)) {
+        fprintf(stderr, "Unable to read %s: %s\n", path, error->message);
+        g_error_free(error);
+        g_key_file_free(key_file);
+        return NULL;
+    }
+
+    return key_file;
+}
+
+static bool save_filters_file(GKeyFile *key_file, const char *path) {
+    gsize len = 0;
+    gchar *data = g_key_file_to_data(key_file, &len, NULL);
+    assert(NULL != data);
+
+    // replaces the file atomically
+    GError *error = NULL;
+    bool ret = g_file_set_contents(path, data, (gssize) len, &error);
+    if (!ret) {
+        fprintf(stderr, "Unable to write %s: %s\n", path, error->message);
+        g_error_free(error);
+    }
+
+    g_free(data);
+    return ret;
+}
+
+GList *saved_filters_load(const char *path) {
+    assert(NULL != path);
+
+    GKeyFile *key_file = load_filters_file(path);
+    if (NULL == key_file) {
+        return NULL;
+    }
+
+    GList *ret = NULL;
+    gchar **names = g_key_file_get_keys(key_file, FILTERS_GROUP, NULL, NULL);
+    for (gchar **name = names; (NULL != names) && (NULL != *name); name++) {
+        gchar *expression = g_key_file_get_string(key_file, FILTERS_GROUP, *name, NULL);
+        if (NULL == expression) {
+            continue;
+        }
+
+        SavedFilter *filter = g_malloc(sizeof(SavedFilter));
+        assert(NULL != filter);
+        filter->name = g_strdup(*name);
+        filter->expression = expression;
+        ret = g_list_prepend(ret, filter);
+    }
+    g_strfreev(names);
+
+    g_key_file_free(key_file);
+    return g_list_reverse(ret);
+}
+
+bool saved_filter_store(const char *path, const char *name, const char *expression) {
+    assert(NULL != path);
+    assert(NULL != name);
+    assert(NULL != expression);
+
+    // names are key file keys
+    if (('\0' == *name) || (NULL != strpbrk(name, "=[]\n"))) {
+        fprintf(stderr, "Filter names cannot be empty or contain =, [, ] or new lines\n");
+        return false;
+    }
+
+    GKeyFile *key_file = load_filters_file(path);
+    if (NULL == key_file) {
+        return false;
+    }
+
+    g_key_file_set_string(key_file, FILTERS_GROUP, name, expression);
+    const bool ret = save_filters_file(key_file, path);
+
+    g_key_file_free(key_file);
+    return ret;
+}
+
+bool saved_filter_remove(const char *path, const char *name) {
+    assert(NULL != path);
+    assert(NULL != name);
+
+    GKeyFile *key_file = load_filters_file(path);
+    if (NULL == key_file) {
+        return false;
+    }
+
+    bool ret = true;
+    if (g_key_file_remove_key(key_file, FILTERS_GROUP, name, NULL)) {
+        ret = save_filters_file(key_file, path);
+    }
+
+    g_key_file_free(key_file);
+    return ret;
+}
@@ -0,0 +1,267 @@
+/*
+ * Copyright 2017
+ * GPL3 Licensed
+ * heatmap.c
+ * Overview of every node drawn as a grid (a row per rack, a column per chassis) coloured by recent errors
+ */
+
+// includes
+#include "config.h"
+#include "heatmap.h"
+#include "node_activity.h"
+#include <assert.h>
+#include <stdio.h>
+#include <time.h>
+
+// space for the rack labels on the left and the chassis labels along the top
+#define LABEL_WIDTH 70
+#define HEADER_HEIGHT 20
+#define MAX_CELL_SIZE 60
+#define CELL_GAP 2
+
+// seconds between checks for errors becoming too old to be recent
+#define REDRAW_INTERVAL 30
+
+typedef struct {
+    heatmap_click_t on_click;
+    gpointer user_data;
+    guint timer;        // for REDRAW_INTERVAL
+    guint drawn_version; // node_activity_version when last drawn
+    gint64 drawn_minute;
+    // layout when last drawn. Used to find what was clicked
+    GArray *nodes;      // NodeActivity snapshot
+    GArray *racks;      // rack number of each row
+    GArray *chassis;    // chassis number of each column
+    double cell_size;
+} HeatmapState;
+
+// functions
+
+static void free_heatmap_state(gpointer data) {
+    HeatmapState *state = data;
+    g_source_remove(state->timer);
+    if (NULL != state->nodes) {
+        g_array_unref(state->nodes);
+        g_array_unref(state->racks);
+        g_array_unref(state->chassis);
+    }
+    g_free(state);
+}
+
+// index of value in a sorted array of guint, adding it if it isn't there
+static guint sorted_insert(GArray *array, const guint value) {
+    guint i = 0;
+    while ((i < array->len) && (g_array_index(array, guint, i) < value)) {
+        i++;
+    }
+    if ((i == array->len) || (g_array_index(array, guint, i) != value)) {
+        g_array_insert_val(array, i, value);
+    }
+    return i;
+}
+
+static gint sorted_find(const GArray *array, const guint value) {
+    for (guint i = 0; i < array->len; i++) {
+        if (g_array_index(array, guint, i) == value) {
+            return (gint) i;
+        }
+    }
+    return -1;
+}
+
+// take a new snapshot and work out where everything goes
+static void layout(HeatmapState *state, const double width, const double height) {
+    if (NULL != state->nodes) {
+        g_array_unref(state->nodes);
+        g_array_unref(state->racks);
+        g_array_unref(state->chassis);
+    }
+
+    state->drawn_version = node_activity_version();
+    const time_t now = time(NULL);
+    state->drawn_minute = now / 60;
+    state->nodes = node_activity_snapshot(now);
+
+    state->racks = g_array_new(FALSE, FALSE, sizeof(guint));
+    state->chassis = g_array_new(FALSE, FALSE, sizeof(guint));
+    assert((NULL != state->racks) && (NULL != state->chassis));
+    for (guint i = 0; i < state->nodes->len; i++) {
+        const NodeActivity *node = &g_array_index(state->nodes, NodeActivity, i);
+        sorted_insert(state->racks, node->rack_no);
+        sorted_insert(state->chassis, node->chassis_no);
+    }
+
+    state->cell_size = MAX_CELL_SIZE;
+    if (state->chassis->len > 0) {
+        state->cell_size = MIN(state->cell_size, (width - LABEL_WIDTH) / state->chassis->len);
+        state->cell_size = MIN(state->cell_size, (height - HEADER_HEIGHT) / state->racks->len);
+    }
+}
+
+// green when quiet, through yellow to red for the busiest node. Grey when disabled
+static void set_cell_colour(cairo_t *cr, const NodeActivity *node, const guint max) {
+    if (!node->enabled) {
+        cairo_set_source_rgb(cr, 0.6, 0.6, 0.6);
+    } else if (0 == node->recent) {
+        cairo_set_source_rgb(cr, 0.35, 0.7, 0.35);
+    } else {
+        const double t = (double) node->recent / max;
+        cairo_set_source_rgb(cr, 0.95, 0.85 * (1.0 - t), 0.2 * (1.0 - t));
+    }
+}
+
+static gboolean draw_heatmap(GtkWidget *widget, cairo_t *cr, HeatmapState *state) {
+    assert(NULL != widget);
+    assert(NULL != state);
+
+    layout(state, gtk_widget_get_allocated_width(widget), gtk_widget_get_allocated_height(widget));
+    const double cell = state->cell_size;
+
+    GdkRGBA text_colour;
+    GtkStyleContext *style = gtk_widget_get_style_context(widget);
+    gtk_style_context_get_color(style, gtk_style_context_get_state(style), &text_colour);
+
+    if (0 == state->nodes->len) {
+        gdk_cairo_set_source_rgba(cr, &text_colour);
+        cairo_move_to(cr, CELL_GAP, HEADER_HEIGHT);
+        cairo_show_text(cr, "No nodes");
+        return FALSE;
+    }
+
+    guint max = 1;
+    for (guint i = 0; i < state->nodes->len; i++) {
+        const NodeActivity *node = &g_array_index(state->nodes, NodeActivity, i);
+        if (node->enabled) {
+            max = MAX(max, node->recent);
+        }
+    }
+
+    // labels
+    char label[32];
+    gdk_cairo_set_source_rgba(cr, &text_colour);
+    for (guint row = 0; row < state->racks->len; row++) {
+        snprintf(label, sizeof(label), "Rack %u", g_array_index(state->racks, guint, row));
+        cairo_move_to(cr, CELL_GAP, HEADER_HEIGHT + (row + 0.5) * cell);
+        cairo_show_text(cr, label);
+    }
+    for (guint column = 0; column < state->chassis->len; column++) {
+        snprintf(label, sizeof(label), "%u", g_array_index(state->chassis, guint, column));
+        cairo_move_to(cr, LABEL_WIDTH + column * cell + CELL_GAP, HEADER_HEIGHT - CELL_GAP * 2);
+        cairo_show_text(cr, label);
+    }
+
+    // cells
+    for (guint i = 0; i < state->nodes->len; i++) {
+        const NodeActivity *node = &g_array_index(state->nodes, NodeActivity, i);
+        const double x = LABEL_WIDTH + sorted_find(state->chassis, node->chassis_no) * cell;
+        const double y = HEADER_HEIGHT + sorted_find(state->racks, node->rack_no) * cell;
+
+        set_cell_colour(cr, node, max);
+        cairo_rectangle(cr, x, y, cell - CELL_GAP, cell - CELL_GAP);
+        cairo_fill(cr);
+
+        if ((node->recent > 0) && (cell > 20)) {
+            snprintf(label, sizeof(label), "%u", node->recent);
+            cairo_set_source_rgb(cr, 0, 0, 0);
+            cairo_move_to(cr, x + CELL_GAP * 2, y + cell / 2);
+            cairo_show_text(cr, label);
+        }
+    }
+
+    return FALSE;
+}
+
+// the node drawn at x, y. NULL if there isn't one
+static const NodeActivity *node_at(const HeatmapState *state, const double x, const double y) {
+    if ((NULL == state->nodes) || (x < LABEL_WIDTH) || (y < HEADER_HEIGHT) || (state->cell_size <= 0)) {
+        return NULL;
+    }
+
+    const guint column = (guint) ((x - LABEL_WIDTH) / state->cell_size);
+    const guint row = (guint) ((y - HEADER_HEIGHT) / state->cell_size);
+    if ((column >= state->chassis->len) || (row >= state->racks->len)) {
+        return NULL;
+    }
+
+    const guint rack_no = g_array_index(state->racks, guint, row);
+    const guint chassis_no = g_array_index(state->chassis, guint, column);
+    for (guint i = 0; i < state->nodes->len; i++) {
+        const NodeActivity *node = &g_array_index(state->nodes, NodeActivity, i);
+        if ((node->rack_no == rack_no) && (node->chassis_no == chassis_no)) {
+            return node;
+        }
+    }
+
+    return NULL;
+}
+
+static gboolean heatmap_clicked(__attribute__((unused)) GtkWidget *widget, GdkEventButton *event, HeatmapState *state) {
+    if ((GDK_BUTTON_PRESS != event->type) || (1 != event->button)) {
+        return FALSE;
+    }
+
+    const NodeActivity *node = node_at(state, event->x, event->y);
+    if (NULL != node) {
+        // copied because on_click might cause a redraw
+        const unsigned int rack_no = node->rack_no;
+        const unsigned int chassis_no = node->chassis_no;
+        state->on_click(rack_no, chassis_no, state->user_data);
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+static gboolean heatmap_tooltip(__attribute__((unused)) GtkWidget *widget, gint x, gint y,
+        __attribute__((unused)) gboolean keyboard_mode, GtkTooltip *tooltip, HeatmapState *state) {
+    const NodeActivity *node = node_at(state, x, y);
+    if (NULL == node) {
+        return FALSE;
+    }
+
+    char text[128];
+    snprintf(text, sizeof(text), "Rack %u, Chassis %u%s: %u errors in the last %i minutes", node->rack_no, node->chassis_no,
+        node->enabled ? "" : " (disabled)", node->recent, NODE_ACTIVITY_MINUTES);
+    gtk_tooltip_set_text(tooltip, text);
+
+    return TRUE;
+}
+
+static gboolean heatmap_timer(gpointer data) {
+    heatmap_update(GTK_WIDGET(data));
+    return G_SOURCE_CONTINUE;
+}
+
+GtkWidget *heatmap_new(heatmap_click_t on_click, gpointer user_data) {
+    assert(NULL != on_click);
+
+    GtkWidget *area = gtk_drawing_area_new();
+    assert(NULL != area);
+
+    HeatmapState *state = g_malloc0(sizeof(HeatmapState));
+    assert(NULL != state);
+    state->on_click = on_click;
+    state->user_data = user_data;
+    state->timer = g_timeout_add_seconds(REDRAW_INTERVAL, heatmap_timer, area);
+    g_object_set_data_full(G_OBJECT(area), "heatmap", state, free_heatmap_state);
+
+    gtk_widget_add_events(area, GDK_BUTTON_PRESS_MASK);
+    gtk_widget_set_has_tooltip(area, TRUE);
+    gtk_widget_set_hexpand(area, TRUE);
+    gtk_widget_set_vexpand(area, TRUE);
+    g_signal_connect(G_OBJECT(area), "draw", G_CALLBACK(draw_heatmap), state);
+    g_signal_connect(G_OBJECT(area), "button-press-event", G_CALLBACK(heatmap_clicked), state);
+    g_signal_connect(G_OBJECT(area), "query-tooltip", G_CALLBACK(heatmap_tooltip), state);
+
+    return area;
+}
+
+void heatmap_update(GtkWidget *heatmap) {
+    assert(NULL != heatmap);
+    const HeatmapState *state = g_object_get_data(G_OBJECT(heatmap), "heatmap");
+    assert(NULL != state);
+
+    if ((state->drawn_version != node_activity_version()) || (state->drawn_minute != time(NULL) / 60)) {
+        gtk_widget_queue_draw(heatmap);
+    }
+}
@@ -0,0 +1,269 @@
+/*
+ * Copyright 2017
+ * GPL3 Licensed
+ * heavy_hitters.c
+ * The valves and nodes sending the most errors recently, counted in bounded memory as errors arrive
+ *
+ * Space-Saving (Metwally et al. 2005): keep CAPACITY counters. An item without a counter takes over the smallest,
+ * starting from its count, which is remembered as the error. The counters are a binary min-heap on count so that the
+ * smallest is always at the root, and a hash table finds an item's counter.
+ */
+
+// includes
+#include "config.h"
+#include "heavy_hitters.h"
+#include <assert.h>
+#include <string.h>
+
+// rack, chassis and valve + 1 in 20 bits each
+#define ITEM_KEY(rack_no, chassis_no, valve_no) ((gint64) ((((guint64) (rack_no) & 0xFFFFF) << 40) \
+    | (((guint64) (chassis_no) & 0xFFFFF) << 20) | ((guint64) ((valve_no) + 1) & 0xFFFFF)))
+
+// one minute's counters
+typedef struct {
+    gint64 minute;      // time / 60. 0 if never used
+    guint len;          // slots in use
+    gint64 keys[HEAVY_HITTERS_CAPACITY];    // ITEM_KEY of each slot
+    guint counts[HEAVY_HITTERS_CAPACITY];
+    guint errors[HEAVY_HITTERS_CAPACITY];
+    guint heap[HEAVY_HITTERS_CAPACITY];     // slots, ordered as a min-heap on counts
+    guint position[HEAVY_HITTERS_CAPACITY]; // index in heap of each slot
+    GHashTable *slots;  // pointer into keys -> slot + 1
+} Summary;
+
+// a ring of summaries, one per recent minute
+typedef struct {
+    Summary minutes[HEAVY_HITTERS_MINUTES];
+} Sketch;
+
+static GMutex hitters_lock; // protects everything below
+static Sketch valves;
+static Sketch nodes;
+static guint version = 0;
+
+// functions
+
+static void summary_reset(Summary *summary, const gint64 minute) {
+    if (NULL == summary->slots) {
+        summary->slots = g_hash_table_new(g_int64_hash, g_int64_equal);
+        assert(NULL != summary->slots);
+    } else {
+        g_hash_table_remove_all(summary->slots);
+    }
+    summary->minute = minute;
+    summary->len = 0;
+}
+
+static void heap_swap(Summary *summary, const guint a, const guint b) {
+    const guint slot = summary->heap[a];
+    summary->heap[a] = summary->heap[b];
+    summary->heap[b] = slot;
+    summary->position[summary->heap[a]] = a;
+    summary->position[summary->heap[b]] = b;
+}
+
+static guint heap_count(const Summary *summary, const guint index) {
+    return summary->counts[summary->heap[index]];
+}
+
+static void sift_up(Summary *summary, guint index) {
+    while ((index > 0) && (heap_count(summary, (index - 1) / 2) > heap_count(summary, index))) {
+        heap_swap(summary, index, (index - 1) / 2);
+        index = (index - 1) / 2;
+    }
+}
+
+static void sift_down(Summary *summary, guint index) {
+    while (true) {
+        guint smallest = index;
+        const guint left = 2 * index + 1;
+        const guint right = left + 1;
+        if ((left < summary->len) && (heap_count(summary, left) < heap_count(summary, smallest))) {
+            smallest = left;
+        }
+        if ((right < summary->len) && (heap_count(summary, right) < heap_count(summary, smallest))) {
+            smallest = right;
+        }
+        if (smallest == index) {
+            return;
+        }
+        heap_swap(summary, index, smallest);
+        index = smallest;
+    }
+}
+
+static void summary_add(Summary *summary, const gint64 key, const guint count) {
+    const guint found = GPOINTER_TO_UINT(g_hash_table_lookup(summary->slots, &key));
+    if (0 != found) {
+        const guint slot = found - 1;
+        summary->counts[slot] += count;
+        sift_down(summary, summary->position[slot]);
+        return;
+    }
+
+    guint slot = 0;
+    if (summary->len < HEAVY_HITTERS_CAPACITY) {
+        slot = summary->len;
+        summary->keys[slot] = key;
+        summary->counts[slot] = count;
+        summary->errors[slot] = 0;
+        summary->heap[slot] = slot;
+        summary->position[slot] = slot;
+        summary->len++;
+        sift_up(summary, slot);
+    } else {
+        // take over the smallest counter
+        slot = summary->heap[0];
+        g_hash_table_remove(summary->slots, &summary->keys[slot]);
+        summary->keys[slot] = key;
+        summary->errors[slot] = summary->counts[slot];
+        summary->counts[slot] += count;
+        sift_down(summary, 0);
+    }
+    g_hash_table_insert(summary->slots, &summary->keys[slot], GUINT_TO_POINTER(slot + 1));
+}
+
+// call with hitters_lock held
+static void sketch_add(Sketch *sketch, const gint64 key, const guint count, const gint64 minute) {
+    Summary *summary = &sketch->minutes[(size_t) (minute % HEAVY_HITTERS_MINUTES)];
+    if (summary->minute != minute) {
+        // an old minute's summary
+        summary_reset(summary, minute);
+    }
+    summary_add(summary, key, count);
+}
+
+static void sketch_clear(Sketch *sketch) {
+    for (size_t i = 0; i < HEAVY_HITTERS_MINUTES; i++) {
+        Summary *summary = &sketch->minutes[i];
+        if (NULL != summary->slots) {
+            g_hash_table_destroy(summary->slots);
+        }
+        memset(summary, 0, sizeof(*summary));
+    }
+}
+
+void heavy_hitters_clear(void) {
+    g_mutex_lock(&hitters_lock);
+    sketch_clear(&valves);
+    sketch_clear(&nodes);
+    version++;
+    g_mutex_unlock(&hitters_lock);
+}
+
+static void sketch_remove_node(Sketch *sketch, const unsigned int rack_no, const unsigned int chassis_no) {
+    const gint64 node_bits = ITEM_KEY(rack_no, chassis_no, -1) & ~(gint64) 0xFFFFF;
+    for (size_t i = 0; i < HEAVY_HITTERS_MINUTES; i++) {
+        Summary *summary = &sketch->minutes[i];
+        for (guint slot = 0; slot < summary->len; slot++) {
+            if ((summary->keys[slot] & ~(gint64) 0xFFFFF) == node_bits) {
+                // zero counts are never reported and are the first to be taken over
+                summary->counts[slot] = 0;
+                summary->errors[slot] = 0;
+                sift_up(summary, summary->position[slot]);
+            }
+        }
+    }
+}
+
+void heavy_hitters_remove_node(const unsigned int rack_no, const unsigned int chassis_no) {
+    g_mutex_lock(&hitters_lock);
+    sketch_remove_node(&valves, rack_no, chassis_no);
+    sketch_remove_node(&nodes, rack_no, chassis_no);
+    version++;
+    g_mutex_unlock(&hitters_lock);
+}
+
+void heavy_hitters_add(const unsigned int rack_no, const unsigned int chassis_no, const int valve_no, const guint count,
+        const time_t recv_time) {
+    const gint64 minute = recv_time / 60;
+    if (minute <= (time(NULL) / 60) - HEAVY_HITTERS_MINUTES) {
+        return; // too old to matter
+    }
+
+    g_mutex_lock(&hitters_lock);
+    if (valve_no >= 0) {
+        sketch_add(&valves, ITEM_KEY(rack_no, chassis_no, valve_no), count, minute);
+    }
+    sketch_add(&nodes, ITEM_KEY(rack_no, chassis_no, -1), count, minute);
+    version++;
+    g_mutex_unlock(&hitters_lock);
+}
+
+// Implements GCompareFunc for HeavyHitter: busiest first
+static gint compare_hitters(gconstpointer a, gconstpointer b) {
+    const HeavyHitter *A = a;
+    const HeavyHitter *B = b;
+
+    if (A->count != B->count) {
+        return (A->count > B->count) ? -1 : 1;
+    }
+    if (A->rack_no != B->rack_no) {
+        return (A->rack_no < B->rack_no) ? -1 : 1;
+    }
+    if (A->chassis_no != B->chassis_no) {
+        return (A->chassis_no < B->chassis_no) ? -1 : 1;
+    }
+    return (A->valve_no < B->valve_no) ? -1 : (A->valve_no > B->valve_no);
+}
+
+GArray *heavy_hitters_top(const bool valves_not_nodes, const guint n, const time_t now) {
+    const gint64 oldest = (now / 60) - HEAVY_HITTERS_MINUTES + 1;
+
+    // the sum of each item's counts over the recent minutes. Bounded by HEAVY_HITTERS_MINUTES * HEAVY_HITTERS_CAPACITY
+    GArray *merged = g_array_new(FALSE, FALSE, sizeof(HeavyHitter));
+    assert(NULL != merged);
+    GHashTable *merged_index = g_hash_table_new(g_int64_hash, g_int64_equal); // pointer into keys -> index + 1
+    assert(NULL != merged_index);
+
+    g_mutex_lock(&hitters_lock);
+
+    const Sketch *sketch = valves_not_nodes ? &valves : &nodes;
+    for (size_t i = 0; i < HEAVY_HITTERS_MINUTES; i++) {
+        const Summary *summary = &sketch->minutes[i];
+        if ((summary->minute < oldest) || (summary->minute > now / 60)) {
+            continue;
+        }
+
+        for (guint slot = 0; slot < summary->len; slot++) {
+            if (0 == summary->counts[slot]) {
+                continue;
+            }
+
+            const guint found = GPOINTER_TO_UINT(g_hash_table_lookup(merged_index, &summary->keys[slot]));
+            if (0 != found) {
+                HeavyHitter *hitter = &g_array_index(merged, HeavyHitter, found - 1);
+                hitter->count += summary->counts[slot];
+                hitter->error += summary->errors[slot];
+                continue;
+            }
+
+            const gint64 key = summary->keys[slot];
+            HeavyHitter hitter;
+            hitter.rack_no = (unsigned int) ((key >> 40) & 0xFFFFF);
+            hitter.chassis_no = (unsigned int) ((key >> 20) & 0xFFFFF);
+            hitter.valve_no = (int) (key & 0xFFFFF) - 1;
+            hitter.count = summary->counts[slot];
+            hitter.error = summary->errors[slot];
+            g_array_append_val(merged, hitter);
+            g_hash_table_insert(merged_index, (gpointer) &summary->keys[slot], GUINT_TO_POINTER(merged->len));
+        }
+    }
+
+    // merged_index points into the summaries
+    g_hash_table_destroy(merged_index);
+    g_mutex_unlock(&hitters_lock);
+
+    g_array_sort(merged, compare_hitters);
+    if (merged->len > n) {
+        g_array_set_size(merged, n);
+    }
+    return merged;
+}
+
+guint heavy_hitters_version(void) {
+    g_mutex_lock(&hitters_lock);
+    const guint ret = version;
+    g_mutex_unlock(&hitters_lock);
+    return ret;
+}
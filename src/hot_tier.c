@@ -0,0 +1,573 @@
+/*
+ * Copyright 2017
+ * GPL3 Licensed
+ * hot_tier.c
+ * Bounded in-memory copy of the most recent errors so that recent history can be searched without the database
+ *
+ * Errors are kept in a ring stored column by column (struct of arrays) so that a scan only touches the columns it
+ * needs. Each entry links to the previous entry from the same node so that searching one node only visits that
+ * node's errors. Positions count every error ever added; an entry lives in slot position % capacity.
+ */
+
+// includes
+#include "config.h"
+#include "hot_tier.h"
+#include "clickable.h"
+#include "filter.h"
+#include <assert.h>
+#include <string.h>
+
+#define FLAG_ENABLED 1
+#define FLAG_DEAD 2 // removed from the database
+#define FLAG_ACKED 4
+
+// what kind of error an entry is (from the start of its description)
+typedef enum {
+    TYPE_OTHER,
+    TYPE_HARDWARE,
+    TYPE_SOFTWARE
+} HotErrorType;
+
+typedef struct {
+    guint64 latest; // position + 1 of the newest entry from this node. 0 if there isn't one
+    bool enabled;
+} HotNode;
+
+typedef struct {
+    char *text;
+    guint refs;
+} HotMessage;
+
+static GMutex hot_lock; // protects everything below
+
+static guint capacity = 0;
+static guint64 head = 0;     // position of the next entry
+static gint64 floor_id = 0;  // every error with a larger id is in the ring
+
+// the ring
+static gint64 *ids = NULL;
+static gint64 *recv_times = NULL;
+static guint32 *racks = NULL;
+static guint32 *chassis = NULL;
+static gint32 *valves = NULL;
+static guint8 *types = NULL;
+static guint32 *messages = NULL;     // index into message_table
+static guint8 *flags = NULL;
+static guint64 *prev_same_node = NULL; // position + 1 of the previous entry from the same node. 0 if there isn't one
+
+static GHashTable *nodes = NULL;         // NODE_KEY -> HotNode
+static GHashTable *message_ids = NULL;   // text -> index + 1 into message_table
+static GPtrArray *message_table = NULL;  // of HotMessage
+static GArray *free_messages = NULL;     // unused indices into message_table
+
+// functions
+
+static guint64 oldest_position(void) {
+    return (head > capacity) ? head - capacity : 0;
+}
+
+static guint slot_of(const guint64 position) {
+    return (guint) (position % capacity);
+}
+
+static void free_hot_message(gpointer data) {
+    if (NULL == data) {
+        return;
+    }
+
+    HotMessage *message = data;
+    g_free(message->text);
+    g_free(message);
+}
+
+// descriptions are shared between entries so that repeated errors don't cost much memory
+static guint32 intern_message(const char *text) {
+    const guint32 found = GPOINTER_TO_UINT(g_hash_table_lookup(message_ids, text));
+    if (0 != found) {
+        HotMessage *message = g_ptr_array_index(message_table, found - 1);
+        message->refs += 1;
+        return found - 1;
+    }
+
+    HotMessage *message = g_malloc(sizeof(HotMessage));
+    assert(NULL != message);
+    message->text = g_strdup(text);
+    message->refs = 1;
+
+    guint32 index = 0;
+    if (free_messages->len > 0) {
+        index = g_array_index(free_messages, guint32, free_messages->len - 1);
+        g_array_set_size(free_messages, free_messages->len - 1);
+        g_ptr_array_index(message_table, index) = message;
+    } else {
+        index = message_table->len;
+        g_ptr_array_add(message_table, message);
+    }
+
+    g_hash_table_insert(message_ids, message->text, GUINT_TO_POINTER(index + 1));
+    return index;
+}
+
+static void release_message(const guint32 index) {
+    HotMessage *message = g_ptr_array_index(message_table, index);
+    assert(NULL != message);
+
+    message->refs -= 1;
+    if (0 == message->refs) {
+        g_hash_table_remove(message_ids, message->text);
+        free_hot_message(message);
+        g_ptr_array_index(message_table, index) = NULL;
+        g_array_append_val(free_messages, index);
+    }
+}
+
+static HotNode *get_node(const unsigned int rack_no, const unsigned int chassis_no) {
+    HotNode *node = g_hash_table_lookup(nodes, NODE_KEY(rack_no, chassis_no));
+    if (NULL == node) {
+        node = g_malloc(sizeof(HotNode));
+        assert(NULL != node);
+        node->latest = 0;
+        node->enabled = true;
+        g_hash_table_insert(nodes, NODE_KEY(rack_no, chassis_no), node);
+    }
+
+    return node;
+}
+
+// an entry is removed from the database
+static void kill_entry(const guint slot) {
+    if (0 == (flags[slot] & FLAG_DEAD)) {
+        flags[slot] |= FLAG_DEAD;
+        release_message(messages[slot]);
+    }
+}
+
+// make room for the entry at position head
+static void evict(const guint slot, const guint64 position) {
+    kill_entry(slot);
+
+    // older errors have to come from the database now
+    if (ids[slot] > floor_id) {
+        floor_id = ids[slot];
+    }
+
+    HotNode *node = g_hash_table_lookup(nodes, NODE_KEY(racks[slot], chassis[slot]));
+    if ((NULL != node) && (node->latest == position + 1)) {
+        node->latest = 0;
+    }
+}
+
+static void free_ring(void) {
+    g_free(ids);
+    g_free(recv_times);
+    g_free(racks);
+    g_free(chassis);
+    g_free(valves);
+    g_free(types);
+    g_free(messages);
+    g_free(flags);
+    g_free(prev_same_node);
+    ids = NULL;
+    recv_times = NULL;
+    racks = NULL;
+    chassis = NULL;
+    valves = NULL;
+    types = NULL;
+    messages = NULL;
+    flags = NULL;
+    prev_same_node = NULL;
+
+    if (NULL != nodes) {
+        g_hash_table_unref(nodes);
+        nodes = NULL;
+    }
+    if (NULL != message_ids) {
+        g_hash_table_unref(message_ids);
+        message_ids = NULL;
+    }
+    if (NULL != message_table) {
+        g_ptr_array_unref(message_table);
+        message_table = NULL;
+    }
+    if (NULL != free_messages) {
+        g_array_unref(free_messages);
+        free_messages = NULL;
+    }
+
+    capacity = 0;
+    head = 0;
+    floor_id = 0;
+}
+
+void hot_tier_init(const guint new_capacity) {
+    g_mutex_lock(&hot_lock);
+
+    free_ring();
+
+    if (new_capacity > 0) {
+        capacity = new_capacity;
+        ids = g_new0(gint64, capacity);
+        recv_times = g_new0(gint64, capacity);
+        racks = g_new0(guint32, capacity);
+        chassis = g_new0(guint32, capacity);
+        valves = g_new0(gint32, capacity);
+        types = g_new0(guint8, capacity);
+        messages = g_new0(guint32, capacity);
+        flags = g_new0(guint8, capacity);
+        prev_same_node = g_new0(guint64, capacity);
+
+        nodes = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+        message_ids = g_hash_table_new(g_str_hash, g_str_equal); // keys belong to the HotMessages
+        message_table = g_ptr_array_new_with_free_func(free_hot_message);
+        free_messages = g_array_new(FALSE, FALSE, sizeof(guint32));
+    }
+
+    g_mutex_unlock(&hot_lock);
+}
+
+void hot_tier_free(void) {
+    hot_tier_init(0);
+}
+
+bool hot_tier_enabled(void) {
+    g_mutex_lock(&hot_lock);
+    const bool ret = (capacity > 0);
+    g_mutex_unlock(&hot_lock);
+    return ret;
+}
+
+gint64 hot_tier_floor(void) {
+    g_mutex_lock(&hot_lock);
+    const gint64 ret = floor_id;
+    g_mutex_unlock(&hot_lock);
+    return ret;
+}
+
+void hot_tier_set_floor(const gint64 floor) {
+    g_mutex_lock(&hot_lock);
+    floor_id = floor;
+    g_mutex_unlock(&hot_lock);
+}
+
+void hot_tier_add(const gint64 id, const time_t recv_time, const unsigned int rack_no, const unsigned int chassis_no,
+        const int valve_no, const bool enabled, const bool acked, const char *description) {
+    assert(NULL != description);
+
+    g_mutex_lock(&hot_lock);
+    if (0 == capacity) {
+        g_mutex_unlock(&hot_lock);
+        return;
+    }
+
+    const guint64 position = head;
+    const guint slot = slot_of(position);
+    if (position >= capacity) {
+        evict(slot, position - capacity);
+    }
+
+    HotNode *node = get_node(rack_no, chassis_no);
+
+    ids[slot] = id;
+    recv_times[slot] = recv_time;
+    racks[slot] = rack_no;
+    chassis[slot] = chassis_no;
+    valves[slot] = valve_no;
+    if (g_str_has_prefix(description, "Hardware Error")) {
+        types[slot] = TYPE_HARDWARE;
+    } else if (g_str_has_prefix(description, "Software Error")) {
+        types[slot] = TYPE_SOFTWARE;
+    } else {
+        types[slot] = TYPE_OTHER;
+    }
+    messages[slot] = intern_message(description);
+    flags[slot] = (guint8) ((enabled ? FLAG_ENABLED : 0) | (acked ? FLAG_ACKED : 0));
+    prev_same_node[slot] = node->latest;
+    node->latest = position + 1;
+
+    head += 1;
+    g_mutex_unlock(&hot_lock);
+}
+
+// set or clear flag on the entry for error id if it is in the ring. Call with hot_lock held
+static void set_error_flag(const gint64 id, const guint8 flag, const bool set) {
+    if ((0 == capacity) || (0 == head)) {
+        return;
+    }
+
+    // ids increase with position so binary search for it
+    guint64 low = oldest_position();
+    guint64 high = head;
+    while (low < high) {
+        const guint64 mid = low + (high - low) / 2;
+        if (ids[slot_of(mid)] < id) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    if (low < head) {
+        const guint slot = slot_of(low);
+        if (ids[slot] == id) {
+            if (set) {
+                flags[slot] |= flag;
+            } else {
+                flags[slot] &= (guint8) ~flag;
+            }
+        }
+    }
+}
+
+void hot_tier_set_error_enabled(const gint64 id, const bool enabled) {
+    g_mutex_lock(&hot_lock);
+    set_error_flag(id, FLAG_ENABLED, enabled);
+    g_mutex_unlock(&hot_lock);
+}
+
+void hot_tier_set_error_acked(const gint64 id, const bool acked) {
+    g_mutex_lock(&hot_lock);
+    set_error_flag(id, FLAG_ACKED, acked);
+    g_mutex_unlock(&hot_lock);
+}
+
+void hot_tier_set_node_enabled(const unsigned int rack_no, const unsigned int chassis_no, const bool enabled) {
+    g_mutex_lock(&hot_lock);
+    if (0 != capacity) {
+        get_node(rack_no, chassis_no)->enabled = enabled;
+    }
+    g_mutex_unlock(&hot_lock);
+}
+
+void hot_tier_remove_node(const unsigned int rack_no, const unsigned int chassis_no) {
+    g_mutex_lock(&hot_lock);
+    if (0 == capacity) {
+        g_mutex_unlock(&hot_lock);
+        return;
+    }
+
+    HotNode *node = g_hash_table_lookup(nodes, NODE_KEY(rack_no, chassis_no));
+    if (NULL != node) {
+        const guint64 oldest = oldest_position();
+        for (guint64 next = node->latest; (next > 0) && (next - 1 >= oldest); next = prev_same_node[slot_of(next - 1)]) {
+            kill_entry(slot_of(next - 1));
+        }
+        g_hash_table_remove(nodes, NODE_KEY(rack_no, chassis_no));
+    }
+
+    g_mutex_unlock(&hot_lock);
+}
+
+void hot_tier_remove_before(const time_t cutoff, const gint64 max_id) {
+    g_mutex_lock(&hot_lock);
+
+    for (guint64 position = oldest_position(); (0 != capacity) && (position < head); position++) {
+        const guint slot = slot_of(position);
+        if (ids[slot] > max_id) {
+            break; // ids increase with position
+        }
+
+        if (recv_times[slot] < cutoff) {
+            kill_entry(slot);
+        }
+    }
+
+    g_mutex_unlock(&hot_lock);
+}
+
+void hot_tier_clear(void) {
+    g_mutex_lock(&hot_lock);
+
+    for (guint64 position = oldest_position(); (0 != capacity) && (position < head); position++) {
+        kill_entry(slot_of(position));
+    }
+
+    if (NULL != nodes) {
+        GHashTableIter iter;
+        gpointer value = NULL;
+        g_hash_table_iter_init(&iter, nodes);
+        while (g_hash_table_iter_next(&iter, NULL, &value)) {
+            ((HotNode *) value)->latest = 0;
+        }
+    }
+
+    g_mutex_unlock(&hot_lock);
+}
+
+// should this entry be shown?
+static bool entry_visible(const guint slot, const bool show_disabled, const bool show_acked) {
+    if (0 != (flags[slot] & FLAG_DEAD)) {
+        return false;
+    }
+
+    if (!show_acked && (0 != (flags[slot] & FLAG_ACKED))) {
+        return false;
+    }
+
+    if (show_disabled) {
+        return true;
+    }
+
+    if (0 == (flags[slot] & FLAG_ENABLED)) {
+        return false;
+    }
+
+    const HotNode *node = g_hash_table_lookup(nodes, NODE_KEY(racks[slot], chassis[slot]));
+    return (NULL == node) || node->enabled;
+}
+
+// order entries by time then id. Implements GCompareFunc over slots
+static gint compare_slots(gconstpointer a, gconstpointer b) {
+    const guint A = *((const guint *) a);
+    const guint B = *((const guint *) b);
+
+    if (recv_times[A] != recv_times[B]) {
+        return (recv_times[A] < recv_times[B]) ? -1 : 1;
+    }
+    if (ids[A] != ids[B]) {
+        return (ids[A] < ids[B]) ? -1 : 1;
+    }
+    return 0;
+}
+
+// slots of the visible entries matching search, ordered by time. Call with hot_lock held
+// append the slots of one node's errors (with valve_no unless it is negative) to slots, newest first
+static void node_slots(GArray *slots, const unsigned int rack_no, const unsigned int chassis_no, const int valve_no,
+        const time_t since, const time_t until, const bool show_disabled, const bool show_acked) {
+    const guint64 oldest = oldest_position();
+    const HotNode *node = g_hash_table_lookup(nodes, NODE_KEY(rack_no, chassis_no));
+
+    guint64 next = (NULL == node) ? 0 : node->latest;
+    for (; (next > 0) && (next - 1 >= oldest); next = prev_same_node[slot_of(next - 1)]) {
+        const guint slot = slot_of(next - 1);
+        if (((valve_no < 0) || (valves[slot] == valve_no)) && (recv_times[slot] >= since) && (recv_times[slot] < until)
+                && entry_visible(slot, show_disabled, show_acked)) {
+            g_array_append_val(slots, slot);
+        }
+    }
+}
+
+static GArray *matching_slots(const Clickable *search, const bool show_disabled, const bool show_acked) {
+    GArray *slots = g_array_new(FALSE, FALSE, sizeof(guint));
+    assert(NULL != slots);
+
+    if (0 == capacity) {
+        return slots;
+    }
+
+    const guint64 oldest = oldest_position();
+
+    time_t since = 0;
+    time_t until = 0;
+    clickable_time_bounds(search, time(NULL), &since, &until);
+    if (0 == until) {
+        until = G_MAXINT64;
+    }
+
+    if ((CHASSIS == search->type) || (VALVE == search->type)) {
+        // only visit this node's errors
+        node_slots(slots, search->rack_num, search->chassis_num, (VALVE == search->type) ? search->valve_num : -1,
+            since, until, show_disabled, show_acked);
+
+        // we went newest first
+        for (guint i = 0; i < slots->len / 2; i++) {
+            const guint tmp = g_array_index(slots, guint, i);
+            g_array_index(slots, guint, i) = g_array_index(slots, guint, slots->len - 1 - i);
+            g_array_index(slots, guint, slots->len - 1 - i) = tmp;
+        }
+    } else if (NODE_SET == search->type) {
+        // only visit the members' errors. Sorted below
+        const GArray *members = node_set_members(search->text);
+        for (guint i = 0; (NULL != members) && (i < members->len); i++) {
+            const NodeIdentifier *member = &g_array_index(members, NodeIdentifier, i);
+            node_slots(slots, member->rack_no, member->chassis_no, -1, since, until, show_disabled, show_acked);
+        }
+    } else if (FILTER == search->type) {
+        const Filter *filter = filter_get(search->text);
+        for (guint64 position = oldest; (NULL != filter) && (position < head); position++) {
+            const guint slot = slot_of(position);
+            const HotMessage *message = g_ptr_array_index(message_table, messages[slot]);
+            if ((recv_times[slot] >= since) && (recv_times[slot] < until) && entry_visible(slot, show_disabled, show_acked)
+                    && filter_matches(filter, racks[slot], chassis[slot], valves[slot], message->text)) {
+                g_array_append_val(slots, slot);
+            }
+        }
+    } else {
+        for (guint64 position = oldest; position < head; position++) {
+            const guint slot = slot_of(position);
+            if ((recv_times[slot] >= since) && (recv_times[slot] < until)
+                    && clickable_matches(search, racks[slot], chassis[slot], valves[slot]) && entry_visible(slot, show_disabled, show_acked)) {
+                g_array_append_val(slots, slot);
+            }
+        }
+    }
+
+    // entries are in order of id. This is almost always the order of time too
+    bool sorted = true;
+    for (guint i = 1; sorted && (i < slots->len); i++) {
+        sorted = (compare_slots(&g_array_index(slots, guint, i - 1), &g_array_index(slots, guint, i)) <= 0);
+    }
+    if (!sorted) {
+        g_array_sort(slots, compare_slots);
+    }
+
+    return slots;
+}
+
+GList *hot_tier_search(const Clickable *search, const bool show_disabled, const bool show_acked) {
+    assert(NULL != search);
+
+    g_mutex_lock(&hot_lock);
+
+    GArray *slots = matching_slots(search, show_disabled, show_acked);
+
+    GList *results = NULL;
+    for (guint i = slots->len; i > 0; i--) {
+        const guint slot = g_array_index(slots, guint, i - 1);
+        const HotNode *node = g_hash_table_lookup(nodes, NODE_KEY(racks[slot], chassis[slot]));
+        const bool enabled = (0 != (flags[slot] & FLAG_ENABLED)) && ((NULL == node) || node->enabled);
+        const HotMessage *message = g_ptr_array_index(message_table, messages[slot]);
+
+        SearchResult *res = new_search_result(recv_times[slot], message->text, racks[slot], chassis[slot],
+            valves[slot], enabled, (int) ids[slot]);
+        res->acked = (0 != (flags[slot] & FLAG_ACKED));
+        results = g_list_prepend(results, res); // backwards so that the list ends up in order
+    }
+
+    g_array_unref(slots);
+    g_mutex_unlock(&hot_lock);
+
+    return results;
+}
+
+void hot_tier_set_enabled_matching(const Clickable *search, const bool enabled) {
+    assert(NULL != search);
+
+    g_mutex_lock(&hot_lock);
+
+    GArray *slots = matching_slots(search, true, true);
+    for (guint i = 0; i < slots->len; i++) {
+        const guint slot = g_array_index(slots, guint, i);
+        if (enabled) {
+            flags[slot] |= FLAG_ENABLED;
+        } else {
+            flags[slot] &= (guint8) ~FLAG_ENABLED;
+        }
+    }
+    g_array_unref(slots);
+
+    g_mutex_unlock(&hot_lock);
+}
+
+int hot_tier_count(const Clickable *search, const bool show_disabled, const bool show_acked) {
+    assert(NULL != search);
+
+    g_mutex_lock(&hot_lock);
+
+    GArray *slots = matching_slots(search, show_disabled, show_acked);
+    const int count = (int) slots->len;
+    g_array_unref(slots);
+
+    g_mutex_unlock(&hot_lock);
+
+    return count;
+}
@@ -0,0 +1,384 @@
+/*
+ * Copyright 2017
+ * GPL3 Licensed
+ * ingest.c
+ * Moves received messages from the server's buffer into the database
+ *
+ * Each message is appended to the journal (and the journal synced) before it goes into the database, and the
+ * database records which journal records it contains in the same transaction as the errors. Anything which was
+ * read from the server but did not make it into the database is replayed from the journal on the next start up, so
+ * the database can use relaxed durability without losing errors.
+ *
+ * Each drain commits the most urgent errors (see priority.h) before the rest so that they can be shown sooner. Their
+ * journal records are marked as stored in the same transaction so that they aren't replayed if the rest of the drain
+ * has to be stored from the journal. When a
+ * drain is much bigger than usual the pipeline has fallen behind, so low priority errors repeating the same message
+ * from the same place are stored as one row saying how many there were. Past a budget the rest of each node's low
+ * priority errors share one row. The rows count every error they stand for in the error rates, overview and top
+ * offenders, and every error is still checked against the alert rules (see alerts.h).
+ */
+
+// includes
+#include "config.h"
+#include "ingest.h"
+#include "journal.h"
+#include "sql.h"
+#include "template.h"
+#include "liveness.h"
+#include "alerts.h"
+#include <assert.h>
+#include <stdio.h>
+#include <glib.h>
+#include <edsac_server.h>
+
+// where ingest_drain reads received messages from
+static ingest_read_func_t reader = read_message;
+
+// a drain failed to commit, so the journal has errors which aren't in the database yet
+static bool journal_behind = false;
+
+// functions
+
+// progress of catch_up_journal
+typedef struct {
+    GHashTable *stored; // journal records past the applied sequence number which are in the database already
+    guint64 last_seq;
+    guint64 recovered;
+} Replay;
+
+// implements journal_replay_func_t. user_data is a Replay
+static void replay_item(const BufferItem *item, const guint64 seq, gpointer user_data) {
+    assert(NULL != item);
+    assert(NULL != user_data);
+    Replay *replay = user_data;
+
+    const gint64 key = (gint64) seq;
+    if (!g_hash_table_contains(replay->stored, &key)) {
+        if (!replay_error(item)) {
+            puts("Unable to replay an error from the journal");
+        }
+        replay->recovered += 1;
+    }
+
+    replay->last_seq = seq;
+}
+
+// put everything in the journal which isn't in the database yet into the database. Returns false if it couldn't be
+// committed, in which case it is all still in the journal
+static bool catch_up_journal(void) {
+    const gint64 applied = get_journal_applied();
+    if (applied < 0) {
+        return false;
+    }
+
+    Replay replay = {.stored = get_journal_stored(), .last_seq = (guint64) applied, .recovered = 0};
+    if (NULL == replay.stored) {
+        return false;
+    }
+
+    begin_batch();
+    journal_replay((guint64) applied, replay_item, &replay);
+    if (!set_journal_applied((gint64) replay.last_seq)) {
+        fail_batch();
+    }
+    const bool ret = end_batch();
+    g_hash_table_destroy(replay.stored);
+    if (!ret) {
+        return false;
+    }
+
+    journal_checkpoint(replay.last_seq);
+    if (replay.recovered > 0) {
+        printf("Recovered %lu errors from the journal\n", replay.recovered);
+    }
+
+    return true;
+}
+
+bool ingest_init(const char *prefix) {
+    assert(NULL != prefix);
+
+    const gint64 applied = get_journal_applied();
+    if (applied < 0) {
+        return false;
+    }
+
+    GString *path = g_string_new(prefix);
+    assert(NULL != path);
+    g_string_append(path, "/ingest.journal");
+    const bool opened = journal_open(path->str, (guint64) applied);
+    if (!opened) {
+        fprintf(stderr, "Unable to open the journal at %s. Errors will be lost if we crash\n", path->str);
+    }
+    g_string_free(path, TRUE);
+    if (!opened) {
+        return false;
+    }
+
+    // anything not in the database yet. If it can't be stored now ingest_drain tries again
+    journal_behind = !catch_up_journal();
+
+    return true;
+}
+
+void ingest_shutdown(void) {
+    journal_close();
+}
+
+// a received message, decoded once
+typedef struct {
+    BufferItem *item;
+    guint64 seq; // in the journal. 0 if it couldn't be journaled
+    NodeIdentifier node;
+    int valve_no;
+    GString *description;
+    bool valid; // false for message types which aren't stored
+} Received;
+
+static Received *received_new(BufferItem *item, const guint64 seq) {
+    Received *received = g_malloc(sizeof(Received));
+    assert(NULL != received);
+
+    received->item = item;
+    received->seq = seq;
+    received->description = g_string_new(NULL);
+    assert(NULL != received->description);
+    received->valid = decode_error(item, &received->node, &received->valve_no, received->description);
+
+    return received;
+}
+
+static void free_received(gpointer data) {
+    Received *received = data;
+    free_bufferitem(received->item);
+    g_string_free(received->description, TRUE);
+    g_free(received);
+}
+
+// low priority errors from an overloaded drain which are stored as one row
+typedef struct {
+    Received *first; // the row is this with a note of how many more there were
+    guint count;
+    bool per_node; // everything else from the node past INGEST_LOW_BUDGET rather than one valve and template
+} Coalesced;
+
+static void free_coalesced(gpointer data) {
+    Coalesced *group = data;
+    free_received(group->first);
+    g_free(group);
+}
+
+// add a low priority error from an overloaded drain to its group in groups (by key) and order (in the order they are
+// to be stored). The first INGEST_LOW_BUDGET groups each hold the errors from one valve (or node) with one message
+// template. Past that, the rest of each node's errors share one group. Takes ownership of received
+static void coalesce_low(GHashTable *groups, GPtrArray *order, Received *received) {
+    gchar *key = g_strdup_printf("%u.%u.%i.%" G_GINT64_FORMAT, received->node.rack_no, received->node.chassis_no,
+        received->valve_no, template_id(received->description->str));
+    assert(NULL != key);
+
+    Coalesced *group = g_hash_table_lookup(groups, key);
+    const bool per_node = (NULL == group) && (order->len >= INGEST_LOW_BUDGET);
+    if (per_node) {
+        g_free(key);
+        key = g_strdup_printf("%u.%u", received->node.rack_no, received->node.chassis_no);
+        assert(NULL != key);
+        group = g_hash_table_lookup(groups, key);
+    }
+
+    if (NULL != group) {
+        group->count++;
+        g_free(key);
+        free_received(received);
+        return;
+    }
+
+    group = g_malloc(sizeof(Coalesced));
+    assert(NULL != group);
+    group->first = received;
+    group->count = 1;
+    group->per_node = per_node;
+    g_hash_table_insert(groups, key, group);
+    g_ptr_array_add(order, group);
+}
+
+// check a received error against the alert rules and note that its node is alive
+static void note_received(const Received *received) {
+    const NodeIdentifier *node = &received->node;
+    const time_t recv_time = received->item->recv_time;
+
+    if (received->valid) {
+        alerts_check(received->item->msg.type, node->rack_no, node->chassis_no, received->valve_no, recv_time,
+            received->description->str);
+    }
+
+    // errors are the only traffic from a node so receiving one shows it is alive
+    liveness_seen(node->rack_no, node->chassis_no, recv_time);
+}
+
+static void store_received(const Received *received) {
+    const NodeIdentifier *node = &received->node;
+    if (!received->valid || !add_error_decoded(node->rack_no, node->chassis_no, received->valve_no,
+            received->item->recv_time, received->description->str)) {
+        puts("Unable to add an error to the database");
+    }
+    note_received(received);
+}
+
+// store a group of coalesced errors as one row saying how many there were
+static void store_coalesced(const Coalesced *group) {
+    const Received *first = group->first;
+    if (1 == group->count) {
+        store_received(first);
+        return;
+    }
+
+    GString *description = g_string_new(first->description->str);
+    assert(NULL != description);
+    g_string_append_printf(description, group->per_node ? " (%u more low priority errors suppressed)"
+        : " (%u similar suppressed)", group->count - 1);
+
+    if (!add_error_repeated(first->node.rack_no, first->node.chassis_no, group->per_node ? -1 : first->valve_no,
+            first->item->recv_time, description->str, group->count)) {
+        puts("Unable to add an error to the database");
+    }
+
+    g_string_free(description, TRUE);
+}
+
+// a batch of this drain failed to commit (and was rolled back), so store the drain from the journal instead. Alert
+// rules still see the errors which hadn't been looked at yet
+static void store_from_journal(PriorityQueue *queue) {
+    Received *received = NULL;
+    while (NULL != (received = priority_queue_pop(queue, NULL))) {
+        note_received(received);
+        free_received(received);
+    }
+
+    journal_behind = !catch_up_journal();
+    if (journal_behind) {
+        puts("Unable to store received errors. They are kept in the journal until they can be");
+    }
+}
+
+void ingest_set_reader(ingest_read_func_t func) {
+    reader = (NULL == func) ? read_message : func;
+}
+
+bool ingest_drain(Priority *highest, ingest_stored_func_t urgent_stored, gpointer user_data) {
+    // what an earlier drain couldn't store comes first. Until it is stored new messages wait in the server's buffer
+    const bool recovered = journal_behind;
+    if (journal_behind) {
+        journal_behind = !catch_up_journal();
+        if (journal_behind) {
+            return false;
+        }
+    }
+
+    PriorityQueue *queue = priority_queue_new();
+    assert(NULL != queue);
+
+    // journal everything first
+    guint64 last_seq = 0;
+    BufferItem *item = NULL;
+    while (NULL != (item = reader())) {
+        const guint64 seq = journal_append(item);
+        if (0 != seq) {
+            last_seq = seq;
+        }
+
+        Received *received = received_new(item, seq);
+        const Priority priority = received->valid ? priority_classify(item->msg.type, received->node.rack_no,
+            received->node.chassis_no, received->valve_no, received->description->str) : PRIORITY_LOW;
+        priority_queue_push(queue, received, priority);
+    }
+
+    const guint count = priority_queue_length(queue);
+    if (0 == count) {
+        priority_queue_free(queue, NULL);
+        return recovered;
+    }
+
+    if (NULL != highest) {
+        *highest = PRIORITY_LOW;
+        for (int level = PRIORITY_LEVELS - 1; level >= 0; level--) {
+            if (0 != priority_queue_length_at(queue, (Priority) level)) {
+                *highest = (Priority) level;
+                break;
+            }
+        }
+    }
+
+    journal_sync();
+
+    // the most urgent errors are committed on their own so that they can be shown while the rest are stored. The
+    // journal position is only recorded with the rest, so their records are marked as stored individually
+    const guint urgent = priority_queue_length_at(queue, PRIORITY_HIGH);
+    if (0 != urgent) {
+        begin_batch();
+        for (guint i = 0; i < urgent; i++) {
+            Received *received = priority_queue_pop(queue, NULL);
+            store_received(received);
+            if ((0 != received->seq) && !set_journal_stored((gint64) received->seq)) {
+                fail_batch();
+            }
+            free_received(received);
+        }
+
+        if (!end_batch()) {
+            store_from_journal(queue);
+            priority_queue_free(queue, NULL);
+            return true;
+        }
+
+        if (NULL != urgent_stored) {
+            urgent_stored(user_data);
+        }
+    }
+
+    // then the rest in one transaction, most urgent first
+    const bool overloaded = count > INGEST_OVERLOAD;
+    GHashTable *groups = overloaded ? g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL) : NULL;
+    GPtrArray *coalesced = overloaded ? g_ptr_array_new_with_free_func(free_coalesced) : NULL;
+
+    begin_batch();
+    Priority priority = PRIORITY_LOW;
+    Received *received = NULL;
+    while (NULL != (received = priority_queue_pop(queue, &priority))) {
+        if (overloaded && (PRIORITY_LOW == priority) && received->valid) {
+            note_received(received);
+            coalesce_low(groups, coalesced, received);
+        } else {
+            store_received(received);
+            free_received(received);
+        }
+    }
+
+    guint suppressed = 0;
+    for (guint i = 0; (NULL != coalesced) && (i < coalesced->len); i++) {
+        const Coalesced *group = g_ptr_array_index(coalesced, i);
+        store_coalesced(group);
+        suppressed += group->count - 1;
+    }
+
+    if ((0 != last_seq) && !set_journal_applied((gint64) last_seq)) {
+        fail_batch();
+    }
+
+    if (!end_batch()) {
+        store_from_journal(queue);
+    } else if (0 != last_seq) {
+        journal_checkpoint(last_seq);
+    }
+
+    if (suppressed > 0) {
+        printf("Falling behind: %u low priority errors were stored as repeats of others out of %u received\n",
+            suppressed, count);
+    }
+
+    if (NULL != coalesced) {
+        g_ptr_array_unref(coalesced);
+        g_hash_table_destroy(groups);
+    }
+    priority_queue_free(queue, NULL);
+    return true;
+}
@@ -0,0 +1,329 @@
+/*
+ * Copyright 2017
+ * GPL3 Licensed
+ * journal.c
+ * Append-only journal of received messages written before they go into the database
+ *
+ * The journal file is memory mapped. It starts with JOURNAL_HEADER_SIZE bytes of header (JOURNAL_MAGIC) followed by
+ * JournalRecords, each followed by the message text padded to a multiple of 8 bytes. The journal ends at the first
+ * record with the wrong magic, a bad checksum or a sequence number which does not increase. Once everything in
+ * the journal is in the database, the journal starts again from the beginning of the file.
+ */
+
+// includes
+#include "config.h"
+#include "journal.h"
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <edsac_representation.h>
+
+#define JOURNAL_MAGIC "EDSACJNL"
+#define JOURNAL_MAGIC_LEN 8
+#define JOURNAL_HEADER_SIZE 64
+#define JOURNAL_RECORD_MAGIC 0x4A524543 // "JREC"
+#define JOURNAL_INITIAL_SIZE (1024 * 1024)
+#define JOURNAL_MAX_MESSAGE (64 * 1024) // longer messages are truncated
+
+// stored in the file. Followed by length bytes of message text
+typedef struct {
+    guint32 magic;      // JOURNAL_RECORD_MAGIC
+    guint32 length;     // bytes of message text
+    guint32 checksum;   // of the rest of the record and the message text
+    guint32 address;    // IPv4 address of the node (network byte order)
+    guint64 seq;        // sequence number
+    gint64 recv_time;
+    gint32 type;        // MessageType
+    gint32 valve_no;
+} JournalRecord;
+
+// bytes after the checksum field covered by the checksum
+#define CHECKSUMMED_OFFSET (offsetof(JournalRecord, address))
+
+static int journal_fd = -1;
+static guint8 *map = NULL;      // the mapped file
+static size_t map_size = 0;
+static size_t write_offset = 0; // where the next record goes
+static size_t dirty_start = 0;  // start of the records which have not been synced
+static guint64 next_seq = 1;
+static guint64 last_seq = 0;    // sequence number of the last record in the journal (0 if empty)
+
+// functions
+
+// records are padded so that the next one is 8 byte aligned
+static size_t padded_length(const size_t len) {
+    return (len + 7) & ~((size_t) 7);
+}
+
+// FNV-1a
+static guint32 checksum(guint32 hash, const guint8 *data, const size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        hash ^= data[i];
+        hash *= 16777619;
+    }
+    return hash;
+}
+
+static guint32 record_checksum(const JournalRecord *record, const char *text) {
+    const guint32 hash = checksum(2166136261u, ((const guint8 *) record) + CHECKSUMMED_OFFSET, sizeof(JournalRecord) - CHECKSUMMED_OFFSET);
+    return checksum(hash, (const guint8 *) text, record->length);
+}
+
+// read the record at offset. Returns false if there isn't a valid record there
+static bool read_record(const size_t offset, const guint64 prev_seq, JournalRecord *record) {
+    if (offset + sizeof(JournalRecord) > map_size) {
+        return false;
+    }
+
+    memcpy(record, map + offset, sizeof(JournalRecord));
+    if ((JOURNAL_RECORD_MAGIC != record->magic) || (record->length > JOURNAL_MAX_MESSAGE)
+            || (offset + sizeof(JournalRecord) + record->length > map_size) || (record->seq <= prev_seq)) {
+        return false;
+    }
+
+    return record->checksum == record_checksum(record, (const char *) (map + offset + sizeof(JournalRecord)));
+}
+
+// (re)map the file at its current size
+static bool map_journal(const size_t size) {
+    if (NULL != map) {
+        munmap(map, map_size);
+        map = NULL;
+    }
+
+    if (0 != ftruncate(journal_fd, (off_t) size)) {
+        perror("ftruncate journal");
+        return false;
+    }
+
+    void *new_map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, journal_fd, 0);
+    if (MAP_FAILED == new_map) {
+        perror("mmap journal");
+        return false;
+    }
+
+    map = new_map;
+    map_size = size;
+    return true;
+}
+
+bool journal_open(const char *path, const guint64 last_applied) {
+    assert(NULL != path);
+    assert(-1 == journal_fd);
+
+    journal_fd = open(path, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR /*rw-------*/);
+    if (-1 == journal_fd) {
+        perror("open journal");
+        return false;
+    }
+
+    struct stat statbuf;
+    if (0 != fstat(journal_fd, &statbuf)) {
+        perror("stat journal");
+        journal_close();
+        return false;
+    }
+
+    const bool new_journal = (statbuf.st_size < JOURNAL_HEADER_SIZE);
+    size_t size = new_journal ? JOURNAL_INITIAL_SIZE : (size_t) statbuf.st_size;
+    if (!map_journal(size)) {
+        journal_close();
+        return false;
+    }
+
+    if (new_journal) {
+        memset(map, 0, JOURNAL_HEADER_SIZE + sizeof(guint32));
+        memcpy(map, JOURNAL_MAGIC, JOURNAL_MAGIC_LEN);
+    } else if (0 != memcmp(map, JOURNAL_MAGIC, JOURNAL_MAGIC_LEN)) {
+        fprintf(stderr, "%s is not a journal\n", path);
+        journal_close();
+        return false;
+    }
+
+    // find the end of the journal
+    JournalRecord record;
+    write_offset = JOURNAL_HEADER_SIZE;
+    last_seq = 0;
+    while (read_record(write_offset, last_seq, &record)) {
+        last_seq = record.seq;
+        write_offset += sizeof(JournalRecord) + padded_length(record.length);
+    }
+    dirty_start = write_offset;
+
+    next_seq = MAX(last_seq, last_applied) + 1;
+    return true;
+}
+
+void journal_close(void) {
+    if (NULL != map) {
+        msync(map, map_size, MS_SYNC);
+        munmap(map, map_size);
+        map = NULL;
+        map_size = 0;
+    }
+
+    if (-1 != journal_fd) {
+        close(journal_fd);
+        journal_fd = -1;
+    }
+}
+
+guint64 journal_append(const BufferItem *item) {
+    assert(NULL != item);
+
+    if (NULL == map) {
+        return 0;
+    }
+
+    JournalRecord record;
+    memset(&record, 0, sizeof(record));
+    record.magic = JOURNAL_RECORD_MAGIC;
+    record.address = item->address.s_addr;
+    record.recv_time = item->recv_time;
+    record.type = (gint32) item->msg.type;
+    record.valve_no = -1;
+
+    const char *text = "";
+    switch (item->msg.type) {
+        case HARD_ERROR_VALVE:
+            #pragma GCC diagnostic push
+            #pragma GCC diagnostic ignored "-Wconversion"
+            record.valve_no = item->msg.data.hardware_valve.valve_no;
+            #pragma GCC diagnostic pop
+            text = item->msg.data.hardware_valve.message->str;
+            break;
+        case HARD_ERROR_OTHER:
+            text = item->msg.data.hardware_other.message->str;
+            break;
+        case SOFT_ERROR:
+            text = item->msg.data.software.message->str;
+            break;
+        default:
+            break;
+    }
+    record.length = (guint32) MIN(strlen(text), JOURNAL_MAX_MESSAGE);
+
+    // make room
+    const size_t record_size = sizeof(JournalRecord) + padded_length(record.length);
+    if (write_offset + record_size + sizeof(guint32) > map_size) {
+        size_t new_size = map_size;
+        while (write_offset + record_size + sizeof(guint32) > new_size) {
+            new_size *= 2;
+        }
+
+        // the data written so far must survive the remap
+        journal_sync();
+        if (!map_journal(new_size)) {
+            return 0;
+        }
+    }
+
+    record.seq = next_seq;
+    record.checksum = record_checksum(&record, text);
+
+    memcpy(map + write_offset, &record, sizeof(record));
+    memcpy(map + write_offset + sizeof(record), text, record.length);
+    write_offset += record_size;
+
+    // mark the end of the journal
+    memset(map + write_offset, 0, sizeof(guint32));
+
+    next_seq += 1;
+    last_seq = record.seq;
+    return record.seq;
+}
+
+bool journal_sync(void) {
+    if (NULL == map) {
+        return true;
+    }
+
+    // msync wants a page aligned address
+    const size_t page_size = (size_t) sysconf(_SC_PAGESIZE);
+    const size_t start = dirty_start - (dirty_start % page_size);
+    const size_t end = MIN(write_offset + sizeof(guint32), map_size);
+
+    if (0 != msync(map + start, end - start, MS_SYNC)) {
+        perror("msync journal");
+        return false;
+    }
+
+    dirty_start = write_offset;
+    return true;
+}
+
+void journal_checkpoint(const guint64 seq) {
+    if ((NULL == map) || (seq < last_seq)) {
+        return; // there are still records which are not in the database
+    }
+
+    // everything is in the database so start from the beginning of the file again
+    write_offset = JOURNAL_HEADER_SIZE;
+    dirty_start = write_offset;
+    memset(map + write_offset, 0, sizeof(guint32));
+    journal_sync();
+}
+
+guint64 journal_replay(const guint64 after, journal_replay_func_t func, gpointer user_data) {
+    assert(NULL != func);
+
+    if (NULL == map) {
+        return 0;
+    }
+
+    guint64 count = 0;
+    guint64 prev_seq = 0;
+    size_t offset = JOURNAL_HEADER_SIZE;
+    JournalRecord record;
+    while (read_record(offset, prev_seq, &record)) {
+        prev_seq = record.seq;
+        const char *stored_text = (const char *) (map + offset + sizeof(JournalRecord));
+        offset += sizeof(JournalRecord) + padded_length(record.length);
+
+        if (record.seq <= after) {
+            continue; // already in the database
+        }
+
+        BufferItem *item = malloc(sizeof(BufferItem));
+        assert(NULL != item);
+        memset(item, 0, sizeof(BufferItem));
+        item->address.s_addr = record.address;
+        item->recv_time = record.recv_time;
+
+        // the stored text is not nul terminated
+        gchar *text = g_strndup(stored_text, record.length);
+        assert(NULL != text);
+
+        #pragma GCC diagnostic push
+        #pragma GCC diagnostic ignored "-Wconversion"
+        switch (record.type) {
+            case HARD_ERROR_VALVE:
+                hardware_error_valve(&item->msg, record.valve_no, text);
+                break;
+            case HARD_ERROR_OTHER:
+                hardware_error_other(&item->msg, text);
+                break;
+            case SOFT_ERROR:
+                software_error(&item->msg, text);
+                break;
+            default:
+                item->msg.type = record.type;
+                break;
+        }
+        #pragma GCC diagnostic pop
+        g_free(text);
+
+        func(item, record.seq, user_data);
+        free_bufferitem(item);
+        count += 1;
+    }
+
+    return count;
+}
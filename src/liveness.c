@@ -0,0 +1,177 @@
+/*
+ * Copyright 2017
+ * GPL3 Licensed
+ * liveness.c
+ * Whether each node is up, worked out from the server's connected list and from the errors it sends
+ */
+
+// includes
+#include "config.h"
+#include "liveness.h"
+#include "clickable.h"
+#include <assert.h>
+
+typedef struct {
+    unsigned int rack_no;
+    unsigned int chassis_no;
+    LivenessState state;
+    time_t known_since; // when the node was added (or loaded)
+    time_t last_seen;   // 0 for never
+    bool connected;     // in the connected list of the poll in progress
+} LivenessNode;
+
+static GMutex liveness_lock; // protects everything below
+static GHashTable *nodes = NULL; // NODE_KEY -> LivenessNode
+static guint version = 0;
+
+// functions
+
+// call with liveness_lock held
+static GHashTable *get_nodes(void) {
+    if (NULL == nodes) {
+        nodes = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+        assert(NULL != nodes);
+    }
+    return nodes;
+}
+
+void liveness_clear(void) {
+    g_mutex_lock(&liveness_lock);
+    if (NULL != nodes) {
+        g_hash_table_destroy(nodes);
+        nodes = NULL;
+    }
+    version++;
+    g_mutex_unlock(&liveness_lock);
+}
+
+void liveness_set_node(const unsigned int rack_no, const unsigned int chassis_no, const time_t now) {
+    g_mutex_lock(&liveness_lock);
+
+    if (NULL == g_hash_table_lookup(get_nodes(), NODE_KEY(rack_no, chassis_no))) {
+        LivenessNode *node = g_malloc0(sizeof(LivenessNode));
+        assert(NULL != node);
+        node->rack_no = rack_no;
+        node->chassis_no = chassis_no;
+        node->state = LIVENESS_UNKNOWN;
+        node->known_since = now;
+        g_hash_table_insert(nodes, NODE_KEY(rack_no, chassis_no), node);
+        version++;
+    }
+
+    g_mutex_unlock(&liveness_lock);
+}
+
+void liveness_remove_node(const unsigned int rack_no, const unsigned int chassis_no) {
+    g_mutex_lock(&liveness_lock);
+    if (g_hash_table_remove(get_nodes(), NODE_KEY(rack_no, chassis_no))) {
+        version++;
+    }
+    g_mutex_unlock(&liveness_lock);
+}
+
+void liveness_seen(const unsigned int rack_no, const unsigned int chassis_no, const time_t recv_time) {
+    g_mutex_lock(&liveness_lock);
+
+    LivenessNode *node = g_hash_table_lookup(get_nodes(), NODE_KEY(rack_no, chassis_no));
+    if ((NULL != node) && (recv_time > node->last_seen)) {
+        node->last_seen = recv_time;
+    }
+
+    g_mutex_unlock(&liveness_lock);
+}
+
+void liveness_connected(const unsigned int rack_no, const unsigned int chassis_no) {
+    g_mutex_lock(&liveness_lock);
+
+    LivenessNode *node = g_hash_table_lookup(get_nodes(), NODE_KEY(rack_no, chassis_no));
+    if (NULL != node) {
+        node->connected = true;
+    }
+
+    g_mutex_unlock(&liveness_lock);
+}
+
+GArray *liveness_check(const time_t now) {
+    GArray *changes = g_array_new(FALSE, FALSE, sizeof(LivenessChange));
+    assert(NULL != changes);
+
+    g_mutex_lock(&liveness_lock);
+
+    GHashTableIter iter;
+    gpointer value = NULL;
+    g_hash_table_iter_init(&iter, get_nodes());
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        LivenessNode *node = value;
+
+        const bool recent = (0 != node->last_seen) && ((now - node->last_seen) < LIVENESS_STALE_SECONDS);
+        LivenessState state = LIVENESS_DOWN;
+        if (node->connected || recent) {
+            state = LIVENESS_UP;
+        } else if ((LIVENESS_UNKNOWN == node->state) && ((now - node->known_since) < LIVENESS_STALE_SECONDS)) {
+            state = LIVENESS_UNKNOWN; // give it a chance to connect
+        }
+        node->connected = false;
+
+        if ((state != node->state) && (LIVENESS_UNKNOWN != state)) {
+            LivenessChange change;
+            change.rack_no = node->rack_no;
+            change.chassis_no = node->chassis_no;
+            change.up = (LIVENESS_UP == state);
+            change.time = now;
+            change.previous = node->state;
+            g_array_append_val(changes, change);
+        }
+        node->state = state;
+    }
+
+    if (changes->len > 0) {
+        version++;
+    }
+
+    g_mutex_unlock(&liveness_lock);
+    return changes;
+}
+
+void liveness_revert(const GArray *changes) {
+    assert(NULL != changes);
+
+    g_mutex_lock(&liveness_lock);
+
+    for (guint i = 0; i < changes->len; i++) {
+        const LivenessChange *change = &g_array_index(changes, LivenessChange, i);
+        LivenessNode *node = g_hash_table_lookup(get_nodes(), NODE_KEY(change->rack_no, change->chassis_no));
+        if (NULL != node) {
+            node->state = change->previous;
+        }
+    }
+
+    if (changes->len > 0) {
+        version++;
+    }
+
+    g_mutex_unlock(&liveness_lock);
+}
+
+LivenessState liveness_state(const unsigned int rack_no, const unsigned int chassis_no, time_t *last_seen) {
+    g_mutex_lock(&liveness_lock);
+
+    LivenessState state = LIVENESS_UNKNOWN;
+    const LivenessNode *node = g_hash_table_lookup(get_nodes(), NODE_KEY(rack_no, chassis_no));
+    if (NULL != node) {
+        state = node->state;
+    }
+    if (NULL != last_seen) {
+        *last_seen = (NULL == node) ? 0 : node->last_seen;
+    }
+
+    g_mutex_unlock(&liveness_lock);
+    return state;
+}
+
+guint liveness_version(void) {
+    g_mutex_lock(&liveness_lock);
+    const guint ret = version;
+    g_mutex_unlock(&liveness_lock);
+    return ret;
+}
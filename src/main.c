@@ -8,6 +8,8 @@
 // includes
 #include "config.h"
 #include <glib.h>
+#include <glib-unix.h>
+#include <signal.h>
 #include <stdlib.h>
 #include <edsac_timer.h>
 #include <edsac_arguments.h>
@@ -15,6 +17,10 @@
 #include "sql.h"
 #include <assert.h>
 #include "ui.h"
+#include "ingest.h"
+#include "priority.h"
+#include "alerts.h"
+#include "liveness.h"
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
@@ -23,36 +29,88 @@
 
 
 #define DEFAULT_PREFIX_PATH "./edsac"
+#define OPTIMIZE_INTERVAL (60 * 60) // seconds between updates of the query planner's statistics
+#define BACKUP_INTERVAL (6 * 60 * 60) // seconds between scheduled database backups
 char *g_prefix_path = NULL;
+static char *storage_profile_name = NULL;
+static gboolean headless = FALSE; // no GTK: just the server, ingest and the database
+static gboolean read_only = FALSE; // GUI attached to another instance's database
 
 // functions
 
+// show what has been added to the database once the main loop has nothing more important to do than priority
+static void queue_gui_update(const gint priority) {
+    #pragma GCC diagnostic push
+    #pragma GCC diagnostic ignored "-Wpedantic"
+    g_idle_add_full(priority, (GSourceFunc) gui_update, (gpointer) gui_update, NULL); // uses the data parameter to remove itself from g_idle once it has run once
+    #pragma GCC diagnostic pop
+}
+
+// implements ingest_stored_func_t. Urgent errors are shown ahead of other idle work, while the rest are stored
+static void show_urgent(__attribute__((unused)) gpointer unused) {
+    if (!headless) {
+        queue_gui_update(G_PRIORITY_DEFAULT);
+    }
+}
+
 // called periodically in its own thread to update the database and gui with new messages
 static void periodic_update(__attribute__((unused)) void *unused) {
-    BufferItem *item = NULL;
-    bool need_update = false;
-
-    while (true) {
-        // read messages from the server's buffer
-        item = read_message();
-        if (NULL == item) {
-            break;
+    if (!ingest_drain(NULL, show_urgent, NULL)) {
+        return;
+    }
+
+    if (headless) {
+        // nobody to show them to so log them instead
+        GList *alerts = alerts_take();
+        for (const GList *item = alerts; NULL != item; item = item->next) {
+            const Alert *alert = item->data;
+            printf("Alert \"%s\": rack %u chassis %u: %s\n", alert->rule, alert->rack_no, alert->chassis_no, alert->description);
         }
+        g_list_free_full(alerts, free_alert);
+    } else {
+        queue_gui_update(G_PRIORITY_DEFAULT_IDLE);
+    }
+}
+
+// keep query plans good and the error rate rollup small as the database grows
+static gboolean periodic_optimize(__attribute__((unused)) gpointer unused) {
+    compact_rollup(time(NULL));
+    optimize_database();
+    return G_SOURCE_CONTINUE;
+}
+
+static gboolean scheduled_backup(__attribute__((unused)) gpointer unused) {
+    start_backup();
+    return G_SOURCE_CONTINUE;
+}
+
+// notice nodes going up and down (see liveness.h)
+static gboolean periodic_liveness(__attribute__((unused)) gpointer unused) {
+    const guint version = liveness_version();
 
-        // we have an update to do!
-        need_update = true;
-        // add the error to the database
-        assert(true == add_error(item));
-        free_bufferitem(item);
-        item = NULL;
+    GSList *connected = get_connected_list();
+    update_liveness(connected, time(NULL));
+    g_slist_free_full(connected, g_free);
+
+    if (!headless && (liveness_version() != version)) {
+        gui_update(NULL);
     }
+    return G_SOURCE_CONTINUE;
+}
 
-    if (need_update) {
-        #pragma GCC diagnostic push
-        #pragma GCC diagnostic ignored "-Wpedantic"
-        g_idle_add((GSourceFunc) gui_update, (gpointer) gui_update); // uses the data parameter to remove itself from g_idle once it has run once
-        #pragma GCC diagnostic pop
+// show what another instance has written to the database since last time
+static gboolean periodic_refresh(__attribute__((unused)) gpointer unused) {
+    if (database_changed() && reload_database_state()) {
+        refresh_nodes_menu(); // nodes might have been added, removed or toggled
+        gui_update(NULL);
     }
+    return G_SOURCE_CONTINUE;
+}
+
+// SIGINT or SIGTERM in headless mode
+static gboolean quit_signal(gpointer loop) {
+    g_main_loop_quit(loop);
+    return G_SOURCE_REMOVE;
 }
 
 static gboolean version_option_callback(__attribute__((unused)) gchar *option_name, __attribute__((unused)) gchar *value,
@@ -71,13 +129,33 @@ int main(int argc, char** argv) {
     GOptionEntry entries[] = {
         {"version", 'v', G_OPTION_FLAG_NO_ARG, G_OPTION_ARG_CALLBACK, version_option_callback, NULL, NULL},
         {"path", 'd', G_OPTION_FLAG_NONE, G_OPTION_ARG_FILENAME, &g_prefix_path, "Path to the prefix directory underwhich the database is stored and other files are expected", "PATH"},
+        {"storage-profile", 's', G_OPTION_FLAG_NONE, G_OPTION_ARG_STRING, &storage_profile_name, "Database performance profile: safe, balanced or fast. Overrides PATH/mothership.conf", "PROFILE"},
+        {"headless", 0, G_OPTION_FLAG_NONE, G_OPTION_ARG_NONE, &headless, "Receive and store errors without a window", NULL},
+        {"read-only", 0, G_OPTION_FLAG_NONE, G_OPTION_ARG_NONE, &read_only, "Show the database of a headless instance without receiving errors", NULL},
         {NULL}
     };
     #pragma GCC diagnostic pop
 
-    struct sockaddr *addr = get_args(&argc, &argv, gtk_get_option_group(TRUE), entries);
+    // GTK's option group initialises GTK as the options are parsed, so headless gets an empty group in its place and
+    // GTK's own options (e.g. --display) aren't accepted
+    bool opens_display = true;
+    for (int i = 1; i < argc; i++) {
+        if (0 == strcmp("--headless", argv[i])) {
+            opens_display = false;
+        }
+    }
+    GOptionGroup *toolkit_options = opens_display ? gtk_get_option_group(TRUE)
+        : g_option_group_new("headless", "Headless options", "Show headless options", NULL, NULL);
+    assert(NULL != toolkit_options);
+
+    struct sockaddr *addr = get_args(&argc, &argv, toolkit_options, entries);
     assert(NULL != addr);
 
+    if (headless && read_only) {
+        fprintf(stderr, "--headless and --read-only can't be used together\n");
+        return EXIT_FAILURE;
+    }
+
     if (NULL == g_prefix_path) {
         g_prefix_path = (char *) DEFAULT_PREFIX_PATH;
     } 
@@ -115,17 +193,90 @@ int main(int argc, char** argv) {
     GString *db_path = g_string_new(g_prefix_path);
     assert(NULL != db_path);
     g_string_append_printf(db_path, "/mothership.db");
+    if (read_only) {
+        // the instance writing to the database does all the receiving
+        if (!init_database_read_only(db_path->str)) {
+            fprintf(stderr, "Unable to open %s read-only\n", db_path->str);
+            return EXIT_FAILURE;
+        }
+        g_string_free(db_path, TRUE);
+
+        // shift boundaries are only used for display
+        GString *conf_path = g_string_new(g_prefix_path);
+        assert(NULL != conf_path);
+        g_string_append_printf(conf_path, "/mothership.conf");
+        if (!load_shift_changes(conf_path->str)) {
+            return EXIT_FAILURE;
+        }
+        g_string_free(conf_path, TRUE);
+
+        g_timeout_add_seconds((guint) update_time, periodic_refresh, NULL);
+        return start_ui(&argc, &argv, NULL);
+    }
     init_database(db_path->str);
     g_string_free(db_path, TRUE);
     db_path = NULL;
 
+    // storage performance profile: the default, then path/mothership.conf, then the command line
+    StorageProfile profile;
+    assert(true == storage_profile_preset(DEFAULT_STORAGE_PROFILE, &profile));
+    GString *conf_path = g_string_new(g_prefix_path);
+    assert(NULL != conf_path);
+    g_string_append_printf(conf_path, "/mothership.conf");
+    if (!storage_profile_load(conf_path->str, &profile)) {
+        return EXIT_FAILURE;
+    }
+    if (!load_shift_changes(conf_path->str)) {
+        return EXIT_FAILURE;
+    }
+    if (!priority_load_rules(conf_path->str)) {
+        return EXIT_FAILURE;
+    }
+    if (!alerts_load_rules(conf_path->str)) {
+        return EXIT_FAILURE;
+    }
+    g_string_free(conf_path, TRUE);
+    if ((NULL != storage_profile_name) && !storage_profile_preset(storage_profile_name, &profile)) {
+        fprintf(stderr, "Unknown storage profile %s\n", storage_profile_name);
+        return EXIT_FAILURE;
+    }
+    if (!apply_storage_profile(&profile)) {
+        fprintf(stderr, "Unable to apply storage profile\n");
+        return EXIT_FAILURE;
+    }
+    g_timeout_add_seconds(OPTIMIZE_INTERVAL, periodic_optimize, NULL);
+    // only the instance writing to the database backs it up, with or without a window
+    g_timeout_add_seconds(BACKUP_INTERVAL, scheduled_backup, NULL);
+
+    // recover anything received last time which didn't make it into the database
+    ingest_init(g_prefix_path);
+
     assert(true == create_timer((timer_handler_t) periodic_update, &timer_id, update_time));
 
    if (false == start_server(addr, sizeof(*addr))) {
        fprintf(stderr, "Unable to bind to address\n");
        exit(EXIT_FAILURE);
    }
+    g_timeout_add_seconds(LIVENESS_INTERVAL, periodic_liveness, NULL);
+
+    if (!headless) {
+        return start_ui(&argc, &argv, (gpointer) &timer_id);
+    }
+
+    // run until told to stop then shut down like the GUI does
+    GMainLoop *loop = g_main_loop_new(NULL, FALSE);
+    assert(NULL != loop);
+    g_unix_signal_add(SIGINT, quit_signal, loop);
+    g_unix_signal_add(SIGTERM, quit_signal, loop);
+    printf("Running headless with the database in %s\n", g_prefix_path);
+    g_main_loop_run(loop);
+    g_main_loop_unref(loop);
 
-    return start_ui(&argc, &argv, (gpointer) &timer_id);
+    stop_timer(timer_id);
+    stop_server();
+    ingest_drain(NULL, NULL, NULL); // anything left in the server's buffer
+    ingest_shutdown();
+    close_database();
+    return EXIT_SUCCESS;
     // g_prefix_path points to a leaked dynamically allocated string if the argument was specified. 
 }
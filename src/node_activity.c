@@ -0,0 +1,161 @@
+/*
+ * Copyright 2017
+ * GPL3 Licensed
+ * node_activity.c
+ * Per node counts of recent errors, kept up to date as errors arrive so that overviews never query the database
+ *
+ * Each node has a ring of one minute buckets. A bucket is reused once its minute is too old to be recent.
+ */
+
+// includes
+#include "config.h"
+#include "node_activity.h"
+#include "clickable.h"
+#include <assert.h>
+#include <string.h>
+
+typedef struct {
+    unsigned int rack_no;
+    unsigned int chassis_no;
+    bool enabled;
+    guint counts[NODE_ACTIVITY_MINUTES];
+    gint64 minutes[NODE_ACTIVITY_MINUTES]; // which minute (time / 60) each bucket is counting
+} ActivityNode;
+
+static GMutex activity_lock; // protects everything below
+static GHashTable *nodes = NULL; // NODE_KEY -> ActivityNode
+static guint version = 0;
+
+// functions
+
+// call with activity_lock held
+static GHashTable *get_nodes(void) {
+    if (NULL == nodes) {
+        nodes = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+        assert(NULL != nodes);
+    }
+    return nodes;
+}
+
+void node_activity_clear(void) {
+    g_mutex_lock(&activity_lock);
+    if (NULL != nodes) {
+        g_hash_table_destroy(nodes);
+        nodes = NULL;
+    }
+    version++;
+    g_mutex_unlock(&activity_lock);
+}
+
+void node_activity_set_node(const unsigned int rack_no, const unsigned int chassis_no, const bool enabled) {
+    g_mutex_lock(&activity_lock);
+
+    ActivityNode *node = g_hash_table_lookup(get_nodes(), NODE_KEY(rack_no, chassis_no));
+    if (NULL == node) {
+        node = g_malloc0(sizeof(ActivityNode));
+        assert(NULL != node);
+        node->rack_no = rack_no;
+        node->chassis_no = chassis_no;
+        g_hash_table_insert(nodes, NODE_KEY(rack_no, chassis_no), node);
+    }
+    node->enabled = enabled;
+    version++;
+
+    g_mutex_unlock(&activity_lock);
+}
+
+void node_activity_remove_node(const unsigned int rack_no, const unsigned int chassis_no) {
+    g_mutex_lock(&activity_lock);
+    g_hash_table_remove(get_nodes(), NODE_KEY(rack_no, chassis_no));
+    version++;
+    g_mutex_unlock(&activity_lock);
+}
+
+void node_activity_clear_errors(void) {
+    g_mutex_lock(&activity_lock);
+
+    GHashTableIter iter;
+    gpointer value = NULL;
+    g_hash_table_iter_init(&iter, get_nodes());
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        ActivityNode *node = value;
+        memset(node->counts, 0, sizeof(node->counts));
+    }
+    version++;
+
+    g_mutex_unlock(&activity_lock);
+}
+
+void node_activity_add(const unsigned int rack_no, const unsigned int chassis_no, const guint count, const time_t recv_time) {
+    const gint64 minute = recv_time / 60;
+    if (minute <= (time(NULL) / 60) - NODE_ACTIVITY_MINUTES) {
+        return; // too old to matter
+    }
+
+    g_mutex_lock(&activity_lock);
+
+    ActivityNode *node = g_hash_table_lookup(get_nodes(), NODE_KEY(rack_no, chassis_no));
+    if (NULL != node) {
+        const size_t bucket = (size_t) (minute % NODE_ACTIVITY_MINUTES);
+        if (node->minutes[bucket] != minute) {
+            // an old minute's bucket
+            node->minutes[bucket] = minute;
+            node->counts[bucket] = 0;
+        }
+        node->counts[bucket] += count;
+        version++;
+    }
+
+    g_mutex_unlock(&activity_lock);
+}
+
+// Implements GCompareFunc for NodeActivity
+static gint compare_activity(gconstpointer a, gconstpointer b) {
+    const NodeActivity *A = a;
+    const NodeActivity *B = b;
+
+    if (A->rack_no != B->rack_no) {
+        return (A->rack_no < B->rack_no) ? -1 : 1;
+    }
+    return (A->chassis_no < B->chassis_no) ? -1 : (A->chassis_no > B->chassis_no);
+}
+
+GArray *node_activity_snapshot(const time_t now) {
+    const gint64 oldest = (now / 60) - NODE_ACTIVITY_MINUTES + 1;
+
+    g_mutex_lock(&activity_lock);
+
+    GArray *snapshot = g_array_sized_new(FALSE, FALSE, sizeof(NodeActivity), g_hash_table_size(get_nodes()));
+    assert(NULL != snapshot);
+
+    GHashTableIter iter;
+    gpointer value = NULL;
+    g_hash_table_iter_init(&iter, nodes);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        const ActivityNode *node = value;
+
+        NodeActivity activity;
+        activity.rack_no = node->rack_no;
+        activity.chassis_no = node->chassis_no;
+        activity.enabled = node->enabled;
+        activity.recent = 0;
+        for (size_t i = 0; i < NODE_ACTIVITY_MINUTES; i++) {
+            if (node->minutes[i] >= oldest) {
+                activity.recent += node->counts[i];
+            }
+        }
+        g_array_append_val(snapshot, activity);
+    }
+
+    g_mutex_unlock(&activity_lock);
+
+    g_array_sort(snapshot, compare_activity);
+    return snapshot;
+}
+
+guint node_activity_version(void) {
+    g_mutex_lock(&activity_lock);
+    const guint ret = version;
+    g_mutex_unlock(&activity_lock);
+    return ret;
+}
@@ -0,0 +1,506 @@
+/*
+ * Copyright 2017
+ * GPL3 Licensed
+ * node_browser.c
+ * Side panel listing every node with its status, searchable by typing and with actions on several nodes at once
+ */
+
+// includes
+#include "config.h"
+#include "node_browser.h"
+#include "node_activity.h"
+#include "liveness.h"
+#include "sql.h"
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <time.h>
+
+// seconds between checks for errors becoming too old to be recent
+#define REFRESH_INTERVAL 30
+
+// columns of the model
+enum {
+    NODE_COLUMN,    // "Rack 1, Chassis 2"
+    STATUS_COLUMN,  // disabled, up, down or unknown (see liveness.h)
+    ERRORS_COLUMN,  // errors in the last NODE_ACTIVITY_MINUTES minutes
+    RACK_COLUMN,
+    CHASSIS_COLUMN,
+    N_COLUMNS
+};
+
+typedef struct {
+    NodeActivity node;
+    LivenessState liveness;
+} BrowserRow;
+
+// A flat GtkTreeModel over BrowserRows. Nothing is made for a row until the view asks for one of its values, which it
+// only does for rows on screen (the view is in fixed height mode), so opening the browser doesn't get slower with
+// more nodes
+typedef struct {
+    GObject parent_instance;
+    GArray *rows;   // BrowserRows ordered by rack then chassis
+    gint stamp;     // for telling our iters apart
+} NodeBrowserModel;
+
+typedef struct {
+    GObjectClass parent_class;
+} NodeBrowserModelClass;
+
+typedef struct {
+    node_browser_action_t on_action;
+    gpointer user_data;
+    NodeBrowserModel *model;
+    GtkTreeView *view;
+    GtkWidget *buttons;     // only sensitive when something is selected
+    guint timer;            // for REFRESH_INTERVAL
+    guint shown_version;    // node_activity_version when last refreshed
+    guint shown_liveness;   // liveness_version when last refreshed
+    gint64 shown_minute;
+} BrowserState;
+
+// declarations
+GType node_browser_model_get_type(void);
+static void node_browser_model_tree_model_init(GtkTreeModelIface *iface);
+
+G_DEFINE_TYPE_WITH_CODE(NodeBrowserModel, node_browser_model, G_TYPE_OBJECT,
+    G_IMPLEMENT_INTERFACE(GTK_TYPE_TREE_MODEL, node_browser_model_tree_model_init))
+
+#define NODE_BROWSER_MODEL(obj) (G_TYPE_CHECK_INSTANCE_CAST((obj), node_browser_model_get_type(), NodeBrowserModel))
+
+// functions
+
+/**** the model ****/
+
+static void node_browser_model_finalize(GObject *object) {
+    NodeBrowserModel *self = NODE_BROWSER_MODEL(object);
+    g_array_unref(self->rows);
+    G_OBJECT_CLASS(node_browser_model_parent_class)->finalize(object);
+}
+
+static void node_browser_model_class_init(NodeBrowserModelClass *klass) {
+    G_OBJECT_CLASS(klass)->finalize = node_browser_model_finalize;
+}
+
+static void node_browser_model_init(NodeBrowserModel *self) {
+    self->rows = g_array_new(FALSE, FALSE, sizeof(BrowserRow));
+    assert(NULL != self->rows);
+    self->stamp = g_random_int_range(1, G_MAXINT);
+}
+
+static void set_iter(const NodeBrowserModel *self, GtkTreeIter *iter, const guint index) {
+    iter->stamp = self->stamp;
+    iter->user_data = GUINT_TO_POINTER(index);
+    iter->user_data2 = NULL;
+    iter->user_data3 = NULL;
+}
+
+static const BrowserRow *get_row(const NodeBrowserModel *self, const GtkTreeIter *iter) {
+    assert(iter->stamp == self->stamp);
+    const guint index = GPOINTER_TO_UINT(iter->user_data);
+    assert(index < self->rows->len);
+    return &g_array_index(self->rows, BrowserRow, index);
+}
+
+static GtkTreeModelFlags model_get_flags(__attribute__((unused)) GtkTreeModel *model) {
+    return GTK_TREE_MODEL_LIST_ONLY;
+}
+
+static gint model_get_n_columns(__attribute__((unused)) GtkTreeModel *model) {
+    return N_COLUMNS;
+}
+
+static GType model_get_column_type(__attribute__((unused)) GtkTreeModel *model, gint column) {
+    switch (column) {
+        case NODE_COLUMN:
+        case STATUS_COLUMN:
+            return G_TYPE_STRING;
+        default:
+            return G_TYPE_UINT;
+    }
+}
+
+static gboolean model_get_iter(GtkTreeModel *model, GtkTreeIter *iter, GtkTreePath *path) {
+    NodeBrowserModel *self = NODE_BROWSER_MODEL(model);
+    if (1 != gtk_tree_path_get_depth(path)) {
+        return FALSE;
+    }
+
+    const gint index = gtk_tree_path_get_indices(path)[0];
+    if ((index < 0) || ((guint) index >= self->rows->len)) {
+        return FALSE;
+    }
+
+    set_iter(self, iter, (guint) index);
+    return TRUE;
+}
+
+static GtkTreePath *model_get_path(GtkTreeModel *model, GtkTreeIter *iter) {
+    NodeBrowserModel *self = NODE_BROWSER_MODEL(model);
+    assert(iter->stamp == self->stamp);
+    return gtk_tree_path_new_from_indices((gint) GPOINTER_TO_UINT(iter->user_data), -1);
+}
+
+static void model_get_value(GtkTreeModel *model, GtkTreeIter *iter, gint column, GValue *value) {
+    const BrowserRow *row = get_row(NODE_BROWSER_MODEL(model), iter);
+
+    g_value_init(value, model_get_column_type(model, column));
+    switch (column) {
+        case NODE_COLUMN:
+            g_value_take_string(value, g_strdup_printf("Rack %u, Chassis %u", row->node.rack_no, row->node.chassis_no));
+            break;
+        case STATUS_COLUMN:
+            if (!row->node.enabled) {
+                g_value_set_static_string(value, "disabled");
+            } else if (LIVENESS_UP == row->liveness) {
+                g_value_set_static_string(value, "up");
+            } else if (LIVENESS_DOWN == row->liveness) {
+                g_value_set_static_string(value, "down");
+            } else {
+                g_value_set_static_string(value, "unknown");
+            }
+            break;
+        case ERRORS_COLUMN:
+            g_value_set_uint(value, row->node.recent);
+            break;
+        case RACK_COLUMN:
+            g_value_set_uint(value, row->node.rack_no);
+            break;
+        case CHASSIS_COLUMN:
+            g_value_set_uint(value, row->node.chassis_no);
+            break;
+        default:
+            assert(false);
+    }
+}
+
+static gboolean model_iter_next(GtkTreeModel *model, GtkTreeIter *iter) {
+    NodeBrowserModel *self = NODE_BROWSER_MODEL(model);
+    const guint next = GPOINTER_TO_UINT(iter->user_data) + 1;
+    if (next >= self->rows->len) {
+        iter->stamp = 0;
+        return FALSE;
+    }
+
+    set_iter(self, iter, next);
+    return TRUE;
+}
+
+static gboolean model_iter_nth_child(GtkTreeModel *model, GtkTreeIter *iter, GtkTreeIter *parent, gint n) {
+    NodeBrowserModel *self = NODE_BROWSER_MODEL(model);
+    if ((NULL != parent) || (n < 0) || ((guint) n >= self->rows->len)) {
+        return FALSE;
+    }
+
+    set_iter(self, iter, (guint) n);
+    return TRUE;
+}
+
+static gboolean model_iter_children(GtkTreeModel *model, GtkTreeIter *iter, GtkTreeIter *parent) {
+    return model_iter_nth_child(model, iter, parent, 0);
+}
+
+static gboolean model_iter_has_child(__attribute__((unused)) GtkTreeModel *model, __attribute__((unused)) GtkTreeIter *iter) {
+    return FALSE;
+}
+
+static gint model_iter_n_children(GtkTreeModel *model, GtkTreeIter *iter) {
+    NodeBrowserModel *self = NODE_BROWSER_MODEL(model);
+    return (NULL == iter) ? (gint) self->rows->len : 0;
+}
+
+static gboolean model_iter_parent(__attribute__((unused)) GtkTreeModel *model, __attribute__((unused)) GtkTreeIter *iter,
+        __attribute__((unused)) GtkTreeIter *child) {
+    return FALSE;
+}
+
+static void node_browser_model_tree_model_init(GtkTreeModelIface *iface) {
+    iface->get_flags = model_get_flags;
+    iface->get_n_columns = model_get_n_columns;
+    iface->get_column_type = model_get_column_type;
+    iface->get_iter = model_get_iter;
+    iface->get_path = model_get_path;
+    iface->get_value = model_get_value;
+    iface->iter_next = model_iter_next;
+    iface->iter_children = model_iter_children;
+    iface->iter_has_child = model_iter_has_child;
+    iface->iter_n_children = model_iter_n_children;
+    iface->iter_nth_child = model_iter_nth_child;
+    iface->iter_parent = model_iter_parent;
+}
+
+static gint compare_rows(const BrowserRow *a, const BrowserRow *b) {
+    if (a->node.rack_no != b->node.rack_no) {
+        return (a->node.rack_no < b->node.rack_no) ? -1 : 1;
+    }
+    if (a->node.chassis_no != b->node.chassis_no) {
+        return (a->node.chassis_no < b->node.chassis_no) ? -1 : 1;
+    }
+    return 0;
+}
+
+static bool same_row(const BrowserRow *a, const BrowserRow *b) {
+    return (0 == compare_rows(a, b)) && (a->node.enabled == b->node.enabled) && (a->node.recent == b->node.recent)
+        && (a->liveness == b->liveness);
+}
+
+// replace the rows with next (in the same order), telling the view only about the rows which changed so that the
+// selection and scroll position are kept
+static void model_set_rows(NodeBrowserModel *self, const GArray *next) {
+    GtkTreeModel *model = GTK_TREE_MODEL(self);
+    GtkTreeIter iter;
+    guint position = 0;
+    guint j = 0;
+
+    while ((position < self->rows->len) || (j < next->len)) {
+        BrowserRow *old_row = (position < self->rows->len) ? &g_array_index(self->rows, BrowserRow, position) : NULL;
+        const BrowserRow *new_row = (j < next->len) ? &g_array_index(next, BrowserRow, j) : NULL;
+
+        gint order = 0;
+        if (NULL == old_row) {
+            order = 1;
+        } else if (NULL == new_row) {
+            order = -1;
+        } else {
+            order = compare_rows(old_row, new_row);
+        }
+
+        GtkTreePath *path = gtk_tree_path_new_from_indices((gint) position, -1);
+        assert(NULL != path);
+        if (order < 0) { // gone
+            g_array_remove_index(self->rows, position);
+            gtk_tree_model_row_deleted(model, path);
+        } else if (order > 0) { // new
+            g_array_insert_vals(self->rows, position, new_row, 1);
+            set_iter(self, &iter, position);
+            gtk_tree_model_row_inserted(model, path, &iter);
+            position++;
+            j++;
+        } else {
+            if (!same_row(old_row, new_row)) {
+                *old_row = *new_row;
+                set_iter(self, &iter, position);
+                gtk_tree_model_row_changed(model, path, &iter);
+            }
+            position++;
+            j++;
+        }
+        gtk_tree_path_free(path);
+    }
+}
+
+/**** the panel ****/
+
+static void refresh(BrowserState *state) {
+    const time_t now = time(NULL);
+    state->shown_version = node_activity_version();
+    state->shown_liveness = liveness_version();
+    state->shown_minute = now / 60;
+
+    GArray *nodes = node_activity_snapshot(now);
+    GArray *rows = g_array_sized_new(FALSE, FALSE, sizeof(BrowserRow), nodes->len);
+    assert(NULL != rows);
+    for (guint i = 0; i < nodes->len; i++) {
+        BrowserRow row;
+        row.node = g_array_index(nodes, NodeActivity, i);
+        row.liveness = liveness_state(row.node.rack_no, row.node.chassis_no, NULL);
+        g_array_append_val(rows, row);
+    }
+    g_array_unref(nodes);
+
+    model_set_rows(state->model, rows);
+    g_array_unref(rows);
+}
+
+static void free_browser_state(gpointer data) {
+    BrowserState *state = data;
+    g_source_remove(state->timer);
+    g_object_unref(state->model);
+    g_free(state);
+}
+
+static gboolean browser_timer(gpointer data) {
+    BrowserState *state = data;
+    refresh(state);
+    return G_SOURCE_CONTINUE;
+}
+
+static void free_path(gpointer path) {
+    gtk_tree_path_free(path);
+}
+
+static void run_action(BrowserState *state, const NodeBrowserAction action) {
+    GtkTreeModel *model = GTK_TREE_MODEL(state->model);
+    GList *paths = gtk_tree_selection_get_selected_rows(gtk_tree_view_get_selection(state->view), NULL);
+
+    // copied because the action will probably change the rows
+    GSList *nodes = NULL;
+    for (GList *item = paths; NULL != item; item = item->next) {
+        GtkTreeIter iter;
+        if (!gtk_tree_model_get_iter(model, &iter, item->data)) {
+            continue;
+        }
+        const BrowserRow *row = get_row(state->model, &iter);
+
+        NodeIdentifier *node = g_malloc(sizeof(NodeIdentifier));
+        assert(NULL != node);
+        node->rack_no = row->node.rack_no;
+        node->chassis_no = row->node.chassis_no;
+        nodes = g_slist_prepend(nodes, node);
+    }
+    g_list_free_full(paths, free_path);
+
+    if (NULL != nodes) {
+        nodes = g_slist_reverse(nodes);
+        state->on_action(action, nodes, state->user_data);
+        g_slist_free_full(nodes, g_free);
+    }
+}
+
+static void show_clicked(__attribute__((unused)) GtkButton *button, BrowserState *state) {
+    run_action(state, NODE_BROWSER_SHOW);
+}
+
+static void enable_clicked(__attribute__((unused)) GtkButton *button, BrowserState *state) {
+    run_action(state, NODE_BROWSER_ENABLE);
+}
+
+static void disable_clicked(__attribute__((unused)) GtkButton *button, BrowserState *state) {
+    run_action(state, NODE_BROWSER_DISABLE);
+}
+
+static void delete_clicked(__attribute__((unused)) GtkButton *button, BrowserState *state) {
+    run_action(state, NODE_BROWSER_DELETE);
+}
+
+static void history_clicked(__attribute__((unused)) GtkButton *button, BrowserState *state) {
+    run_action(state, NODE_BROWSER_HISTORY);
+}
+
+static void row_activated(__attribute__((unused)) GtkTreeView *view, __attribute__((unused)) GtkTreePath *path,
+        __attribute__((unused)) GtkTreeViewColumn *column, BrowserState *state) {
+    run_action(state, NODE_BROWSER_SHOW);
+}
+
+static void selection_changed(GtkTreeSelection *selection, BrowserState *state) {
+    gtk_widget_set_sensitive(state->buttons, gtk_tree_selection_count_selected_rows(selection) > 0);
+}
+
+// Type to search: "12" finds rack 12 and "12 3" (or 12.3, 12/3, "rack 12 chassis 3") finds rack 12, chassis 3.
+// Implements GtkTreeViewSearchEqualFunc so returns FALSE for a match
+static gboolean search_equal(GtkTreeModel *model, __attribute__((unused)) gint column, const gchar *key, GtkTreeIter *iter,
+        __attribute__((unused)) gpointer unused) {
+    const BrowserRow *row = get_row(NODE_BROWSER_MODEL(model), iter);
+
+    unsigned int numbers[2] = {0, 0};
+    int found = 0;
+    const char *c = key;
+    while (('\0' != *c) && (found < 2)) {
+        if (g_ascii_isdigit(*c)) {
+            gchar *end = NULL;
+            const guint64 number = g_ascii_strtoull(c, &end, 10);
+            numbers[found++] = (number > G_MAXUINT) ? G_MAXUINT : (unsigned int) number;
+            c = end;
+        } else {
+            c++;
+        }
+    }
+
+    if (0 == found) {
+        return TRUE;
+    }
+    if (numbers[0] != row->node.rack_no) {
+        return TRUE;
+    }
+    return (2 == found) && (numbers[1] != row->node.chassis_no);
+}
+
+static GtkTreeViewColumn *fixed_column(const char *title, const gint column, const gint width) {
+    GtkCellRenderer *renderer = gtk_cell_renderer_text_new();
+    assert(NULL != renderer);
+    GtkTreeViewColumn *view_column = gtk_tree_view_column_new_with_attributes(title, renderer, "text", column, NULL);
+    assert(NULL != view_column);
+    gtk_tree_view_column_set_sizing(view_column, GTK_TREE_VIEW_COLUMN_FIXED);
+    gtk_tree_view_column_set_fixed_width(view_column, width);
+    gtk_tree_view_column_set_resizable(view_column, TRUE);
+    return view_column;
+}
+
+static void action_button(GtkBox *box, const char *label, GCallback on_click, BrowserState *state) {
+    GtkWidget *button = gtk_button_new_with_label(label);
+    assert(NULL != button);
+    g_signal_connect(G_OBJECT(button), "clicked", on_click, state);
+    gtk_box_pack_start(box, button, TRUE, TRUE, 0);
+}
+
+GtkWidget *node_browser_new(node_browser_action_t on_action, gpointer user_data) {
+    assert(NULL != on_action);
+
+    GtkBox *panel = GTK_BOX(gtk_box_new(GTK_ORIENTATION_VERTICAL, 4));
+    assert(NULL != panel);
+
+    BrowserState *state = g_malloc0(sizeof(BrowserState));
+    assert(NULL != state);
+    state->on_action = on_action;
+    state->user_data = user_data;
+    state->model = g_object_new(node_browser_model_get_type(), NULL);
+    assert(NULL != state->model);
+    state->timer = g_timeout_add_seconds(REFRESH_INTERVAL, browser_timer, state);
+    g_object_set_data_full(G_OBJECT(panel), "node_browser", state, free_browser_state);
+
+    GtkWidget *search = gtk_search_entry_new();
+    assert(NULL != search);
+    gtk_entry_set_placeholder_text(GTK_ENTRY(search), "Find node");
+    gtk_widget_set_tooltip_text(search, "Type a rack number, optionally followed by a chassis number");
+    gtk_box_pack_start(panel, search, FALSE, FALSE, 0);
+
+    state->view = GTK_TREE_VIEW(gtk_tree_view_new_with_model(GTK_TREE_MODEL(state->model)));
+    assert(NULL != state->view);
+    gtk_tree_view_append_column(state->view, fixed_column("Node", NODE_COLUMN, 130));
+    gtk_tree_view_append_column(state->view, fixed_column("Status", STATUS_COLUMN, 90));
+    gtk_tree_view_append_column(state->view, fixed_column("Errors", ERRORS_COLUMN, 50));
+    gtk_tree_view_set_fixed_height_mode(state->view, TRUE);
+    gtk_tree_view_set_enable_search(state->view, TRUE);
+    gtk_tree_view_set_search_column(state->view, NODE_COLUMN);
+    gtk_tree_view_set_search_entry(state->view, GTK_ENTRY(search));
+    gtk_tree_view_set_search_equal_func(state->view, search_equal, NULL, NULL);
+    gtk_widget_set_tooltip_text(GTK_WIDGET(state->view), "Errors are from the last " G_STRINGIFY(NODE_ACTIVITY_MINUTES) " minutes");
+    g_signal_connect(G_OBJECT(state->view), "row-activated", G_CALLBACK(row_activated), state);
+
+    GtkTreeSelection *selection = gtk_tree_view_get_selection(state->view);
+    gtk_tree_selection_set_mode(selection, GTK_SELECTION_MULTIPLE);
+    g_signal_connect(G_OBJECT(selection), "changed", G_CALLBACK(selection_changed), state);
+
+    GtkWidget *scroll = gtk_scrolled_window_new(NULL, NULL);
+    assert(NULL != scroll);
+    gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scroll), GTK_POLICY_NEVER, GTK_POLICY_AUTOMATIC);
+    gtk_container_add(GTK_CONTAINER(scroll), GTK_WIDGET(state->view));
+    gtk_widget_set_vexpand(scroll, TRUE);
+    gtk_box_pack_start(panel, scroll, TRUE, TRUE, 0);
+
+    GtkBox *buttons = GTK_BOX(gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 2));
+    assert(NULL != buttons);
+    action_button(buttons, "Show", G_CALLBACK(show_clicked), state);
+    action_button(buttons, "Enable", G_CALLBACK(enable_clicked), state);
+    action_button(buttons, "Disable", G_CALLBACK(disable_clicked), state);
+    action_button(buttons, "Delete", G_CALLBACK(delete_clicked), state);
+    action_button(buttons, "History", G_CALLBACK(history_clicked), state);
+    state->buttons = GTK_WIDGET(buttons);
+    gtk_widget_set_sensitive(state->buttons, FALSE);
+    gtk_box_pack_start(panel, state->buttons, FALSE, FALSE, 0);
+
+    refresh(state);
+
+    return GTK_WIDGET(panel);
+}
+
+void node_browser_update(GtkWidget *browser) {
+    assert(NULL != browser);
+    BrowserState *state = g_object_get_data(G_OBJECT(browser), "node_browser");
+    assert(NULL != state);
+
+    if ((node_activity_version() != state->shown_version) || (liveness_version() != state->shown_liveness)
+            || ((time(NULL) / 60) != state->shown_minute)) {
+        refresh(state);
+    }
+}
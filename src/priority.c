@@ -0,0 +1,194 @@
+/*
+ * Copyright 2017
+ * GPL3 Licensed
+ * priority.c
+ * How urgent received errors are, and a queue which hands out the most urgent first
+ */
+
+// includes
+#include "config.h"
+#include "priority.h"
+#include "filter.h"
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+struct _PriorityQueue {
+    GQueue levels[PRIORITY_LEVELS];
+    guint length;
+};
+
+// Filters overriding the default priorities, by priority. Set up before ingest starts and only read afterwards
+static GPtrArray *rules[PRIORITY_LEVELS] = {NULL};
+
+// the key in the priority group for each level
+static const char *rule_keys[PRIORITY_LEVELS] = {"low", "normal", "high"};
+
+// functions
+
+static void free_filter(gpointer filter) {
+    filter_free(filter);
+}
+
+void priority_clear_rules(void) {
+    for (int level = 0; level < PRIORITY_LEVELS; level++) {
+        if (NULL != rules[level]) {
+            g_ptr_array_unref(rules[level]);
+            rules[level] = NULL;
+        }
+    }
+}
+
+bool priority_load_rules(const char *path) {
+    assert(NULL != path);
+
+    if (0 != access(path, F_OK)) {
+        priority_clear_rules();
+        return true; // no config file: no rules
+    }
+
+    GKeyFile *key_file = g_key_file_new();
+    assert(NULL != key_file);
+
+    GError *error = NULL;
+    if (!g_key_file_load_from_file(key_file, path, G_KEY_FILE_NONE, &error)) {
+        fprintf(stderr, "Unable to read %s: %s\n", path, error->message);
+        g_error_free(error);
+        g_key_file_free(key_file);
+        return false;
+    }
+
+    bool ret = true;
+    GPtrArray *loaded[PRIORITY_LEVELS] = {NULL};
+    for (int level = 0; ret && (level < PRIORITY_LEVELS); level++) {
+        gsize len = 0;
+        gchar **expressions = g_key_file_get_string_list(key_file, "priority", rule_keys[level], &len, NULL);
+        if (NULL == expressions) {
+            continue;
+        }
+
+        loaded[level] = g_ptr_array_new_with_free_func(free_filter);
+        assert(NULL != loaded[level]);
+        for (gsize i = 0; i < len; i++) {
+            char *error_message = NULL;
+            Filter *filter = filter_parse(expressions[i], &error_message);
+            if (NULL == filter) {
+                fprintf(stderr, "%s: %s priority rule \"%s\": %s\n", path, rule_keys[level], expressions[i], error_message);
+                g_free(error_message);
+                ret = false;
+                break;
+            }
+            g_ptr_array_add(loaded[level], filter);
+        }
+        g_strfreev(expressions);
+    }
+    g_key_file_free(key_file);
+
+    if (ret) {
+        priority_clear_rules();
+        memcpy(rules, loaded, sizeof(rules));
+    } else {
+        for (int level = 0; level < PRIORITY_LEVELS; level++) {
+            if (NULL != loaded[level]) {
+                g_ptr_array_unref(loaded[level]);
+            }
+        }
+    }
+
+    return ret;
+}
+
+// does any rule for level match?
+static bool rules_match(const Priority level, const unsigned int rack_no, const unsigned int chassis_no,
+        const int valve_no, const char *description) {
+    const GPtrArray *filters = rules[level];
+    for (guint i = 0; (NULL != filters) && (i < filters->len); i++) {
+        if (filter_matches(g_ptr_array_index(filters, i), rack_no, chassis_no, valve_no, description)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+Priority priority_classify(const MessageType type, const unsigned int rack_no, const unsigned int chassis_no,
+        const int valve_no, const char *description) {
+    assert(NULL != description);
+
+    // most urgent rule first
+    for (int level = PRIORITY_LEVELS - 1; level >= 0; level--) {
+        if (rules_match((Priority) level, rack_no, chassis_no, valve_no, description)) {
+            return (Priority) level;
+        }
+    }
+
+    switch (type) {
+        case HARD_ERROR_VALVE:
+            return PRIORITY_HIGH;
+        case HARD_ERROR_OTHER:
+            return PRIORITY_NORMAL;
+        default:
+            return PRIORITY_LOW;
+    }
+}
+
+PriorityQueue *priority_queue_new(void) {
+    PriorityQueue *queue = g_malloc(sizeof(PriorityQueue));
+    assert(NULL != queue);
+
+    for (int level = 0; level < PRIORITY_LEVELS; level++) {
+        g_queue_init(&queue->levels[level]);
+    }
+    queue->length = 0;
+
+    return queue;
+}
+
+void priority_queue_free(PriorityQueue *queue, GDestroyNotify free_func) {
+    if (NULL == queue) {
+        return;
+    }
+
+    gpointer data = NULL;
+    while (NULL != (data = priority_queue_pop(queue, NULL))) {
+        if (NULL != free_func) {
+            free_func(data);
+        }
+    }
+    g_free(queue);
+}
+
+void priority_queue_push(PriorityQueue *queue, gpointer data, const Priority priority) {
+    assert(NULL != queue);
+    assert(priority < PRIORITY_LEVELS);
+
+    g_queue_push_tail(&queue->levels[priority], data);
+    queue->length++;
+}
+
+gpointer priority_queue_pop(PriorityQueue *queue, Priority *priority) {
+    assert(NULL != queue);
+
+    for (int level = PRIORITY_LEVELS - 1; level >= 0; level--) {
+        if (!g_queue_is_empty(&queue->levels[level])) {
+            if (NULL != priority) {
+                *priority = (Priority) level;
+            }
+            queue->length--;
+            return g_queue_pop_head(&queue->levels[level]);
+        }
+    }
+
+    return NULL;
+}
+
+guint priority_queue_length(const PriorityQueue *queue) {
+    assert(NULL != queue);
+    return queue->length;
+}
+
+guint priority_queue_length_at(const PriorityQueue *queue, const Priority priority) {
+    assert(NULL != queue);
+    assert(priority < PRIORITY_LEVELS);
+    return queue->levels[priority].length;
+}
@@ -0,0 +1,425 @@
+/*
+ * Copyright 2017
+ * GPL3 Licensed
+ * query.c
+ * mothership-query: print errors from the mothership database (or an archive of it) as text, CSV or JSON for reports
+ * and scripts
+ */
+
+// includes
+#include "config.h"
+#include "sql.h"
+#include "filter.h"
+#include "archive.h"
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <glib.h>
+
+#define DEFAULT_PREFIX_PATH "./edsac"
+#define TIME_FORMAT "%Y-%m-%d %H:%M:%S"
+
+typedef enum {
+    FORMAT_TEXT,
+    FORMAT_CSV,
+    FORMAT_JSON
+} OutputFormat;
+
+// passed to write_row
+typedef struct {
+    OutputFormat format;
+    gint64 limit;   // rows to print. 0 for no limit
+    gint64 rows;    // printed so far
+} Output;
+
+// names accepted by --range
+static const struct {
+    const char *name;
+    TimeRange time_range;
+} time_range_names[] = {
+    {"all", TIME_ALL},
+    {"hour", TIME_LAST_HOUR},
+    {"shift", TIME_SHIFT},
+    {"today", TIME_TODAY},
+    {"day", TIME_LAST_DAY}
+};
+
+// command line options
+static char *prefix_path = NULL;
+static char *archive_path = NULL;
+static char *rack_set = NULL;
+static char *chassis_set = NULL;
+static char *valve_set = NULL;
+static char *types = NULL;
+static char *templates = NULL;
+static gboolean enabled_only = FALSE;
+static char *expression = NULL;
+static char *range_name = NULL;
+static char *since_text = NULL;
+static char *until_text = NULL;
+static char *format_name = NULL;
+static gint limit = 0;
+
+// functions
+
+static gboolean version_option_callback(__attribute__((unused)) gchar *option_name, __attribute__((unused)) gchar *value,
+                                 __attribute__((unused)) gpointer data, __attribute__((unused)) GError **error) {
+    puts(PACKAGE_STRING);
+    exit(EXIT_SUCCESS);
+}
+
+// parse local time YYYY-MM-DD, YYYY-MM-DD HH:MM or YYYY-MM-DD HH:MM:SS (T may separate the date and time), or seconds
+// since the epoch preceded by @. Returns success
+static bool parse_time(const char *text, time_t *result) {
+    assert(NULL != text);
+    assert(NULL != result);
+
+    if ('@' == text[0]) {
+        char *end = NULL;
+        const gint64 seconds = g_ascii_strtoll(text + 1, &end, 10);
+        if ((end == text + 1) || ('\0' != *end) || (seconds < 0)) {
+            return false;
+        }
+        *result = (time_t) seconds;
+        return true;
+    }
+
+    gchar *copy = g_strdup(text);
+    assert(NULL != copy);
+    g_strdelimit(copy, "T", ' ');
+
+    int year = 0, month = 0, day = 0, hour = 0, minute = 0, second = 0;
+    int used = -1;
+    if (!((6 == sscanf(copy, "%d-%d-%d %d:%d:%d%n", &year, &month, &day, &hour, &minute, &second, &used))
+            && ('\0' == copy[used]))) {
+        used = -1;
+        second = 0;
+        if (!((5 == sscanf(copy, "%d-%d-%d %d:%d%n", &year, &month, &day, &hour, &minute, &used))
+                && ('\0' == copy[used]))) {
+            used = -1;
+            hour = 0;
+            minute = 0;
+            if (!((3 == sscanf(copy, "%d-%d-%d%n", &year, &month, &day, &used)) && ('\0' == copy[used]))) {
+                g_free(copy);
+                return false;
+            }
+        }
+    }
+    g_free(copy);
+
+    if ((year < 1970) || (month < 1) || (month > 12) || (day < 1) || (day > 31) || (hour < 0) || (hour > 23)
+            || (minute < 0) || (minute > 59) || (second < 0) || (second > 60)) {
+        return false;
+    }
+
+    struct tm local;
+    memset(&local, 0, sizeof(local));
+    local.tm_year = year - 1900;
+    local.tm_mon = month - 1;
+    local.tm_mday = day;
+    local.tm_hour = hour;
+    local.tm_min = minute;
+    local.tm_sec = second;
+    local.tm_isdst = -1; // work it out
+    *result = mktime(&local);
+    return ((time_t) -1) != *result;
+}
+
+// the filter expression made from the command line options. Free with g_free
+static char *build_expression(void) {
+    GString *built = g_string_new(NULL);
+    assert(NULL != built);
+
+    if (NULL != rack_set) {
+        g_string_append_printf(built, " rack=%s", rack_set);
+    }
+    if (NULL != chassis_set) {
+        g_string_append_printf(built, " chassis=%s", chassis_set);
+    }
+    if (NULL != valve_set) {
+        g_string_append_printf(built, " valve=%s", valve_set);
+    }
+    if (NULL != types) {
+        g_string_append_printf(built, " type=%s", types);
+    }
+    if (NULL != templates) {
+        g_string_append_printf(built, " template=%s", templates);
+    }
+    if (enabled_only) {
+        g_string_append(built, " enabled");
+    }
+    if (NULL != expression) {
+        g_string_append_printf(built, " %s", expression);
+    }
+
+    return g_string_free(built, FALSE);
+}
+
+// print str as a CSV field, quoted if it needs to be
+static void put_csv_string(const char *str) {
+    if (NULL == strpbrk(str, ",\"\r\n")) {
+        fputs(str, stdout);
+        return;
+    }
+
+    putchar('"');
+    for (const char *c = str; '\0' != *c; c++) {
+        if ('"' == *c) {
+            putchar('"'); // doubled
+        }
+        putchar(*c);
+    }
+    putchar('"');
+}
+
+// print str as a JSON string
+static void put_json_string(const char *str) {
+    putchar('"');
+    for (const char *c = str; '\0' != *c; c++) {
+        switch (*c) {
+            case '"':
+                fputs("\\\"", stdout);
+                break;
+            case '\\':
+                fputs("\\\\", stdout);
+                break;
+            case '\n':
+                fputs("\\n", stdout);
+                break;
+            case '\r':
+                fputs("\\r", stdout);
+                break;
+            case '\t':
+                fputs("\\t", stdout);
+                break;
+            default:
+                if ((unsigned char) *c < 0x20) {
+                    printf("\\u%04x", (unsigned int) (unsigned char) *c);
+                } else {
+                    putchar(*c);
+                }
+        }
+    }
+    putchar('"');
+}
+
+// implements error_row_func_t to print a row in the chosen format
+static bool write_row(const time_t recv_time, const unsigned int rack_no, const unsigned int chassis_no,
+        const int valve_no, const bool enabled, __attribute__((unused)) const bool acked, const char *description,
+        gpointer user_data) {
+    assert(NULL != description);
+    assert(NULL != user_data);
+    Output *output = user_data;
+
+    char time_str[32];
+    struct tm local;
+    assert(NULL != localtime_r(&recv_time, &local));
+    strftime(time_str, sizeof(time_str), TIME_FORMAT, &local);
+
+    switch (output->format) {
+        case FORMAT_TEXT:
+            printf("%s  rack %u chassis %u", time_str, rack_no, chassis_no);
+            if (valve_no >= 0) {
+                printf(" valve %i", valve_no);
+            }
+            printf("%s  %s\n", enabled ? "" : " (disabled)", description);
+            break;
+        case FORMAT_CSV:
+            printf("%s,%u,%u,", time_str, rack_no, chassis_no);
+            if (valve_no >= 0) {
+                printf("%i", valve_no);
+            }
+            printf(",%i,", enabled ? 1 : 0);
+            put_csv_string(description);
+            putchar('\n');
+            break;
+        case FORMAT_JSON:
+            printf("%s\n  {\"time\": %li, \"rack\": %u, \"chassis\": %u, \"valve\": ", (0 == output->rows) ? "" : ",",
+                (long) recv_time, rack_no, chassis_no);
+            if (valve_no >= 0) {
+                printf("%i", valve_no);
+            } else {
+                fputs("null", stdout);
+            }
+            printf(", \"enabled\": %s, \"description\": ", enabled ? "true" : "false");
+            put_json_string(description);
+            putchar('}');
+            break;
+    }
+
+    output->rows += 1;
+    return (0 == output->limit) || (output->rows < output->limit);
+}
+
+int main(int argc, char **argv) {
+    #pragma GCC diagnostic push
+    #pragma GCC diagnostic ignored "-Wpedantic"
+    GOptionEntry entries[] = {
+        {"version", 'v', G_OPTION_FLAG_NO_ARG, G_OPTION_ARG_CALLBACK, version_option_callback, NULL, NULL},
+        {"path", 'd', G_OPTION_FLAG_NONE, G_OPTION_ARG_FILENAME, &prefix_path, "Path to the prefix directory underwhich the database is stored", "PATH"},
+        {"archive", 'a', G_OPTION_FLAG_NONE, G_OPTION_ARG_FILENAME, &archive_path, "Search an archive file instead of the database", "FILE"},
+        {"rack", 'r', G_OPTION_FLAG_NONE, G_OPTION_ARG_STRING, &rack_set, "Rack numbers and ranges e.g. 1,3,10-12", "SET"},
+        {"chassis", 'c', G_OPTION_FLAG_NONE, G_OPTION_ARG_STRING, &chassis_set, "Chassis numbers and ranges", "SET"},
+        {"valve", 'V', G_OPTION_FLAG_NONE, G_OPTION_ARG_STRING, &valve_set, "Valve numbers and ranges", "SET"},
+        {"type", 't', G_OPTION_FLAG_NONE, G_OPTION_ARG_STRING, &types, "hardware, software or other, separated by commas", "TYPES"},
+        {"template", 0, G_OPTION_FLAG_NONE, G_OPTION_ARG_STRING, &templates, "Message template ids separated by commas", "IDS"},
+        {"enabled", 'e', G_OPTION_FLAG_NONE, G_OPTION_ARG_NONE, &enabled_only, "Leave out disabled errors and errors from disabled nodes", NULL},
+        {"filter", 0, G_OPTION_FLAG_NONE, G_OPTION_ARG_STRING, &expression, "A saved filter expression, combined with the options above", "EXPRESSION"},
+        {"range", 'R', G_OPTION_FLAG_NONE, G_OPTION_ARG_STRING, &range_name, "all (default), hour, shift, today or day", "RANGE"},
+        {"since", 0, G_OPTION_FLAG_NONE, G_OPTION_ARG_STRING, &since_text, "Errors received at or after TIME: YYYY-MM-DD[ HH:MM[:SS]] or @SECONDS", "TIME"},
+        {"until", 0, G_OPTION_FLAG_NONE, G_OPTION_ARG_STRING, &until_text, "Errors received before TIME", "TIME"},
+        {"format", 'f', G_OPTION_FLAG_NONE, G_OPTION_ARG_STRING, &format_name, "text (default), csv or json", "FORMAT"},
+        {"limit", 'n', G_OPTION_FLAG_NONE, G_OPTION_ARG_INT, &limit, "Print at most N errors", "N"},
+        {NULL}
+    };
+    #pragma GCC diagnostic pop
+
+    GOptionContext *context = g_option_context_new("- print errors from the mothership database");
+    assert(NULL != context);
+    g_option_context_add_main_entries(context, entries, NULL);
+    GError *error = NULL;
+    if (!g_option_context_parse(context, &argc, &argv, &error)) {
+        fprintf(stderr, "%s\n", error->message);
+        g_error_free(error);
+        g_option_context_free(context);
+        return EXIT_FAILURE;
+    }
+    g_option_context_free(context);
+
+    if (argc > 1) {
+        fprintf(stderr, "Unexpected argument %s\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+    if (limit < 0) {
+        fprintf(stderr, "--limit can't be negative\n");
+        return EXIT_FAILURE;
+    }
+    if (NULL == prefix_path) {
+        prefix_path = (char *) DEFAULT_PREFIX_PATH;
+    }
+
+    Output output = {FORMAT_TEXT, limit, 0};
+    if ((NULL == format_name) || (0 == g_ascii_strcasecmp("text", format_name))) {
+        output.format = FORMAT_TEXT;
+    } else if (0 == g_ascii_strcasecmp("csv", format_name)) {
+        output.format = FORMAT_CSV;
+    } else if (0 == g_ascii_strcasecmp("json", format_name)) {
+        output.format = FORMAT_JSON;
+    } else {
+        fprintf(stderr, "Unknown format %s\n", format_name);
+        return EXIT_FAILURE;
+    }
+
+    char *built = build_expression();
+    const char *interned = g_intern_string(built); // for searching archives
+    g_free(built);
+    char *error_message = NULL;
+    Filter *filter = filter_parse(interned, &error_message);
+    if (NULL == filter) {
+        fprintf(stderr, "%s\n", error_message);
+        g_free(error_message);
+        return EXIT_FAILURE;
+    }
+
+    // a preset range as the GUI works it out, narrowed by --since and --until
+    Clickable range;
+    memset(&range, 0, sizeof(range));
+    range.type = ALL;
+    range.time_range = TIME_ALL;
+    for (gsize i = 0; (NULL != range_name) && (i < G_N_ELEMENTS(time_range_names)); i++) {
+        if (0 == g_ascii_strcasecmp(time_range_names[i].name, range_name)) {
+            range.time_range = time_range_names[i].time_range;
+            range_name = NULL;
+        }
+    }
+    if (NULL != range_name) {
+        fprintf(stderr, "Unknown range %s\n", range_name);
+        return EXIT_FAILURE;
+    }
+    if (TIME_SHIFT == range.time_range) {
+        gchar *conf_path = g_build_filename(prefix_path, "mothership.conf", NULL);
+        assert(NULL != conf_path);
+        const bool loaded = load_shift_changes(conf_path);
+        g_free(conf_path);
+        if (!loaded) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    time_t since = 0;
+    time_t until = 0;
+    clickable_time_bounds(&range, time(NULL), &since, &until);
+    time_t bound = 0;
+    if (NULL != since_text) {
+        if (!parse_time(since_text, &bound)) {
+            fprintf(stderr, "Can't understand the time %s\n", since_text);
+            return EXIT_FAILURE;
+        }
+        since = MAX(since, bound);
+    }
+    if (NULL != until_text) {
+        if (!parse_time(until_text, &bound)) {
+            fprintf(stderr, "Can't understand the time %s\n", until_text);
+            return EXIT_FAILURE;
+        }
+        until = (0 == until) ? bound : MIN(until, bound);
+    }
+
+    // safe to use while a mothership is writing to it
+    if (NULL == archive_path) {
+        gchar *db_path = g_build_filename(prefix_path, "mothership.db", NULL);
+        assert(NULL != db_path);
+        const bool opened = open_database_read_only(db_path);
+        g_free(db_path);
+        if (!opened) {
+            filter_free(filter);
+            return EXIT_FAILURE;
+        }
+    }
+
+    switch (output.format) {
+        case FORMAT_CSV:
+            puts("time,rack,chassis,valve,enabled,description");
+            break;
+        case FORMAT_JSON:
+            putchar('[');
+            break;
+        default:
+            break;
+    }
+
+    gint64 rows = -1;
+    if (NULL == archive_path) {
+        rows = foreach_error_matching(filter, since, until, write_row, &output);
+        close_database();
+    } else {
+        // read straight from the archive without importing it
+        Clickable search;
+        memset(&search, 0, sizeof(search));
+        search.type = FILTER;
+        search.text = interned;
+        search.time_range = TIME_BETWEEN;
+        search.since = since;
+        search.until = until;
+        rows = archive_search_foreach(archive_path, &search, NULL, write_row, &output);
+    }
+
+    if (FORMAT_JSON == output.format) {
+        puts((0 == output.rows) ? "]" : "\n]");
+    }
+
+    filter_free(filter);
+
+    if (rows < 0) {
+        fprintf(stderr, "Unable to read the errors\n");
+        return EXIT_FAILURE;
+    }
+    if ((0 != fflush(stdout)) || ferror(stdout)) {
+        perror("Unable to write the errors");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
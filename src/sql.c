@@ -8,6 +8,15 @@
 // includes
 #include "config.h"
 #include "sql.h"
+#include "hot_tier.h"
+#include "filter.h"
+#include "node_activity.h"
+#include "heavy_hitters.h"
+#include "correlator.h"
+#include "template.h"
+#include "topology.h"
+#include "liveness.h"
+#include "unacked.h"
 #include <stdio.h>
 #include <assert.h>
 #include <sqlite3.h>
@@ -17,9 +26,86 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <stdlib.h>
+#include <unistd.h>
+
+// pages copied by each step of an online backup and how long to sleep between steps
+#define BACKUP_PAGES_PER_STEP 64
+#define BACKUP_STEP_DELAY_MS 10
+
+// how long a connection waits for another one to finish with the database before giving up. The mothership writing
+// to it and read-only windows or mothership-query reading it wait for each other
+#define BUSY_TIMEOUT_MS 5000
+
+// rows examined per index by ANALYZE (through PRAGMA optimize) so that it never takes long
+#define ANALYSIS_LIMIT 1000
+// PRAGMA analysis_limit is new in 3.32.0. Older libraries ignore it (and PRAGMA optimize before 3.18.0) without error
+#define SQLITE_ANALYSIS_LIMIT_VERSION 3032000
+
+// error_rollup buckets (seconds). Ingest counts errors per minute
+#define ROLLUP_MINUTE 60
+
+// errors replayed from the journal older than this (seconds) are too stale for the overview, top offenders and correlator
+#define REPLAY_LIVE_SECONDS (NODE_ACTIVITY_MINUTES * 60)
 
 static sqlite3 *db = NULL;
 static bool show_disabled = false;
+static bool show_acked = false;
+static bool search_available = false; // is there a full text index?
+static bool read_only = false; // opened with init_database_read_only
+static gint64 data_version = -1; // as of the last reload_database_state
+static gint rack_events_changes = 0; // only access atomically
+static gint errors_enabled_changes = 0; // only access atomically
+static GHashTable *known_templates = NULL; // ids of templates already in the templates table. Protected by batch_lock
+static bool batch_failed = false; // the open batch is to be rolled back. Protected by batch_lock
+
+typedef struct {
+    const char *name;
+    StorageProfile profile;
+} StoragePreset;
+
+static const StoragePreset storage_presets[] = {
+    // sqlite defaults: every commit is synced to disk
+    {"safe", {2000, 0, false, "FULL", "DELETE"}},
+    // a power cut can lose the last few commits but never corrupts the database
+    {"balanced", {64 * 1024, 256 * 1024 * 1024, true, "NORMAL", "WAL"}},
+    // nothing is synced: an OS crash or power cut can corrupt the database
+    {"fast", {256 * 1024, 1024 * 1024 * 1024, true, "OFF", "WAL"}}
+};
+
+// compact_rollup merges buckets older than age into buckets of the next resolution
+static const struct {
+    gint64 resolution;
+    gint64 age;
+} rollup_levels[] = {
+    {ROLLUP_MINUTE, 2 * 24 * 60 * 60},
+    {60 * 60, 60 * 24 * 60 * 60},
+    {24 * 60 * 60, 0} // kept
+};
+
+// db is shared between threads so only one thread may have a transaction open at a time
+static GRecMutex batch_lock;
+static unsigned int batch_depth = 0; // protected by batch_lock
+
+// columns read by collect_search_results
+#define SEARCH_FIELDS "errors.recv_time, errors.description, nodes.rack_no, nodes.chassis_no, errors.valve_no, nodes.enabled, errors.enabled, errors.id, errors.acked"
+
+// FILTER queries are prepared the first time the filter is used and kept until the database is closed
+typedef struct {
+    sqlite3_stmt *search;
+    sqlite3_stmt *count;
+} FilterStatements;
+
+static GHashTable *filter_statements = NULL; // const Filter * -> FilterStatements *. Protected by batch_lock
+static GHashTable *node_set_ids = NULL; // interned node set text -> set_id in temp.node_set_members. Protected by batch_lock
+static gint next_node_set_id = 1; // protected by batch_lock
+
+// parameters before the filter's own: show disabled, since, until, max id, show acknowledged
+#define FILTER_FIRST_PARAM 6
+// the first parameter of foreach_error_matching's query used by filter_sql
+#define MATCHING_FIRST_PARAM 7
+// rows read by foreach_error_matching per query
+#define MATCHING_CHUNK_ROWS 1000
+
 
 // functions
 void set_show_disabled(bool new_val) {
@@ -30,6 +116,14 @@ bool get_show_disabled(void) {
     return show_disabled;
 }
 
+void set_show_acked(bool new_val) {
+    show_acked = new_val;
+}
+
+bool get_show_acked(void) {
+    return show_acked;
+}
+
 // checks that str is a valid mac address
 bool check_mac_address(const char* str) {
     if (NULL == str) {
@@ -102,237 +196,2071 @@ static bool create_tables(void) {
     return true;
 }
 
-void init_database(const char *path) {
-    bool new_db = true;
-    if ((NULL != path) && (0 != strncmp("", path, 1))) {
-        // check to see if the database already exists
-        if (0 == access(path, F_OK)) {
-            // file exists
-            new_db = false;
+// add anything introduced since the database was created. Everything here must be safe to run on every start up
+static bool upgrade_tables(void) {
+    const char *table_upgrade_sql = \
+    "CREATE TABLE IF NOT EXISTS journal_state(\
+	    id INTEGER PRIMARY KEY CHECK (id = 0),\
+	    applied_seq INTEGER NOT NULL\
+    );\
+    CREATE TABLE IF NOT EXISTS journal_stored(\
+	    seq INTEGER PRIMARY KEY\
+    );\
+    CREATE INDEX IF NOT EXISTS errors_by_time ON errors(recv_time);\
+    CREATE INDEX IF NOT EXISTS errors_by_node_time ON errors(node_id, recv_time);\
+    CREATE TABLE IF NOT EXISTS rack_events(\
+	    id INTEGER PRIMARY KEY,\
+	    rack_no INTEGER NOT NULL,\
+	    start_time INTEGER NOT NULL,\
+	    end_time INTEGER NOT NULL,\
+	    chassis_count INTEGER NOT NULL,\
+	    valve_count INTEGER NOT NULL,\
+	    error_count INTEGER NOT NULL\
+    );\
+    CREATE TABLE IF NOT EXISTS rack_event_errors(\
+	    error_id INTEGER PRIMARY KEY,\
+	    event_id INTEGER NOT NULL\
+    );\
+    CREATE INDEX IF NOT EXISTS rack_event_errors_by_event ON rack_event_errors(event_id);\
+    CREATE TRIGGER IF NOT EXISTS rack_event_errors_delete AFTER DELETE ON errors BEGIN\
+        DELETE FROM rack_event_errors WHERE error_id = old.id;\
+    END;\
+    CREATE TABLE IF NOT EXISTS node_connections(\
+	    node_id INTEGER NOT NULL,\
+	    change_time INTEGER NOT NULL,\
+	    up INTEGER NOT NULL\
+    );\
+    CREATE INDEX IF NOT EXISTS node_connections_by_node_time ON node_connections(node_id, change_time);\
+    CREATE TABLE IF NOT EXISTS node_uptime(\
+	    node_id INTEGER PRIMARY KEY,\
+	    first_change INTEGER NOT NULL,\
+	    last_change INTEGER NOT NULL,\
+	    up INTEGER NOT NULL,\
+	    up_seconds INTEGER NOT NULL,\
+	    down_seconds INTEGER NOT NULL,\
+	    flaps INTEGER NOT NULL\
+    );";
 
-            // check that we have read and write permissions on the file
-            if (0 != access(path, W_OK | R_OK)) {
-                fprintf(stderr, "I don't have permission to access database file %s\n", path);
-                exit(EXIT_FAILURE);
-            } else {
-                printf("Using existing database at %s\n", path);
-                // open database with sqlite
-                assert(SQLITE_OK == sqlite3_open(path, &db));
-            }
-        } else {
-            printf("Creating a new database at %s\n", path);
-            // open database with sqlite
-            if (SQLITE_OK != sqlite3_open(path, &db)) {
-                fprintf(stderr, "I did not have permissions to create database file %s\n", path);
-                exit(EXIT_FAILURE);
-            }
-        }
-    } else {
-        puts("Creating memory resident database");
-        // open database with sqlite
-        assert(SQLITE_OK == sqlite3_open(NULL, &db));
+    char *errstr = NULL;
+    if (SQLITE_OK != sqlite3_exec(db, table_upgrade_sql, NULL, NULL, &errstr)) {
+        puts(errstr);
+        sqlite3_free(errstr);
+        return false;
     }
 
-    if (new_db) {
-        create_tables();
-    }
+    return true;
 }
 
-void close_database(void) {
-    assert(SQLITE_OK == sqlite3_close(db));
-}
+// fill the hot tier with the newest errors in the database
+static bool load_hot_tier(const guint capacity) {
+    hot_tier_init(capacity);
+    if (0 == capacity) {
+        return true;
+    }
 
-bool add_node(const unsigned int rack_no, const unsigned int chassis_no, const bool enabled) {
-    gint enabled_int;
-    if (enabled) {
-        enabled_int = 1;
-    } else {
-        enabled_int = 0;
+    sqlite3_stmt *statement = NULL;
+    if (SQLITE_OK != sqlite3_prepare_v2(db, "SELECT rack_no, chassis_no, enabled FROM nodes;", -1, &statement, NULL)) {
+        puts("Error constructing load_hot_tier nodes query");
+        return false;
+    }
+
+    int status = SQLITE_ERROR;
+    while (SQLITE_ROW == (status = sqlite3_step(statement))) {
+        #pragma GCC diagnostic push
+        #pragma GCC diagnostic ignored "-Wsign-conversion"
+        hot_tier_set_node_enabled(sqlite3_column_int(statement, 0), sqlite3_column_int(statement, 1),
+            0 != sqlite3_column_int(statement, 2));
+        #pragma GCC diagnostic pop
+    }
+    assert(SQLITE_OK == sqlite3_finalize(statement));
+    if (SQLITE_DONE != status) {
+        puts("Bad sqlite3_step load_hot_tier");
+        return false;
     }
 
+    // the newest errors, oldest first
     GString *query = g_string_new(NULL);
     assert(NULL != query);
-
     g_string_printf(query,
-        "INSERT into nodes(rack_no, chassis_no, enabled) VALUES(%i, %i, %i);", 
-        rack_no, chassis_no, enabled_int);
+        "SELECT * FROM \
+            (SELECT errors.id, errors.recv_time, nodes.rack_no, nodes.chassis_no, errors.valve_no, errors.enabled, errors.acked, \
+                    errors.description \
+                FROM errors \
+                INNER JOIN nodes \
+                ON errors.node_id = nodes.id \
+                ORDER BY errors.id DESC LIMIT %u) \
+            ORDER BY id;", capacity);
 
-    bool ret = true;
-    char *errstr = NULL;
-    if (SQLITE_OK != sqlite3_exec(db, query->str, NULL, NULL, &errstr)) {
-        puts(errstr);
-        ret = false;
+    if (SQLITE_OK != sqlite3_prepare_v2(db, query->str, -1, &statement, NULL)) {
+        g_string_free(query, TRUE);
+        puts("Error constructing load_hot_tier errors query");
+        return false;
     }
-
     g_string_free(query, TRUE);
 
-    return ret;
-}
+    guint loaded = 0;
+    gint64 min_id = 0;
+    while (SQLITE_ROW == (status = sqlite3_step(statement))) {
+        const gint64 id = sqlite3_column_int64(statement, 0);
+        if (0 == loaded) {
+            min_id = id;
+        }
+        loaded += 1;
 
-bool remove_node(const unsigned int rack_no, const unsigned int chassis_no) {
-    // begin transaction
-    GString *query = g_string_new("begin transaction;");
-    assert(NULL != query);
+        #pragma GCC diagnostic push
+        #pragma GCC diagnostic ignored "-Wsign-conversion"
+        #pragma GCC diagnostic ignored "-Wpointer-sign"
+        hot_tier_add(id, sqlite3_column_int64(statement, 1), sqlite3_column_int(statement, 2),
+            sqlite3_column_int(statement, 3), sqlite3_column_int(statement, 4), 0 != sqlite3_column_int(statement, 5),
+            0 != sqlite3_column_int(statement, 6), sqlite3_column_text(statement, 7));
+        #pragma GCC diagnostic pop
+    }
+    assert(SQLITE_OK == sqlite3_finalize(statement));
+    if (SQLITE_DONE != status) {
+        puts("Bad sqlite3_step load_hot_tier");
+        hot_tier_init(0); // we can't trust it
+        return false;
+    }
 
-    // delete all of the errors associated with this node
-    g_string_append_printf(query,
-        "DELETE FROM errors WHERE node_id IN \
-            (SELECT DISTINCT id FROM nodes \
-                WHERE rack_no = %i AND chassis_no = %i);", rack_no, chassis_no);
-    
-    // delete the node
-    g_string_append_printf(query,
-        "DELETE FROM nodes WHERE rack_no = %i AND chassis_no = %i;", rack_no, chassis_no);
+    // if the hot tier is full there may be older errors which are only in the database
+    hot_tier_set_floor((loaded == capacity) ? min_id - 1 : 0);
+    return true;
+}
+
+// full text index of error descriptions. Kept up to date by triggers so nothing else has to know about it.
+// Needs sqlite built with FTS5 so failure is not fatal: searching is just unavailable
+static bool create_search_index(void) {
+    sqlite3_stmt *statement = NULL;
+    assert(SQLITE_OK == sqlite3_prepare_v2(db, "SELECT COUNT(*) FROM sqlite_master WHERE name = 'errors_fts';", -1, &statement, NULL));
+    assert(SQLITE_ROW == sqlite3_step(statement));
+    const bool exists = (0 != sqlite3_column_int(statement, 0));
+    assert(SQLITE_OK == sqlite3_finalize(statement));
 
-    // commit transaction to the database
-    g_string_append(query, "commit;");
+    const char *index_sql = \
+    "CREATE VIRTUAL TABLE IF NOT EXISTS errors_fts USING fts5(description, content='errors', content_rowid='id');\
+    CREATE TRIGGER IF NOT EXISTS errors_fts_insert AFTER INSERT ON errors BEGIN\
+        INSERT INTO errors_fts(rowid, description) VALUES (new.id, new.description);\
+    END;\
+    CREATE TRIGGER IF NOT EXISTS errors_fts_delete AFTER DELETE ON errors BEGIN\
+        INSERT INTO errors_fts(errors_fts, rowid, description) VALUES ('delete', old.id, old.description);\
+    END;\
+    CREATE TRIGGER IF NOT EXISTS errors_fts_update AFTER UPDATE OF description ON errors BEGIN\
+        INSERT INTO errors_fts(errors_fts, rowid, description) VALUES ('delete', old.id, old.description);\
+        INSERT INTO errors_fts(rowid, description) VALUES (new.id, new.description);\
+    END;";
 
-    bool ret = true;
     char *errstr = NULL;
-    if (SQLITE_OK != sqlite3_exec(db, query->str, NULL, NULL, &errstr)) {
-        puts(errstr);
-        ret = false;
+    if (SQLITE_OK != sqlite3_exec(db, index_sql, NULL, NULL, &errstr)) {
+        printf("Full text search unavailable: %s\n", errstr);
+        sqlite3_free(errstr);
+        return false;
     }
 
-    g_string_free(query, TRUE);
+    // index errors from before the index existed
+    if (!exists) {
+        puts("Building the full text search index");
+        if (SQLITE_OK != sqlite3_exec(db, "INSERT INTO errors_fts(errors_fts) VALUES ('rebuild');", NULL, NULL, &errstr)) {
+            puts(errstr);
+            sqlite3_free(errstr);
+            return false;
+        }
+    }
 
-    return ret;
+    return true;
 }
 
-bool node_exists(const unsigned int rack_no, const unsigned int chassis_no) {
-    GString *query = g_string_new(NULL);
-    assert(NULL != query);
+// template_id(description) and template_text(description) in SQL (see template.h)
+static void sql_template_id(sqlite3_context *context, __attribute__((unused)) int argc, sqlite3_value **argv) {
+    const unsigned char *description = sqlite3_value_text(argv[0]);
+    if (NULL == description) {
+        sqlite3_result_null(context);
+        return;
+    }
+    #pragma GCC diagnostic push
+    #pragma GCC diagnostic ignored "-Wpointer-sign"
+    sqlite3_result_int64(context, template_id(description));
+    #pragma GCC diagnostic pop
+}
 
-    g_string_sprintf(query, "SELECT COUNT(*) FROM nodes WHERE rack_no = %i AND chassis_no = %i;", rack_no, chassis_no);
+static void sql_template_text(sqlite3_context *context, __attribute__((unused)) int argc, sqlite3_value **argv) {
+    const unsigned char *description = sqlite3_value_text(argv[0]);
+    if (NULL == description) {
+        sqlite3_result_null(context);
+        return;
+    }
+    #pragma GCC diagnostic push
+    #pragma GCC diagnostic ignored "-Wpointer-sign"
+    sqlite3_result_text(context, template_text(description), -1, g_free);
+    #pragma GCC diagnostic pop
+}
 
-    sqlite3_stmt *statement = NULL;
-    assert(SQLITE_OK == sqlite3_prepare_v2(db, query->str, -1, &statement, NULL));
-    g_string_free(query, TRUE);
+// give every error a template (see template.h)
+static bool create_templates(void) {
+    assert(SQLITE_OK == sqlite3_create_function(db, "template_id", 1, SQLITE_UTF8 | SQLITE_DETERMINISTIC, NULL,
+        sql_template_id, NULL, NULL));
+    assert(SQLITE_OK == sqlite3_create_function(db, "template_text", 1, SQLITE_UTF8 | SQLITE_DETERMINISTIC, NULL,
+        sql_template_text, NULL, NULL));
 
+    sqlite3_stmt *statement = NULL;
+    assert(SQLITE_OK == sqlite3_prepare_v2(db, "SELECT COUNT(*) FROM sqlite_master WHERE name = 'templates';", -1, &statement, NULL));
     assert(SQLITE_ROW == sqlite3_step(statement));
+    const bool exists = (0 != sqlite3_column_int(statement, 0));
+    assert(SQLITE_OK == sqlite3_finalize(statement));
 
-    const int count = sqlite3_column_int(statement, 0);
+    char *errstr = NULL;
+    if (!exists) {
+        // errors from before templates existed
+        puts("Working out the template of every error");
+        if (SQLITE_OK != sqlite3_exec(db, "BEGIN TRANSACTION;\
+                CREATE TABLE templates(\
+	                id INTEGER PRIMARY KEY,\
+	                text TEXT NOT NULL\
+                );\
+                ALTER TABLE errors ADD COLUMN template_id INTEGER;\
+                UPDATE errors SET template_id = template_id(description);\
+                INSERT OR IGNORE INTO templates(id, text) \
+                    SELECT template_id, template_text(description) FROM errors GROUP BY template_id;\
+                COMMIT;", NULL, NULL, &errstr)) {
+            puts(errstr);
+            sqlite3_free(errstr);
+            sqlite3_exec(db, "ROLLBACK;", NULL, NULL, NULL);
+            return false;
+        }
+    }
 
-    assert(SQLITE_OK == sqlite3_finalize(statement));
-    return (count != 0);
+    if (SQLITE_OK != sqlite3_exec(db, "CREATE INDEX IF NOT EXISTS errors_by_template ON errors(template_id, recv_time);",
+            NULL, NULL, &errstr)) {
+        puts(errstr);
+        sqlite3_free(errstr);
+        return false;
+    }
+
+    known_templates = g_hash_table_new_full(g_int64_hash, g_int64_equal, g_free, NULL);
+    assert(NULL != known_templates);
+
+    return true;
 }
 
-bool remove_all_errors(void) {
-    const char *query = "DELETE FROM errors;";
+// acknowledgement: a flag on each error so that "unacknowledged only" can use a partial index, and who acknowledged
+// it and when in a separate table so that unacknowledged errors cost nothing more
+static bool create_acks(void) {
+    sqlite3_stmt *statement = NULL;
+    assert(SQLITE_OK == sqlite3_prepare_v2(db, "SELECT COUNT(*) FROM sqlite_master WHERE name = 'error_acks';", -1, &statement, NULL));
+    assert(SQLITE_ROW == sqlite3_step(statement));
+    const bool exists = (0 != sqlite3_column_int(statement, 0));
+    assert(SQLITE_OK == sqlite3_finalize(statement));
 
-    bool ret = true;
-    if (SQLITE_OK != sqlite3_exec(db, query, NULL, NULL, NULL)) {
-        ret = false;
+    char *errstr = NULL;
+    if (!exists) {
+        if (SQLITE_OK != sqlite3_exec(db, "BEGIN TRANSACTION;\
+                CREATE TABLE ack_users(\
+	                id INTEGER PRIMARY KEY,\
+	                name TEXT NOT NULL UNIQUE\
+                );\
+                CREATE TABLE error_acks(\
+	                error_id INTEGER PRIMARY KEY,\
+	                ack_time INTEGER NOT NULL,\
+	                user_id INTEGER NOT NULL\
+                );\
+                ALTER TABLE errors ADD COLUMN acked INTEGER NOT NULL DEFAULT 0;\
+                COMMIT;", NULL, NULL, &errstr)) {
+            puts(errstr);
+            sqlite3_free(errstr);
+            sqlite3_exec(db, "ROLLBACK;", NULL, NULL, NULL);
+            return false;
+        }
     }
 
-    return ret;
+    // partial indices only hold unacknowledged errors
+    if (SQLITE_OK != sqlite3_exec(db, "CREATE INDEX IF NOT EXISTS errors_unacked_by_time ON errors(recv_time) WHERE acked = 0;\
+            CREATE INDEX IF NOT EXISTS errors_unacked_by_node ON errors(node_id, valve_no) WHERE acked = 0;\
+            CREATE TRIGGER IF NOT EXISTS error_acks_delete AFTER DELETE ON errors BEGIN\
+                DELETE FROM error_acks WHERE error_id = old.id;\
+            END;", NULL, NULL, &errstr)) {
+        puts(errstr);
+        sqlite3_free(errstr);
+        return false;
+    }
+
+    return true;
 }
 
-bool add_error_decoded(const uint32_t rack_no, const uint32_t chassis_no, const int valve_no, const time_t recv_time, const char *msg) {
+// add sign times the number of unacknowledged errors matching condition (over errors and nodes) to unacked.h
+static bool count_unacked(const char *condition, const gint64 sign) {
     GString *query = g_string_new(NULL);
     assert(NULL != query);
+    g_string_printf(query, "SELECT nodes.rack_no, nodes.chassis_no, errors.valve_no, COUNT(*) \
+                    FROM errors \
+                    INNER JOIN nodes \
+                    ON errors.node_id = nodes.id \
+                    WHERE errors.acked = 0 AND %s \
+                    GROUP BY errors.node_id, errors.valve_no;", condition);
 
-    GString *msg_str = fix_string(msg);
-
-    g_string_printf(query,
-        "INSERT INTO errors(node_id, recv_time, description, enabled, valve_no) \
-            SELECT nodes.id, %li, \"%s\", 1, %i \
-                FROM nodes \
-                WHERE nodes.rack_no = %i AND nodes.chassis_no = %i;", \
-        recv_time, msg_str->str, valve_no, rack_no, chassis_no);
+    sqlite3_stmt *statement = NULL;
+    if (SQLITE_OK != sqlite3_prepare_v2(db, query->str, -1, &statement, NULL)) {
+        puts("Error constructing count_unacked query");
+        g_string_free(query, TRUE);
+        return false;
+    }
+    g_string_free(query, TRUE);
 
-    bool ret = true;
-    char *errmsg = NULL;
-    if (SQLITE_OK != sqlite3_exec(db, query->str, NULL, NULL, &errmsg)) {
-        puts(errmsg);
-        ret = false;
+    int status = SQLITE_ERROR;
+    while (SQLITE_ROW == (status = sqlite3_step(statement))) {
+        #pragma GCC diagnostic push
+        #pragma GCC diagnostic ignored "-Wsign-conversion"
+        unacked_add(sqlite3_column_int(statement, 0), sqlite3_column_int(statement, 1), sqlite3_column_int(statement, 2),
+            sign * sqlite3_column_int64(statement, 3));
+        #pragma GCC diagnostic pop
     }
+    assert(SQLITE_OK == sqlite3_finalize(statement));
 
-    g_string_free(query, TRUE);
-    g_string_free(msg_str, TRUE);
+    if (SQLITE_DONE != status) {
+        puts("Bad sqlite3_step count_unacked");
+        return false;
+    }
 
-    return ret;
+    return true;
 }
 
-NodeIdentifier *parse_ip_address(const struct in_addr *address) {
-    assert(NULL != address);
+// counts of errors per node and valve over time so that rates never need a scan of errors. insert_error keeps them up
+// to date. Rows only go away when their node does or when everything is deleted: archiving errors keeps them
+static bool create_rollup(void) {
+    sqlite3_stmt *statement = NULL;
+    assert(SQLITE_OK == sqlite3_prepare_v2(db, "SELECT COUNT(*) FROM sqlite_master WHERE name = 'error_rollup';", -1, &statement, NULL));
+    assert(SQLITE_ROW == sqlite3_step(statement));
+    const bool exists = (0 != sqlite3_column_int(statement, 0));
+    assert(SQLITE_OK == sqlite3_finalize(statement));
 
-    NodeIdentifier *ret = malloc(sizeof(NodeIdentifier));
-    assert(NULL != ret);
+    const char *rollup_sql = \
+    "CREATE TABLE IF NOT EXISTS error_rollup(\
+	    node_id INTEGER NOT NULL,\
+	    bucket INTEGER NOT NULL,\
+	    valve_no INTEGER NOT NULL,\
+	    resolution INTEGER NOT NULL,\
+	    count INTEGER NOT NULL,\
+	    PRIMARY KEY(node_id, bucket, valve_no, resolution)\
+    ) WITHOUT ROWID;\
+    CREATE INDEX IF NOT EXISTS error_rollup_by_time ON error_rollup(bucket);\
+    DROP TRIGGER IF EXISTS error_rollup_insert;"; // insert_error counts errors itself now
 
-    // "Network" is big endian. We don't know what the host is
-    uint32_t addr = htonl(address->s_addr);
-    const uint32_t rack_num_n = (addr & 0x0000FF00) << 16;
-    const uint32_t chassis_num_n = (addr & 0x000000FF) << 24;
+    char *errstr = NULL;
+    if (SQLITE_OK != sqlite3_exec(db, rollup_sql, NULL, NULL, &errstr)) {
+        puts(errstr);
+        sqlite3_free(errstr);
+        return false;
+    }
 
-    // don't assume host endianness
-    ret->rack_no = ntohl(rack_num_n);
-    ret->chassis_no = ntohl(chassis_num_n);
+    // count errors from before the rollup existed
+    if (!exists) {
+        puts("Building the error rate rollup");
+        GString *query = g_string_new(NULL);
+        assert(NULL != query);
+        g_string_printf(query, "INSERT INTO error_rollup(node_id, bucket, valve_no, resolution, count) \
+                SELECT node_id, recv_time - recv_time %% %i, valve_no, %i, COUNT(*) FROM errors \
+                GROUP BY node_id, recv_time - recv_time %% %i, valve_no;", ROLLUP_MINUTE, ROLLUP_MINUTE, ROLLUP_MINUTE);
+        const int status = sqlite3_exec(db, query->str, NULL, NULL, &errstr);
+        g_string_free(query, TRUE);
+        if (SQLITE_OK != status) {
+            puts(errstr);
+            sqlite3_free(errstr);
+            return false;
+        }
+        return compact_rollup(time(NULL));
+    }
 
-    return ret;
+    return true;
 }
 
-bool add_error(const BufferItem *error) {
-    if (NULL == error) {
-        return false;
+GList *get_rack_events(const unsigned int limit) {
+    GString *query = g_string_new(NULL);
+    assert(NULL != query);
+    g_string_printf(query,
+        "SELECT id, rack_no, start_time, end_time, chassis_count, valve_count, error_count \
+            FROM rack_events ORDER BY id DESC LIMIT %u;", limit);
+
+    sqlite3_stmt *statement = NULL;
+    if (SQLITE_OK != sqlite3_prepare_v2(db, query->str, -1, &statement, NULL)) {
+        puts("Error constructing get_rack_events query");
+        g_string_free(query, TRUE);
+        return NULL;
     }
+    g_string_free(query, TRUE);
 
-    NodeIdentifier *node = parse_ip_address(&error->address);
-    
-    bool ret = false;
+    GList *events = NULL;
+    int status = SQLITE_ERROR;
+    while (SQLITE_ROW == (status = sqlite3_step(statement))) {
+        RackEvent *event = g_malloc(sizeof(RackEvent));
+        assert(NULL != event);
+        #pragma GCC diagnostic push
+        #pragma GCC diagnostic ignored "-Wsign-conversion"
+        event->id = sqlite3_column_int64(statement, 0);
+        event->rack_no = sqlite3_column_int(statement, 1);
+        event->start_time = sqlite3_column_int64(statement, 2);
+        event->end_time = sqlite3_column_int64(statement, 3);
+        event->chassis_count = sqlite3_column_int(statement, 4);
+        event->valve_count = sqlite3_column_int(statement, 5);
+        event->error_count = sqlite3_column_int(statement, 6);
+        #pragma GCC diagnostic pop
+        events = g_list_prepend(events, event);
+    }
+    sqlite3_finalize(statement);
+    if (SQLITE_DONE != status) {
+        puts("Bad sqlite3_step get_rack_events");
+        g_list_free_full(events, g_free);
+        return NULL;
+    }
 
-    GString *error_msg = g_string_new(NULL);
-    assert(NULL != error_msg);
+    return g_list_reverse(events);
+}
 
-    switch (error->msg.type) {
-        case HARD_ERROR_VALVE:
-            g_string_append_printf(error_msg, "Hardware Error: %s", 
-                error->msg.data.hardware_valve.message->str);
+GList *count_templates(const time_t since, const unsigned int limit) {
+    GString *query = g_string_new(NULL);
+    assert(NULL != query);
+    g_string_printf(query,
+        "SELECT counts.template_id, templates.text, counts.count \
+            FROM (SELECT template_id, COUNT(*) AS count FROM errors WHERE recv_time >= %li GROUP BY template_id) AS counts \
+            INNER JOIN templates \
+            ON templates.id = counts.template_id \
+            ORDER BY counts.count DESC LIMIT %u;", since, limit);
 
-            ret = add_error_decoded(node->rack_no, node->chassis_no, 
-                error->msg.data.hardware_valve.valve_no,
-                error->recv_time, error_msg->str);
-            break;
+    sqlite3_stmt *statement = NULL;
+    if (SQLITE_OK != sqlite3_prepare_v2(db, query->str, -1, &statement, NULL)) {
+        puts("Error constructing count_templates query");
+        g_string_free(query, TRUE);
+        return NULL;
+    }
+    g_string_free(query, TRUE);
+
+    GList *counts = NULL;
+    int status = SQLITE_ERROR;
+    while (SQLITE_ROW == (status = sqlite3_step(statement))) {
+        TemplateCount *count = g_malloc(sizeof(TemplateCount));
+        assert(NULL != count);
+        count->id = sqlite3_column_int64(statement, 0);
+        count->text = g_strdup((const char *) sqlite3_column_text(statement, 1));
+        #pragma GCC diagnostic push
+        #pragma GCC diagnostic ignored "-Wsign-conversion"
+        count->count = sqlite3_column_int(statement, 2);
+        #pragma GCC diagnostic pop
+        counts = g_list_prepend(counts, count);
+    }
+    sqlite3_finalize(statement);
+    if (SQLITE_DONE != status) {
+        puts("Bad sqlite3_step count_templates");
+        g_list_free_full(counts, free_template_count);
+        return NULL;
+    }
+
+    return g_list_reverse(counts);
+}
+
+void free_template_count(gpointer count) {
+    TemplateCount *template_count = count;
+    g_free(template_count->text);
+    g_free(template_count);
+}
+
+guint rack_events_version(void) {
+    return (guint) g_atomic_int_get(&rack_events_changes);
+}
+
+guint errors_enabled_version(void) {
+    return (guint) g_atomic_int_get(&errors_enabled_changes);
+}
+
+bool compact_rollup(const time_t now) {
+    begin_batch();
+
+    bool ret = true;
+    for (size_t i = 0; ret && (i + 1 < G_N_ELEMENTS(rollup_levels)); i++) {
+        const gint64 from = rollup_levels[i].resolution;
+        const gint64 to = rollup_levels[i + 1].resolution;
+        gint64 cutoff = now - rollup_levels[i].age;
+        cutoff -= cutoff % to; // only whole buckets of the new resolution
+
+        // add to any bucket of the new resolution which is already there
+        GString *query = g_string_new(NULL);
+        assert(NULL != query);
+        g_string_printf(query,
+            "INSERT OR REPLACE INTO error_rollup(node_id, bucket, valve_no, resolution, count) \
+                SELECT merged.node_id, merged.merged_bucket, merged.valve_no, %li, merged.total + IFNULL(existing.count, 0) \
+                FROM (SELECT node_id, bucket - bucket %% %li AS merged_bucket, valve_no, SUM(count) AS total \
+                    FROM error_rollup WHERE resolution = %li AND bucket < %li \
+                    GROUP BY node_id, merged_bucket, valve_no) AS merged \
+                LEFT JOIN error_rollup AS existing \
+                ON existing.node_id = merged.node_id AND existing.bucket = merged.merged_bucket \
+                    AND existing.valve_no = merged.valve_no AND existing.resolution = %li; \
+            DELETE FROM error_rollup WHERE resolution = %li AND bucket < %li;",
+            to, to, from, cutoff, to, from, cutoff);
+
+        char *errstr = NULL;
+        if (SQLITE_OK != sqlite3_exec(db, query->str, NULL, NULL, &errstr)) {
+            puts(errstr);
+            sqlite3_free(errstr);
+            ret = false;
+        }
+        g_string_free(query, TRUE);
+    }
+
+    // the merged buckets can't be committed without deleting the ones they were made from
+    if (!ret) {
+        fail_batch();
+    }
+    ret &= end_batch();
+    return ret;
+}
+
+// every node (see topology.h) and the errors from the last few minutes, from the rollup
+static bool load_recent_activity(void) {
+    const time_t now = time(NULL);
+    topology_clear();
+    liveness_clear();
+    node_activity_clear();
+    heavy_hitters_clear();
+
+    sqlite3_stmt *statement = NULL;
+    if (SQLITE_OK != sqlite3_prepare_v2(db, "SELECT rack_no, chassis_no, enabled FROM nodes;", -1, &statement, NULL)) {
+        puts("Error constructing load_recent_activity nodes query");
+        return false;
+    }
+
+    int status = SQLITE_ERROR;
+    while (SQLITE_ROW == (status = sqlite3_step(statement))) {
+        #pragma GCC diagnostic push
+        #pragma GCC diagnostic ignored "-Wsign-conversion"
+        node_activity_set_node(sqlite3_column_int(statement, 0), sqlite3_column_int(statement, 1),
+            0 != sqlite3_column_int(statement, 2));
+        topology_set_node(sqlite3_column_int(statement, 0), sqlite3_column_int(statement, 1),
+            0 != sqlite3_column_int(statement, 2));
+        liveness_set_node(sqlite3_column_int(statement, 0), sqlite3_column_int(statement, 1), now);
+        #pragma GCC diagnostic pop
+    }
+    sqlite3_finalize(statement);
+    if (SQLITE_DONE != status) {
+        puts("Bad sqlite3_step load_recent_activity");
+        return false;
+    }
+
+    GString *query = g_string_new(NULL);
+    assert(NULL != query);
+    g_string_printf(query,
+        "SELECT nodes.rack_no, nodes.chassis_no, error_rollup.bucket, error_rollup.count, error_rollup.valve_no \
+            FROM error_rollup \
+            INNER JOIN nodes \
+            ON error_rollup.node_id = nodes.id \
+            WHERE error_rollup.bucket >= %li AND error_rollup.resolution = %i;",
+        now - MAX(NODE_ACTIVITY_MINUTES, HEAVY_HITTERS_MINUTES) * 60, ROLLUP_MINUTE);
+
+    if (SQLITE_OK != sqlite3_prepare_v2(db, query->str, -1, &statement, NULL)) {
+        puts("Error constructing load_recent_activity errors query");
+        g_string_free(query, TRUE);
+        return false;
+    }
+    g_string_free(query, TRUE);
+
+    while (SQLITE_ROW == (status = sqlite3_step(statement))) {
+        #pragma GCC diagnostic push
+        #pragma GCC diagnostic ignored "-Wsign-conversion"
+        #pragma GCC diagnostic ignored "-Wconversion"
+        node_activity_add(sqlite3_column_int(statement, 0), sqlite3_column_int(statement, 1),
+            sqlite3_column_int64(statement, 3), sqlite3_column_int64(statement, 2));
+        heavy_hitters_add(sqlite3_column_int(statement, 0), sqlite3_column_int(statement, 1), sqlite3_column_int(statement, 4),
+            sqlite3_column_int64(statement, 3), sqlite3_column_int64(statement, 2));
+        #pragma GCC diagnostic pop
+    }
+    sqlite3_finalize(statement);
+    if (SQLITE_DONE != status) {
+        puts("Bad sqlite3_step load_recent_activity");
+        return false;
+    }
+
+    return true;
+}
+
+bool search_index_available(void) {
+    return search_available;
+}
+
+// temporary tables belong to this connection and go away when it is closed
+static bool create_temp_tables(void) {
+    const char *temp_create_sql = \
+    "CREATE TEMP TABLE IF NOT EXISTS node_set_members(\
+	    set_id INTEGER NOT NULL,\
+	    rack_no INTEGER NOT NULL,\
+	    chassis_no INTEGER NOT NULL,\
+	    PRIMARY KEY(set_id, rack_no, chassis_no)\
+    ) WITHOUT ROWID;\
+    CREATE TEMP TABLE IF NOT EXISTS ack_batch(\
+	    error_id INTEGER PRIMARY KEY\
+    );";
+
+    char *errstr = NULL;
+    if (SQLITE_OK != sqlite3_exec(db, temp_create_sql, NULL, NULL, &errstr)) {
+        puts(errstr);
+        sqlite3_free(errstr);
+        return false;
+    }
+
+    return true;
+}
+
+void init_database(const char *path) {
+    // configure checks the headers but an older library could still be loaded
+    if (sqlite3_libversion_number() < SQLITE_ANALYSIS_LIMIT_VERSION) {
+        fprintf(stderr, "SQLite %s is too old to keep the query planner's statistics up to date. 3.32.0 or later is needed\n",
+            sqlite3_libversion());
+    }
+
+    bool new_db = true;
+    if ((NULL != path) && (0 != strncmp("", path, 1))) {
+        // check to see if the database already exists
+        if (0 == access(path, F_OK)) {
+            // file exists
+            new_db = false;
+
+            // check that we have read and write permissions on the file
+            if (0 != access(path, W_OK | R_OK)) {
+                fprintf(stderr, "I don't have permission to access database file %s\n", path);
+                exit(EXIT_FAILURE);
+            } else {
+                printf("Using existing database at %s\n", path);
+                // open database with sqlite
+                assert(SQLITE_OK == sqlite3_open(path, &db));
+            }
+        } else {
+            printf("Creating a new database at %s\n", path);
+            // open database with sqlite
+            if (SQLITE_OK != sqlite3_open(path, &db)) {
+                fprintf(stderr, "I did not have permissions to create database file %s\n", path);
+                exit(EXIT_FAILURE);
+            }
+        }
+    } else {
+        puts("Creating memory resident database");
+        // open database with sqlite
+        assert(SQLITE_OK == sqlite3_open(NULL, &db));
+    }
+
+    // readers (e.g. a read-only window) block commits outside of WAL mode, so wait for them rather than failing
+    sqlite3_busy_timeout(db, BUSY_TIMEOUT_MS);
+
+    if (new_db) {
+        create_tables();
+    }
+    assert(true == upgrade_tables());
+    assert(true == create_temp_tables());
+    assert(true == create_templates());
+    assert(true == create_acks());
+    search_available = create_search_index();
+    assert(true == create_rollup());
+    assert(true == load_hot_tier(HOT_TIER_DEFAULT_CAPACITY));
+    assert(true == load_recent_activity());
+    unacked_clear();
+    assert(true == count_unacked("1", 1));
+}
+
+// is there a table (or index or trigger) called name?
+static bool in_schema(const char *name) {
+    sqlite3_stmt *statement = NULL;
+    assert(SQLITE_OK == sqlite3_prepare_v2(db, "SELECT COUNT(*) FROM sqlite_master WHERE name = ?1;", -1, &statement, NULL));
+    assert(SQLITE_OK == sqlite3_bind_text(statement, 1, name, -1, SQLITE_STATIC));
+    assert(SQLITE_ROW == sqlite3_step(statement));
+    const bool exists = (0 != sqlite3_column_int(statement, 0));
+    assert(SQLITE_OK == sqlite3_finalize(statement));
+
+    return exists;
+}
+
+bool open_database_read_only(const char *path) {
+    assert(NULL != path);
+
+    if (SQLITE_OK != sqlite3_open_v2(path, &db, SQLITE_OPEN_READONLY, NULL)) {
+        fprintf(stderr, "Unable to open database file %s read-only\n", path);
+        sqlite3_close(db);
+        db = NULL;
+        return false;
+    }
+    read_only = true;
+
+    // the mothership writing to it keeps the schema up to date. error_acks is the newest table
+    if (!in_schema("error_acks")) {
+        fprintf(stderr, "%s must be opened by a mothership which can write to it first\n", path);
+        close_database();
+        return false;
+    }
+
+    // wait for the writer rather than failing
+    sqlite3_busy_timeout(db, BUSY_TIMEOUT_MS);
+
+    assert(true == create_temp_tables()); // temporary tables aren't part of the file
+    search_available = in_schema("errors_fts");
+    return true;
+}
+
+bool init_database_read_only(const char *path) {
+    if (!open_database_read_only(path)) {
+        return false;
+    }
+    printf("Using existing database at %s read-only\n", path);
+
+    hot_tier_init(0); // errors written by the other process never reach this one's hot tier
+    return reload_database_state();
+}
+
+bool database_read_only(void) {
+    return read_only;
+}
+
+bool database_changed(void) {
+    sqlite3_stmt *statement = NULL;
+    assert(SQLITE_OK == sqlite3_prepare_v2(db, "PRAGMA data_version;", -1, &statement, NULL));
+    const gint64 version = (SQLITE_ROW == sqlite3_step(statement)) ? sqlite3_column_int64(statement, 0) : -1;
+    assert(SQLITE_OK == sqlite3_finalize(statement));
+
+    return version != data_version;
+}
+
+bool reload_database_state(void) {
+    // one snapshot for everything
+    begin_batch();
+    sqlite3_stmt *statement = NULL;
+    assert(SQLITE_OK == sqlite3_prepare_v2(db, "PRAGMA data_version;", -1, &statement, NULL));
+    data_version = (SQLITE_ROW == sqlite3_step(statement)) ? sqlite3_column_int64(statement, 0) : -1;
+    assert(SQLITE_OK == sqlite3_finalize(statement));
+
+    bool ret = load_recent_activity();
+    unacked_clear();
+    ret &= count_unacked("1", 1);
+    ret &= end_batch();
+
+    return ret;
+}
+
+void close_database(void) {
+    // recommended before closing so that statistics gathered by this connection are kept
+    if (!read_only) {
+        optimize_database();
+    }
+    read_only = false;
+    data_version = -1;
+    if (NULL != filter_statements) {
+        g_hash_table_destroy(filter_statements);
+        filter_statements = NULL;
+    }
+    if (NULL != node_set_ids) {
+        g_hash_table_destroy(node_set_ids); // node_set_members goes with the connection
+        node_set_ids = NULL;
+    }
+    if (NULL != known_templates) {
+        g_hash_table_destroy(known_templates);
+        known_templates = NULL;
+    }
+    assert(SQLITE_OK == sqlite3_close(db));
+    hot_tier_free();
+    node_activity_clear();
+    heavy_hitters_clear();
+    correlator_clear();
+    topology_clear();
+    liveness_clear();
+    unacked_clear();
+}
+
+bool backup_database(const char *dest_path, backup_progress_t progress, gpointer user_data) {
+    assert(NULL != dest_path);
+
+    // write to a temporary file first so that dest_path is never a half finished backup
+    GString *partial_path = g_string_new(dest_path);
+    assert(NULL != partial_path);
+    g_string_append(partial_path, ".partial");
+
+    sqlite3 *dest = NULL;
+    if (SQLITE_OK != sqlite3_open(partial_path->str, &dest)) {
+        fprintf(stderr, "Unable to open backup file %s\n", partial_path->str);
+        sqlite3_close(dest);
+        g_string_free(partial_path, TRUE);
+        return false;
+    }
+
+    sqlite3_backup *backup = sqlite3_backup_init(dest, "main", db, "main");
+    if (NULL == backup) {
+        puts(sqlite3_errmsg(dest));
+        assert(SQLITE_OK == sqlite3_close(dest));
+        remove(partial_path->str);
+        g_string_free(partial_path, TRUE);
+        return false;
+    }
+
+    // Changes made through db while we are copying are applied to the backup by sqlite so we never have to restart
+    int status = SQLITE_OK;
+    do {
+        status = sqlite3_backup_step(backup, BACKUP_PAGES_PER_STEP);
+
+        if (NULL != progress) {
+            progress(sqlite3_backup_remaining(backup), sqlite3_backup_pagecount(backup), user_data);
+        }
+
+        if ((SQLITE_OK == status) || (SQLITE_BUSY == status) || (SQLITE_LOCKED == status)) {
+            // let the ingest thread and the gui have the database for a while
+            sqlite3_sleep(BACKUP_STEP_DELAY_MS);
+        }
+    } while ((SQLITE_OK == status) || (SQLITE_BUSY == status) || (SQLITE_LOCKED == status));
+
+    bool ret = (SQLITE_DONE == status);
+    if (!ret) {
+        puts(sqlite3_errstr(status));
+    }
+
+    sqlite3_backup_finish(backup);
+    assert(SQLITE_OK == sqlite3_close(dest));
+
+    if (ret) {
+        if (0 != rename(partial_path->str, dest_path)) {
+            perror("rename backup");
+            ret = false;
+        }
+    } else {
+        remove(partial_path->str);
+    }
+
+    g_string_free(partial_path, TRUE);
+    return ret;
+}
+
+gint64 get_journal_applied(void) {
+    const char *query = "SELECT applied_seq FROM journal_state WHERE id = 0;";
+
+    sqlite3_stmt *statement = NULL;
+    if (SQLITE_OK != sqlite3_prepare_v2(db, query, -1, &statement, NULL)) {
+        puts("Error constructing get_journal_applied query");
+        return -1;
+    }
+
+    gint64 ret = 0; // nothing applied yet
+    const int status = sqlite3_step(statement);
+    if (SQLITE_ROW == status) {
+        ret = sqlite3_column_int64(statement, 0);
+    } else if (SQLITE_DONE != status) {
+        puts("Bad sqlite3_step get_journal_applied");
+        ret = -1;
+    }
+
+    assert(SQLITE_OK == sqlite3_finalize(statement));
+    return ret;
+}
+
+bool set_journal_applied(const gint64 seq) {
+    GString *query = g_string_new(NULL);
+    assert(NULL != query);
+    g_string_printf(query, "INSERT OR REPLACE INTO journal_state(id, applied_seq) VALUES(0, %li); \
+        DELETE FROM journal_stored WHERE seq <= %li;", seq, seq);
+
+    bool ret = true;
+    char *errstr = NULL;
+    if (SQLITE_OK != sqlite3_exec(db, query->str, NULL, NULL, &errstr)) {
+        puts(errstr);
+        sqlite3_free(errstr);
+        ret = false;
+    }
+
+    g_string_free(query, TRUE);
+    return ret;
+}
+
+bool set_journal_stored(const gint64 seq) {
+    GString *query = g_string_new(NULL);
+    assert(NULL != query);
+    g_string_printf(query, "INSERT OR IGNORE INTO journal_stored(seq) VALUES(%li);", seq);
+
+    bool ret = true;
+    char *errstr = NULL;
+    if (SQLITE_OK != sqlite3_exec(db, query->str, NULL, NULL, &errstr)) {
+        puts(errstr);
+        sqlite3_free(errstr);
+        ret = false;
+    }
+
+    g_string_free(query, TRUE);
+    return ret;
+}
+
+GHashTable *get_journal_stored(void) {
+    sqlite3_stmt *statement = NULL;
+    if (SQLITE_OK != sqlite3_prepare_v2(db, "SELECT seq FROM journal_stored;", -1, &statement, NULL)) {
+        puts("Error constructing get_journal_stored query");
+        return NULL;
+    }
+
+    GHashTable *stored = g_hash_table_new_full(g_int64_hash, g_int64_equal, g_free, NULL);
+    assert(NULL != stored);
+    int status = SQLITE_ERROR;
+    while (SQLITE_ROW == (status = sqlite3_step(statement))) {
+        gint64 *seq = g_malloc(sizeof(gint64));
+        assert(NULL != seq);
+        *seq = sqlite3_column_int64(statement, 0);
+        g_hash_table_add(stored, seq);
+    }
+    sqlite3_finalize(statement);
+    if (SQLITE_DONE != status) {
+        puts("Bad sqlite3_step get_journal_stored");
+        g_hash_table_destroy(stored);
+        return NULL;
+    }
+
+    return stored;
+}
+
+bool storage_profile_preset(const char *name, StorageProfile *profile) {
+    assert(NULL != name);
+    assert(NULL != profile);
+
+    for (size_t i = 0; i < G_N_ELEMENTS(storage_presets); i++) {
+        if (0 == g_ascii_strcasecmp(name, storage_presets[i].name)) {
+            memcpy(profile, &storage_presets[i].profile, sizeof(*profile));
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// copies value into dest (uppercase) if it is one of the allowed values
+static bool set_pragma_value(char *dest, const size_t dest_len, const char *value, const char * const *allowed) {
+    assert(NULL != dest);
+    assert(NULL != value);
+    assert(NULL != allowed);
+
+    for (const char * const *option = allowed; NULL != *option; option++) {
+        if (0 == g_ascii_strcasecmp(value, *option)) {
+            g_strlcpy(dest, *option, dest_len);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool storage_profile_load(const char *path, StorageProfile *profile) {
+    assert(NULL != path);
+    assert(NULL != profile);
+
+    static const char * const synchronous_values[] = {"OFF", "NORMAL", "FULL", NULL};
+    static const char * const journal_values[] = {"DELETE", "TRUNCATE", "WAL", NULL};
+
+    if (0 != access(path, F_OK)) {
+        return true; // no config file: keep the defaults
+    }
+
+    GKeyFile *key_file = g_key_file_new();
+    assert(NULL != key_file);
+
+    GError *error = NULL;
+    if (!g_key_file_load_from_file(key_file, path, G_KEY_FILE_NONE, &error)) {
+        fprintf(stderr, "Unable to read %s: %s\n", path, error->message);
+        g_error_free(error);
+        g_key_file_free(key_file);
+        return false;
+    }
+
+    bool ret = true;
+
+    // a preset first so that individual settings can override it
+    gchar *value = g_key_file_get_string(key_file, "storage", "profile", NULL);
+    if (NULL != value) {
+        if (!storage_profile_preset(value, profile)) {
+            fprintf(stderr, "%s: unknown storage profile %s\n", path, value);
+            ret = false;
+        }
+        g_free(value);
+    }
+
+    if (g_key_file_has_key(key_file, "storage", "cache_size_kib", NULL)) {
+        profile->cache_size_kib = g_key_file_get_integer(key_file, "storage", "cache_size_kib", NULL);
+    }
+
+    if (g_key_file_has_key(key_file, "storage", "mmap_size", NULL)) {
+        profile->mmap_size = g_key_file_get_int64(key_file, "storage", "mmap_size", NULL);
+    }
+
+    value = g_key_file_get_string(key_file, "storage", "temp_store", NULL);
+    if (NULL != value) {
+        if (0 == g_ascii_strcasecmp(value, "memory")) {
+            profile->temp_store_memory = true;
+        } else if (0 == g_ascii_strcasecmp(value, "file")) {
+            profile->temp_store_memory = false;
+        } else {
+            fprintf(stderr, "%s: temp_store should be memory or file\n", path);
+            ret = false;
+        }
+        g_free(value);
+    }
+
+    value = g_key_file_get_string(key_file, "storage", "synchronous", NULL);
+    if ((NULL != value) && !set_pragma_value(profile->synchronous, sizeof(profile->synchronous), value, synchronous_values)) {
+        fprintf(stderr, "%s: synchronous should be OFF, NORMAL or FULL\n", path);
+        ret = false;
+    }
+    g_free(value);
+
+    value = g_key_file_get_string(key_file, "storage", "journal_mode", NULL);
+    if ((NULL != value) && !set_pragma_value(profile->journal_mode, sizeof(profile->journal_mode), value, journal_values)) {
+        fprintf(stderr, "%s: journal_mode should be DELETE, TRUNCATE or WAL\n", path);
+        ret = false;
+    }
+    g_free(value);
+
+    if ((profile->cache_size_kib <= 0) || (profile->mmap_size < 0)) {
+        fprintf(stderr, "%s: cache_size_kib must be positive and mmap_size must not be negative\n", path);
+        ret = false;
+    }
+
+    g_key_file_free(key_file);
+    return ret;
+}
+
+bool apply_storage_profile(const StorageProfile *profile) {
+    assert(NULL != profile);
+
+    // the string values were checked when the profile was made so they are safe to put in the query
+    GString *query = g_string_new(NULL);
+    assert(NULL != query);
+    g_string_printf(query,
+        "PRAGMA cache_size = -%i;\
+        PRAGMA mmap_size = %li;\
+        PRAGMA temp_store = %s;\
+        PRAGMA journal_mode = %s;\
+        PRAGMA synchronous = %s;\
+        PRAGMA analysis_limit = %i;",
+        profile->cache_size_kib, profile->mmap_size, profile->temp_store_memory ? "MEMORY" : "FILE",
+        profile->journal_mode, profile->synchronous, ANALYSIS_LIMIT);
+
+    bool ret = true;
+    char *errstr = NULL;
+    if (SQLITE_OK != sqlite3_exec(db, query->str, NULL, NULL, &errstr)) {
+        puts(errstr);
+        sqlite3_free(errstr);
+        ret = false;
+    }
+
+    g_string_free(query, TRUE);
+    return ret;
+}
+
+bool optimize_database(void) {
+    char *errstr = NULL;
+    if (SQLITE_OK != sqlite3_exec(db, "PRAGMA optimize;", NULL, NULL, &errstr)) {
+        puts(errstr);
+        sqlite3_free(errstr);
+        return false;
+    }
+
+    return true;
+}
+
+// after a rolled back batch: the caches and in-memory models may have things which never reached the database, so
+// reload them. Call with batch_lock held
+static void forget_rolled_back(void) {
+    if (NULL != known_templates) {
+        g_hash_table_remove_all(known_templates);
+    }
+    if (NULL != node_set_ids) {
+        g_hash_table_remove_all(node_set_ids); // temp.node_set_members was rolled back too
+    }
+    correlator_clear();
+
+    bool ret = load_hot_tier(hot_tier_enabled() ? HOT_TIER_DEFAULT_CAPACITY : 0) && load_recent_activity();
+    unacked_clear();
+    ret &= count_unacked("1", 1);
+    if (!ret) {
+        puts("Unable to reload state after a failed commit");
+    }
+}
+
+void begin_batch(void) {
+    g_rec_mutex_lock(&batch_lock);
+
+    if (0 == batch_depth) {
+        assert(SQLITE_OK == sqlite3_exec(db, "begin transaction;", NULL, NULL, NULL));
+    }
+    batch_depth += 1;
+}
+
+void fail_batch(void) {
+    g_rec_mutex_lock(&batch_lock);
+    assert(batch_depth > 0);
+    batch_failed = true;
+    g_rec_mutex_unlock(&batch_lock);
+}
+
+bool end_batch(void) {
+    assert(batch_depth > 0);
+
+    bool ret = !batch_failed;
+    batch_depth -= 1;
+    if (0 == batch_depth) {
+        char *errstr = NULL;
+        if (ret && (SQLITE_OK != sqlite3_exec(db, "commit;", NULL, NULL, &errstr))) {
+            puts(errstr);
+            sqlite3_free(errstr);
+            ret = false;
+        }
+
+        if (!ret) {
+            // a busy commit leaves the transaction open too
+            if (0 == sqlite3_get_autocommit(db)) {
+                sqlite3_exec(db, "rollback;", NULL, NULL, NULL);
+            }
+            forget_rolled_back();
+        }
+        batch_failed = false;
+    }
+
+    g_rec_mutex_unlock(&batch_lock);
+    return ret;
+}
+
+bool add_node(const unsigned int rack_no, const unsigned int chassis_no, const bool enabled) {
+    gint enabled_int;
+    if (enabled) {
+        enabled_int = 1;
+    } else {
+        enabled_int = 0;
+    }
+
+    GString *query = g_string_new(NULL);
+    assert(NULL != query);
+
+    g_string_printf(query,
+        "INSERT into nodes(rack_no, chassis_no, enabled) VALUES(%i, %i, %i);", 
+        rack_no, chassis_no, enabled_int);
+
+    bool ret = true;
+    char *errstr = NULL;
+    if (SQLITE_OK != sqlite3_exec(db, query->str, NULL, NULL, &errstr)) {
+        puts(errstr);
+        ret = false;
+    } else {
+        hot_tier_set_node_enabled(rack_no, chassis_no, enabled);
+        node_activity_set_node(rack_no, chassis_no, enabled);
+        topology_set_node(rack_no, chassis_no, enabled);
+        liveness_set_node(rack_no, chassis_no, time(NULL));
+    }
+
+    g_string_free(query, TRUE);
+
+    return ret;
+}
+
+bool remove_node(const unsigned int rack_no, const unsigned int chassis_no) {
+    GString *query = g_string_new(NULL);
+    assert(NULL != query);
+
+    // delete all of the errors associated with this node
+    g_string_append_printf(query,
+        "DELETE FROM errors WHERE node_id IN \
+            (SELECT DISTINCT id FROM nodes \
+                WHERE rack_no = %i AND chassis_no = %i);", rack_no, chassis_no);
+
+    // and their counts (a new node could be given the same id)
+    g_string_append_printf(query,
+        "DELETE FROM error_rollup WHERE node_id IN \
+            (SELECT id FROM nodes WHERE rack_no = %i AND chassis_no = %i);", rack_no, chassis_no);
+    
+    // and its connection history
+    g_string_append_printf(query,
+        "DELETE FROM node_connections WHERE node_id IN \
+            (SELECT id FROM nodes WHERE rack_no = %i AND chassis_no = %i);", rack_no, chassis_no);
+    g_string_append_printf(query,
+        "DELETE FROM node_uptime WHERE node_id IN \
+            (SELECT id FROM nodes WHERE rack_no = %i AND chassis_no = %i);", rack_no, chassis_no);
+
+    // delete the node
+    g_string_append_printf(query,
+        "DELETE FROM nodes WHERE rack_no = %i AND chassis_no = %i;", rack_no, chassis_no);
+
+    // the node and everything stored about it go in one transaction, or none of it does
+    begin_batch();
+
+    bool ret = true;
+    char *errstr = NULL;
+    if (SQLITE_OK != sqlite3_exec(db, query->str, NULL, NULL, &errstr)) {
+        puts(errstr);
+        ret = false;
+        fail_batch();
+    } else {
+        hot_tier_remove_node(rack_no, chassis_no);
+        node_activity_remove_node(rack_no, chassis_no);
+        topology_remove_node(rack_no, chassis_no);
+        liveness_remove_node(rack_no, chassis_no);
+        heavy_hitters_remove_node(rack_no, chassis_no);
+        unacked_remove_node(rack_no, chassis_no);
+        correlator_clear(); // its windows might hold the node's errors
+    }
+
+    ret &= end_batch();
+
+    g_string_free(query, TRUE);
+
+    return ret;
+}
+
+bool node_exists(const unsigned int rack_no, const unsigned int chassis_no) {
+    return topology_node_exists(rack_no, chassis_no, NULL);
+}
+
+bool remove_all_errors(void) {
+    const char *query = "DELETE FROM errors; DELETE FROM error_rollup; DELETE FROM rack_events;";
+
+    bool ret = true;
+    if (SQLITE_OK != sqlite3_exec(db, query, NULL, NULL, NULL)) {
+        ret = false;
+    } else {
+        hot_tier_clear();
+        node_activity_clear_errors();
+        heavy_hitters_clear();
+        correlator_clear();
+        unacked_clear();
+        g_atomic_int_inc(&rack_events_changes);
+    }
+
+    return ret;
+}
+
+// record what the correlator found out about an error's rack. Call with batch_lock held
+static bool store_rack_event(const RackEventUpdate *update) {
+    GString *query = g_string_new(NULL);
+    assert(NULL != query);
+
+    char *errmsg = NULL;
+    gint64 event_id = update->event_id;
+    if (0 == event_id) {
+        g_string_printf(query,
+            "INSERT INTO rack_events(rack_no, start_time, end_time, chassis_count, valve_count, error_count) \
+                VALUES (%u, %li, %li, %u, %u, 0);",
+            update->rack_no, update->start_time, update->end_time, update->chassis_count, update->valve_count);
+        if (SQLITE_OK != sqlite3_exec(db, query->str, NULL, NULL, &errmsg)) {
+            puts(errmsg);
+            sqlite3_free(errmsg);
+            g_string_free(query, TRUE);
+            return false;
+        }
+        event_id = sqlite3_last_insert_rowid(db);
+        correlator_set_event_id(update->rack_no, event_id);
+    }
+
+    g_string_printf(query,
+        "UPDATE rack_events SET end_time = MAX(end_time, %li), chassis_count = MAX(chassis_count, %u), \
+            valve_count = MAX(valve_count, %u), error_count = error_count + %u WHERE id = %" G_GINT64_FORMAT ";",
+        update->end_time, update->chassis_count, update->valve_count, update->error_ids->len, event_id);
+    for (guint i = 0; i < update->error_ids->len; i++) {
+        g_string_append_printf(query, "INSERT OR IGNORE INTO rack_event_errors(error_id, event_id) \
+                VALUES (%" G_GINT64_FORMAT ", %" G_GINT64_FORMAT ");", g_array_index(update->error_ids, gint64, i), event_id);
+    }
+
+    bool ret = true;
+    if (SQLITE_OK != sqlite3_exec(db, query->str, NULL, NULL, &errmsg)) {
+        puts(errmsg);
+        sqlite3_free(errmsg);
+        ret = false;
+    } else {
+        g_atomic_int_inc(&rack_events_changes);
+    }
+
+    g_string_free(query, TRUE);
+    return ret;
+}
+
+// where an error given to insert_error comes from
+typedef enum {
+    INSERT_RECEIVED, // just received from a node
+    INSERT_REPLAYED, // received before a crash and replayed from the journal. Only recent ones reach the live models
+    INSERT_RESTORED  // back from an archive. Archiving kept its count in error_rollup so it isn't counted again, and it
+                     // is too old for the live models (the overview, top offenders and correlator)
+} InsertKind;
+
+// count is the number of received errors the row stands for (see add_error_repeated)
+static bool insert_error(const uint32_t rack_no, const uint32_t chassis_no, const int valve_no, const time_t recv_time,
+        const char *msg, const bool enabled, const bool acked, const guint count, const InsertKind kind) {
+    assert(count > 0);
+
+    GString *query = g_string_new(NULL);
+    assert(NULL != query);
+
+    GString *msg_str = fix_string(msg);
+    const gint64 message_template = template_id(msg);
+
+    // count it in its minute of the rollup first so that sqlite3_changes is still about the error
+    if (INSERT_RESTORED != kind) {
+        const time_t bucket = recv_time - recv_time % ROLLUP_MINUTE;
+        g_string_append_printf(query,
+            "INSERT OR IGNORE INTO error_rollup(node_id, bucket, valve_no, resolution, count) \
+                SELECT id, %li, %i, %i, 0 FROM nodes WHERE rack_no = %u AND chassis_no = %u; \
+            UPDATE error_rollup SET count = count + %u \
+                WHERE node_id = (SELECT id FROM nodes WHERE rack_no = %u AND chassis_no = %u) \
+                AND bucket = %li AND valve_no = %i AND resolution = %i;",
+            bucket, valve_no, ROLLUP_MINUTE, rack_no, chassis_no, count, rack_no, chassis_no, bucket, valve_no, ROLLUP_MINUTE);
+    }
+
+    g_string_append_printf(query,
+        "INSERT INTO errors(node_id, recv_time, description, enabled, acked, valve_no, template_id) \
+            SELECT nodes.id, %li, \"%s\", %i, %i, %i, %" G_GINT64_FORMAT " \
+                FROM nodes \
+                WHERE nodes.rack_no = %i AND nodes.chassis_no = %i;", \
+        recv_time, msg_str->str, enabled ? 1 : 0, acked ? 1 : 0, valve_no, message_template, rack_no, chassis_no);
+
+    // nothing else may insert between our insert and asking for its id. Errors have to reach the hot tier in id order.
+    // The batch also keeps the error and its rollup count together
+    begin_batch();
+
+    // name each template the first time it is seen, in the same exec as the error
+    if (!g_hash_table_contains(known_templates, &message_template)) {
+        char *text = template_text(msg);
+        GString *text_str = fix_string(text);
+        g_free(text);
+        GString *name_query = g_string_new(NULL);
+        assert(NULL != name_query);
+        g_string_printf(name_query, "INSERT OR IGNORE INTO templates(id, text) VALUES (%" G_GINT64_FORMAT ", \"%s\");",
+            message_template, text_str->str);
+        g_string_prepend(query, name_query->str);
+        g_string_free(name_query, TRUE);
+        g_string_free(text_str, TRUE);
+
+        gint64 *key = g_malloc(sizeof(gint64));
+        assert(NULL != key);
+        *key = message_template;
+        g_hash_table_add(known_templates, key);
+    }
+
+    bool ret = true;
+    char *errmsg = NULL;
+    if (SQLITE_OK != sqlite3_exec(db, query->str, NULL, NULL, &errmsg)) {
+        puts(errmsg);
+        ret = false;
+    } else if (1 == sqlite3_changes(db)) { // 0 if the node does not exist
+        const sqlite3_int64 error_id = sqlite3_last_insert_rowid(db);
+        hot_tier_add(error_id, recv_time, rack_no, chassis_no, valve_no, enabled, acked, msg);
+        if (!acked) {
+            unacked_add(rack_no, chassis_no, valve_no, 1);
+        }
+
+        // the correlator assumes errors arrive in time order, which old errors would break
+        const bool live = (INSERT_RECEIVED == kind)
+            || ((INSERT_REPLAYED == kind) && (recv_time > time(NULL) - REPLAY_LIVE_SECONDS));
+        if (live) {
+            node_activity_add(rack_no, chassis_no, count, recv_time);
+            heavy_hitters_add(rack_no, chassis_no, valve_no, count, recv_time);
+
+            RackEventUpdate update;
+            if (correlator_add(rack_no, chassis_no, valve_no, recv_time, error_id, &update)) {
+                ret = store_rack_event(&update);
+                g_array_unref(update.error_ids);
+            }
+        }
+    }
+
+    ret &= end_batch();
+
+    g_string_free(query, TRUE);
+    g_string_free(msg_str, TRUE);
+
+    return ret;
+}
+
+bool add_error_decoded(const uint32_t rack_no, const uint32_t chassis_no, const int valve_no, const time_t recv_time, const char *msg) {
+    return insert_error(rack_no, chassis_no, valve_no, recv_time, msg, true, false, 1, INSERT_RECEIVED);
+}
+
+bool add_error_repeated(const uint32_t rack_no, const uint32_t chassis_no, const int valve_no, const time_t recv_time,
+        const char *msg, const guint count) {
+    return insert_error(rack_no, chassis_no, valve_no, recv_time, msg, true, false, count, INSERT_RECEIVED);
+}
+
+bool restore_error(const uint32_t rack_no, const uint32_t chassis_no, const int valve_no, const time_t recv_time, const char *msg,
+        const bool enabled, const bool acked) {
+    return insert_error(rack_no, chassis_no, valve_no, recv_time, msg, enabled, acked, 1, INSERT_RESTORED);
+}
+
+gint64 foreach_error_before(const time_t cutoff, error_row_func_t func, gpointer user_data) {
+    assert(NULL != func);
+
+    GString *query = g_string_new(NULL);
+    assert(NULL != query);
+    g_string_printf(query,
+        "SELECT errors.id, errors.recv_time, nodes.rack_no, nodes.chassis_no, errors.valve_no, errors.enabled, errors.description, \
+                errors.acked \
+            FROM errors \
+            INNER JOIN nodes \
+            ON errors.node_id = nodes.id \
+            WHERE errors.recv_time < %li \
+            ORDER BY errors.recv_time;", cutoff);
+
+    sqlite3_stmt *statement = NULL;
+    if (SQLITE_OK != sqlite3_prepare_v2(db, query->str, -1, &statement, NULL)) {
+        g_string_free(query, TRUE);
+        puts("Error constructing foreach_error_before query");
+        return -1;
+    }
+    g_string_free(query, TRUE);
+
+    gint64 max_id = 0;
+    int status = SQLITE_ERROR;
+    do {
+        status = sqlite3_step(statement);
+        if (SQLITE_DONE == status) {
+            break;
+        } else if (SQLITE_ROW != status) {
+            sqlite3_finalize(statement);
+            puts("Bad sqlite3_step foreach_error_before");
+            return -1;
+        }
+        // status == SQL_ROW so get data
+        const gint64 id = sqlite3_column_int64(statement, 0);
+        if (id > max_id) {
+            max_id = id;
+        }
+
+        #pragma GCC diagnostic push
+        #pragma GCC diagnostic ignored "-Wsign-conversion"
+        #pragma GCC diagnostic ignored "-Wpointer-sign"
+        const bool keep_going = func(sqlite3_column_int64(statement, 1), sqlite3_column_int(statement, 2),
+            sqlite3_column_int(statement, 3), sqlite3_column_int(statement, 4), 0 != sqlite3_column_int(statement, 5),
+            0 != sqlite3_column_int(statement, 7), sqlite3_column_text(statement, 6), user_data);
+        #pragma GCC diagnostic pop
+
+        if (!keep_going) {
+            assert(SQLITE_OK == sqlite3_finalize(statement));
+            return -1;
+        }
+    } while (true);
+
+    assert(SQLITE_OK == sqlite3_finalize(statement));
+    return max_id;
+}
+
+// id of the newest error. 0 if there are none and -1 on failure
+static gint64 get_max_error_id(void) {
+    sqlite3_stmt *statement = NULL;
+    if (SQLITE_OK != sqlite3_prepare_v2(db, "SELECT COALESCE(MAX(id), 0) FROM errors;", -1, &statement, NULL)) {
+        puts("Error constructing get_max_error_id query");
+        return -1;
+    }
+
+    const gint64 max_id = (SQLITE_ROW == sqlite3_step(statement)) ? sqlite3_column_int64(statement, 0) : -1;
+    sqlite3_finalize(statement); // returns the step's error, if any, again
+    return max_id;
+}
+
+gint64 foreach_error_matching(const Filter *filter, const time_t since, const time_t until, error_row_func_t func,
+        gpointer user_data) {
+    assert(NULL != filter);
+    assert(NULL != func);
+
+    char *condition = filter_sql(filter, MATCHING_FIRST_PARAM);
+    assert(NULL != condition);
+
+    // resumes after the last row of the previous chunk. errors_by_time holds ids too so this is a range of the index
+    GString *query = g_string_new(NULL);
+    assert(NULL != query);
+    g_string_printf(query,
+        "SELECT errors.id, errors.recv_time, nodes.rack_no, nodes.chassis_no, errors.valve_no, \
+                (nodes.enabled = 1 AND errors.enabled = 1), errors.description, errors.acked \
+            FROM errors \
+            INNER JOIN nodes \
+            ON errors.node_id = nodes.id \
+            WHERE (?1 OR (nodes.enabled = 1 AND errors.enabled = 1)) \
+            AND errors.recv_time >= ?2 AND (?3 = 0 OR errors.recv_time < ?3) AND errors.id <= ?4 \
+            AND (errors.recv_time > ?5 OR (errors.recv_time = ?5 AND errors.id > ?6)) \
+            AND %s \
+            ORDER BY errors.recv_time, errors.id \
+            LIMIT %i;", condition, MATCHING_CHUNK_ROWS);
+    g_free(condition);
+
+    sqlite3_stmt *statement = NULL;
+    if (SQLITE_OK != sqlite3_prepare_v2(db, query->str, -1, &statement, NULL)) {
+        g_string_free(query, TRUE);
+        puts("Error constructing foreach_error_matching query");
+        return -1;
+    }
+    g_string_free(query, TRUE);
+
+    // errors arriving while this runs aren't visited
+    const gint64 max_id = get_max_error_id();
+    if (max_id < 0) {
+        sqlite3_finalize(statement);
+        return -1;
+    }
+
+    gint64 rows = 0;
+    time_t last_time = (time_t) -1;
+    gint64 last_id = 0;
+    bool keep_going = true;
+    bool ret = true;
+    while (keep_going && ret) {
+        // each chunk is a separate read so a writer using a rollback journal is only held up for one chunk
+        if (!(SQLITE_OK == sqlite3_reset(statement)
+                && SQLITE_OK == sqlite3_bind_int(statement, 1, !filter_enabled_only(filter))
+                && SQLITE_OK == sqlite3_bind_int64(statement, 2, since)
+                && SQLITE_OK == sqlite3_bind_int64(statement, 3, until)
+                && SQLITE_OK == sqlite3_bind_int64(statement, 4, max_id)
+                && SQLITE_OK == sqlite3_bind_int64(statement, 5, last_time)
+                && SQLITE_OK == sqlite3_bind_int64(statement, 6, last_id)
+                && filter_bind(filter, statement, MATCHING_FIRST_PARAM))) {
+            puts("Error binding foreach_error_matching query");
+            ret = false;
+            break;
+        }
+
+        int chunk_rows = 0;
+        int status = SQLITE_ERROR;
+        while (keep_going && (SQLITE_ROW == (status = sqlite3_step(statement)))) {
+            last_id = sqlite3_column_int64(statement, 0);
+            last_time = sqlite3_column_int64(statement, 1);
+            chunk_rows += 1;
+            rows += 1;
+
+            #pragma GCC diagnostic push
+            #pragma GCC diagnostic ignored "-Wsign-conversion"
+            #pragma GCC diagnostic ignored "-Wpointer-sign"
+            keep_going = func(last_time, sqlite3_column_int(statement, 2), sqlite3_column_int(statement, 3),
+                sqlite3_column_int(statement, 4), 0 != sqlite3_column_int(statement, 5),
+                0 != sqlite3_column_int(statement, 7), sqlite3_column_text(statement, 6), user_data);
+            #pragma GCC diagnostic pop
+        }
+
+        if (keep_going && (SQLITE_DONE != status)) {
+            puts("Bad sqlite3_step foreach_error_matching");
+            ret = false;
+        } else if (chunk_rows < MATCHING_CHUNK_ROWS) {
+            break; // that was the last chunk
+        }
+    }
+
+    sqlite3_finalize(statement); // returns the step's error, if any, again
+    return ret ? rows : -1;
+}
+
+bool remove_errors_before(const time_t cutoff, const gint64 max_id) {
+    GString *query = g_string_new(NULL);
+    assert(NULL != query);
+
+    // no errors may be acknowledged between counting and deleting
+    begin_batch();
+
+    // the unacknowledged ones no longer count
+    g_string_printf(query, "errors.recv_time < %li AND errors.id <= %li", cutoff, max_id);
+    bool ret = count_unacked(query->str, -1);
+
+    if (ret) {
+        g_string_printf(query, "DELETE FROM errors WHERE recv_time < %li AND id <= %li;", cutoff, max_id);
+        char *errstr = NULL;
+        if (SQLITE_OK != sqlite3_exec(db, query->str, NULL, NULL, &errstr)) {
+            puts(errstr);
+            ret = false;
+
+            // they are still there
+            g_string_printf(query, "errors.recv_time < %li AND errors.id <= %li", cutoff, max_id);
+            count_unacked(query->str, 1);
+        } else {
+            hot_tier_remove_before(cutoff, max_id);
+        }
+    }
+
+    ret &= end_batch();
+
+    g_string_free(query, TRUE);
+    return ret;
+}
+
+NodeIdentifier *parse_ip_address(const struct in_addr *address) {
+    assert(NULL != address);
+
+    NodeIdentifier *ret = malloc(sizeof(NodeIdentifier));
+    assert(NULL != ret);
+
+    // "Network" is big endian. We don't know what the host is
+    uint32_t addr = htonl(address->s_addr);
+    const uint32_t rack_num_n = (addr & 0x0000FF00) << 16;
+    const uint32_t chassis_num_n = (addr & 0x000000FF) << 24;
+
+    // don't assume host endianness
+    ret->rack_no = ntohl(rack_num_n);
+    ret->chassis_no = ntohl(chassis_num_n);
+
+    return ret;
+}
+
+bool decode_error(const BufferItem *error, NodeIdentifier *node, int *valve_no, GString *description) {
+    assert(NULL != error);
+    assert(NULL != node);
+    assert(NULL != valve_no);
+    assert(NULL != description);
+
+    NodeIdentifier *parsed = parse_ip_address(&error->address);
+    memcpy(node, parsed, sizeof(*node));
+    g_free(parsed);
+
+    *valve_no = -1;
+    switch (error->msg.type) {
+        case HARD_ERROR_VALVE:
+            g_string_printf(description, "Hardware Error: %s",
+                error->msg.data.hardware_valve.message->str);
+            *valve_no = error->msg.data.hardware_valve.valve_no;
+            return true;
 
         case HARD_ERROR_OTHER:
-            g_string_append_printf(error_msg, "Hardware Error: %s",
+            g_string_printf(description, "Hardware Error: %s",
                 error->msg.data.hardware_other.message->str);
+            return true;
+
+        case SOFT_ERROR:
+            g_string_printf(description, "Software Error: %s",
+                error->msg.data.software.message->str);
+            return true;
+
+        default:
+            g_string_printf(description, "Unknown Error Type: %i",
+                error->msg.type);
+            return false;
+    }
+}
+
+// add_error and replay_error
+static bool insert_buffer_item(const BufferItem *error, const InsertKind kind) {
+    if (NULL == error) {
+        return false;
+    }
+
+    NodeIdentifier node;
+    int valve_no = -1;
+    GString *error_msg = g_string_new(NULL);
+    assert(NULL != error_msg);
+
+    const bool ret = decode_error(error, &node, &valve_no, error_msg)
+        && insert_error(node.rack_no, node.chassis_no, valve_no, error->recv_time, error_msg->str, true, false, 1, kind);
+
+    // errors are the only traffic from a node so receiving one shows it is alive
+    liveness_seen(node.rack_no, node.chassis_no, error->recv_time);
+
+    g_string_free(error_msg, TRUE);
+    return ret;
+}
+
+bool add_error(const BufferItem *error) {
+    return insert_buffer_item(error, INSERT_RECEIVED);
+}
+
+bool replay_error(const BufferItem *error) {
+    return insert_buffer_item(error, INSERT_REPLAYED);
+}
+
+// add a change to the node's connection history and running totals
+static bool store_liveness_change(const LivenessChange *change) {
+    GString *query = g_string_new(NULL);
+    assert(NULL != query);
+
+    const int up = change->up ? 1 : 0;
+    g_string_printf(query,
+        "INSERT INTO node_connections(node_id, change_time, up) \
+            SELECT id, %li, %i FROM nodes WHERE rack_no = %u AND chassis_no = %u;",
+        change->time, up, change->rack_no, change->chassis_no);
+
+    // the totals start at the node's first change
+    g_string_append_printf(query,
+        "INSERT OR IGNORE INTO node_uptime(node_id, first_change, last_change, up, up_seconds, down_seconds, flaps) \
+            SELECT id, %li, %li, %i, 0, 0, 0 FROM nodes WHERE rack_no = %u AND chassis_no = %u;",
+        change->time, change->time, up, change->rack_no, change->chassis_no);
+
+    // the time since the last change goes to whichever state the node was in
+    g_string_append_printf(query,
+        "UPDATE node_uptime SET \
+            up_seconds = up_seconds + CASE WHEN up = 1 THEN %li - last_change ELSE 0 END, \
+            down_seconds = down_seconds + CASE WHEN up = 1 THEN 0 ELSE %li - last_change END, \
+            flaps = flaps + CASE WHEN up = 1 AND %i = 0 THEN 1 ELSE 0 END, \
+            up = %i, \
+            last_change = %li \
+            WHERE node_id = (SELECT id FROM nodes WHERE rack_no = %u AND chassis_no = %u);",
+        change->time, change->time, up, up, change->time, change->rack_no, change->chassis_no);
+
+    bool ret = true;
+    char *errmsg = NULL;
+    if (SQLITE_OK != sqlite3_exec(db, query->str, NULL, NULL, &errmsg)) {
+        puts(errmsg);
+        sqlite3_free(errmsg);
+        ret = false;
+    }
+
+    g_string_free(query, TRUE);
+    return ret;
+}
+
+bool update_liveness(GSList *connected, const time_t now) {
+    for (GSList *item = connected; NULL != item; item = item->next) {
+        const struct sockaddr_in *address = item->data;
+        NodeIdentifier *node = parse_ip_address(&address->sin_addr);
+        liveness_connected(node->rack_no, node->chassis_no);
+        g_free(node);
+    }
+
+    GArray *changes = liveness_check(now);
+    if (0 == changes->len) {
+        g_array_unref(changes);
+        return true;
+    }
+
+    // all of the changes in one transaction
+    begin_batch();
+
+    bool ret = true;
+    for (guint i = 0; i < changes->len; i++) {
+        const LivenessChange *change = &g_array_index(changes, LivenessChange, i);
+        ret &= store_liveness_change(change);
+        if (!change->up) {
+            ret &= add_error_decoded(change->rack_no, change->chassis_no, -1, change->time, "Node not connected");
+        }
+    }
+
+    // all or nothing. If nothing was stored the next poll reports the same changes again
+    if (!ret) {
+        fail_batch();
+    }
+    if (!end_batch()) {
+        liveness_revert(changes);
+        ret = false;
+    }
 
-            ret = add_error_decoded(node->rack_no, node->chassis_no, -1, 
-                error->recv_time, error_msg->str);
-            break;
+    g_array_unref(changes);
+    return ret;
+}
 
-        case SOFT_ERROR:
-            g_string_append_printf(error_msg, "Software Error: %s",
-                error->msg.data.software.message->str);
+// the running totals from node_uptime, brought up to now
+static bool node_uptime_total(const unsigned int rack_no, const unsigned int chassis_no, const time_t now, NodeUptime *uptime) {
+    GString *query = g_string_new(NULL);
+    assert(NULL != query);
+    g_string_printf(query,
+        "SELECT first_change, last_change, up, up_seconds, down_seconds, flaps FROM node_uptime \
+            WHERE node_id = (SELECT id FROM nodes WHERE rack_no = %u AND chassis_no = %u);",
+        rack_no, chassis_no);
 
-            ret = add_error_decoded(node->rack_no, node->chassis_no, -1,
-                error->recv_time, error_msg->str);
-            break;
+    sqlite3_stmt *statement = NULL;
+    if (SQLITE_OK != sqlite3_prepare_v2(db, query->str, -1, &statement, NULL)) {
+        puts("Error constructing node_uptime query");
+        g_string_free(query, TRUE);
+        return false;
+    }
+    g_string_free(query, TRUE);
 
-        default:
-            g_string_append_printf(error_msg, "Unknown Error Type: %i",
-                error->msg.type);
+    const int status = sqlite3_step(statement);
+    if (SQLITE_ROW == status) {
+        const time_t last_change = sqlite3_column_int64(statement, 1);
+        const time_t open = (now > last_change) ? now - last_change : 0;
+        uptime->known = true;
+        uptime->since = sqlite3_column_int64(statement, 0);
+        uptime->up = (0 != sqlite3_column_int(statement, 2));
+        #pragma GCC diagnostic push
+        #pragma GCC diagnostic ignored "-Wsign-conversion"
+        uptime->up_seconds = sqlite3_column_int64(statement, 3) + (uptime->up ? open : 0);
+        uptime->down_seconds = sqlite3_column_int64(statement, 4) + (uptime->up ? 0 : open);
+        uptime->flaps = sqlite3_column_int(statement, 5);
+        #pragma GCC diagnostic pop
+    }
+    sqlite3_finalize(statement);
+
+    if ((SQLITE_ROW != status) && (SQLITE_DONE != status)) {
+        puts("Bad sqlite3_step node_uptime");
+        return false;
+    }
+    return true;
+}
+
+bool node_uptime(const unsigned int rack_no, const unsigned int chassis_no, const time_t since, const time_t until,
+        NodeUptime *uptime) {
+    assert(NULL != uptime);
+    memset(uptime, 0, sizeof(NodeUptime));
+    uptime->since = since;
+    uptime->until = until;
+
+    if (0 == since) {
+        return node_uptime_total(rack_no, chassis_no, until, uptime);
+    }
+
+    // the state going into the window then each change in it, from the index
+    GString *query = g_string_new(NULL);
+    assert(NULL != query);
+    g_string_printf(query,
+        "SELECT change_time, up FROM ( \
+            SELECT * FROM (SELECT change_time, up FROM node_connections \
+                WHERE node_id = (SELECT id FROM nodes WHERE rack_no = %u AND chassis_no = %u) AND change_time < %li \
+                ORDER BY change_time DESC LIMIT 1) \
+            UNION ALL \
+            SELECT change_time, up FROM node_connections \
+                WHERE node_id = (SELECT id FROM nodes WHERE rack_no = %u AND chassis_no = %u) \
+                    AND change_time >= %li AND change_time < %li) \
+            ORDER BY change_time;",
+        rack_no, chassis_no, since, rack_no, chassis_no, since, until);
+
+    sqlite3_stmt *statement = NULL;
+    if (SQLITE_OK != sqlite3_prepare_v2(db, query->str, -1, &statement, NULL)) {
+        puts("Error constructing node_uptime query");
+        g_string_free(query, TRUE);
+        return false;
+    }
+    g_string_free(query, TRUE);
+
+    time_t last_change = since;
+    int status = SQLITE_ERROR;
+    while (SQLITE_ROW == (status = sqlite3_step(statement))) {
+        const time_t change_time = MAX(since, (time_t) sqlite3_column_int64(statement, 0));
+        const bool up = (0 != sqlite3_column_int(statement, 1));
+
+        if (uptime->known) {
+            #pragma GCC diagnostic push
+            #pragma GCC diagnostic ignored "-Wsign-conversion"
+            if (uptime->up) {
+                uptime->up_seconds += change_time - last_change;
+            } else {
+                uptime->down_seconds += change_time - last_change;
+            }
+            #pragma GCC diagnostic pop
+            if (uptime->up && !up) {
+                uptime->flaps += 1;
+            }
+        }
+
+        uptime->known = true;
+        uptime->up = up;
+        last_change = change_time;
+    }
+    sqlite3_finalize(statement);
+    if (SQLITE_DONE != status) {
+        puts("Bad sqlite3_step node_uptime");
+        return false;
+    }
+
+    if (uptime->known && (until > last_change)) {
+        #pragma GCC diagnostic push
+        #pragma GCC diagnostic ignored "-Wsign-conversion"
+        if (uptime->up) {
+            uptime->up_seconds += until - last_change;
+        } else {
+            uptime->down_seconds += until - last_change;
+        }
+        #pragma GCC diagnostic pop
+    }
+
+    return true;
+}
+
+GList *node_connection_history(const unsigned int rack_no, const unsigned int chassis_no, const unsigned int limit) {
+    GString *query = g_string_new(NULL);
+    assert(NULL != query);
+    g_string_printf(query,
+        "SELECT change_time, up FROM node_connections \
+            WHERE node_id = (SELECT id FROM nodes WHERE rack_no = %u AND chassis_no = %u) \
+            ORDER BY change_time DESC LIMIT %u;",
+        rack_no, chassis_no, limit);
+
+    sqlite3_stmt *statement = NULL;
+    if (SQLITE_OK != sqlite3_prepare_v2(db, query->str, -1, &statement, NULL)) {
+        puts("Error constructing node_connection_history query");
+        g_string_free(query, TRUE);
+        return NULL;
+    }
+    g_string_free(query, TRUE);
+
+    GList *changes = NULL;
+    int status = SQLITE_ERROR;
+    while (SQLITE_ROW == (status = sqlite3_step(statement))) {
+        LivenessChange *change = g_malloc(sizeof(LivenessChange));
+        assert(NULL != change);
+        change->rack_no = rack_no;
+        change->chassis_no = chassis_no;
+        change->time = sqlite3_column_int64(statement, 0);
+        change->up = (0 != sqlite3_column_int(statement, 1));
+        changes = g_list_prepend(changes, change);
+    }
+    sqlite3_finalize(statement);
+    if (SQLITE_DONE != status) {
+        puts("Bad sqlite3_step node_connection_history");
+        g_list_free_full(changes, g_free);
+        return NULL;
+    }
+
+    return g_list_reverse(changes);
+}
+
+// the set_id of the set's rows in node_set_members, storing them first if they aren't there. -1 on error
+static gint store_node_set(const char *text) {
+    const GArray *members = node_set_members(text);
+    if (NULL == members) {
+        return -1;
+    }
+
+    g_rec_mutex_lock(&batch_lock);
+
+    if (NULL == node_set_ids) {
+        node_set_ids = g_hash_table_new(g_direct_hash, g_direct_equal);
+    }
+    gint set_id = GPOINTER_TO_INT(g_hash_table_lookup(node_set_ids, text));
+
+    if (0 == set_id) {
+        set_id = next_node_set_id;
+        sqlite3_stmt *statement = NULL;
+        if (SQLITE_OK != sqlite3_prepare_v2(db, "INSERT OR IGNORE INTO temp.node_set_members (set_id, rack_no, chassis_no) VALUES (?1, ?2, ?3);",
+                -1, &statement, NULL)) {
+            puts("Error constructing store_node_set query");
+            g_rec_mutex_unlock(&batch_lock);
+            return -1;
+        }
+
+        bool success = true;
+        for (guint i = 0; success && (i < members->len); i++) {
+            const NodeIdentifier *member = &g_array_index(members, NodeIdentifier, i);
+            sqlite3_reset(statement);
+            success = (SQLITE_OK == sqlite3_bind_int(statement, 1, set_id))
+                && (SQLITE_OK == sqlite3_bind_int64(statement, 2, member->rack_no))
+                && (SQLITE_OK == sqlite3_bind_int64(statement, 3, member->chassis_no))
+                && (SQLITE_DONE == sqlite3_step(statement));
+        }
+        sqlite3_finalize(statement);
+
+        if (!success) {
+            puts("Bad sqlite3_step store_node_set");
+            g_rec_mutex_unlock(&batch_lock);
+            return -1;
+        }
+        next_node_set_id++;
+        g_hash_table_insert(node_set_ids, (gpointer) text, GINT_TO_POINTER(set_id));
+    }
+
+    g_rec_mutex_unlock(&batch_lock);
+    return set_id;
+}
+
+// append "AND column IN (ids of the set's nodes)" to query
+static bool append_node_set_condition(GString *query, const char *column, const char *text) {
+    const gint set_id = store_node_set(text);
+    if (set_id < 0) {
+        return false;
+    }
+
+    g_string_append_printf(query, "AND %s IN (SELECT member_nodes.id \
+            FROM temp.node_set_members AS members \
+            INNER JOIN nodes AS member_nodes \
+            ON member_nodes.rack_no = members.rack_no AND member_nodes.chassis_no = members.chassis_no \
+            WHERE members.set_id = %i)", column, set_id);
+
+    return true;
+}
+
+bool rollup_clickable(const Clickable *search, const time_t until, const unsigned int bucket_seconds,
+        const unsigned int num_buckets, guint *counts) {
+    assert(NULL != search);
+    assert(NULL != counts);
+    assert(bucket_seconds > 0);
+    memset(counts, 0, num_buckets * sizeof(guint));
+
+    // the last bucket is the one containing until
+    const gint64 end = until - until % bucket_seconds + bucket_seconds;
+    const gint64 start = end - (gint64) bucket_seconds * num_buckets;
+
+    GString *query = g_string_new(NULL);
+    assert(NULL != query);
+    g_string_printf(query, "SELECT error_rollup.bucket, SUM(error_rollup.count) \
+                    FROM error_rollup \
+                    INNER JOIN nodes \
+                    ON error_rollup.node_id = nodes.id \
+                    WHERE error_rollup.bucket >= %li AND error_rollup.bucket < %li ", start, end);
+    if (!show_disabled) {
+        g_string_append(query, "AND nodes.enabled = 1 ");
+    }
+
+    switch (search->type) {
+        case ALL:
+            break;
+        case RACK:
+            g_string_append_printf(query, "AND nodes.rack_no = %i", search->rack_num);
+            break;
+        case CHASSIS:
+            g_string_append_printf(query, "AND nodes.rack_no = %i AND nodes.chassis_no = %i", search->rack_num, search->chassis_num);
+            break;
+        case VALVE:
+            g_string_append_printf(query, "AND nodes.rack_no = %i AND nodes.chassis_no = %i AND error_rollup.valve_no = %i",
+                search->rack_num, search->chassis_num, search->valve_num);
             break;
+        case NODE_SET:
+            if (!append_node_set_condition(query, "error_rollup.node_id", search->text)) {
+                g_string_free(query, TRUE);
+                return false;
+            }
+            break;
+        default:
+            // the rollup doesn't know about descriptions
+            g_string_free(query, TRUE);
+            return false;
     }
+    g_string_append(query, " GROUP BY error_rollup.bucket;");
 
-    g_free(node);
-    g_string_free(error_msg, TRUE);
-    return ret;
+    sqlite3_stmt *statement = NULL;
+    if (SQLITE_OK != sqlite3_prepare_v2(db, query->str, -1, &statement, NULL)) {
+        puts("Error constructing rollup_clickable query");
+        g_string_free(query, TRUE);
+        return false;
+    }
+    g_string_free(query, TRUE);
+
+    int status = SQLITE_ERROR;
+    while (SQLITE_ROW == (status = sqlite3_step(statement))) {
+        // coarser buckets count towards the bucket their start is in
+        const gint64 index = (sqlite3_column_int64(statement, 0) - start) / bucket_seconds;
+        if ((index >= 0) && (index < num_buckets)) {
+            counts[index] += (guint) sqlite3_column_int64(statement, 1);
+        }
+    }
+    sqlite3_finalize(statement);
+
+    if (SQLITE_DONE != status) {
+        puts("Bad sqlite3_step rollup_clickable");
+        return false;
+    }
+
+    return true;
 }
 
-void free_search_result(gpointer res) {
-    if (NULL == res) {
-        return;
+// turn what the user typed into an FTS5 query. Every word must appear. A word ending in * matches words starting with it.
+// Each word is quoted so nothing typed can be taken as query syntax. NULL if there are no words
+static GString *fts_query(const char *text) {
+    assert(NULL != text);
+
+    GString *query = g_string_new(NULL);
+    assert(NULL != query);
+
+    gchar **words = g_strsplit_set(text, " \t\n", -1);
+    assert(NULL != words);
+    for (gchar **word = words; NULL != *word; word++) {
+        const bool prefix = g_str_has_suffix(*word, "*");
+        if (prefix) {
+            (*word)[strlen(*word) - 1] = '\0';
+        }
+        if ('\0' == **word) {
+            continue;
+        }
+
+        GString *quoted = fix_string(*word);
+        g_string_append_printf(query, "%s\"%s\"%s", (0 == query->len) ? "" : " ", quoted->str, prefix ? "*" : "");
+        g_string_free(quoted, TRUE);
     }
+    g_strfreev(words);
 
-    SearchResult *result = (SearchResult *) res;
-    
-    g_free(result->message);
-    g_free(result);
+    if (0 == query->len) {
+        g_string_free(query, TRUE);
+        return NULL;
+    }
+
+    return query;
 }
 
-static GString *clickable_query(const Clickable *search, const char* fields) {
+// query for fields of the errors matching search. Leaves out disabled items if hide_disabled and acknowledged errors
+// if hide_acked
+static GString *clickable_query(const Clickable *search, const char* fields, const bool hide_disabled, const bool hide_acked) {
     if (NULL == search) {
         return NULL;
     }
@@ -343,9 +2271,14 @@ static GString *clickable_query(const Clickable *search, const char* fields) {
     g_string_append_printf(query, " %s \
                     FROM errors \
                     INNER JOIN nodes \
-                    ON errors.node_id = nodes.id ", fields); 
-    if (!show_disabled) {
-        g_string_append(query, "WHERE nodes.enabled = 1 AND errors.enabled = 1 "); 
+                    ON errors.node_id = nodes.id \
+                    WHERE 1 ", fields); 
+    if (hide_disabled) {
+        g_string_append(query, "AND nodes.enabled = 1 AND errors.enabled = 1 "); 
+    }
+    if (hide_acked) {
+        // uses the errors_unacked_by_time index
+        g_string_append(query, "AND errors.acked = 0 ");
     }
 
     switch(search->type) {
@@ -360,92 +2293,279 @@ static GString *clickable_query(const Clickable *search, const char* fields) {
         case VALVE:
             g_string_append_printf(query, "AND nodes.rack_no = %i AND nodes.chassis_no = %i AND errors.valve_no = %i", search->rack_num, search->chassis_num, search->valve_num);
             break;
+        case SEARCH: {
+            GString *match = (search_available && (NULL != search->text)) ? fts_query(search->text) : NULL;
+            if (NULL == match) {
+                g_string_free(query, TRUE);
+                return NULL;
+            }
+
+            // %Q quotes the match string for SQL
+            char *condition = sqlite3_mprintf("AND errors.id IN (SELECT rowid FROM errors_fts WHERE errors_fts MATCH %Q)", match->str);
+            assert(NULL != condition);
+            g_string_append(query, condition);
+            sqlite3_free(condition);
+            g_string_free(match, TRUE);
+            break;
+        }
+        case NODE_SET:
+            // one query for every member. Uses the errors_by_node_time index
+            if (!append_node_set_condition(query, "errors.node_id", search->text)) {
+                g_string_free(query, TRUE);
+                return NULL;
+            }
+            break;
         default:
             g_string_free(query, TRUE);
             g_print("I don't know how to search for that!\n");
             return NULL;
     }
 
+    // time range. Uses the errors_by_time or errors_by_node_time index
+    time_t since = 0;
+    time_t until = 0;
+    clickable_time_bounds(search, time(NULL), &since, &until);
+    if (0 != since) {
+        g_string_append_printf(query, " AND errors.recv_time >= %li", since);
+    }
+    if (0 != until) {
+        g_string_append_printf(query, " AND errors.recv_time < %li", until);
+    }
+
     return query;
 }
 
-GList *search_clickable(const Clickable *search) {
-    GString *query = clickable_query(search, "errors.recv_time, errors.description, nodes.rack_no, nodes.chassis_no, errors.valve_no, nodes.enabled, errors.enabled, errors.id");
-    if (NULL == query) {
-        return NULL;
-    }
-    g_string_append(query, " ORDER BY errors.recv_time;");
+static void free_filter_statements(gpointer data) {
+    FilterStatements *statements = data;
+    sqlite3_finalize(statements->search);
+    sqlite3_finalize(statements->count);
+    g_free(statements);
+}
 
-    GList *results = NULL; // empty list
+static sqlite3_stmt *prepare_filter_query(const Filter *filter, const char *fields, const char *order) {
+    char *condition = filter_sql(filter, FILTER_FIRST_PARAM);
+    assert(NULL != condition);
+
+    GString *query = g_string_new(NULL);
+    assert(NULL != query);
+    g_string_printf(query, "SELECT %s \
+                    FROM errors \
+                    INNER JOIN nodes \
+                    ON errors.node_id = nodes.id \
+                    WHERE (?1 OR (nodes.enabled = 1 AND errors.enabled = 1)) \
+                    AND errors.recv_time >= ?2 AND errors.recv_time < ?3 AND errors.id <= ?4 \
+                    AND (?5 OR errors.acked = 0) \
+                    AND %s%s;", fields, condition, order);
+    g_free(condition);
 
     sqlite3_stmt *statement = NULL;
     if (SQLITE_OK != sqlite3_prepare_v2(db, query->str, -1, &statement, NULL)) {
-        g_string_free(query, TRUE);
-        return NULL;
+        puts("Error constructing filter query");
+        statement = NULL;
     }
     g_string_free(query, TRUE);
 
+    return statement;
+}
+
+// will disabled errors be shown on this tab?
+static bool clickable_show_disabled(const Clickable *search) {
+    if (FILTER == search->type) {
+        const Filter *filter = filter_get(search->text);
+        return show_disabled && (NULL != filter) && !filter_enabled_only(filter);
+    }
+    return show_disabled;
+}
+
+// the prepared statement for a FILTER with its parameters bound. Call with batch_lock held and reset it afterwards
+// rather than finalizing it. NULL on error
+static sqlite3_stmt *filter_statement(const Clickable *search, const bool count, const gint64 max_id) {
+    const Filter *filter = filter_get(search->text);
+    if (NULL == filter) {
+        return NULL;
+    }
+
+    if (NULL == filter_statements) {
+        filter_statements = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, free_filter_statements);
+        assert(NULL != filter_statements);
+    }
+
+    FilterStatements *statements = g_hash_table_lookup(filter_statements, filter);
+    if (NULL == statements) {
+        statements = g_malloc(sizeof(FilterStatements));
+        assert(NULL != statements);
+        statements->search = prepare_filter_query(filter, SEARCH_FIELDS, " ORDER BY errors.recv_time");
+        statements->count = prepare_filter_query(filter, "Count(*)", "");
+        if ((NULL == statements->search) || (NULL == statements->count)) {
+            free_filter_statements(statements);
+            return NULL;
+        }
+        g_hash_table_insert(filter_statements, (gpointer) filter, statements);
+    }
+
+    sqlite3_stmt *statement = count ? statements->count : statements->search;
+    sqlite3_reset(statement);
+    sqlite3_clear_bindings(statement);
+
+    time_t since = 0;
+    time_t until = 0;
+    clickable_time_bounds(search, time(NULL), &since, &until);
+
+    if ((SQLITE_OK != sqlite3_bind_int(statement, 1, clickable_show_disabled(search)))
+            || (SQLITE_OK != sqlite3_bind_int64(statement, 2, since))
+            || (SQLITE_OK != sqlite3_bind_int64(statement, 3, (0 == until) ? G_MAXINT64 : until))
+            || (SQLITE_OK != sqlite3_bind_int64(statement, 4, (max_id < 0) ? G_MAXINT64 : max_id))
+            || (SQLITE_OK != sqlite3_bind_int(statement, 5, show_acked))
+            || !filter_bind(filter, statement, FILTER_FIRST_PARAM)) {
+        puts("Error binding filter query");
+        return NULL;
+    }
+
+    return statement;
+}
+
+// step through statement collecting SEARCH_FIELDS into a GList of SearchResults. NULL on error
+static GList *collect_search_results(sqlite3_stmt *statement) {
+    GList *results = NULL; // empty list
+
     int status = SQLITE_ERROR;
     do {
         status = sqlite3_step(statement);
         if (SQLITE_DONE == status) {
             break;
         } else if (SQLITE_ROW != status) {
-            assert(SQLITE_OK == sqlite3_finalize(statement));
             puts("Bad sqlite3_step");
             g_list_free_full(results, free_search_result);
             return NULL;
         }
         // status == SQL_ROW so get the data
-        SearchResult *res = malloc(sizeof(SearchResult));
-        assert(NULL != res);
-
-        time_t recv_time = sqlite3_column_int64(statement, 0);
-        struct tm *time = localtime(&recv_time);
-        assert(NULL != time);
-        char *time_str = asctime(time);
-        assert(NULL != time_str);
-
-        GString *msg = g_string_new(time_str);
-        assert(NULL != msg);
-        //g_free(time_str);
-
-        // remove the year and newline from the time string
-        g_string_truncate(msg, msg->len - 5);
+        int node_enabled = sqlite3_column_int(statement, 5);
+        int error_enabled = sqlite3_column_int(statement, 6);
 
         #pragma GCC diagnostic push
+        #pragma GCC diagnostic ignored "-Wsign-conversion"
         #pragma GCC diagnostic ignored "-Wpointer-sign"
-        g_string_append(msg, sqlite3_column_text(statement, 1));
+        SearchResult *res = new_search_result(sqlite3_column_int64(statement, 0), sqlite3_column_text(statement, 1),
+            sqlite3_column_int(statement, 2), sqlite3_column_int(statement, 3), sqlite3_column_int(statement, 4),
+            1 == (node_enabled & error_enabled), sqlite3_column_int(statement, 7));
         #pragma GCC diagnostic pop
-        res->message = msg->str;
-        g_string_free(msg, FALSE);
+        res->acked = (0 != sqlite3_column_int(statement, 8));
 
-        #pragma GCC diagnostic push
-        #pragma GCC diagnostic ignored "-Wsign-conversion"
-        res->rack_no = sqlite3_column_int(statement, 2);
-        res->chassis_no = sqlite3_column_int(statement, 3);
-        #pragma GCC diagnostic pop
-        res->valve_no = sqlite3_column_int(statement, 4);
+        results = g_list_prepend(results, res); // backwards so that the list ends up in order
+    } while (true);
 
-        int node_enabled = sqlite3_column_int(statement, 5);
-        int error_enabled = sqlite3_column_int(statement, 6);
-        res->enabled = 1 == (node_enabled & error_enabled);
+    return g_list_reverse(results);
+}
+
+// search the database for errors with an id no larger than max_id. -1 for no limit
+static GList *search_database(const Clickable *search, const gint64 max_id) {
+    if (FILTER == search->type) {
+        g_rec_mutex_lock(&batch_lock);
+        sqlite3_stmt *statement = filter_statement(search, false, max_id);
+        GList *results = (NULL == statement) ? NULL : collect_search_results(statement);
+        if (NULL != statement) {
+            sqlite3_reset(statement);
+        }
+        g_rec_mutex_unlock(&batch_lock);
+        return results;
+    }
+
+    GString *query = clickable_query(search, SEARCH_FIELDS, !show_disabled, !show_acked);
+    if (NULL == query) {
+        return NULL;
+    }
+    if (max_id >= 0) {
+        g_string_append_printf(query, " AND errors.id <= %li", max_id);
+    }
+    g_string_append(query, " ORDER BY errors.recv_time;");
+
+    sqlite3_stmt *statement = NULL;
+    if (SQLITE_OK != sqlite3_prepare_v2(db, query->str, -1, &statement, NULL)) {
+        g_string_free(query, TRUE);
+        return NULL;
+    }
+    g_string_free(query, TRUE);
+
+    GList *results = collect_search_results(statement);
+    sqlite3_finalize(statement);
+
+    return results;
+}    
+
+// is a before b? Implements GCompareFunc for SearchResults
+static gint compare_search_results(gconstpointer a, gconstpointer b) {
+    const SearchResult *A = a;
+    const SearchResult *B = b;
+
+    if (A->recv_time != B->recv_time) {
+        return (A->recv_time < B->recv_time) ? -1 : 1;
+    }
+    return (A->id < B->id) ? -1 : (A->id > B->id);
+}
+
+// merge two lists of SearchResults ordered by time. Takes ownership of both
+static GList *merge_search_results(GList *a, GList *b) {
+    GList *results = NULL;
+
+    while ((NULL != a) && (NULL != b)) {
+        GList **from = (compare_search_results(a->data, b->data) <= 0) ? &a : &b;
+        GList *link = *from;
+        *from = g_list_remove_link(*from, link);
+        results = g_list_concat(link, results); // backwards for now
+    }
+
+    return g_list_concat(g_list_reverse(results), (NULL != a) ? a : b);
+}
+
+GList *search_clickable(const Clickable *search) {
+    if (NULL == search) {
+        return NULL;
+    }
+
+    // the hot tier does not know about the full text index
+    if (!hot_tier_enabled() || (SEARCH == search->type)) {
+        return search_database(search, -1);
+    }
+    if ((FILTER == search->type) && (NULL == filter_get(search->text))) {
+        return NULL;
+    }
+
+    // no errors may come or go between asking the database and asking the hot tier
+    g_rec_mutex_lock(&batch_lock);
 
-        res->id = sqlite3_column_int(statement, 7);
+    // older errors are only in the database
+    const gint64 floor = hot_tier_floor();
+    GList *older = (floor > 0) ? search_database(search, floor) : NULL;
+    GList *recent = hot_tier_search(search, clickable_show_disabled(search), show_acked);
 
-        results = g_list_append(results, res);
-    } while (true);
+    g_rec_mutex_unlock(&batch_lock);
 
-    assert(SQLITE_OK == sqlite3_finalize(statement));
+    return merge_search_results(older, recent);
+}
 
-    return results;
-}    
+// count errors in the database with an id no larger than max_id. -1 for no limit
+static int count_database(const Clickable *search, const gint64 max_id) {
+    if (FILTER == search->type) {
+        g_rec_mutex_lock(&batch_lock);
+        sqlite3_stmt *statement = filter_statement(search, true, max_id);
+        int count = -1;
+        if (NULL != statement) {
+            if (SQLITE_ROW == sqlite3_step(statement)) {
+                count = sqlite3_column_int(statement, 0);
+            }
+            sqlite3_reset(statement);
+        }
+        g_rec_mutex_unlock(&batch_lock);
+        return count;
+    }
 
-int count_clickable(const Clickable *search) {
-    GString *query = clickable_query(search, "Count(*)");
+    GString *query = clickable_query(search, "Count(*)", !show_disabled, !show_acked);
     if (NULL == query) {
         return -1;
     }
+    if (max_id >= 0) {
+        g_string_append_printf(query, " AND errors.id <= %li", max_id);
+    }
     g_string_append_c(query, ';');
 
     sqlite3_stmt *statement = NULL;
@@ -467,6 +2587,29 @@ int count_clickable(const Clickable *search) {
     return count;
 }
 
+int count_clickable(const Clickable *search) {
+    if (NULL == search) {
+        return -1;
+    }
+
+    if (!hot_tier_enabled() || (SEARCH == search->type)) {
+        return count_database(search, -1);
+    }
+    if ((FILTER == search->type) && (NULL == filter_get(search->text))) {
+        return -1;
+    }
+
+    g_rec_mutex_lock(&batch_lock);
+
+    const gint64 floor = hot_tier_floor();
+    const int older = (floor > 0) ? count_database(search, floor) : 0;
+    const int recent = hot_tier_count(search, clickable_show_disabled(search), show_acked);
+
+    g_rec_mutex_unlock(&batch_lock);
+
+    return (older < 0) ? -1 : older + recent;
+}
+
 GList *list_racks(void) {
     const char* query = "SELECT DISTINCT rack_no FROM nodes;";
 
@@ -575,7 +2718,7 @@ GSList *list_nodes(void) {
 }
 
 bool error_toggle_disabled(const uintptr_t id) {
-    assert(SQLITE_OK == sqlite3_exec(db, "begin transaction;", NULL, NULL, NULL));
+    begin_batch();
 
     // get the current state of the error
     GString *query = g_string_new(NULL);
@@ -585,7 +2728,7 @@ bool error_toggle_disabled(const uintptr_t id) {
     sqlite3_stmt *statement = NULL;
     if (SQLITE_OK != sqlite3_prepare_v2(db, query->str, -1, &statement, NULL)) {
         g_string_free(query, TRUE);
-        assert(SQLITE_OK == sqlite3_exec(db, "commit;", NULL, NULL, NULL));
+        assert(true == end_batch());
         return false;
     }
     g_string_free(query, TRUE);
@@ -599,7 +2742,7 @@ bool error_toggle_disabled(const uintptr_t id) {
         } else if (SQLITE_ROW != status) {
             assert(SQLITE_OK == sqlite3_finalize(statement));
             puts("Bad sqlite step toggle_error_disabled");
-            assert(SQLITE_OK == sqlite3_exec(db, "commit;", NULL, NULL, NULL));
+            assert(true == end_batch());
             return false;
         }
         // status == SQL_ROW
@@ -609,7 +2752,7 @@ bool error_toggle_disabled(const uintptr_t id) {
 
     if (-1 == enabled) {
         puts("Error not found!");
-        assert(SQLITE_OK == sqlite3_exec(db, "commit;", NULL, NULL, NULL));
+        assert(true == end_batch());
         return false;
     }
 
@@ -618,13 +2761,15 @@ bool error_toggle_disabled(const uintptr_t id) {
     g_string_sprintf(update, "UPDATE errors SET ENABLED = %i WHERE id = %li;", 1 - enabled, id);
     assert(SQLITE_OK == sqlite3_exec(db, update->str, NULL, NULL, NULL));
     g_string_free(update, TRUE);
+    hot_tier_set_error_enabled((gint64) id, 0 == enabled);
+    g_atomic_int_inc(&errors_enabled_changes);
 
-    assert(SQLITE_OK == sqlite3_exec(db, "commit;", NULL, NULL, NULL));
+    assert(true == end_batch());
     return true;
 }
 
 bool node_toggle_disabled(const unsigned long int rack_no, const unsigned long int chassis_no) {
-    assert(SQLITE_OK == sqlite3_exec(db, "begin transaction;", NULL, NULL, NULL));
+    begin_batch();
 
     // get the current state of the node
     GString *query = g_string_new(NULL);
@@ -634,7 +2779,7 @@ bool node_toggle_disabled(const unsigned long int rack_no, const unsigned long i
     sqlite3_stmt *statement = NULL;
     if (SQLITE_OK != sqlite3_prepare_v2(db, query->str, -1, &statement, NULL)) {
         g_string_free(query, TRUE);
-        assert(SQLITE_OK == sqlite3_exec(db, "commit;", NULL, NULL, NULL));
+        assert(true == end_batch());
         return false;
     }
     g_string_free(query, TRUE);
@@ -648,7 +2793,7 @@ bool node_toggle_disabled(const unsigned long int rack_no, const unsigned long i
         } else if (SQLITE_ROW != status) {
             assert(SQLITE_OK == sqlite3_finalize(statement));
             puts("Bad sqlite step toggle_node_disabled");
-            assert(SQLITE_OK == sqlite3_exec(db, "commit;", NULL, NULL, NULL));
+            assert(true == end_batch());
             return false;
         }
         // status == SQL_ROW
@@ -658,7 +2803,7 @@ bool node_toggle_disabled(const unsigned long int rack_no, const unsigned long i
 
     if (-1 == enabled) {
         puts("Node not found!");
-        assert(SQLITE_OK == sqlite3_exec(db, "commit;", NULL, NULL, NULL));
+        assert(true == end_batch());
         return false;
     }
 
@@ -667,7 +2812,475 @@ bool node_toggle_disabled(const unsigned long int rack_no, const unsigned long i
     g_string_sprintf(update, "UPDATE nodes SET enabled = %i WHERE rack_no = %li AND chassis_no = %li;", 1 - enabled, rack_no, chassis_no);
     assert(SQLITE_OK == sqlite3_exec(db, update->str, NULL, NULL, NULL));
     g_string_free(update, TRUE);
+    #pragma GCC diagnostic push
+    #pragma GCC diagnostic ignored "-Wconversion"
+    hot_tier_set_node_enabled(rack_no, chassis_no, 0 == enabled);
+    node_activity_set_node(rack_no, chassis_no, 0 == enabled);
+    topology_set_node(rack_no, chassis_no, 0 == enabled);
+    #pragma GCC diagnostic pop
+
+    assert(true == end_batch());
+    return true;
+}
+
+// bring the hot tier in line with set_errors_enabled. The hot tier can't match SEARCH itself so those errors are
+// looked up in the database
+static bool hot_tier_sync_enabled(const Clickable *search, const bool enabled) {
+    if (!hot_tier_enabled()) {
+        return true;
+    }
+    if (SEARCH != search->type) {
+        hot_tier_set_enabled_matching(search, enabled);
+        return true;
+    }
+
+    GString *query = clickable_query(search, "errors.id", false, false);
+    if (NULL == query) {
+        return false;
+    }
+    g_string_append_printf(query, " AND errors.id > %li;", hot_tier_floor());
+
+    sqlite3_stmt *statement = NULL;
+    if (SQLITE_OK != sqlite3_prepare_v2(db, query->str, -1, &statement, NULL)) {
+        puts("Error constructing hot_tier_sync_enabled query");
+        g_string_free(query, TRUE);
+        return false;
+    }
+    g_string_free(query, TRUE);
+
+    int status = SQLITE_ERROR;
+    while (SQLITE_ROW == (status = sqlite3_step(statement))) {
+        hot_tier_set_error_enabled(sqlite3_column_int64(statement, 0), enabled);
+    }
+    assert(SQLITE_OK == sqlite3_finalize(statement));
+
+    if (SQLITE_DONE != status) {
+        puts("Bad sqlite3_step hot_tier_sync_enabled");
+        return false;
+    }
+
+    return true;
+}
+
+// a statement for every error matching search whatever its state, with its parameters bound: statement is a format
+// with a %s for a query selecting the errors' ids. NULL on error
+static sqlite3_stmt *matching_statement(const Clickable *search, const char *statement_format) {
+    GString *query = g_string_new(NULL);
+    assert(NULL != query);
+    const Filter *filter = NULL;
+
+    if (FILTER == search->type) {
+        filter = filter_get(search->text);
+        if (NULL == filter) {
+            g_string_free(query, TRUE);
+            return NULL;
+        }
+
+        // the same parameters as prepare_filter_query
+        char *condition = filter_sql(filter, FILTER_FIRST_PARAM);
+        assert(NULL != condition);
+        GString *matching = g_string_new(NULL);
+        assert(NULL != matching);
+        g_string_printf(matching, "SELECT errors.id \
+                        FROM errors \
+                        INNER JOIN nodes \
+                        ON errors.node_id = nodes.id \
+                        WHERE errors.recv_time >= ?2 AND errors.recv_time < ?3 AND errors.id <= ?4 \
+                        AND %s", condition);
+        g_free(condition);
+        g_string_printf(query, statement_format, matching->str);
+        g_string_free(matching, TRUE);
+    } else {
+        GString *matching = clickable_query(search, "errors.id", false, false);
+        if (NULL == matching) {
+            g_string_free(query, TRUE);
+            return NULL;
+        }
+        g_string_printf(query, statement_format, matching->str);
+        g_string_free(matching, TRUE);
+    }
+
+    sqlite3_stmt *statement = NULL;
+    if (SQLITE_OK != sqlite3_prepare_v2(db, query->str, -1, &statement, NULL)) {
+        puts("Error constructing matching_statement query");
+        g_string_free(query, TRUE);
+        return NULL;
+    }
+    g_string_free(query, TRUE);
+
+    if (NULL != filter) {
+        time_t since = 0;
+        time_t until = 0;
+        clickable_time_bounds(search, time(NULL), &since, &until);
+
+        if ((SQLITE_OK != sqlite3_bind_int64(statement, 2, since))
+                || (SQLITE_OK != sqlite3_bind_int64(statement, 3, (0 == until) ? G_MAXINT64 : until))
+                || (SQLITE_OK != sqlite3_bind_int64(statement, 4, G_MAXINT64))
+                || !filter_bind(filter, statement, FILTER_FIRST_PARAM)) {
+            puts("Error binding matching_statement query");
+            sqlite3_finalize(statement);
+            return NULL;
+        }
+    }
+
+    return statement;
+}
+
+int set_errors_enabled(const Clickable *search, const bool enabled) {
+    if (NULL == search) {
+        return -1;
+    }
+
+    begin_batch();
+
+    sqlite3_stmt *statement = matching_statement(search, enabled
+        ? "UPDATE errors SET enabled = 1 WHERE enabled != 1 AND id IN (%s);"
+        : "UPDATE errors SET enabled = 0 WHERE enabled != 0 AND id IN (%s);");
+    if (NULL == statement) {
+        assert(true == end_batch());
+        return -1;
+    }
+
+    const int status = sqlite3_step(statement);
+    const int changes = sqlite3_changes(db);
+    assert(SQLITE_OK == sqlite3_finalize(statement));
+    if (SQLITE_DONE != status) {
+        puts("Bad sqlite3_step set_errors_enabled");
+        assert(true == end_batch());
+        return -1;
+    }
+
+    const bool synced = hot_tier_sync_enabled(search, enabled);
+    g_atomic_int_inc(&errors_enabled_changes);
+
+    assert(true == end_batch());
+    return synced ? changes : -1;
+}
+
+// SQL condition over the nodes table for the nodes in search. NULL if search isn't about nodes
+static GString *nodes_condition(const Clickable *search) {
+    GString *condition = g_string_new("1 ");
+    assert(NULL != condition);
+
+    switch (search->type) {
+        case ALL:
+            break;
+        case RACK:
+            g_string_append_printf(condition, "AND rack_no = %u", search->rack_num);
+            break;
+        case CHASSIS:
+        case VALVE:
+            g_string_append_printf(condition, "AND rack_no = %u AND chassis_no = %u", search->rack_num, search->chassis_num);
+            break;
+        case NODE_SET:
+            if (!append_node_set_condition(condition, "id", search->text)) {
+                g_string_free(condition, TRUE);
+                return NULL;
+            }
+            break;
+        default:
+            g_string_free(condition, TRUE);
+            return NULL;
+    }
+
+    return condition;
+}
+
+int set_nodes_enabled(const Clickable *search, const bool enabled) {
+    if (NULL == search) {
+        return -1;
+    }
+
+    begin_batch();
+
+    GString *condition = nodes_condition(search);
+    if (NULL == condition) {
+        assert(true == end_batch());
+        return -1;
+    }
+
+    // which nodes will change, for the in-memory models
+    GString *query = g_string_new(NULL);
+    assert(NULL != query);
+    g_string_printf(query, "SELECT rack_no, chassis_no FROM nodes WHERE enabled != %i AND %s;", enabled, condition->str);
+
+    sqlite3_stmt *statement = NULL;
+    if (SQLITE_OK != sqlite3_prepare_v2(db, query->str, -1, &statement, NULL)) {
+        puts("Error constructing set_nodes_enabled query");
+        g_string_free(query, TRUE);
+        g_string_free(condition, TRUE);
+        assert(true == end_batch());
+        return -1;
+    }
+
+    GArray *changed = g_array_new(FALSE, FALSE, sizeof(NodeIdentifier));
+    assert(NULL != changed);
+    int status = SQLITE_ERROR;
+    while (SQLITE_ROW == (status = sqlite3_step(statement))) {
+        NodeIdentifier node;
+        node.rack_no = (unsigned int) sqlite3_column_int64(statement, 0);
+        node.chassis_no = (unsigned int) sqlite3_column_int64(statement, 1);
+        g_array_append_val(changed, node);
+    }
+    assert(SQLITE_OK == sqlite3_finalize(statement));
+
+    if (SQLITE_DONE != status) {
+        puts("Bad sqlite3_step set_nodes_enabled");
+        g_array_unref(changed);
+        g_string_free(query, TRUE);
+        g_string_free(condition, TRUE);
+        assert(true == end_batch());
+        return -1;
+    }
+
+    g_string_printf(query, "UPDATE nodes SET enabled = %i WHERE enabled != %i AND %s;", enabled, enabled, condition->str);
+    assert(SQLITE_OK == sqlite3_exec(db, query->str, NULL, NULL, NULL));
+    g_string_free(query, TRUE);
+    g_string_free(condition, TRUE);
+
+    for (guint i = 0; i < changed->len; i++) {
+        const NodeIdentifier *node = &g_array_index(changed, NodeIdentifier, i);
+        hot_tier_set_node_enabled(node->rack_no, node->chassis_no, enabled);
+        node_activity_set_node(node->rack_no, node->chassis_no, enabled);
+        topology_set_node(node->rack_no, node->chassis_no, enabled);
+    }
+
+    const int count = (int) changed->len;
+    g_array_unref(changed);
+
+    assert(true == end_batch());
+    return count;
+}
+
+int set_error_ids_enabled(const GArray *ids, const bool enabled) {
+    assert(NULL != ids);
+    if (0 == ids->len) {
+        return 0;
+    }
+
+    GString *update = g_string_new(NULL);
+    assert(NULL != update);
+    g_string_printf(update, "UPDATE errors SET enabled = %i WHERE enabled != %i AND id IN (", enabled, enabled);
+    for (guint i = 0; i < ids->len; i++) {
+        g_string_append_printf(update, "%s%li", (0 == i) ? "" : ",", g_array_index(ids, gint64, i));
+    }
+    g_string_append(update, ");");
+
+    begin_batch();
+
+    if (SQLITE_OK != sqlite3_exec(db, update->str, NULL, NULL, NULL)) {
+        puts("Error running set_error_ids_enabled");
+        g_string_free(update, TRUE);
+        assert(true == end_batch());
+        return -1;
+    }
+    g_string_free(update, TRUE);
+    const int changes = sqlite3_changes(db);
+
+    for (guint i = 0; i < ids->len; i++) {
+        hot_tier_set_error_enabled(g_array_index(ids, gint64, i), enabled);
+    }
+    g_atomic_int_inc(&errors_enabled_changes);
+
+    assert(true == end_batch());
+    return changes;
+}
+
+// id of the named user in ack_users, adding them if needed. -1 on error
+static gint64 ack_user_id(const char *user) {
+    // %Q quotes the name for SQL
+    char *query = sqlite3_mprintf("INSERT OR IGNORE INTO ack_users(name) VALUES (%Q);", user);
+    assert(NULL != query);
+    char *errstr = NULL;
+    if (SQLITE_OK != sqlite3_exec(db, query, NULL, NULL, &errstr)) {
+        puts(errstr);
+        sqlite3_free(errstr);
+        sqlite3_free(query);
+        return -1;
+    }
+    sqlite3_free(query);
+
+    query = sqlite3_mprintf("SELECT id FROM ack_users WHERE name = %Q;", user);
+    assert(NULL != query);
+    sqlite3_stmt *statement = NULL;
+    if (SQLITE_OK != sqlite3_prepare_v2(db, query, -1, &statement, NULL)) {
+        puts("Error constructing ack_user_id query");
+        sqlite3_free(query);
+        return -1;
+    }
+    sqlite3_free(query);
+
+    const gint64 id = (SQLITE_ROW == sqlite3_step(statement)) ? sqlite3_column_int64(statement, 0) : -1;
+    assert(SQLITE_OK == sqlite3_finalize(statement));
+
+    return id;
+}
+
+#define ACK_BATCH_CONDITION "errors.id IN (SELECT error_id FROM temp.ack_batch)"
+
+// acknowledge (or un-acknowledge) the errors in temp.ack_batch, which are all in the other state. Call within a batch
+static bool apply_ack_batch(const bool acked, const char *user) {
+    GString *update = g_string_new(NULL);
+    assert(NULL != update);
+
+    if (acked) {
+        const gint64 user_id = ack_user_id(user);
+        if (user_id < 0) {
+            g_string_free(update, TRUE);
+            return false;
+        }
+        g_string_printf(update, "UPDATE errors SET acked = 1 WHERE " ACK_BATCH_CONDITION ";\
+            INSERT OR REPLACE INTO error_acks(error_id, ack_time, user_id) \
+                SELECT error_id, %li, %" G_GINT64_FORMAT " FROM temp.ack_batch;", time(NULL), user_id);
+
+        // counted while they are still unacknowledged
+        if (!count_unacked(ACK_BATCH_CONDITION, -1)) {
+            g_string_free(update, TRUE);
+            return false;
+        }
+    } else {
+        g_string_printf(update, "UPDATE errors SET acked = 0 WHERE " ACK_BATCH_CONDITION ";\
+            DELETE FROM error_acks WHERE error_id IN (SELECT error_id FROM temp.ack_batch);");
+    }
+
+    char *errstr = NULL;
+    const bool updated = (SQLITE_OK == sqlite3_exec(db, update->str, NULL, NULL, &errstr));
+    g_string_free(update, TRUE);
+    if (!updated) {
+        puts(errstr);
+        sqlite3_free(errstr);
+        if (acked) {
+            count_unacked(ACK_BATCH_CONDITION, 1); // put the counts back
+        }
+        return false;
+    }
+
+    // counted now that they are unacknowledged
+    if (!acked && !count_unacked(ACK_BATCH_CONDITION, 1)) {
+        return false;
+    }
+
+    if (!hot_tier_enabled()) {
+        return true;
+    }
+
+    GString *query = g_string_new(NULL);
+    assert(NULL != query);
+    g_string_printf(query, "SELECT error_id FROM temp.ack_batch WHERE error_id > %li;", hot_tier_floor());
+
+    sqlite3_stmt *statement = NULL;
+    if (SQLITE_OK != sqlite3_prepare_v2(db, query->str, -1, &statement, NULL)) {
+        puts("Error constructing apply_ack_batch query");
+        g_string_free(query, TRUE);
+        return false;
+    }
+    g_string_free(query, TRUE);
+
+    int status = SQLITE_ERROR;
+    while (SQLITE_ROW == (status = sqlite3_step(statement))) {
+        hot_tier_set_error_acked(sqlite3_column_int64(statement, 0), acked);
+    }
+    assert(SQLITE_OK == sqlite3_finalize(statement));
+
+    if (SQLITE_DONE != status) {
+        puts("Bad sqlite3_step apply_ack_batch");
+        return false;
+    }
 
-    assert(SQLITE_OK == sqlite3_exec(db, "commit;", NULL, NULL, NULL));
     return true;
-}
\ No newline at end of file
+}
+
+// run statement to fill temp.ack_batch then apply it. Finalizes statement. Returns the number of errors changed or -1.
+// Call within a batch
+static int run_ack_batch(sqlite3_stmt *statement, const bool acked, const char *user) {
+    const int status = sqlite3_step(statement);
+    const int changes = sqlite3_changes(db);
+    assert(SQLITE_OK == sqlite3_finalize(statement));
+    if (SQLITE_DONE != status) {
+        puts("Bad sqlite3_step run_ack_batch");
+        return -1;
+    }
+
+    return apply_ack_batch(acked, user) ? changes : -1;
+}
+
+int set_errors_acked(const Clickable *search, const bool acked, const char *user) {
+    if (NULL == search) {
+        return -1;
+    }
+    assert(!acked || (NULL != user));
+
+    begin_batch();
+    assert(SQLITE_OK == sqlite3_exec(db, "DELETE FROM temp.ack_batch;", NULL, NULL, NULL));
+
+    sqlite3_stmt *statement = matching_statement(search, acked
+        ? "INSERT INTO temp.ack_batch(error_id) SELECT id FROM errors WHERE acked = 0 AND id IN (%s);"
+        : "INSERT INTO temp.ack_batch(error_id) SELECT id FROM errors WHERE acked = 1 AND id IN (%s);");
+    const int changes = (NULL == statement) ? -1 : run_ack_batch(statement, acked, user);
+
+    assert(true == end_batch());
+    return changes;
+}
+
+int set_error_ids_acked(const GArray *ids, const bool acked, const char *user) {
+    assert(NULL != ids);
+    assert(!acked || (NULL != user));
+    if (0 == ids->len) {
+        return 0;
+    }
+
+    GString *query = g_string_new(NULL);
+    assert(NULL != query);
+    g_string_printf(query, "INSERT INTO temp.ack_batch(error_id) SELECT id FROM errors WHERE acked = %i AND id IN (",
+        acked ? 0 : 1);
+    for (guint i = 0; i < ids->len; i++) {
+        g_string_append_printf(query, "%s%li", (0 == i) ? "" : ",", g_array_index(ids, gint64, i));
+    }
+    g_string_append(query, ");");
+
+    begin_batch();
+    assert(SQLITE_OK == sqlite3_exec(db, "DELETE FROM temp.ack_batch;", NULL, NULL, NULL));
+
+    sqlite3_stmt *statement = NULL;
+    int changes = -1;
+    if (SQLITE_OK != sqlite3_prepare_v2(db, query->str, -1, &statement, NULL)) {
+        puts("Error constructing set_error_ids_acked query");
+    } else {
+        changes = run_ack_batch(statement, acked, user);
+    }
+    g_string_free(query, TRUE);
+
+    assert(true == end_batch());
+    return changes;
+}
+
+bool error_ack_info(const gint64 id, time_t *ack_time, char **user) {
+    assert(NULL != ack_time);
+    assert(NULL != user);
+
+    GString *query = g_string_new(NULL);
+    assert(NULL != query);
+    g_string_printf(query, "SELECT error_acks.ack_time, ack_users.name \
+                    FROM error_acks \
+                    INNER JOIN ack_users \
+                    ON error_acks.user_id = ack_users.id \
+                    WHERE error_acks.error_id = %li;", id);
+
+    sqlite3_stmt *statement = NULL;
+    if (SQLITE_OK != sqlite3_prepare_v2(db, query->str, -1, &statement, NULL)) {
+        puts("Error constructing error_ack_info query");
+        g_string_free(query, TRUE);
+        return false;
+    }
+    g_string_free(query, TRUE);
+
+    bool found = false;
+    if (SQLITE_ROW == sqlite3_step(statement)) {
+        found = true;
+        *ack_time = sqlite3_column_int64(statement, 0);
+        *user = g_strdup((const char *) sqlite3_column_text(statement, 1));
+    }
+    assert(SQLITE_OK == sqlite3_finalize(statement));
+
+    return found;
+}
@@ -0,0 +1,107 @@
+/*
+ * Copyright 2017
+ * GPL3 Licensed
+ * template.c
+ * Message templates: error descriptions with their numbers masked so that errors differing only by a voltage, a
+ * counter or an address are grouped together
+ */
+
+// includes
+#include "config.h"
+#include "template.h"
+#include <assert.h>
+#include <stdbool.h>
+#include <string.h>
+
+// 64 bit FNV-1a
+#define FNV_OFFSET_BASIS G_GUINT64_CONSTANT(14695981039346656037)
+#define FNV_PRIME G_GUINT64_CONSTANT(1099511628211)
+
+#define MASK '#'
+
+// where the template goes: text if it is wanted, and always the hash
+typedef struct {
+    GString *text;
+    guint64 hash;
+} TemplateOutput;
+
+// functions
+
+static void emit(TemplateOutput *output, const char c) {
+    if (NULL != output->text) {
+        g_string_append_c(output->text, c);
+    }
+    output->hash ^= (guchar) c;
+    output->hash *= FNV_PRIME;
+}
+
+// is the word [start, start + len) a hex number?
+static bool hex_number(const char *start, const size_t len) {
+    size_t i = 0;
+    bool digit = false;
+    if ((len > 2) && ('0' == start[0]) && (('x' == start[1]) || ('X' == start[1]))) {
+        i = 2;
+        digit = true; // 0xbad is a number
+    }
+
+    for (; i < len; i++) {
+        if (!g_ascii_isxdigit(start[i])) {
+            return false;
+        }
+        digit = digit || g_ascii_isdigit(start[i]);
+    }
+
+    return digit;
+}
+
+static void make_template(const char *description, TemplateOutput *output) {
+    assert(NULL != description);
+    output->hash = FNV_OFFSET_BASIS;
+
+    const char *c = description;
+    while ('\0' != *c) {
+        if (!g_ascii_isalnum(*c)) {
+            emit(output, *c);
+            c++;
+            continue;
+        }
+
+        // a word
+        const char *start = c;
+        while (g_ascii_isalnum(*c)) {
+            c++;
+        }
+
+        if (hex_number(start, (size_t) (c - start))) {
+            emit(output, MASK);
+            continue;
+        }
+
+        // mask runs of digits within other words e.g. eth0
+        for (const char *in_word = start; in_word < c; in_word++) {
+            if (!g_ascii_isdigit(*in_word)) {
+                emit(output, *in_word);
+            } else if ((in_word == start) || !g_ascii_isdigit(in_word[-1])) {
+                emit(output, MASK);
+            }
+        }
+    }
+}
+
+char *template_text(const char *description) {
+    TemplateOutput output;
+    output.text = g_string_sized_new(strlen(description));
+    assert(NULL != output.text);
+    make_template(description, &output);
+    return g_string_free(output.text, FALSE);
+}
+
+gint64 template_id(const char *description) {
+    TemplateOutput output;
+    output.text = NULL;
+    make_template(description, &output);
+
+    // positive so that it works as a number in filter expressions
+    const gint64 id = (gint64) (output.hash & G_MAXINT64);
+    return (0 == id) ? 1 : id;
+}
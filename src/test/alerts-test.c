@@ -0,0 +1,86 @@
+/*
+ * Copyright 2017
+ * GPL3 Licensed
+ * alerts-test.c
+ * Tests for alerts.c
+ */
+
+// includes
+#include "config.h"
+#include "alerts.h"
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <glib.h>
+
+// functions
+
+// the name of the only alert fired since last time, or NULL if none were. Free with g_free
+static char *take_one(void) {
+    GList *alerts = alerts_take();
+    if (NULL == alerts) {
+        return NULL;
+    }
+    assert(1 == g_list_length(alerts));
+
+    char *rule = g_strdup(((Alert *) alerts->data)->rule);
+    g_list_free_full(alerts, free_alert);
+    return rule;
+}
+
+static void assert_fired(const char *expected) {
+    char *rule = take_one();
+    assert((NULL == expected) ? (NULL == rule) : ((NULL != rule) && (0 == strcmp(expected, rule))));
+    g_free(rule);
+}
+
+int main(void) {
+    gchar *path = g_build_filename(g_get_tmp_dir(), "mothership-alerts-test.conf", NULL);
+    assert(NULL != path);
+    assert(TRUE == g_file_set_contents(path, "[storage]\nprofile=fast\n\
+[alert Rack 0 valves]\nrack=0\ntype=valve\naction=notify, banner\n\
+[alert Noisy chassis]\ncount=3\nseconds=60\naction=bell\n", -1, NULL));
+    assert(true == alerts_load_rules(path));
+    assert(2 == alerts_rule_count());
+
+    // any valve error in rack 0, then not again from that chassis within the minute
+    alerts_check(HARD_ERROR_VALVE, 0, 1, 5, 1000, "Hardware Error: heater");
+    GList *alerts = alerts_take();
+    assert(1 == g_list_length(alerts));
+    const Alert *alert = alerts->data;
+    assert(0 == strcmp("Rack 0 valves", alert->rule));
+    assert((ALERT_NOTIFY | ALERT_BANNER) == alert->actions);
+    assert((0 == alert->rack_no) && (1 == alert->chassis_no) && (5 == alert->valve_no) && (1000 == alert->time));
+    assert(0 == strcmp("Hardware Error: heater", alert->description));
+    g_list_free_full(alerts, free_alert);
+    alerts_check(HARD_ERROR_VALVE, 0, 1, 5, 1010, "Hardware Error: heater");
+    assert_fired(NULL);
+    alerts_check(HARD_ERROR_OTHER, 0, 2, -1, 1010, "Hardware Error: fan"); // not a valve
+    assert_fired(NULL);
+    alerts_check(HARD_ERROR_VALVE, 1, 1, 5, 1010, "Hardware Error: heater"); // another rack
+    assert_fired(NULL);
+
+    // three errors of any type from one chassis within a minute
+    alerts_check(SOFT_ERROR, 0, 1, -1, 1020, "Software Error: crashed");
+    assert_fired("Noisy chassis");
+    alerts_check(SOFT_ERROR, 2, 0, -1, 2000, "Software Error: crashed");
+    alerts_check(SOFT_ERROR, 2, 0, -1, 2100, "Software Error: crashed");
+    alerts_check(SOFT_ERROR, 2, 0, -1, 2200, "Software Error: crashed"); // too far apart
+    assert_fired(NULL);
+
+    // fires again once the minute is up
+    alerts_check(HARD_ERROR_VALVE, 0, 1, 6, 1100, "Hardware Error: heater");
+    assert_fired("Rack 0 valves");
+
+    // a bad rule keeps the old ones
+    assert(TRUE == g_file_set_contents(path, "[alert Bad]\ntype=firmware\n", -1, NULL));
+    assert(false == alerts_load_rules(path));
+    assert(2 == alerts_rule_count());
+
+    assert(0 == remove(path));
+    g_free(path);
+    alerts_clear_rules();
+    assert(0 == alerts_rule_count());
+    alerts_check(HARD_ERROR_VALVE, 0, 1, 5, 5000, "Hardware Error: heater");
+    assert_fired(NULL);
+}
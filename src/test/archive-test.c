@@ -0,0 +1,158 @@
+/*
+ * Copyright 2017
+ * GPL3 Licensed
+ * archive-test.c
+ * Tests for archive.c
+ */
+
+// includes
+#include "config.h"
+#include "archive.h"
+#include "sql.h"
+#include "unacked.h"
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <glib.h>
+#include <unistd.h>
+
+#define NUM_OLD_ERRORS 10000 // enough for more than one block
+
+// functions
+
+// implements archive_row_func_t. Checks rows come back in order with the right contents
+static bool check_row(const ArchiveRow *row, gpointer user_data) {
+    assert(NULL != row);
+    assert(NULL != user_data);
+    gint64 *count = user_data;
+
+    assert(1000 + *count == row->recv_time);
+    assert(0 == row->rack_no);
+    assert(1 == row->chassis_no);
+    assert((*count % 3) - 1 == row->valve_no);
+    assert((0 != (*count % 2)) == row->enabled);
+    assert((0 == (*count % 5)) == row->acked);
+
+    char expected[32];
+    snprintf(expected, sizeof(expected), "Hardware Error: %li", *count % 7);
+    assert(0 == strcmp(expected, row->description));
+
+    *count += 1;
+    return true;
+}
+
+// implements error_row_func_t. Stops after 5 rows
+static bool count_five(__attribute__((unused)) const time_t recv_time, __attribute__((unused)) const unsigned int rack_no,
+        __attribute__((unused)) const unsigned int chassis_no, __attribute__((unused)) const int valve_no,
+        __attribute__((unused)) const bool enabled, __attribute__((unused)) const bool acked,
+        __attribute__((unused)) const char *description, gpointer user_data) {
+    gint64 *count = user_data;
+    *count += 1;
+    return *count < 5;
+}
+
+int main(void) {
+    init_database(NULL); // NULL: memory only database
+
+    assert(true == add_node(0, 1, true));
+
+    // old errors to be archived
+    char description[32];
+    begin_batch();
+    for (gint64 i = 0; i < NUM_OLD_ERRORS; i++) {
+        snprintf(description, sizeof(description), "Hardware Error: %li", i % 7);
+        assert(true == restore_error(0, 1, (int) (i % 3) - 1, 1000 + i, description, 0 != (i % 2), 0 == (i % 5)));
+    }
+    assert(true == end_batch());
+
+    // a new error which should stay in the database
+    assert(true == add_error_decoded(0, 1, -1, time(NULL), "Software Error: recent"));
+
+    Clickable all;
+    all.time_range = TIME_ALL;
+    all.type = ALL;
+    set_show_disabled(true);
+    set_show_acked(true);
+    assert(NUM_OLD_ERRORS + 1 == count_clickable(&all));
+    const gint64 unacked = unacked_count(&all);
+    assert(NUM_OLD_ERRORS - NUM_OLD_ERRORS / 5 + 1 == unacked);
+
+    gchar *path = g_build_filename(g_get_tmp_dir(), "mothership-archive-test.edsacarc", NULL);
+    assert(NULL != path);
+    remove(path); // left over from a previous run
+
+    // archive the old errors
+    assert(NUM_OLD_ERRORS == archive_errors_before(path, 1000 + NUM_OLD_ERRORS));
+    assert(1 == count_clickable(&all));
+
+    // archives are never overwritten
+    assert(-1 == archive_errors_before(path, time(NULL) + 1));
+    assert(1 == count_clickable(&all));
+
+    // read it back
+    gint64 count = 0;
+    assert(true == archive_foreach(path, check_row, &count));
+    assert(NUM_OLD_ERRORS == count);
+
+    // search without importing
+    Clickable valve;
+    valve.time_range = TIME_ALL;
+    valve.type = VALVE;
+    valve.rack_num = 0;
+    valve.chassis_num = 1;
+    valve.valve_num = 1;
+    GList *results = archive_search(path, &valve, "error: 3");
+    // valve 1 is every i % 3 == 2, "3" is every i % 7 == 3
+    guint expected_results = 0;
+    for (gint64 i = 0; i < NUM_OLD_ERRORS; i++) {
+        if ((2 == i % 3) && (3 == i % 7)) {
+            expected_results += 1;
+        }
+    }
+    assert(expected_results == g_list_length(results));
+    for (GList *item = results; NULL != item; item = item->next) {
+        SearchResult *res = item->data;
+        assert(1 == res->valve_no);
+        assert(NULL != strstr(res->message, "Hardware Error: 3"));
+    }
+    g_list_free_full(results, free_search_result);
+
+    // streaming search through a filter, as mothership-query --archive does
+    Clickable filtered;
+    memset(&filtered, 0, sizeof(filtered));
+    filtered.type = FILTER;
+    filtered.text = g_intern_string("chassis=1 valve=1 enabled");
+    filtered.time_range = TIME_ALL;
+    gint64 streamed = 0;
+    assert(5 == archive_search_foreach(path, &filtered, NULL, count_five, &streamed));
+    assert(5 == streamed);
+
+    // put them back. Archiving kept their counts in the rollup so they aren't counted again
+    guint archived_rate[1];
+    assert(true == rollup_clickable(&all, 1000 + NUM_OLD_ERRORS, 24 * 60 * 60, 1, archived_rate));
+    assert(NUM_OLD_ERRORS == archive_import(path));
+    assert(NUM_OLD_ERRORS + 1 == count_clickable(&all));
+    guint imported_rate[1];
+    assert(true == rollup_clickable(&all, 1000 + NUM_OLD_ERRORS, 24 * 60 * 60, 1, imported_rate));
+    assert(archived_rate[0] == imported_rate[0]);
+
+    // acknowledged errors stay acknowledged
+    assert(unacked == unacked_count(&all));
+
+    // disabled errors stay disabled
+    set_show_disabled(false);
+    assert(NUM_OLD_ERRORS / 2 + 1 == count_clickable(&all));
+
+    // not an archive
+    FILE *garbage = fopen(path, "w");
+    assert(NULL != garbage);
+    fputs("not an archive", garbage);
+    fclose(garbage);
+    assert(false == archive_foreach(path, check_row, &count));
+
+    assert(0 == remove(path));
+    g_free(path);
+
+    close_database();
+    return 0;
+}
@@ -0,0 +1,188 @@
+/*
+ * Copyright 2017
+ * GPL3 Licensed
+ * filter-test.c
+ * Tests for filter.c
+ */
+
+// includes
+#include "config.h"
+#include "filter.h"
+#include "sql.h"
+#include "hot_tier.h"
+#include "template.h"
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <glib.h>
+
+// functions
+
+static bool valid(const char *expression) {
+    char *error_message = NULL;
+    Filter *filter = filter_parse(expression, &error_message);
+    filter_free(filter);
+
+    // exactly one of them
+    assert((NULL == filter) != (NULL == error_message));
+    g_free(error_message);
+    return NULL != filter;
+}
+
+static int count_filter(const char *expression) {
+    Clickable search;
+    memset(&search, 0, sizeof(search));
+    search.type = FILTER;
+    search.text = g_intern_string(expression);
+    return count_clickable(&search);
+}
+
+int main(void) {
+    // parsing
+    assert(valid(""));
+    assert(valid("rack=4-7 type=hardware valve=10-20 enabled"));
+    assert(valid("  chassis=1,3,5-6  type=software,other "));
+    assert(!valid("rack"));
+    assert(!valid("rack=7-4"));
+    assert(!valid("rack=a"));
+    assert(!valid("rack=1-"));
+    assert(!valid("rack=-1"));
+    assert(!valid("rack=1,"));
+    assert(!valid("colour=red"));
+    assert(!valid("type=firmware"));
+
+    // message templates
+    char *text = template_text("Hardware Error: 3.3V on 0x1F, eth0 at 7fff0a (bad face)");
+    assert(0 == strcmp("Hardware Error: #.#V on #, eth# at # (bad face)", text));
+    g_free(text);
+    assert(template_id("Software Error: counter 17") == template_id("Software Error: counter 40000"));
+    assert(template_id("Software Error: counter 17") != template_id("Software Error: timer 17"));
+    assert(template_id("") > 0);
+
+    // the in-memory predicate
+    const Filter *filter = filter_get(g_intern_string("rack=4-7 type=hardware valve=10-20"));
+    assert(NULL != filter);
+    assert(filter == filter_get(g_intern_string("rack=4-7 type=hardware valve=10-20"))); // only parsed once
+    assert(!filter_enabled_only(filter));
+    assert(filter_matches(filter, 4, 0, 10, "Hardware Error: low"));
+    assert(filter_matches(filter, 7, 9, 20, "Hardware Error: low"));
+    assert(!filter_matches(filter, 8, 0, 10, "Hardware Error: low"));
+    assert(!filter_matches(filter, 4, 0, 21, "Hardware Error: low"));
+    assert(!filter_matches(filter, 4, 0, -1, "Hardware Error: low")); // no valve
+    assert(!filter_matches(filter, 4, 0, 10, "Software Error: low"));
+    assert(NULL == filter_get(g_intern_string("rack=")));
+
+    const Filter *other = filter_get(g_intern_string("type=other enabled"));
+    assert(NULL != other);
+    assert(filter_enabled_only(other));
+    assert(filter_matches(other, 0, 0, -1, "Node not connected"));
+    assert(!filter_matches(other, 0, 0, -1, "Software Error: x"));
+
+    // the same answers from the database and from the hot tier
+    init_database(NULL);
+    assert(true == add_node(4, 0, true));
+    assert(true == add_node(5, 1, true));
+    assert(true == add_node(9, 0, true));
+    const time_t now = time(NULL);
+    assert(true == add_error_decoded(4, 0, 12, now, "Hardware Error: heater"));
+    assert(true == add_error_decoded(4, 0, 30, now, "Hardware Error: heater"));
+    assert(true == add_error_decoded(5, 1, -1, now, "Software Error: crashed"));
+    assert(true == add_error_decoded(5, 1, -1, now, "Node not connected"));
+    assert(true == add_error_decoded(9, 0, 15, now, "Hardware Error: heater"));
+    assert(true == node_toggle_disabled(5, 1));
+    set_show_disabled(true);
+
+    for (int pass = 0; pass < 2; pass++) {
+        assert(5 == count_filter(""));
+        assert(1 == count_filter("rack=4-7 type=hardware valve=10-20"));
+        assert(2 == count_filter("valve=10-20"));
+        assert(3 == count_filter("rack=4,9 chassis=0 type=hardware valve=0-100"));
+        assert(1 == count_filter("type=other"));
+        assert(2 == count_filter("type=software,other"));
+        assert(0 == count_filter("type=software,other enabled")); // node 5, 1 is disabled
+        assert(-1 == count_filter("rack=x"));
+
+        gchar *by_template = g_strdup_printf("template=%" G_GINT64_FORMAT, template_id("Hardware Error: heater"));
+        assert(3 == count_filter(by_template));
+        g_free(by_template);
+
+        GList *results = NULL;
+        Clickable search;
+        memset(&search, 0, sizeof(search));
+        search.type = FILTER;
+        search.text = g_intern_string("rack=5");
+        results = search_clickable(&search);
+        assert(2 == g_list_length(results));
+        assert(5 == ((SearchResult *) results->data)->rack_no);
+        g_list_free_full(results, free_search_result);
+
+        // bulk changes. Put back as they were for the next pass
+        set_show_disabled(false);
+        assert(3 == count_filter(""));
+        Clickable bulk;
+        memset(&bulk, 0, sizeof(bulk));
+        bulk.type = VALVE;
+        bulk.rack_num = 4;
+        bulk.valve_num = 12;
+        assert(1 == set_errors_enabled(&bulk, false));
+        assert(2 == count_filter(""));
+        bulk.type = FILTER;
+        bulk.text = g_intern_string("type=hardware");
+        assert(2 == set_errors_enabled(&bulk, false)); // the valve 12 error is already disabled
+        assert(0 == count_filter(""));
+        bulk.type = ALL;
+        assert(3 == set_errors_enabled(&bulk, true));
+        assert(3 == count_filter(""));
+
+        bulk.type = RACK;
+        bulk.rack_num = 5;
+        assert(1 == set_nodes_enabled(&bulk, true));
+        assert(5 == count_filter(""));
+        assert(1 == set_nodes_enabled(&bulk, false));
+        assert(0 == set_nodes_enabled(&bulk, false));
+        assert(3 == count_filter(""));
+
+        bulk.type = ALL;
+        results = search_clickable(&bulk);
+        GArray *ids = g_array_new(FALSE, FALSE, sizeof(gint64));
+        const gint64 first_id = ((SearchResult *) results->data)->id;
+        g_array_append_val(ids, first_id);
+        g_list_free_full(results, free_search_result);
+        assert(1 == set_error_ids_enabled(ids, false));
+        assert(2 == count_filter(""));
+        assert(1 == set_error_ids_enabled(ids, true));
+        g_array_unref(ids);
+        set_show_disabled(true);
+
+        hot_tier_init(0); // now only the database
+    }
+
+    close_database();
+
+    // saved filters
+    gchar *path = g_build_filename(g_get_tmp_dir(), "mothership-filters-test.conf", NULL);
+    assert(NULL != path);
+    remove(path);
+    assert(NULL == saved_filters_load(path));
+    assert(true == saved_filter_store(path, "Hot racks", "rack=4-7 type=hardware"));
+    assert(true == saved_filter_store(path, "Software", "type=software"));
+    assert(true == saved_filter_store(path, "Hot racks", "rack=4-8 type=hardware")); // replaces
+    assert(false == saved_filter_store(path, "a=b", "rack=1"));
+
+    GList *saved = saved_filters_load(path);
+    assert(2 == g_list_length(saved));
+    const SavedFilter *first = saved->data;
+    assert(0 == strcmp("Hot racks", first->name));
+    assert(0 == strcmp("rack=4-8 type=hardware", first->expression));
+    g_list_free_full(saved, free_saved_filter);
+
+    assert(true == saved_filter_remove(path, "Hot racks"));
+    saved = saved_filters_load(path);
+    assert(1 == g_list_length(saved));
+    assert(0 == strcmp("Software", ((SavedFilter *) saved->data)->name));
+    g_list_free_full(saved, free_saved_filter);
+
+    assert(0 == remove(path));
+    g_free(path);
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright 2017
+ * GPL3 Licensed
+ * heavy-hitters-test.c
+ * Tests for heavy_hitters.c
+ */
+
+// includes
+#include "config.h"
+#include "heavy_hitters.h"
+#include <assert.h>
+#include <time.h>
+#include <glib.h>
+
+// functions
+
+int main(void) {
+    const time_t now = time(NULL);
+
+    // exact while there are fewer items than counters
+    heavy_hitters_add(1, 2, 3, 5, now);
+    heavy_hitters_add(1, 2, 4, 2, now);
+    heavy_hitters_add(1, 2, -1, 1, now);
+    heavy_hitters_add(4, 0, 3, 1, now - 60);
+    heavy_hitters_add(4, 0, 3, 100, now - HEAVY_HITTERS_MINUTES * 60); // too old
+
+    GArray *top = heavy_hitters_top(true, 2, now);
+    assert(2 == top->len);
+    const HeavyHitter *first = &g_array_index(top, HeavyHitter, 0);
+    assert((1 == first->rack_no) && (2 == first->chassis_no) && (3 == first->valve_no));
+    assert((5 == first->count) && (0 == first->error));
+    assert(4 == g_array_index(top, HeavyHitter, 1).valve_no);
+    g_array_unref(top);
+
+    top = heavy_hitters_top(false, 10, now);
+    assert(2 == top->len);
+    assert(8 == g_array_index(top, HeavyHitter, 0).count); // every error from node 1, 2
+    assert(-1 == g_array_index(top, HeavyHitter, 0).valve_no);
+    assert(1 == g_array_index(top, HeavyHitter, 1).count);
+    g_array_unref(top);
+
+    // minutes drop out of the window
+    top = heavy_hitters_top(false, 10, now + HEAVY_HITTERS_MINUTES * 60);
+    assert(0 == top->len);
+    g_array_unref(top);
+
+    heavy_hitters_remove_node(1, 2);
+    top = heavy_hitters_top(true, 10, now);
+    assert(1 == top->len);
+    assert(4 == g_array_index(top, HeavyHitter, 0).rack_no);
+    g_array_unref(top);
+
+    // a noisy valve among far more quiet ones than there are counters is still found, and its count is bounded
+    heavy_hitters_clear();
+    const guint version = heavy_hitters_version();
+    for (int round = 0; round < 20; round++) {
+        for (int valve = 0; valve < HEAVY_HITTERS_CAPACITY * 4; valve++) {
+            heavy_hitters_add(2, 0, valve, 1, now);
+        }
+        heavy_hitters_add(3, 1, 7, 10, now);
+    }
+    assert(version != heavy_hitters_version());
+
+    top = heavy_hitters_top(true, 1, now);
+    assert(1 == top->len);
+    first = &g_array_index(top, HeavyHitter, 0);
+    assert((3 == first->rack_no) && (1 == first->chassis_no) && (7 == first->valve_no));
+    assert(first->count >= 200);
+    assert(first->count - first->error <= 200);
+    g_array_unref(top);
+
+    heavy_hitters_clear();
+    return 0;
+}
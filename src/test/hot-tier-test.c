@@ -0,0 +1,99 @@
+/*
+ * Copyright 2017
+ * GPL3 Licensed
+ * hot-tier-test.c
+ * Tests for hot_tier.c
+ */
+
+// includes
+#include "config.h"
+#include "hot_tier.h"
+#include "clickable.h"
+#include <assert.h>
+#include <string.h>
+#include <glib.h>
+
+#define CAPACITY 8
+
+// functions
+
+static Clickable clickable(const ClickableType type, const unsigned int rack_no, const unsigned int chassis_no, const int valve_no) {
+    Clickable ret;
+    memset(&ret, 0, sizeof(ret));
+    ret.type = type;
+    ret.rack_num = rack_no;
+    ret.chassis_num = chassis_no;
+    ret.valve_num = valve_no;
+    return ret;
+}
+
+int main(void) {
+    hot_tier_init(CAPACITY);
+    assert(true == hot_tier_enabled());
+    assert(0 == hot_tier_floor());
+
+    const Clickable all = clickable(ALL, 0, 0, 0);
+    const Clickable rack1 = clickable(RACK, 1, 0, 0);
+    const Clickable node12 = clickable(CHASSIS, 1, 2, 0);
+    const Clickable valve12 = clickable(VALVE, 1, 2, 3);
+
+    // alternate between two nodes. Times go backwards once so that ordering by time is tested
+    for (gint64 id = 1; id <= 6; id++) {
+        const time_t recv_time = (3 == id) ? 1 : 100 + id;
+        hot_tier_add(id, recv_time, 1, (id % 2) ? 2 : 3, (id % 2) ? 3 : -1, true, false, "Hardware Error: test");
+    }
+    assert(6 == hot_tier_count(&all, false, false));
+    assert(6 == hot_tier_count(&rack1, false, false));
+    assert(3 == hot_tier_count(&node12, false, false));
+    assert(3 == hot_tier_count(&valve12, false, false));
+
+    GList *results = hot_tier_search(&node12, false, false);
+    assert(3 == g_list_length(results));
+    assert(3 == ((SearchResult *) results->data)->id); // oldest
+    assert(1 == ((SearchResult *) results->next->data)->id);
+    assert(5 == ((SearchResult *) results->next->next->data)->id);
+    g_list_free_full(results, free_search_result);
+
+    // disabled errors and nodes are only shown when asked for
+    hot_tier_set_error_enabled(5, false);
+    assert(2 == hot_tier_count(&node12, false, false));
+    assert(3 == hot_tier_count(&node12, true, false));
+    hot_tier_set_node_enabled(1, 3, false);
+    assert(2 == hot_tier_count(&all, false, false));
+    assert(6 == hot_tier_count(&all, true, false));
+    hot_tier_set_node_enabled(1, 3, true);
+    hot_tier_set_error_enabled(5, true);
+
+    // and so are acknowledged ones
+    hot_tier_set_error_acked(1, true);
+    assert(2 == hot_tier_count(&node12, false, false));
+    assert(3 == hot_tier_count(&node12, false, true));
+    results = hot_tier_search(&node12, false, true);
+    assert(((SearchResult *) results->next->data)->acked);
+    g_list_free_full(results, free_search_result);
+    hot_tier_set_error_acked(1, false);
+
+    // fill it up so that the oldest errors are evicted
+    for (gint64 id = 7; id <= 10; id++) {
+        hot_tier_add(id, 100 + id, 1, 2, 3, true, false, "Software Error: newer");
+    }
+    assert(CAPACITY == hot_tier_count(&all, false, false));
+    assert(2 == hot_tier_floor());
+    assert(6 == hot_tier_count(&node12, false, false)); // ids 3, 5, 7, 8, 9, 10
+
+    // removed errors are forgotten
+    hot_tier_remove_before(105, 10);
+    assert(CAPACITY - 2 == hot_tier_count(&all, false, false)); // ids 3 and 4
+    hot_tier_remove_node(1, 3);
+    assert(5 == hot_tier_count(&all, false, false));
+    const Clickable node13 = clickable(CHASSIS, 1, 3, 0);
+    assert(0 == hot_tier_count(&node13, false, false));
+
+    hot_tier_clear();
+    assert(0 == hot_tier_count(&all, true, false));
+
+    hot_tier_free();
+    assert(false == hot_tier_enabled());
+
+    return 0;
+}
@@ -0,0 +1,175 @@
+/*
+ * Copyright 2017
+ * GPL3 Licensed
+ * ingest-test.c
+ * Tests for ingest.c
+ */
+
+// includes
+#include "config.h"
+#include "ingest.h"
+#include "journal.h"
+#include "sql.h"
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include <arpa/inet.h>
+#include <edsac_representation.h>
+
+#define FAN_ERRORS 1200  // the same low priority error from one node
+#define CODE_ERRORS 300  // low priority errors from another node, each with its own message template
+
+// what the server has received but ingest hasn't read yet
+static GQueue pending = G_QUEUE_INIT;
+
+// functions
+
+// implements ingest_read_func_t
+static BufferItem *read_pending(void) {
+    return g_queue_pop_head(&pending);
+}
+
+static BufferItem *new_item(const unsigned int rack_no, const unsigned int chassis_no, const char *msg,
+        const bool hardware, const time_t recv_time) {
+    BufferItem *item = malloc(sizeof(BufferItem));
+    assert(NULL != item);
+    memset(item, 0, sizeof(BufferItem));
+
+    item->address.s_addr = htonl(0x7F000000 | (rack_no << 8) | chassis_no); // 127.0.rack_no.chassis_no
+    item->recv_time = recv_time;
+    if (hardware) {
+        hardware_error_valve(&item->msg, /* arbitrary valve number */ 22, msg); // PRIORITY_HIGH
+    } else {
+        software_error(&item->msg, msg); // PRIORITY_LOW
+    }
+
+    return item;
+}
+
+static void receive(const unsigned int rack_no, const unsigned int chassis_no, const char *msg, const bool hardware,
+        const time_t recv_time) {
+    g_queue_push_tail(&pending, new_item(rack_no, chassis_no, msg, hardware, recv_time));
+}
+
+static Clickable chassis_clickable(const unsigned int rack_no, const unsigned int chassis_no) {
+    Clickable chassis;
+    memset(&chassis, 0, sizeof(chassis));
+    chassis.type = CHASSIS;
+    chassis.time_range = TIME_ALL;
+    chassis.rack_num = rack_no;
+    chassis.chassis_num = chassis_no;
+    return chassis;
+}
+
+// implements ingest_stored_func_t. The urgent error is in the database before any of the others
+static void check_urgent(gpointer user_data) {
+    guint *calls = user_data;
+    *calls += 1;
+
+    Clickable valve_node = chassis_clickable(0, 2);
+    assert(1 == count_clickable(&valve_node));
+    Clickable fan_node = chassis_clickable(0, 0);
+    assert(0 == count_clickable(&fan_node));
+}
+
+int main(void) {
+    init_database(NULL); // NULL: memory only database
+    for (unsigned int chassis = 0; chassis < 3; chassis++) {
+        assert(true == add_node(0, chassis, true));
+    }
+
+    gchar *prefix = g_dir_make_tmp("mothership-ingest-test-XXXXXX", NULL);
+    assert(NULL != prefix);
+    assert(true == ingest_init(prefix));
+    ingest_set_reader(read_pending);
+
+    // nothing received
+    guint urgent_calls = 0;
+    assert(false == ingest_drain(NULL, check_urgent, &urgent_calls));
+    assert(0 == urgent_calls);
+
+    // more than INGEST_OVERLOAD at once
+    const time_t now = time(NULL);
+    for (guint i = 0; i < FAN_ERRORS; i++) {
+        receive(0, 0, "fan stalled", false, now);
+    }
+    char code[32];
+    for (guint i = 0; i < CODE_ERRORS; i++) {
+        snprintf(code, sizeof(code), "code %c%c", 'a' + i / 26, 'a' + i % 26);
+        receive(0, 1, code, false, now);
+    }
+    receive(0, 2, "valve blown", true, now);
+    assert(FAN_ERRORS + CODE_ERRORS + 1 > INGEST_OVERLOAD);
+
+    Priority highest = PRIORITY_LOW;
+    assert(true == ingest_drain(&highest, check_urgent, &urgent_calls));
+    assert(PRIORITY_HIGH == highest);
+    assert(1 == urgent_calls);
+
+    // the repeats are one row which still counts them all
+    Clickable fan_node = chassis_clickable(0, 0);
+    assert(1 == count_clickable(&fan_node));
+    GList *results = search_clickable(&fan_node);
+    assert(1 == g_list_length(results));
+    assert(g_str_has_suffix(((SearchResult *) results->data)->message, "Software Error: fan stalled (1199 similar suppressed)"));
+    g_list_free_full(results, free_search_result);
+    guint rate[1];
+    assert(true == rollup_clickable(&fan_node, now, 24 * 60 * 60, G_N_ELEMENTS(rate), rate));
+    assert(FAN_ERRORS == rate[0]);
+
+    // past the budget (which the fan's row is the first of) the rest of the node's errors share a row
+    Clickable code_node = chassis_clickable(0, 1);
+    assert(INGEST_LOW_BUDGET == count_clickable(&code_node));
+    assert(true == rollup_clickable(&code_node, now, 24 * 60 * 60, G_N_ELEMENTS(rate), rate));
+    assert(CODE_ERRORS == rate[0]);
+
+    // and the journal knows they are all in the database
+    assert(FAN_ERRORS + CODE_ERRORS + 1 == get_journal_applied());
+
+    // an urgent error committed ahead of the rest of a drain which then failed to commit: only the rest is replayed
+    BufferItem *urgent = new_item(0, 2, "valve blown", true, now);
+    BufferItem *rest = new_item(0, 0, "fan stalled", false, now);
+    const guint64 urgent_seq = journal_append(urgent);
+    const guint64 rest_seq = journal_append(rest);
+    assert((0 != urgent_seq) && (urgent_seq < rest_seq));
+    assert(true == journal_sync());
+    begin_batch();
+    assert(true == add_error(urgent));
+    assert(true == set_journal_stored((gint64) urgent_seq));
+    assert(true == end_batch());
+    free_bufferitem(urgent);
+    free_bufferitem(rest);
+
+    ingest_shutdown();
+    assert(true == ingest_init(prefix));
+    Clickable valve_node = chassis_clickable(0, 2);
+    assert(2 == count_clickable(&valve_node));
+    assert(2 == count_clickable(&fan_node));
+    assert((gint64) rest_seq == get_journal_applied());
+    GHashTable *stored = get_journal_stored();
+    assert(NULL != stored);
+    assert(0 == g_hash_table_size(stored));
+    g_hash_table_destroy(stored);
+
+    // a batch which fails is rolled back rather than committed
+    begin_batch();
+    assert(true == add_error_decoded(0, 1, -1, now, "Software Error: rolled back"));
+    fail_batch();
+    assert(false == end_batch());
+    assert(INGEST_LOW_BUDGET == count_clickable(&code_node));
+
+    ingest_set_reader(NULL);
+    ingest_shutdown();
+    close_database();
+
+    gchar *journal_path = g_build_filename(prefix, "ingest.journal", NULL);
+    assert(NULL != journal_path);
+    assert(0 == remove(journal_path));
+    assert(0 == remove(prefix));
+    g_free(journal_path);
+    g_free(prefix);
+
+    return 0;
+}
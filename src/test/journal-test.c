@@ -0,0 +1,95 @@
+/*
+ * Copyright 2017
+ * GPL3 Licensed
+ * journal-test.c
+ * Tests for journal.c
+ */
+
+// includes
+#include "config.h"
+#include "journal.h"
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include <arpa/inet.h>
+#include <edsac_representation.h>
+
+// functions
+
+static BufferItem *error(const char *msg, const time_t recv_time) {
+    BufferItem *item = malloc(sizeof(BufferItem));
+    assert(NULL != item);
+    memset(item, 0, sizeof(BufferItem));
+
+    item->address.s_addr = htonl(0x7F000102); // 127.0.1.2
+    item->recv_time = recv_time;
+    software_error(&item->msg, msg);
+
+    return item;
+}
+
+// implements journal_replay_func_t. Expects the records made in main
+static void check_record(const BufferItem *item, const guint64 seq, gpointer user_data) {
+    assert(NULL != item);
+    guint64 *count = user_data;
+
+    assert(SOFT_ERROR == item->msg.type);
+    assert(htonl(0x7F000102) == item->address.s_addr);
+    assert((time_t) (1000 + seq) == item->recv_time);
+
+    char expected[32];
+    snprintf(expected, sizeof(expected), "error %lu", seq);
+    assert(0 == strcmp(expected, item->msg.data.software.message->str));
+
+    *count += 1;
+}
+
+int main(void) {
+    gchar *path = g_build_filename(g_get_tmp_dir(), "mothership-test.journal", NULL);
+    assert(NULL != path);
+    remove(path); // left over from a previous run
+
+    assert(true == journal_open(path, 0));
+
+    // enough to make the journal grow
+    char msg[32];
+    for (guint64 seq = 1; seq <= 50000; seq++) {
+        snprintf(msg, sizeof(msg), "error %lu", seq);
+        BufferItem *item = error(msg, (time_t) (1000 + seq));
+        assert(seq == journal_append(item));
+        free_bufferitem(item);
+    }
+    assert(true == journal_sync());
+    journal_close();
+
+    // pretend the first 40000 made it into the database
+    guint64 count = 0;
+    assert(true == journal_open(path, 40000));
+    assert(10000 == journal_replay(40000, check_record, &count));
+    assert(10000 == count);
+
+    // sequence numbers carry on
+    BufferItem *item = error("error 50001", 1000 + 50001);
+    assert(50001 == journal_append(item));
+    free_bufferitem(item);
+
+    // once it is all in the database there is nothing to replay
+    journal_checkpoint(50001);
+    count = 0;
+    assert(0 == journal_replay(0, check_record, &count));
+    journal_close();
+
+    // after a checkpoint the sequence numbers carry on from what the database has applied
+    assert(true == journal_open(path, 50001));
+    item = error("error 50002", 1000 + 50002);
+    assert(50002 == journal_append(item));
+    free_bufferitem(item);
+    assert(1 == journal_replay(50001, check_record, &count));
+    journal_close();
+
+    assert(0 == remove(path));
+    g_free(path);
+    return 0;
+}
@@ -0,0 +1,108 @@
+/*
+ * Copyright 2017
+ * GPL3 Licensed
+ * liveness-test.c
+ * Tests for liveness.c
+ */
+
+// includes
+#include "config.h"
+#include "liveness.h"
+#include <assert.h>
+#include <time.h>
+#include <glib.h>
+
+// functions
+
+// the only change from a poll at now. Asserts there is exactly one
+static LivenessChange only_change(const time_t now) {
+    GArray *changes = liveness_check(now);
+    assert(1 == changes->len);
+    const LivenessChange change = g_array_index(changes, LivenessChange, 0);
+    g_array_unref(changes);
+    return change;
+}
+
+static guint count_changes(const time_t now) {
+    GArray *changes = liveness_check(now);
+    const guint ret = changes->len;
+    g_array_unref(changes);
+    return ret;
+}
+
+int main(void) {
+    const time_t start = time(NULL);
+    liveness_set_node(1, 2, start);
+    liveness_set_node(3, 4, start);
+    assert(LIVENESS_UNKNOWN == liveness_state(1, 2, NULL));
+
+    // nothing happens while new nodes have a chance to connect
+    assert(0 == count_changes(start + 10));
+
+    // connecting brings a node up
+    liveness_connected(1, 2);
+    LivenessChange change = only_change(start + 20);
+    assert((1 == change.rack_no) && (2 == change.chassis_no) && change.up && (start + 20 == change.time));
+    assert(LIVENESS_UP == liveness_state(1, 2, NULL));
+
+    // a node which never shows up is down once it has had its chance
+    liveness_connected(1, 2);
+    change = only_change(start + LIVENESS_STALE_SECONDS);
+    assert((3 == change.rack_no) && !change.up);
+    assert(LIVENESS_DOWN == liveness_state(3, 4, NULL));
+    liveness_connected(1, 2);
+    assert(0 == count_changes(start + LIVENESS_STALE_SECONDS + 1)); // only reported once
+
+    // changes which couldn't be stored are reported again
+    liveness_connected(1, 2);
+    liveness_connected(3, 4);
+    GArray *changes = liveness_check(start + LIVENESS_STALE_SECONDS + 2);
+    assert(1 == changes->len);
+    assert(LIVENESS_DOWN == g_array_index(changes, LivenessChange, 0).previous);
+    liveness_revert(changes);
+    g_array_unref(changes);
+    assert(LIVENESS_DOWN == liveness_state(3, 4, NULL));
+    liveness_connected(1, 2);
+    liveness_connected(3, 4);
+    change = only_change(start + LIVENESS_STALE_SECONDS + 3);
+    assert((3 == change.rack_no) && change.up);
+    liveness_connected(1, 2);
+    change = only_change(start + LIVENESS_STALE_SECONDS + 4);
+    assert((3 == change.rack_no) && !change.up);
+
+    // node 1, 2 is no longer connected but sent an error recently so it is still up
+    time_t now = start + 200;
+    liveness_seen(1, 2, now - 10);
+    time_t last_seen = 0;
+    assert(LIVENESS_UP == liveness_state(1, 2, &last_seen));
+    assert(now - 10 == last_seen);
+    assert(0 == count_changes(now));
+
+    // until it goes quiet
+    now += LIVENESS_STALE_SECONDS;
+    change = only_change(now);
+    assert((1 == change.rack_no) && !change.up);
+
+    // errors bring a node back up without it connecting
+    liveness_seen(3, 4, now);
+    change = only_change(now + 1);
+    assert((3 == change.rack_no) && change.up);
+
+    // unknown nodes are ignored
+    liveness_seen(9, 9, now);
+    liveness_connected(9, 9);
+    assert(0 == count_changes(now + 2));
+    assert(LIVENESS_UNKNOWN == liveness_state(9, 9, &last_seen));
+    assert(0 == last_seen);
+
+    // versions change with nodes going up or down
+    const guint version = liveness_version();
+    liveness_connected(1, 2);
+    assert(1 == count_changes(now + 3));
+    assert(version != liveness_version());
+
+    liveness_remove_node(1, 2);
+    assert(LIVENESS_UNKNOWN == liveness_state(1, 2, NULL));
+    liveness_clear();
+    assert(LIVENESS_UNKNOWN == liveness_state(3, 4, NULL));
+}
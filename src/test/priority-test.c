@@ -0,0 +1,68 @@
+/*
+ * Copyright 2017
+ * GPL3 Licensed
+ * priority-test.c
+ * Tests for priority.c
+ */
+
+// includes
+#include "config.h"
+#include "priority.h"
+#include <assert.h>
+#include <stdio.h>
+#include <glib.h>
+
+// functions
+
+int main(void) {
+    // defaults by message type
+    assert(PRIORITY_HIGH == priority_classify(HARD_ERROR_VALVE, 1, 2, 3, "Hardware Error: heater"));
+    assert(PRIORITY_NORMAL == priority_classify(HARD_ERROR_OTHER, 1, 2, -1, "Hardware Error: fan"));
+    assert(PRIORITY_LOW == priority_classify(SOFT_ERROR, 1, 2, -1, "Software Error: crashed"));
+
+    // rules from the config file override them, most urgent first
+    gchar *path = g_build_filename(g_get_tmp_dir(), "mothership-priority-test.conf", NULL);
+    assert(NULL != path);
+    assert(TRUE == g_file_set_contents(path, "[priority]\n\
+high=rack=7 type=software;valve=200\n\
+low=type=hardware valve=100-300\n", -1, NULL));
+    assert(true == priority_load_rules(path));
+    assert(PRIORITY_HIGH == priority_classify(SOFT_ERROR, 7, 0, -1, "Software Error: crashed"));
+    assert(PRIORITY_LOW == priority_classify(SOFT_ERROR, 6, 0, -1, "Software Error: crashed"));
+    assert(PRIORITY_LOW == priority_classify(HARD_ERROR_VALVE, 1, 2, 150, "Hardware Error: heater"));
+    assert(PRIORITY_HIGH == priority_classify(HARD_ERROR_VALVE, 1, 2, 200, "Hardware Error: heater")); // both match
+    assert(PRIORITY_HIGH == priority_classify(HARD_ERROR_VALVE, 1, 2, 3, "Hardware Error: heater"));
+
+    // a bad rule keeps the old ones
+    assert(TRUE == g_file_set_contents(path, "[priority]\nnormal=rack=x\n", -1, NULL));
+    assert(false == priority_load_rules(path));
+    assert(PRIORITY_HIGH == priority_classify(SOFT_ERROR, 7, 0, -1, "Software Error: crashed"));
+    assert(0 == remove(path));
+    g_free(path);
+    priority_clear_rules();
+    assert(PRIORITY_LOW == priority_classify(SOFT_ERROR, 7, 0, -1, "Software Error: crashed"));
+
+    // the queue hands out the most urgent first, oldest first within a priority
+    PriorityQueue *queue = priority_queue_new();
+    int values[5] = {0, 1, 2, 3, 4};
+    priority_queue_push(queue, &values[0], PRIORITY_LOW);
+    priority_queue_push(queue, &values[1], PRIORITY_HIGH);
+    priority_queue_push(queue, &values[2], PRIORITY_NORMAL);
+    priority_queue_push(queue, &values[3], PRIORITY_HIGH);
+    priority_queue_push(queue, &values[4], PRIORITY_LOW);
+    assert(5 == priority_queue_length(queue));
+    assert(2 == priority_queue_length_at(queue, PRIORITY_LOW));
+
+    const int expected[5] = {1, 3, 2, 0, 4};
+    for (int i = 0; i < 5; i++) {
+        Priority priority = PRIORITY_LOW;
+        const int *value = priority_queue_pop(queue, &priority);
+        assert((NULL != value) && (expected[i] == *value));
+        assert((i < 2) ? (PRIORITY_HIGH == priority) : true);
+    }
+    assert(NULL == priority_queue_pop(queue, NULL));
+    assert(0 == priority_queue_length(queue));
+
+    priority_queue_push(queue, &values[0], PRIORITY_NORMAL);
+    priority_queue_free(queue, NULL);
+}
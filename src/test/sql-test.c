@@ -8,6 +8,11 @@
 // includes
 #include "config.h"
 #include "sql.h"
+#include "hot_tier.h"
+#include "node_activity.h"
+#include "topology.h"
+#include "liveness.h"
+#include "unacked.h"
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -16,6 +21,7 @@
 #include <string.h>
 #include <time.h>
 #include <edsac_arguments.h>
+#include <unistd.h>
 
 // functions
 
@@ -55,8 +61,28 @@ static BufferItem *error(int rack_no, int chassis_no, const char* msg, MessageTy
     return item;
 }
 
+// counts rows passed by foreach_error_matching and checks that they are in time order
+typedef struct {
+    gint64 rows;
+    time_t last_time;
+    gint64 stop_after; // 0 for never
+} RowCounter;
+
+static bool count_row(const time_t recv_time, __attribute__((unused)) const unsigned int rack_no,
+        __attribute__((unused)) const unsigned int chassis_no, __attribute__((unused)) const int valve_no,
+        __attribute__((unused)) const bool enabled, __attribute__((unused)) const bool acked, const char *description,
+        gpointer user_data) {
+    assert(NULL != description);
+    RowCounter *counter = user_data;
+    assert(recv_time >= counter->last_time);
+    counter->last_time = recv_time;
+    counter->rows += 1;
+    return (0 == counter->stop_after) || (counter->rows < counter->stop_after);
+}
+
 static void search_error(const unsigned int rack_no, const unsigned int chassis_no, const char *msg, MessageType type) {
     Clickable search;
+    search.time_range = TIME_ALL;
     search.type = CHASSIS;
     search.rack_num = rack_no;
     search.chassis_num = chassis_no;
@@ -104,6 +130,7 @@ int main(void) {
 
     // for count searching
     Clickable search;
+    search.time_range = TIME_ALL;
     search.type = RACK;
     search.rack_num = 0;
 
@@ -148,6 +175,7 @@ int main(void) {
     assert(true == add_error(error(0, 0, "", HARD_ERROR_OTHER)));
     assert(true == add_error(error(0, 0, "", SOFT_ERROR)));
     Clickable node00_search;
+    node00_search.time_range = TIME_ALL;
     node00_search.type = CHASSIS;
     node00_search.rack_num = 0;
     node00_search.chassis_num = 0;
@@ -195,6 +223,19 @@ int main(void) {
     assert(NULL == nodes_rack_1->next);
     assert(0 == (uintptr_t) nodes_rack_1->data);
 
+    // the topology agrees with the database
+    GArray *topology = topology_nodes();
+    assert(3 == topology->len);
+    assert(0 == g_array_index(topology, TopologyNode, 0).rack_no);
+    assert(2 == g_array_index(topology, TopologyNode, 1).chassis_no);
+    assert(1 == g_array_index(topology, TopologyNode, 2).rack_no);
+    g_array_unref(topology);
+    bool enabled = false;
+    assert(topology_node_exists(1, 0, &enabled) && enabled);
+    assert(true == node_toggle_disabled(1, 0));
+    assert(topology_node_exists(1, 0, &enabled) && !enabled);
+    assert(!topology_node_exists(0, 0, NULL));
+
     assert(true == remove_node(0, 1));
     assert(true == remove_node(0, 2));
     assert(true == remove_node(1, 0));
@@ -202,6 +243,296 @@ int main(void) {
     assert(NULL == list_racks());
     assert(NULL == list_chassis_by_rack(0));
     assert(NULL == list_chassis_by_rack(1));
+    assert(!topology_node_exists(1, 0, NULL));
+
+    // time ranges
+    assert(true == add_node(3, 0, true));
+    const time_t now = time(NULL);
+    assert(true == add_error_decoded(3, 0, -1, now - 2 * 24 * 60 * 60, "Software Error: old"));
+    assert(true == add_error_decoded(3, 0, -1, now - 2 * 60 * 60, "Software Error: earlier today"));
+    assert(true == add_error_decoded(3, 0, -1, now, "Software Error: new"));
+    Clickable recent;
+    memset(&recent, 0, sizeof(recent));
+    recent.type = CHASSIS;
+    recent.rack_num = 3;
+    recent.chassis_num = 0;
+    assert(3 == count_clickable(&recent)); // TIME_ALL
+    recent.time_range = TIME_LAST_DAY;
+    assert(2 == count_clickable(&recent));
+    recent.time_range = TIME_LAST_HOUR;
+    assert(1 == count_clickable(&recent));
+    recent.time_range = TIME_BETWEEN;
+    recent.since = now - 3 * 60 * 60;
+    recent.until = now;
+    assert(1 == count_clickable(&recent));
+    time_t since = 0;
+    time_t until = 0;
+    recent.time_range = TIME_SHIFT;
+    clickable_time_bounds(&recent, now, &since, &until);
+    assert((since <= now) && (since > now - 25 * 60 * 60) && (0 == until));
+    assert(true == remove_node(3, 0));
+
+    // full text search (only if sqlite has FTS5)
+    if (search_index_available()) {
+        assert(true == add_node(2, 0, true));
+        assert(true == add_error_decoded(2, 0, -1, time(NULL), "Hardware Error: HT supply low"));
+        assert(true == add_error_decoded(2, 0, 3, time(NULL), "Hardware Error: heater supply open"));
+        assert(true == add_error_decoded(2, 0, -1, time(NULL), "Software Error: \"HT\" isn't configured"));
+
+        Clickable text_search;
+        memset(&text_search, 0, sizeof(text_search));
+        text_search.type = SEARCH;
+        text_search.text = g_intern_string("ht supply");
+        assert(1 == count_clickable(&text_search));
+        text_search.text = g_intern_string("supply");
+        assert(2 == count_clickable(&text_search));
+        text_search.text = g_intern_string("\"HT\" isn't");
+        assert(1 == count_clickable(&text_search));
+        text_search.text = g_intern_string("heat*");
+        assert(1 == count_clickable(&text_search));
+        text_search.text = g_intern_string("  ");
+        assert(-1 == count_clickable(&text_search));
+
+        // deleted errors leave the index
+        assert(true == remove_node(2, 0));
+        text_search.text = g_intern_string("supply");
+        assert(0 == count_clickable(&text_search));
+    }
+
+    // several nodes in one tab
+    assert(true == add_node(6, 0, true));
+    assert(true == add_node(6, 1, true));
+    assert(true == add_node(7, 0, true));
+    assert(true == add_error_decoded(6, 0, -1, now - 3, "Software Error: a"));
+    assert(true == add_error_decoded(6, 1, -1, now - 2, "Software Error: b"));
+    assert(true == add_error_decoded(7, 0, -1, now - 1, "Software Error: c"));
+    assert(true == add_error_decoded(6, 0, -1, now, "Software Error: d"));
+
+    NodeIdentifier set_nodes[] = {{7, 0}, {6, 0}, {7, 0}};
+    GSList *node_ids = NULL;
+    for (size_t i = 0; i < G_N_ELEMENTS(set_nodes); i++) {
+        node_ids = g_slist_prepend(node_ids, &set_nodes[i]);
+    }
+    const char *set_text = node_set_text(node_ids);
+    g_slist_free(node_ids);
+    assert(0 == strcmp("6.0,7.0", set_text));
+    assert(2 == node_set_members(set_text)->len);
+    assert(NULL == node_set_text(NULL));
+    assert(NULL == node_set_members(g_intern_string("6.0,x")));
+
+    Clickable node_set;
+    memset(&node_set, 0, sizeof(node_set));
+    node_set.type = NODE_SET;
+    node_set.text = set_text;
+    for (int pass = 0; pass < 2; pass++) {
+        assert(3 == count_clickable(&node_set));
+        GList *set_results = search_clickable(&node_set);
+        assert(3 == g_list_length(set_results));
+        assert(g_str_has_suffix(((SearchResult *) g_list_last(set_results)->data)->message, "Software Error: d"));
+        g_list_free_full(set_results, free_search_result);
+
+        hot_tier_init(0); // now only the database
+    }
+
+    // error rates come from the rollup, which keeps counts after compaction
+    assert(true == add_node(8, 0, true));
+    const time_t minute = now - now % 60;
+    assert(true == add_error_decoded(8, 0, -1, minute, "Software Error: a"));
+    assert(true == add_error_decoded(8, 0, 4, minute, "Hardware Error: b"));
+    assert(true == add_error_decoded(8, 0, -1, minute - 60, "Software Error: c"));
+    assert(true == add_error_decoded(8, 0, -1, minute - 3 * 24 * 60 * 60, "Software Error: d"));
+    Clickable node80;
+    memset(&node80, 0, sizeof(node80));
+    node80.type = CHASSIS;
+    node80.rack_num = 8;
+    guint rate[4];
+    for (int pass = 0; pass < 2; pass++) {
+        assert(true == rollup_clickable(&node80, now, 60, G_N_ELEMENTS(rate), rate));
+        assert((0 == rate[0]) && (0 == rate[1]) && (1 == rate[2]) && (2 == rate[3]));
+
+        assert(true == rollup_clickable(&node80, now, 24 * 60 * 60, G_N_ELEMENTS(rate), rate));
+        assert(4 == rate[0] + rate[1] + rate[2] + rate[3]);
+
+        assert(true == compact_rollup(now));
+    }
+    node80.type = VALVE;
+    node80.valve_num = 4;
+    assert(true == rollup_clickable(&node80, now, 60, G_N_ELEMENTS(rate), rate));
+    assert(1 == rate[3]);
+    node80.type = SEARCH;
+    assert(false == rollup_clickable(&node80, now, 60, G_N_ELEMENTS(rate), rate));
+
+    // the overview counts recent errors as they arrive, without the database
+    const guint version = node_activity_version();
+    assert(true == add_error_decoded(8, 0, -1, now, "Software Error: e"));
+    assert(version != node_activity_version());
+    assert(true == node_toggle_disabled(8, 0));
+    GArray *activity = node_activity_snapshot(now);
+    const NodeActivity *node8 = NULL;
+    for (guint i = 0; i < activity->len; i++) {
+        const NodeActivity *node = &g_array_index(activity, NodeActivity, i);
+        if ((8 == node->rack_no) && (0 == node->chassis_no)) {
+            node8 = node;
+        }
+    }
+    assert(NULL != node8);
+    assert(4 == node8->recent); // the three-day-old error isn't recent
+    assert(!node8->enabled);
+    g_array_unref(activity);
+    assert(true == node_toggle_disabled(8, 0));
+
+    // errors from several chassis of one rack at once become a rack event
+    const guint events_version = rack_events_version();
+    for (unsigned int chassis = 0; chassis < 4; chassis++) {
+        assert(true == add_node(10, chassis, true));
+    }
+    assert(true == add_error_decoded(10, 0, -1, now - 100, "Software Error: power"));
+    assert(true == add_error_decoded(10, 1, -1, now - 100, "Software Error: power"));
+    assert(events_version == rack_events_version()); // two chassis aren't enough
+    assert(true == add_error_decoded(10, 2, -1, now - 99, "Software Error: power"));
+    assert(true == add_error_decoded(10, 3, -1, now - 99, "Software Error: power")); // joins the event
+    assert(true == add_error_decoded(10, 0, -1, now - 50, "Software Error: later")); // too late
+    assert(events_version != rack_events_version());
+    GList *events = get_rack_events(5);
+    assert(1 == g_list_length(events));
+    const RackEvent *event = events->data;
+    assert((10 == event->rack_no) && (now - 100 == event->start_time) && (now - 99 == event->end_time));
+    assert((4 == event->chassis_count) && (0 == event->valve_count) && (4 == event->error_count));
+    g_list_free_full(events, g_free);
+
+    // errors put back from an archive are too old to be correlated
+    const guint restored_version = rack_events_version();
+    for (unsigned int chassis = 0; chassis < 4; chassis++) {
+        assert(true == add_node(13, chassis, true));
+        assert(true == restore_error(13, chassis, -1, now - 10, "Software Error: restored", true, false));
+    }
+    assert(restored_version == rack_events_version());
+
+    // errors differing only by numbers share a template
+    for (int retry = 1; retry <= 5; retry++) {
+        char retry_msg[64];
+        snprintf(retry_msg, sizeof(retry_msg), "Software Error: retry %i after %ims", retry, retry * 250);
+        assert(true == add_error_decoded(10, 1, -1, now - 200, retry_msg));
+    }
+    GList *counts = count_templates(now - 300, 100);
+    assert(NULL != counts);
+    guint found_templates = 0;
+    for (const GList *item = counts; NULL != item; item = item->next) {
+        const TemplateCount *count = item->data;
+        if (0 == strcmp("Software Error: retry # after #ms", count->text)) {
+            assert(5 == count->count);
+            found_templates++;
+        } else if (0 == strcmp("Software Error: power", count->text)) {
+            assert(4 == count->count);
+            found_templates++;
+        }
+    }
+    assert(2 == found_templates);
+    g_list_free_full(counts, free_template_count);
+
+    // nodes which go quiet get one "Node not connected" error when they go down
+    assert(true == add_node(11, 0, true));
+    liveness_seen(11, 0, now);
+    assert(true == update_liveness(NULL, now));
+    assert(LIVENESS_UP == liveness_state(11, 0, NULL));
+    Clickable node110_search;
+    memset(&node110_search, 0, sizeof(node110_search));
+    node110_search.time_range = TIME_ALL;
+    node110_search.type = CHASSIS;
+    node110_search.rack_num = 11;
+    assert(0 == count_clickable(&node110_search));
+    assert(true == update_liveness(NULL, now + LIVENESS_STALE_SECONDS));
+    assert(true == update_liveness(NULL, now + LIVENESS_STALE_SECONDS + 1));
+    assert(LIVENESS_DOWN == liveness_state(11, 0, NULL));
+    assert(1 == count_clickable(&node110_search));
+
+    // and the changes are kept as connection history
+    NodeUptime uptime;
+    const time_t later = now + LIVENESS_STALE_SECONDS + 100;
+    assert(true == node_uptime(11, 0, 0, later, &uptime));
+    assert(uptime.known && !uptime.up && (now == uptime.since));
+    assert((LIVENESS_STALE_SECONDS == uptime.up_seconds) && (100 == uptime.down_seconds) && (1 == uptime.flaps));
+    assert(true == node_uptime(11, 0, now + 10, later, &uptime));
+    assert((LIVENESS_STALE_SECONDS - 10 == uptime.up_seconds) && (100 == uptime.down_seconds) && (1 == uptime.flaps));
+    assert(true == node_uptime(11, 0, later, later + 10, &uptime));
+    assert(uptime.known && (0 == uptime.up_seconds) && (10 == uptime.down_seconds) && (0 == uptime.flaps));
+    assert(true == node_uptime(11, 0, now - 100, now - 10, &uptime));
+    assert(!uptime.known);
+    GList *history = node_connection_history(11, 0, 10);
+    assert(2 == g_list_length(history));
+    assert(((LivenessChange *) history->data)->up && (now == ((LivenessChange *) history->data)->time));
+    g_list_free_full(history, g_free);
+
+    // acknowledged errors are hidden and counted without querying
+    Clickable rack10_search;
+    memset(&rack10_search, 0, sizeof(rack10_search));
+    rack10_search.time_range = TIME_ALL;
+    rack10_search.type = RACK;
+    rack10_search.rack_num = 10;
+    Clickable node101_search = rack10_search;
+    node101_search.type = CHASSIS;
+    node101_search.chassis_num = 1;
+    assert(10 == unacked_count(&rack10_search));
+    assert(6 == set_errors_acked(&node101_search, true, "operator"));
+    assert(0 == set_errors_acked(&node101_search, true, "operator")); // already acknowledged
+    assert(0 == unacked_count(&node101_search));
+    assert(4 == unacked_count(&rack10_search));
+    assert(4 == count_clickable(&rack10_search));
+    set_show_acked(true);
+    assert(10 == count_clickable(&rack10_search));
+    GList *acked = search_clickable(&node101_search);
+    assert(6 == g_list_length(acked));
+    const SearchResult *acked_result = acked->data;
+    assert(acked_result->acked);
+    time_t ack_time = 0;
+    char *ack_user = NULL;
+    assert(true == error_ack_info(acked_result->id, &ack_time, &ack_user));
+    assert((0 == strcmp("operator", ack_user)) && (ack_time >= now));
+    g_free(ack_user);
+    GArray *ack_ids = g_array_new(FALSE, FALSE, sizeof(gint64));
+    const gint64 acked_id = acked_result->id;
+    g_array_append_val(ack_ids, acked_id);
+    g_list_free_full(acked, free_search_result);
+    set_show_acked(false);
+    assert(1 == set_error_ids_acked(ack_ids, false, NULL));
+    assert(false == error_ack_info(acked_id, &ack_time, &ack_user));
+    assert(1 == unacked_count(&node101_search));
+    assert(5 == count_clickable(&rack10_search));
+    g_array_unref(ack_ids);
+
+    // streaming errors matching a filter, in chunks which all have the same time
+    assert(true == add_node(12, 0, true));
+    assert(true == add_node(12, 1, false));
+    begin_batch();
+    for (int i = 0; i < 2500; i++) {
+        assert(true == add_error_decoded(12, (unsigned int) (i % 2), i % 10, now - 60, "Hardware Error: heater"));
+    }
+    assert(true == end_batch());
+    char *stream_error = NULL;
+    Filter *stream_filter = filter_parse("rack=12", &stream_error);
+    assert(NULL != stream_filter);
+    RowCounter counter = {0, 0, 0};
+    assert(2500 == foreach_error_matching(stream_filter, 0, 0, count_row, &counter));
+    assert(2500 == counter.rows);
+    filter_free(stream_filter);
+    stream_filter = filter_parse("rack=12 valve=0-4 enabled", &stream_error); // node 12.1 is disabled
+    assert(NULL != stream_filter);
+    memset(&counter, 0, sizeof(counter));
+    assert(750 == foreach_error_matching(stream_filter, now - 120, now, count_row, &counter));
+    memset(&counter, 0, sizeof(counter));
+    assert(0 == foreach_error_matching(stream_filter, now - 30, 0, count_row, &counter));
+    memset(&counter, 0, sizeof(counter));
+    counter.stop_after = 10;
+    assert(10 == foreach_error_matching(stream_filter, 0, 0, count_row, &counter));
+    filter_free(stream_filter);
+
+    // online backup of the (memory) database to a file
+    gchar *backup_path = g_build_filename(g_get_tmp_dir(), "mothership-backup-test.db", NULL);
+    assert(NULL != backup_path);
+    assert(true == backup_database(backup_path, NULL, NULL));
+    assert(0 == access(backup_path, R_OK));
+    assert(0 == remove(backup_path));
+    g_free(backup_path);
 
     close_database();
 }
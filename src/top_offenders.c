@@ -0,0 +1,236 @@
+/*
+ * Copyright 2017
+ * GPL3 Licensed
+ * top_offenders.c
+ * Panel listing the valves and nodes sending the most errors recently (see heavy_hitters.h) and the latest rack
+ * events (see correlator.h)
+ */
+
+// includes
+#include "config.h"
+#include "top_offenders.h"
+#include "heavy_hitters.h"
+#include "sql.h"
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+// seconds between checks for errors becoming too old to be recent
+#define REFRESH_INTERVAL 30
+
+typedef struct {
+    top_offenders_click_t on_click;
+    gpointer user_data;
+    guint timer;            // for REFRESH_INTERVAL
+    guint filled_version;   // heavy_hitters_version when last filled
+    gint64 filled_minute;
+    guint events_version;   // rack_events_version when event_list was last filled
+    GtkListBox *valve_list;
+    GtkListBox *node_list;
+    GtkListBox *event_list;
+    GArray *valves;         // HeavyHitters shown in valve_list, in order
+    GArray *nodes;          // HeavyHitters shown in node_list, in order
+    GList *events;          // RackEvents shown in event_list, in order
+} TopOffendersState;
+
+// functions
+
+static void free_top_offenders_state(gpointer data) {
+    TopOffendersState *state = data;
+    g_source_remove(state->timer);
+    if (NULL != state->valves) {
+        g_array_unref(state->valves);
+        g_array_unref(state->nodes);
+    }
+    g_list_free_full(state->events, g_free);
+    g_free(state);
+}
+
+static void clear_list(GtkListBox *list) {
+    GList *rows = gtk_container_get_children(GTK_CONTAINER(list));
+    for (GList *row = rows; NULL != row; row = row->next) {
+        gtk_widget_destroy(GTK_WIDGET(row->data));
+    }
+    g_list_free(rows);
+}
+
+static void add_row(GtkListBox *list, const char *text) {
+    GtkWidget *label = gtk_label_new(text);
+    assert(NULL != label);
+    gtk_widget_set_halign(label, GTK_ALIGN_START);
+    gtk_list_box_insert(list, label, -1);
+}
+
+static void add_empty_row(GtkListBox *list, const char *text) {
+    GtkWidget *label = gtk_label_new(text);
+    assert(NULL != label);
+    gtk_widget_set_sensitive(label, FALSE);
+    gtk_list_box_insert(list, label, -1);
+}
+
+static void fill_list(GtkListBox *list, const GArray *hitters) {
+    clear_list(list);
+
+    char text[128];
+    for (guint i = 0; i < hitters->len; i++) {
+        const HeavyHitter *hitter = &g_array_index(hitters, HeavyHitter, i);
+
+        int len = 0;
+        if (hitter->valve_no >= 0) {
+            len = snprintf(text, sizeof(text), "Rack %u, Chassis %u, Valve %i: ", hitter->rack_no, hitter->chassis_no, hitter->valve_no);
+        } else {
+            len = snprintf(text, sizeof(text), "Rack %u, Chassis %u: ", hitter->rack_no, hitter->chassis_no);
+        }
+        assert((len > 0) && ((size_t) len < sizeof(text)));
+
+        // counts are exact unless the summary was full
+        if (0 == hitter->error) {
+            snprintf(text + len, sizeof(text) - (size_t) len, "%u errors", hitter->count);
+        } else {
+            snprintf(text + len, sizeof(text) - (size_t) len, "%u to %u errors", hitter->count - hitter->error, hitter->count);
+        }
+
+        add_row(list, text);
+    }
+
+    if (0 == hitters->len) {
+        add_empty_row(list, "No recent errors");
+    }
+
+    gtk_widget_show_all(GTK_WIDGET(list));
+}
+
+static void fill_events(TopOffendersState *state) {
+    g_list_free_full(state->events, g_free);
+    state->events_version = rack_events_version();
+    state->events = get_rack_events(TOP_OFFENDERS_ROWS);
+
+    clear_list(state->event_list);
+    char text[128];
+    char when[32];
+    for (const GList *item = state->events; NULL != item; item = item->next) {
+        const RackEvent *event = item->data;
+        struct tm start;
+        assert(NULL != localtime_r(&event->start_time, &start));
+        strftime(when, sizeof(when), "%d %b %H:%M:%S", &start);
+        snprintf(text, sizeof(text), "Rack %u at %s: %u chassis, %u valves, %u errors in %lis", event->rack_no, when,
+            event->chassis_count, event->valve_count, event->error_count, event->end_time - event->start_time + 1);
+        add_row(state->event_list, text);
+    }
+
+    if (NULL == state->events) {
+        add_empty_row(state->event_list, "No rack events");
+    }
+
+    gtk_widget_show_all(GTK_WIDGET(state->event_list));
+}
+
+static void fill(TopOffendersState *state) {
+    if (NULL != state->valves) {
+        g_array_unref(state->valves);
+        g_array_unref(state->nodes);
+    }
+
+    state->filled_version = heavy_hitters_version();
+    const time_t now = time(NULL);
+    state->filled_minute = now / 60;
+    state->valves = heavy_hitters_top(true, TOP_OFFENDERS_ROWS, now);
+    state->nodes = heavy_hitters_top(false, TOP_OFFENDERS_ROWS, now);
+
+    fill_list(state->valve_list, state->valves);
+    fill_list(state->node_list, state->nodes);
+}
+
+static void row_activated(GtkListBox *list, GtkListBoxRow *row, TopOffendersState *state) {
+    const gint index = gtk_list_box_row_get_index(row);
+    if (index < 0) {
+        return;
+    }
+
+    Clickable link;
+    memset(&link, 0, sizeof(link));
+    link.time_range = DEFAULT_TIME_RANGE;
+
+    if (list == state->event_list) {
+        const RackEvent *event = g_list_nth_data(state->events, (guint) index);
+        if (NULL == event) {
+            return; // "No rack events"
+        }
+        link.type = RACK;
+        link.rack_num = event->rack_no;
+        link.time_range = TIME_BETWEEN;
+        link.since = event->start_time;
+        link.until = event->end_time + 1;
+    } else {
+        const GArray *hitters = (list == state->valve_list) ? state->valves : state->nodes;
+        if ((guint) index >= hitters->len) {
+            return; // "No recent errors"
+        }
+        const HeavyHitter *hitter = &g_array_index(hitters, HeavyHitter, index);
+        link.type = (hitter->valve_no >= 0) ? VALVE : CHASSIS;
+        link.rack_num = hitter->rack_no;
+        link.chassis_num = hitter->chassis_no;
+        link.valve_num = hitter->valve_no;
+    }
+
+    // on_click might cause a refill but link is a copy
+    state->on_click(&link, state->user_data);
+}
+
+static GtkListBox *new_list(GtkBox *box, const char *heading, TopOffendersState *state) {
+    GtkWidget *label = gtk_label_new(NULL);
+    assert(NULL != label);
+    gchar *markup = g_markup_printf_escaped("<b>%s</b>", heading);
+    gtk_label_set_markup(GTK_LABEL(label), markup);
+    g_free(markup);
+    gtk_widget_set_halign(label, GTK_ALIGN_START);
+    gtk_box_pack_start(box, label, FALSE, FALSE, 4);
+
+    GtkWidget *list = gtk_list_box_new();
+    assert(NULL != list);
+    gtk_list_box_set_activate_on_single_click(GTK_LIST_BOX(list), TRUE);
+    g_signal_connect(G_OBJECT(list), "row-activated", G_CALLBACK(row_activated), state);
+    gtk_box_pack_start(box, list, FALSE, FALSE, 0);
+
+    return GTK_LIST_BOX(list);
+}
+
+static gboolean top_offenders_timer(gpointer data) {
+    top_offenders_update(GTK_WIDGET(data));
+    return G_SOURCE_CONTINUE;
+}
+
+GtkWidget *top_offenders_new(top_offenders_click_t on_click, gpointer user_data) {
+    assert(NULL != on_click);
+
+    GtkWidget *box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 0);
+    assert(NULL != box);
+
+    TopOffendersState *state = g_malloc0(sizeof(TopOffendersState));
+    assert(NULL != state);
+    state->on_click = on_click;
+    state->user_data = user_data;
+    state->valve_list = new_list(GTK_BOX(box), "Noisiest valves", state);
+    state->node_list = new_list(GTK_BOX(box), "Noisiest nodes", state);
+    state->event_list = new_list(GTK_BOX(box), "Rack events", state);
+    state->timer = g_timeout_add_seconds(REFRESH_INTERVAL, top_offenders_timer, box);
+    g_object_set_data_full(G_OBJECT(box), "top_offenders", state, free_top_offenders_state);
+
+    fill(state);
+    fill_events(state);
+    return box;
+}
+
+void top_offenders_update(GtkWidget *top_offenders) {
+    assert(NULL != top_offenders);
+    TopOffendersState *state = g_object_get_data(G_OBJECT(top_offenders), "top_offenders");
+    assert(NULL != state);
+
+    if ((state->filled_version != heavy_hitters_version()) || (state->filled_minute != time(NULL) / 60)) {
+        fill(state);
+    }
+    if (state->events_version != rack_events_version()) {
+        fill_events(state);
+    }
+}
@@ -0,0 +1,129 @@
+/*
+ * Copyright 2017
+ * GPL3 Licensed
+ * topology.c
+ * Every node (rack and chassis) and whether it is enabled, kept in memory so that menus and checks don't query the
+ * database
+ */
+
+// includes
+#include "config.h"
+#include "topology.h"
+#include <assert.h>
+
+static GMutex topology_lock; // protects racks
+static GTree *racks = NULL; // rack_no -> GTree of chassis_no -> enabled (as ENABLED or DISABLED)
+
+#define ENABLED GINT_TO_POINTER(1)
+#define DISABLED GINT_TO_POINTER(2) // not NULL so that it can be told apart from a missing node
+
+// functions
+
+// Implements GCompareDataFunc for keys made with GUINT_TO_POINTER
+static gint compare_numbers(gconstpointer a, gconstpointer b, __attribute__((unused)) gpointer unused) {
+    const guint A = GPOINTER_TO_UINT(a);
+    const guint B = GPOINTER_TO_UINT(b);
+    return (A < B) ? -1 : (A > B);
+}
+
+static void free_chassis_tree(gpointer tree) {
+    g_tree_destroy(tree);
+}
+
+// call with topology_lock held
+static GTree *get_racks(void) {
+    if (NULL == racks) {
+        racks = g_tree_new_full(compare_numbers, NULL, NULL, free_chassis_tree);
+        assert(NULL != racks);
+    }
+    return racks;
+}
+
+void topology_clear(void) {
+    g_mutex_lock(&topology_lock);
+    if (NULL != racks) {
+        g_tree_destroy(racks);
+        racks = NULL;
+    }
+    g_mutex_unlock(&topology_lock);
+}
+
+void topology_set_node(const unsigned int rack_no, const unsigned int chassis_no, const bool enabled) {
+    g_mutex_lock(&topology_lock);
+
+    GTree *chassis = g_tree_lookup(get_racks(), GUINT_TO_POINTER(rack_no));
+    if (NULL == chassis) {
+        chassis = g_tree_new_full(compare_numbers, NULL, NULL, NULL);
+        assert(NULL != chassis);
+        g_tree_insert(racks, GUINT_TO_POINTER(rack_no), chassis);
+    }
+    g_tree_insert(chassis, GUINT_TO_POINTER(chassis_no), enabled ? ENABLED : DISABLED);
+
+    g_mutex_unlock(&topology_lock);
+}
+
+void topology_remove_node(const unsigned int rack_no, const unsigned int chassis_no) {
+    g_mutex_lock(&topology_lock);
+
+    GTree *chassis = g_tree_lookup(get_racks(), GUINT_TO_POINTER(rack_no));
+    if (NULL != chassis) {
+        g_tree_remove(chassis, GUINT_TO_POINTER(chassis_no));
+        if (0 == g_tree_nnodes(chassis)) {
+            g_tree_remove(racks, GUINT_TO_POINTER(rack_no));
+        }
+    }
+
+    g_mutex_unlock(&topology_lock);
+}
+
+bool topology_node_exists(const unsigned int rack_no, const unsigned int chassis_no, bool *enabled) {
+    g_mutex_lock(&topology_lock);
+
+    gpointer state = NULL;
+    GTree *chassis = g_tree_lookup(get_racks(), GUINT_TO_POINTER(rack_no));
+    if (NULL != chassis) {
+        state = g_tree_lookup(chassis, GUINT_TO_POINTER(chassis_no));
+    }
+
+    g_mutex_unlock(&topology_lock);
+
+    if ((NULL != state) && (NULL != enabled)) {
+        *enabled = (ENABLED == state);
+    }
+    return NULL != state;
+}
+
+// for collecting nodes with g_tree_foreach
+typedef struct {
+    GArray *nodes;
+    unsigned int rack_no;
+} Collector;
+
+static gboolean collect_chassis(gpointer key, gpointer value, gpointer data) {
+    Collector *collector = data;
+    TopologyNode node;
+    node.rack_no = collector->rack_no;
+    node.chassis_no = GPOINTER_TO_UINT(key);
+    node.enabled = (ENABLED == value);
+    g_array_append_val(collector->nodes, node);
+    return FALSE;
+}
+
+static gboolean collect_rack(gpointer key, gpointer value, gpointer data) {
+    Collector *collector = data;
+    collector->rack_no = GPOINTER_TO_UINT(key);
+    g_tree_foreach(value, collect_chassis, collector);
+    return FALSE;
+}
+
+GArray *topology_nodes(void) {
+    Collector collector;
+    collector.nodes = g_array_new(FALSE, FALSE, sizeof(TopologyNode));
+    assert(NULL != collector.nodes);
+
+    g_mutex_lock(&topology_lock);
+    g_tree_foreach(get_racks(), collect_rack, &collector);
+    g_mutex_unlock(&topology_lock);
+
+    return collector.nodes;
+}
@@ -16,11 +16,26 @@
 #include <edsac_timer.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
+#include <sys/stat.h>
+#include <glib/gstdio.h>
 #include "node_setup.h"
+#include "archive.h"
+#include "ingest.h"
+#include "filter.h"
+#include "node_activity.h"
+#include "topology.h"
+#include "node_browser.h"
+#include "liveness.h"
+#include "alerts.h"
 
 extern const char * g_prefix_path; // main.c
 
+#define JOB_MESSAGE_TIMEOUT 10 // seconds to leave the result of a background job in the status bar
+#define ARCHIVE_AGE (90 * 24 * 60 * 60) // seconds after which errors are moved out of the database into an archive
+#define NODE_HISTORY_CHANGES 20 // connection changes listed in a node's history
+
 // declarations
 static void activate(GtkApplication *app, gpointer data);
 static void shutdown_handler(__attribute__((unused)) GApplication *app, gpointer user_data);
@@ -28,14 +43,46 @@ static void shutdown_handler(__attribute__((unused)) GApplication *app, gpointer
 static EdsacErrorNotebook *notebook = NULL;
 static GtkStatusbar *bar = NULL;
 static GtkWindow *main_window = NULL;
+static GtkWidget *node_browser = NULL;
+static GtkApplication *application = NULL; // sends alert notifications
+static GtkWidget *banners = NULL; // box of pinned alert banners above the notebook
 static GMenu *model = NULL;
+static gint backup_running = 0; // only access atomically
+static gint archive_running = 0; // only access atomically
+static TimeRange time_range = DEFAULT_TIME_RANGE; // for tabs opened from menus
+
+// names of the time range presets used as the state of the time_range action
+static const struct {
+    const char *name;
+    const char *label;
+    TimeRange time_range;
+} time_range_presets[] = {
+    {"hour", "Last Hour", TIME_LAST_HOUR},
+    {"shift", "Since Shift Change", TIME_SHIFT},
+    {"today", "Today", TIME_TODAY},
+    {"day", "Last 24 Hours", TIME_LAST_DAY},
+    {"all", "All Time", TIME_ALL}
+};
+
+// progress of a backup passed from the backup thread to the gui thread
+typedef struct {
+    int remaining;  // pages left to copy. Negative once the backup has finished
+    int total;      // total pages in the database
+    bool success;   // only valid once finished
+    char *path;     // only set once finished
+} BackupStatus;
+
+// a status bar message which goes away after a while
+typedef struct {
+    guint context;
+    guint id;
+} StatusMessage;
 
 // functions
 
 int start_ui(int *argc, char ***argv, gpointer timer_id) {
     assert(NULL != argc);
     assert(NULL != argv);
-    assert(NULL != timer_id);
 
     gtk_init(argc, argv);
 
@@ -46,7 +93,13 @@ int start_ui(int *argc, char ***argv, gpointer timer_id) {
     return g_application_run(G_APPLICATION(app), *argc, *argv);
 }
 
-static void update_bar(void) {
+void update_bar(void) {
+    if (edsac_error_notebook_showing_dashboard(notebook)) {
+        gtk_statusbar_pop(bar, 0);
+        gtk_statusbar_push(bar, 0, "Errors per node over the last " G_STRINGIFY(NODE_ACTIVITY_MINUTES) " minutes. Click a node to show its errors");
+        return;
+    }
+
     const int num_errors = edsac_error_notebook_get_error_count(notebook);
 
     GString *msg = g_string_new(NULL);
@@ -62,8 +115,12 @@ static void update_bar(void) {
         g_string_sprintf(msg, "Failure to count errors (something is probably very wrong)");
     }
 
-    if (!get_show_disabled()) {
+    if (!get_show_disabled() && !get_show_acked()) {
+        g_string_append(msg, " (disabled and acknowledged items hidden and not counted)");
+    } else if (!get_show_disabled()) {
         g_string_append(msg, " (disabled items hidden and not counted)");
+    } else if (!get_show_acked()) {
+        g_string_append(msg, " (acknowledged items hidden and not counted)");
     }
 
     gtk_statusbar_pop(bar, 0);
@@ -71,15 +128,345 @@ static void update_bar(void) {
     g_string_free(msg, TRUE);
 }
 
+static void banner_response(GtkInfoBar *banner, __attribute__((unused)) gint response_id) {
+    gtk_widget_destroy(GTK_WIDGET(banner));
+}
+
+// pin a banner for an alert rule above the notebook. Replaces the text of the rule's banner if it is still there
+static void show_banner(const char *rule, const char *text) {
+    gchar *markup = g_markup_printf_escaped("<b>%s</b>  %s", rule, text);
+    assert(NULL != markup);
+
+    GList *children = gtk_container_get_children(GTK_CONTAINER(banners));
+    for (const GList *child = children; NULL != child; child = child->next) {
+        const char *child_rule = g_object_get_data(G_OBJECT(child->data), "rule");
+        if ((NULL != child_rule) && (0 == strcmp(rule, child_rule))) {
+            GtkLabel *label = g_object_get_data(G_OBJECT(child->data), "label");
+            gtk_label_set_markup(label, markup);
+            g_free(markup);
+            g_list_free(children);
+            return;
+        }
+    }
+    g_list_free(children);
+
+    GtkWidget *label = gtk_label_new(NULL);
+    assert(NULL != label);
+    gtk_label_set_markup(GTK_LABEL(label), markup);
+    gtk_label_set_line_wrap(GTK_LABEL(label), TRUE);
+    g_free(markup);
+
+    GtkWidget *banner = gtk_info_bar_new();
+    assert(NULL != banner);
+    gtk_info_bar_set_message_type(GTK_INFO_BAR(banner), GTK_MESSAGE_WARNING);
+    gtk_info_bar_set_show_close_button(GTK_INFO_BAR(banner), TRUE);
+    gtk_container_add(GTK_CONTAINER(gtk_info_bar_get_content_area(GTK_INFO_BAR(banner))), label);
+    g_object_set_data_full(G_OBJECT(banner), "rule", g_strdup(rule), g_free);
+    g_object_set_data(G_OBJECT(banner), "label", label);
+    g_signal_connect(G_OBJECT(banner), "response", G_CALLBACK(banner_response), NULL);
+
+    gtk_box_pack_start(GTK_BOX(banners), banner, FALSE, FALSE, 0);
+    gtk_widget_show_all(banner);
+}
+
+// tell the operator about alerts which have fired since last time (see alerts.h)
+static void show_alerts(void) {
+    if (NULL == banners) {
+        return; // no window yet. They wait
+    }
+
+    GList *alerts = alerts_take();
+    bool bell = false;
+    for (const GList *item = alerts; NULL != item; item = item->next) {
+        const Alert *alert = item->data;
+
+        GString *text = g_string_new(NULL);
+        assert(NULL != text);
+        g_string_printf(text, "Rack %u, Chassis %u", alert->rack_no, alert->chassis_no);
+        if (alert->valve_no >= 0) {
+            g_string_append_printf(text, ", Valve %i", alert->valve_no);
+        }
+        g_string_append_printf(text, ": %s", alert->description);
+        if (alert->count > 1) {
+            g_string_append_printf(text, " (%u errors)", alert->count);
+        }
+
+        if (0 != (alert->actions & ALERT_NOTIFY)) {
+            GNotification *notification = g_notification_new(alert->rule);
+            assert(NULL != notification);
+            g_notification_set_body(notification, text->str);
+            // one notification per rule, replaced when it fires again
+            g_application_send_notification(G_APPLICATION(application), alert->rule, notification);
+            g_object_unref(notification);
+        }
+        if (0 != (alert->actions & ALERT_BANNER)) {
+            show_banner(alert->rule, text->str);
+        }
+        if (0 != (alert->actions & ALERT_BELL)) {
+            bell = true;
+        }
+
+        g_string_free(text, TRUE);
+    }
+    g_list_free_full(alerts, free_alert);
+
+    if (bell) {
+        gdk_display_beep(gtk_widget_get_display(GTK_WIDGET(main_window)));
+    }
+}
+
 // called when gtk gets around to updating the gui
 void gui_update(gpointer g_idle_id) {
     if (NULL != g_idle_id) {
         assert(TRUE == g_idle_remove_by_data(g_idle_id));
     }
+    show_alerts();
     edsac_error_notebook_update(notebook);
+    node_browser_update(node_browser);
     update_bar();
 }
 
+// removes a status bar message (a StatusMessage) if it is still there. Later messages in its context stay
+static gboolean clear_status_message(gpointer data) {
+    assert(NULL != data);
+    StatusMessage *message = data;
+    gtk_statusbar_remove(bar, message->context, message->id);
+    g_free(message);
+    return G_SOURCE_REMOVE;
+}
+
+// show text in the status bar instead of the last message for the named context. If temporary it is removed after
+// JOB_MESSAGE_TIMEOUT
+static void push_status(const char *context_name, const char *text, const bool temporary) {
+    assert(NULL != context_name);
+    assert(NULL != text);
+
+    const guint context = gtk_statusbar_get_context_id(bar, context_name);
+    gtk_statusbar_pop(bar, context);
+    const guint id = gtk_statusbar_push(bar, context, text);
+
+    if (temporary) {
+        StatusMessage *message = g_malloc(sizeof(StatusMessage));
+        assert(NULL != message);
+        message->context = context;
+        message->id = id;
+        g_timeout_add_seconds(JOB_MESSAGE_TIMEOUT, clear_status_message, message);
+    }
+}
+
+// called in the gui thread once a background job has finished. data is the message to show
+static gboolean show_job_result(gpointer data) {
+    assert(NULL != data);
+
+    push_status("job", (const char *) data, true);
+    g_free(data);
+
+    // the job might have changed the database
+    gui_update(NULL);
+    return G_SOURCE_REMOVE;
+}
+
+// path to a new file in a subdirectory of the prefix directory, named with the current time. NULL on failure
+static char *timestamped_path(const char *subdir, const char *name, const char *extension) {
+    assert(NULL != subdir);
+    assert(NULL != name);
+    assert(NULL != extension);
+
+    GString *path = g_string_new(g_prefix_path);
+    assert(NULL != path);
+    g_string_append_printf(path, "/%s", subdir);
+    if (0 != g_mkdir_with_parents(path->str, S_IRWXU | S_IRGRP | S_IXGRP /*rwxr-x---*/)) {
+        perror("mkdir");
+        g_string_free(path, TRUE);
+        return NULL;
+    }
+
+    GDateTime *now = g_date_time_new_now_local();
+    assert(NULL != now);
+    gchar *timestamp = g_date_time_format(now, "%Y%m%d-%H%M%S");
+    assert(NULL != timestamp);
+    g_string_append_printf(path, "/%s-%s%s", name, timestamp, extension);
+    g_free(timestamp);
+    g_date_time_unref(now);
+
+    return g_string_free(path, FALSE);
+}
+
+// called in the main thread to show the progress of a backup
+static gboolean show_backup_status(gpointer data) {
+    assert(NULL != data);
+    BackupStatus *status = data;
+
+    GString *msg = g_string_new(NULL);
+    assert(NULL != msg);
+
+    const bool finished = status->remaining < 0;
+    if (!finished) {
+        const int done = status->total - status->remaining;
+        g_string_printf(msg, "Backing up database: %i%%", (status->total > 0) ? (100 * done) / status->total : 0);
+    } else {
+        if (status->success) {
+            g_string_printf(msg, "Database backed up to %s", status->path);
+        } else {
+            g_string_printf(msg, "Failed to back up database to %s", status->path);
+        }
+    }
+
+    if (NULL != bar) {
+        push_status("backup", msg->str, finished);
+    } else if (finished) {
+        puts(msg->str); // headless
+    }
+
+    g_string_free(msg, TRUE);
+    g_free(status->path);
+    g_free(status);
+    return G_SOURCE_REMOVE;
+}
+
+// called in the backup thread after each batch of pages is copied
+static void backup_progress(const int remaining, const int total, gpointer user_data) {
+    assert(NULL != user_data);
+    int *last_percent = user_data;
+
+    // only bother the gui when there is something new to show
+    const int percent = (total > 0) ? (100 * (total - remaining)) / total : 0;
+    if (percent == *last_percent) {
+        return;
+    }
+    *last_percent = percent;
+
+    BackupStatus *status = g_malloc0(sizeof(BackupStatus));
+    assert(NULL != status);
+    status->remaining = remaining;
+    status->total = total;
+
+    g_idle_add(show_backup_status, status);
+}
+
+static gpointer backup_thread(gpointer data) {
+    assert(NULL != data);
+    int last_percent = -1;
+
+    BackupStatus *status = g_malloc0(sizeof(BackupStatus));
+    assert(NULL != status);
+    status->success = backup_database((char *) data, backup_progress, &last_percent);
+    status->remaining = -1;
+    status->path = data; // freed by show_backup_status
+
+    g_idle_add(show_backup_status, status);
+
+    g_atomic_int_set(&backup_running, 0);
+    return NULL;
+}
+
+void start_backup(void) {
+    if (!g_atomic_int_compare_and_exchange(&backup_running, 0, 1)) {
+        puts("A backup is already in progress");
+        return;
+    }
+
+    char *path = timestamped_path("backups", "mothership", ".db");
+    if (NULL == path) {
+        g_atomic_int_set(&backup_running, 0);
+        return;
+    }
+
+    GThread *thread = g_thread_new("backup", backup_thread, path);
+    assert(NULL != thread);
+    g_thread_unref(thread); // we don't need to join it
+}
+
+static gpointer archive_thread(gpointer data) {
+    assert(NULL != data);
+    char *path = data;
+
+    const gint64 count = archive_errors_before(path, time(NULL) - ARCHIVE_AGE);
+
+    GString *msg = g_string_new(NULL);
+    assert(NULL != msg);
+    if (count < 0) {
+        g_string_printf(msg, "Failed to archive old errors");
+    } else if (0 == count) {
+        g_string_printf(msg, "No errors were old enough to archive");
+    } else {
+        g_string_printf(msg, "Archived %li errors to %s", count, path);
+    }
+    g_idle_add(show_job_result, g_string_free(msg, FALSE));
+
+    g_free(path);
+    g_atomic_int_set(&archive_running, 0);
+    return NULL;
+}
+
+// move old errors out of the database into an archive in the background
+static void archive_activate(void) {
+    if (!g_atomic_int_compare_and_exchange(&archive_running, 0, 1)) {
+        puts("Already archiving");
+        return;
+    }
+
+    char *path = timestamped_path("archives", "errors", ".edsacarc");
+    if (NULL == path) {
+        g_atomic_int_set(&archive_running, 0);
+        return;
+    }
+
+    GThread *thread = g_thread_new("archive", archive_thread, path);
+    assert(NULL != thread);
+    g_thread_unref(thread);
+}
+
+static gpointer import_archive_thread(gpointer data) {
+    assert(NULL != data);
+    char *path = data;
+
+    const gint64 count = archive_import(path);
+
+    GString *msg = g_string_new(NULL);
+    assert(NULL != msg);
+    if (count < 0) {
+        g_string_printf(msg, "Failed to import %s", path);
+    } else {
+        g_string_printf(msg, "Imported %li errors from %s", count, path);
+    }
+    g_idle_add(show_job_result, g_string_free(msg, FALSE));
+
+    g_free(path);
+    return NULL;
+}
+
+// choose an archive and put its errors back into the database
+static void import_archive_activate(void) {
+    GtkWidget *dialog = gtk_file_chooser_dialog_new("Import Archive", main_window,
+        GTK_FILE_CHOOSER_ACTION_OPEN, "Cancel", GTK_RESPONSE_CANCEL,
+        "Import", GTK_RESPONSE_ACCEPT, NULL);
+    assert(NULL != dialog);
+
+    GString *archives_path = g_string_new(g_prefix_path);
+    assert(NULL != archives_path);
+    g_string_append(archives_path, "/archives");
+    gtk_file_chooser_set_current_folder(GTK_FILE_CHOOSER(dialog), archives_path->str);
+    g_string_free(archives_path, TRUE);
+
+    GtkFileFilter *filter = gtk_file_filter_new();
+    assert(NULL != filter);
+    gtk_file_filter_set_name(filter, "Error archives");
+    gtk_file_filter_add_pattern(filter, "*.edsacarc");
+    gtk_file_chooser_add_filter(GTK_FILE_CHOOSER(dialog), filter);
+
+    if (GTK_RESPONSE_ACCEPT == gtk_dialog_run(GTK_DIALOG(dialog))) {
+        char *path = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(dialog));
+        assert(NULL != path);
+
+        GThread *thread = g_thread_new("import", import_archive_thread, path);
+        assert(NULL != thread);
+        g_thread_unref(thread);
+    }
+
+    gtk_widget_destroy(dialog);
+}
+
 // handles the quit action
 static void quit_activate(void) {
     if (NULL != main_window) {
@@ -87,61 +474,278 @@ static void quit_activate(void) {
     }
 }
 
-static GMenu *generate_nodes_menu(void) {
-    GMenu *nodes = g_menu_new();
-    assert(NULL != nodes);
+// the Nodes menu: a submenu per rack, in order, then the Show Several section. Each rack and chassis item is tagged
+// with its number so that a single node's item can be found and patched when the node changes
+#define RACK_ATTRIBUTE "x-rack"
+#define CHASSIS_ATTRIBUTE "x-chassis"
+
+static GMenu *nodes_menu = NULL;
+static GArray *menu_nodes = NULL; // the topology (TopologyNodes) when the Nodes menu was built or last refreshed
+
+// actions for one node
+static GMenu *node_menu(const guint64 rack_no, const guint64 chassis_no) {
+    GMenu *node = g_menu_new();
+    assert(NULL != node);
+
+    GMenuItem *show = g_menu_item_new("Show", NULL);
+    assert(NULL != show);
+    g_menu_item_set_action_and_target_value(show, "app.node_show", g_variant_new("(tt)", rack_no, chassis_no));
+    g_menu_append_item(node, show);
+    g_object_unref(show);
+
+    GMenuItem *disable = g_menu_item_new("Toggle Disabled", NULL);
+    assert(NULL != disable);
+    g_menu_item_set_action_and_target_value(disable, "app.node_toggle_disabled", g_variant_new("(tt)", rack_no, chassis_no));
+    g_menu_append_item(node, disable);
+    g_object_unref(disable);
+
+    GMenuItem *history = g_menu_item_new("Connection History", NULL);
+    assert(NULL != history);
+    g_menu_item_set_action_and_target_value(history, "app.node_history", g_variant_new("(tt)", rack_no, chassis_no));
+    g_menu_append_item(node, history);
+    g_object_unref(history);
+
+    GMenuItem *delete = g_menu_item_new("Delete", NULL);
+    assert(NULL != delete);
+    g_menu_item_set_action_and_target_value(delete, "app.node_delete", g_variant_new("(tt)", rack_no, chassis_no));
+    g_menu_append_item(node, delete);
+    g_object_unref(delete);
+
+    g_menu_freeze(node);
+    return node;
+}
+
+// index of the first item of menu tagged with attribute no less than number (sets *found if equal to number).
+// Untagged items (the Show Several section) come after every tagged one
+static gint menu_position(GMenu *menu, const char *attribute, const guint number, bool *found) {
+    *found = false;
+
+    const gint n_items = g_menu_model_get_n_items(G_MENU_MODEL(menu));
+    for (gint i = 0; i < n_items; i++) {
+        guint item_number = 0;
+        if (!g_menu_model_get_item_attribute(G_MENU_MODEL(menu), i, attribute, "u", &item_number)
+                || (item_number >= number)) {
+            *found = (item_number == number);
+            return i;
+        }
+    }
+
+    return n_items;
+}
+
+static void insert_chassis_item(GMenu *rack_menu, const gint position, const TopologyNode *node) {
+    char label[32];
+    snprintf(label, sizeof(label), node->enabled ? "Chassis %u" : "Chassis %u (disabled)", node->chassis_no);
+
+    GMenu *actions = node_menu(node->rack_no, node->chassis_no);
+    GMenuItem *item = g_menu_item_new_submenu(label, G_MENU_MODEL(actions));
+    assert(NULL != item);
+    g_menu_item_set_attribute(item, CHASSIS_ATTRIBUTE, "u", node->chassis_no);
+    g_menu_insert_item(rack_menu, position, item);
+    g_object_unref(item);
+    g_object_unref(actions);
+}
 
-    GList *racks = list_racks();
-    while (NULL != racks) {
-        const uintptr_t rack_no = (uintptr_t) racks->data;
-        char rack_label[10];
-        snprintf(rack_label, 10, "Rack %li", rack_no);
+// actions for a whole rack: its nodes and all of their errors at once
+static GMenu *rack_actions(const guint64 rack_no) {
+    GMenu *actions = g_menu_new();
+    assert(NULL != actions);
+
+    GMenuItem *enable = g_menu_item_new("Enable Everything", NULL);
+    assert(NULL != enable);
+    g_menu_item_set_action_and_target_value(enable, "app.rack_set_enabled", g_variant_new("(tb)", rack_no, TRUE));
+    g_menu_append_item(actions, enable);
+    g_object_unref(enable);
+
+    GMenuItem *disable = g_menu_item_new("Disable Everything", NULL);
+    assert(NULL != disable);
+    g_menu_item_set_action_and_target_value(disable, "app.rack_set_enabled", g_variant_new("(tb)", rack_no, FALSE));
+    g_menu_append_item(actions, disable);
+    g_object_unref(disable);
+
+    g_menu_freeze(actions);
+    return actions;
+}
 
-        GMenu *rack = g_menu_new();
+// the submenu for a rack, adding it if needed. Free with g_object_unref. NULL if it doesn't exist and !create
+static GMenu *get_rack_menu(const unsigned int rack_no, const bool create, gint *position) {
+    bool found = false;
+    *position = menu_position(nodes_menu, RACK_ATTRIBUTE, rack_no, &found);
+    if (found) {
+        return G_MENU(g_menu_model_get_item_link(G_MENU_MODEL(nodes_menu), *position, G_MENU_LINK_SUBMENU));
+    }
+    if (!create) {
+        return NULL;
+    }
 
-        GList *chassis = list_chassis_by_rack(rack_no);
-        while (NULL != chassis) {
-            const uintptr_t chassis_no = (uintptr_t) chassis->data;
-            char chassis_label[15];
-            snprintf(chassis_label, 15, "Chassis %li", chassis_no);
+    char label[32];
+    snprintf(label, sizeof(label), "Rack %u", rack_no);
 
-            GMenu *node = g_menu_new();
-            assert(NULL != node);
-            
-            GMenuItem *show = g_menu_item_new("Show", "app.node_show");
-            assert(NULL != show);
-            g_menu_item_set_action_and_target_value(show, "app.node_show", g_variant_new("(tt)", rack_no, chassis_no));
-            g_menu_append_item(node, show);
+    GMenu *rack_menu = g_menu_new();
+    assert(NULL != rack_menu);
+    GMenuItem *item = g_menu_item_new_submenu(label, G_MENU_MODEL(rack_menu));
+    assert(NULL != item);
+    g_menu_item_set_attribute(item, RACK_ATTRIBUTE, "u", rack_no);
+    g_menu_insert_item(nodes_menu, *position, item);
+    g_object_unref(item);
 
-            GMenuItem *disable = g_menu_item_new("Toggle Disabled", "app.node_toggle_disabled");
-            assert(NULL != disable);
-            g_menu_item_set_action_and_target_value(disable, "app.node_toggle_disabled", g_variant_new("(tt)", rack_no, chassis_no));
-            g_menu_append_item(node, disable);
+    // untagged so it stays after the chassis
+    GMenu *actions = rack_actions(rack_no);
+    g_menu_append_section(rack_menu, NULL, G_MENU_MODEL(actions));
+    g_object_unref(actions);
 
-            GMenuItem *delete = g_menu_item_new("Delete", "app.node_delete");
-            assert(NULL != delete);
-            g_menu_item_set_action_and_target_value(delete, "app.node_delete", g_variant_new("(tt)", rack_no, chassis_no));
-            g_menu_append_item(node, delete);
+    return rack_menu;
+}
+
+static GMenu *generate_nodes_menu(void) {
+    nodes_menu = g_menu_new();
+    assert(NULL != nodes_menu);
+
+    // several chassis in one tab
+    GMenu *several = g_menu_new();
+    assert(NULL != several);
+    g_menu_append(several, "Show Several...", "app.node_set");
+    g_menu_freeze(several);
+    g_menu_append_section(nodes_menu, NULL, G_MENU_MODEL(several));
+    g_object_unref(several);
+
+    // nodes come in order so each goes after the other chassis of its rack
+    GArray *nodes = topology_nodes();
+    for (guint i = 0; i < nodes->len; i++) {
+        const TopologyNode *node = &g_array_index(nodes, TopologyNode, i);
+        gint rack_position = 0;
+        GMenu *rack_menu = get_rack_menu(node->rack_no, true, &rack_position);
+        bool found = false;
+        insert_chassis_item(rack_menu, menu_position(rack_menu, CHASSIS_ATTRIBUTE, node->chassis_no, &found), node);
+        g_object_unref(rack_menu);
+    }
+    menu_nodes = nodes;
 
-            g_menu_freeze(node);
-            g_menu_append_submenu(rack, chassis_label, G_MENU_MODEL(node));
+    // not frozen: items are patched by update_nodes_menu
+    return nodes_menu;
+}
 
-            chassis = chassis->next;
+// bring the Nodes menu item for one node in line with the topology after it was added, removed or toggled
+static void update_nodes_menu(const unsigned int rack_no, const unsigned int chassis_no) {
+    TopologyNode node;
+    node.rack_no = rack_no;
+    node.chassis_no = chassis_no;
+    node.enabled = true;
+    const bool exists = topology_node_exists(rack_no, chassis_no, &node.enabled);
+
+    gint rack_position = 0;
+    GMenu *rack_menu = get_rack_menu(rack_no, exists, &rack_position);
+    if (NULL == rack_menu) {
+        return; // nothing to remove
+    }
+
+    bool found = false;
+    const gint position = menu_position(rack_menu, CHASSIS_ATTRIBUTE, chassis_no, &found);
+    if (found) {
+        g_menu_remove(rack_menu, position);
+    }
+    if (exists) {
+        insert_chassis_item(rack_menu, position, &node);
+    } else if (1 == g_menu_model_get_n_items(G_MENU_MODEL(rack_menu))) { // only the whole rack actions are left
+        g_menu_remove(nodes_menu, rack_position);
+    }
+
+    g_object_unref(rack_menu);
+}
+
+// order of TopologyNodes in topology_nodes()
+static gint compare_topology_nodes(const TopologyNode *a, const TopologyNode *b) {
+    if (a->rack_no != b->rack_no) {
+        return (a->rack_no < b->rack_no) ? -1 : 1;
+    }
+    return (a->chassis_no < b->chassis_no) ? -1 : (a->chassis_no > b->chassis_no);
+}
+
+void refresh_nodes_menu(void) {
+    if (NULL == nodes_menu) {
+        return; // not built yet
+    }
+
+    // both are in order so walk them together, patching only the nodes which were added, removed or toggled
+    GArray *nodes = topology_nodes();
+    guint shown = 0;
+    guint current = 0;
+    while ((shown < menu_nodes->len) || (current < nodes->len)) {
+        const TopologyNode *before = (shown < menu_nodes->len) ? &g_array_index(menu_nodes, TopologyNode, shown) : NULL;
+        const TopologyNode *now = (current < nodes->len) ? &g_array_index(nodes, TopologyNode, current) : NULL;
+        const gint order = (NULL == before) ? 1 : ((NULL == now) ? -1 : compare_topology_nodes(before, now));
+
+        if (order < 0) {
+            update_nodes_menu(before->rack_no, before->chassis_no); // removed
+            shown++;
+        } else if (order > 0) {
+            update_nodes_menu(now->rack_no, now->chassis_no); // added
+            current++;
+        } else {
+            if (before->enabled != now->enabled) {
+                update_nodes_menu(now->rack_no, now->chassis_no);
+            }
+            shown++;
+            current++;
         }
+    }
 
-        g_menu_freeze(rack);
-        g_menu_append_submenu(nodes, rack_label, G_MENU_MODEL(rack));
-        racks = racks->next;
-    } 
+    g_array_unref(menu_nodes);
+    menu_nodes = nodes;
+}
 
-    g_menu_freeze(nodes);
+// where saved filters are kept. Free with g_free
+static char *filters_path(void) {
+    return g_strdup_printf("%s/filters.conf", g_prefix_path);
+}
 
-    return nodes;
+static GMenu *generate_filters_menu(void) {
+    GMenu *filters = g_menu_new();
+    assert(NULL != filters);
+
+    GMenu *new_section = g_menu_new();
+    assert(NULL != new_section);
+    g_menu_append(new_section, "New Filter...", "app.filter_new");
+    g_menu_freeze(new_section);
+    g_menu_append_section(filters, NULL, G_MENU_MODEL(new_section));
+
+    char *path = filters_path();
+    GList *saved_filters = saved_filters_load(path);
+    g_free(path);
+
+    GMenu *saved_section = g_menu_new();
+    assert(NULL != saved_section);
+    for (GList *item = saved_filters; NULL != item; item = item->next) {
+        const SavedFilter *saved_filter = item->data;
+
+        GMenu *filter = g_menu_new();
+        assert(NULL != filter);
+
+        GMenuItem *show = g_menu_item_new("Show", "app.filter_show");
+        assert(NULL != show);
+        g_menu_item_set_action_and_target_value(show, "app.filter_show", g_variant_new_string(saved_filter->expression));
+        g_menu_append_item(filter, show);
+
+        GMenuItem *delete = g_menu_item_new("Delete", "app.filter_delete");
+        assert(NULL != delete);
+        g_menu_item_set_action_and_target_value(delete, "app.filter_delete", g_variant_new_string(saved_filter->name));
+        g_menu_append_item(filter, delete);
+
+        g_menu_freeze(filter);
+        g_menu_append_submenu(saved_section, saved_filter->name, G_MENU_MODEL(filter));
+    }
+    g_list_free_full(saved_filters, free_saved_filter);
+
+    g_menu_freeze(saved_section);
+    g_menu_append_section(filters, NULL, G_MENU_MODEL(saved_section));
+
+    g_menu_freeze(filters);
+    return filters;
 }
 
-static void update_nodes_menu(void) {
-    g_menu_remove(model, 2);
-    g_menu_append_submenu(model, "Nodes", G_MENU_MODEL(generate_nodes_menu()));
+static void update_filters_menu(void) {
+    g_menu_remove(model, 3);
+    g_menu_insert_submenu(model, 3, "Filters", G_MENU_MODEL(generate_filters_menu()));
 }
 
 static void choose_config_file_callback(__attribute__((unused)) GtkButton *unused, gpointer user_data) {
@@ -254,7 +858,7 @@ static void ok_callback(__attribute__((unused)) GtkButton *unused, gpointer user
     #pragma GCC diagnostic pop
 
     // check that the node doesn't already exist
-    if (node_exists(rack_no, chassis_no)) {
+    if (topology_node_exists(rack_no, chassis_no, NULL)) {
         valid = false;
         set_error_text(rack_no_buffer);
         set_error_text(chassis_no_buffer);
@@ -316,7 +920,7 @@ static void ok_callback(__attribute__((unused)) GtkButton *unused, gpointer user
 
         // add the node to the database
         add_node(rack_no, chassis_no, true);
-        update_nodes_menu();
+        update_nodes_menu(rack_no, chassis_no);
  
         g_object_unref(G_OBJECT(config_file_buffer)); // ref'ed in add_node_activate
         gtk_window_close(add_node_window);
@@ -438,137 +1042,580 @@ static void hide_disabled_change_state(GSimpleAction *simple) {
    }
 }
 
-static void node_toggle_disabled_activate(__attribute__((unused)) GSimpleAction *simple, GVariant *parameter) {
-    assert(NULL != parameter);
-
-    GVariant *rack_variant = g_variant_get_child_value(parameter, 0);
-    GVariant *chassis_variant = g_variant_get_child_value(parameter, 1);
+static void hide_acked_change_state(GSimpleAction *simple) {
+    assert(NULL != simple);
+    const gboolean hide_acked = g_variant_get_boolean(g_action_get_state(G_ACTION(simple)));
 
-    uint64_t rack_no = g_variant_get_uint64(rack_variant);
-    uint64_t chassis_no = g_variant_get_uint64(chassis_variant);
+    // toggle
+    g_simple_action_set_state(simple, g_variant_new_boolean(!hide_acked));
+    set_show_acked(hide_acked);
+    gui_update(NULL);
+}
 
-    g_variant_unref(rack_variant);
-    g_variant_unref(chassis_variant);
+// a time range preset was chosen from the View menu. Applies to the current tab and tabs opened from menus
+static void time_range_change_state(GSimpleAction *simple, GVariant *value) {
+    assert(NULL != simple);
+    assert(NULL != value);
+
+    const char *name = g_variant_get_string(value, NULL);
+    for (size_t i = 0; i < G_N_ELEMENTS(time_range_presets); i++) {
+        if (0 == strcmp(name, time_range_presets[i].name)) {
+            g_simple_action_set_state(simple, value);
+            time_range = time_range_presets[i].time_range;
+            edsac_error_notebook_set_time_range(notebook, time_range);
+            update_bar();
+            return;
+        }
+    }
+}
 
+static void toggle_node(const unsigned int rack_no, const unsigned int chassis_no) {
     assert(true == node_toggle_disabled(rack_no, chassis_no));
-    
-    printf("Node %li %li toggled\n", rack_no, chassis_no);
 
-    gui_update(NULL);
+    printf("Node %u %u toggled\n", rack_no, chassis_no);
+
+    update_nodes_menu(rack_no, chassis_no);
 }
 
-static void node_delete_activate(__attribute__((unused)) GSimpleAction *simple, GVariant *parameter) {
+// bring the Nodes menu in line after set_nodes_enabled changed every node of a rack
+static void update_rack_menu(const unsigned int rack_no) {
+    GArray *nodes = topology_nodes();
+    for (guint i = 0; i < nodes->len; i++) {
+        const TopologyNode *node = &g_array_index(nodes, TopologyNode, i);
+        if (node->rack_no == rack_no) {
+            update_nodes_menu(node->rack_no, node->chassis_no);
+        }
+    }
+    g_array_unref(nodes);
+}
+
+// enable or disable several nodes with one UPDATE
+static void set_several_enabled(GSList *nodes, const bool enabled) {
+    Clickable several;
+    memset(&several, 0, sizeof(several));
+    several.type = NODE_SET;
+    several.text = node_set_text(nodes);
+    if ((NULL == several.text) || (set_nodes_enabled(&several, enabled) < 0)) {
+        puts("Error changing nodes");
+        return;
+    }
+
+    for (GSList *item = nodes; NULL != item; item = item->next) {
+        const NodeIdentifier *node = item->data;
+        update_nodes_menu(node->rack_no, node->chassis_no);
+    }
+}
+
+static void delete_node(const unsigned int rack_no, const unsigned int chassis_no) {
+    assert(true == remove_node(rack_no, chassis_no));
+
+    edsac_error_notebook_close_node(notebook, rack_no, chassis_no);
+
+    // clean up node network configuration
+    node_cleanup_network(rack_no, chassis_no);
+
+    printf("Node %u %u removed\n", rack_no, chassis_no);
+
+    update_nodes_menu(rack_no, chassis_no);
+}
+
+static void show_node(const unsigned int rack_no, const unsigned int chassis_no) {
+    Clickable search;
+    memset(&search, 0, sizeof(search));
+    search.type = CHASSIS;
+    search.time_range = time_range;
+    search.rack_num = rack_no;
+    search.chassis_num = chassis_no;
+
+    edsac_error_notebook_show_page(notebook, &search);
+}
+
+// rack and chassis from the (tt) parameter of the node actions
+static void node_parameter(GVariant *parameter, unsigned int *rack_no, unsigned int *chassis_no) {
     assert(NULL != parameter);
 
     GVariant *rack_variant = g_variant_get_child_value(parameter, 0);
     GVariant *chassis_variant = g_variant_get_child_value(parameter, 1);
 
-    uint64_t rack_no = g_variant_get_uint64(rack_variant);
-    uint64_t chassis_no = g_variant_get_uint64(chassis_variant);
+    *rack_no = (unsigned int) g_variant_get_uint64(rack_variant);
+    *chassis_no = (unsigned int) g_variant_get_uint64(chassis_variant);
 
     g_variant_unref(rack_variant);
     g_variant_unref(chassis_variant);
+}
 
-    #pragma GCC diagnostic push
-    #pragma GCC diagnostic ignored "-Wconversion"
-    assert(true == remove_node(rack_no, chassis_no));
-    #pragma GCC diagnostic pop
+static void node_toggle_disabled_activate(__attribute__((unused)) GSimpleAction *simple, GVariant *parameter) {
+    unsigned int rack_no = 0;
+    unsigned int chassis_no = 0;
+    node_parameter(parameter, &rack_no, &chassis_no);
+
+    toggle_node(rack_no, chassis_no);
+    gui_update(NULL);
+}
 
-    edsac_error_notebook_close_node(notebook, (unsigned int) rack_no, (unsigned int) chassis_no);
+// handles the rack_set_enabled action: a rack's nodes and every one of their errors
+static void rack_set_enabled_activate(__attribute__((unused)) GSimpleAction *simple, GVariant *parameter) {
+    assert(NULL != parameter);
+    guint64 rack_no = 0;
+    gboolean enabled = FALSE;
+    g_variant_get(parameter, "(tb)", &rack_no, &enabled);
+
+    Clickable rack;
+    memset(&rack, 0, sizeof(rack));
+    rack.type = RACK;
+    rack.rack_num = (unsigned int) rack_no;
+    rack.time_range = TIME_ALL;
+
+    // one transaction so the tabs never see half of it
+    begin_batch();
+    if ((set_nodes_enabled(&rack, enabled) < 0) || (set_errors_enabled(&rack, enabled) < 0)) {
+        puts("Error changing rack");
+    }
+    assert(true == end_batch());
 
-    // clean up node network configuration
-    node_cleanup_network((unsigned int) rack_no, (unsigned int) chassis_no);
+    update_rack_menu(rack.rack_num);
+    gui_update(NULL);
+}
 
-    printf("Node %li %li removed\n", rack_no, chassis_no);
+static void node_delete_activate(__attribute__((unused)) GSimpleAction *simple, GVariant *parameter) {
+    unsigned int rack_no = 0;
+    unsigned int chassis_no = 0;
+    node_parameter(parameter, &rack_no, &chassis_no);
 
-    update_nodes_menu();
+    delete_node(rack_no, chassis_no);
     gui_update(NULL);
 }
 
 static void node_show_activate(__attribute__((unused)) GSimpleAction *simple, GVariant *parameter) {
-    assert(NULL != parameter);
+    unsigned int rack_no = 0;
+    unsigned int chassis_no = 0;
+    node_parameter(parameter, &rack_no, &chassis_no);
 
-    GVariant *rack_variant = g_variant_get_child_value(parameter, 0);
-    GVariant *chassis_variant = g_variant_get_child_value(parameter, 1);
+    show_node(rack_no, chassis_no);
+}
 
-    uint64_t rack_no = g_variant_get_uint64(rack_variant);
-    uint64_t chassis_no = g_variant_get_uint64(chassis_variant);
+// "99.5% up, went down 3 times" for a node's uptime
+static void append_uptime(GString *text, const NodeUptime *uptime) {
+    const guint64 total = uptime->up_seconds + uptime->down_seconds;
+    if (!uptime->known || (0 == total)) {
+        g_string_append(text, "no history");
+        return;
+    }
 
-    g_variant_unref(rack_variant);
-    g_variant_unref(chassis_variant);
+    g_string_append_printf(text, "%.1f%% up, went down %u time%s", 100.0 * (double) uptime->up_seconds / (double) total,
+        uptime->flaps, (1 == uptime->flaps) ? "" : "s");
+}
 
-    Clickable search;
-    search.type = CHASSIS;
-    #pragma GCC diagnostic push
-    #pragma GCC diagnostic ignored "-Wconversion"
-    search.rack_num = rack_no;
-    search.chassis_num = chassis_no;
-    #pragma GCC diagnostic pop
+// window showing a node's uptime and its latest connection changes, read from the connection history
+static void show_node_history(const unsigned int rack_no, const unsigned int chassis_no) {
+    const time_t now = time(NULL);
+    static const struct {
+        const char *label;
+        time_t seconds; // 0 for everything recorded
+    } periods[] = {
+        {"Last 24 hours", 24 * 60 * 60},
+        {"Last 7 days", 7 * 24 * 60 * 60},
+        {"All recorded", 0}
+    };
 
-    edsac_error_notebook_show_page(notebook, &search);
-}   
+    GString *text = g_string_new(NULL);
+    assert(NULL != text);
 
-static void convert_to_nodeidentifiers(gpointer data, gpointer user_data) {
-    assert(NULL != data);
-    assert(NULL != user_data);
+    time_t last_seen = 0;
+    const LivenessState state = liveness_state(rack_no, chassis_no, &last_seen);
+    g_string_printf(text, "Now %s", (LIVENESS_UP == state) ? "up" : ((LIVENESS_DOWN == state) ? "down" : "unknown"));
+    if (0 != last_seen) {
+        char time_str[64];
+        strftime(time_str, sizeof(time_str), "%c", localtime(&last_seen));
+        g_string_append_printf(text, ", last error received %s", time_str);
+    }
+    g_string_append(text, "\n\n");
+
+    for (size_t i = 0; i < G_N_ELEMENTS(periods); i++) {
+        NodeUptime uptime;
+        const time_t since = (0 == periods[i].seconds) ? 0 : now - periods[i].seconds;
+        g_string_append_printf(text, "%s: ", periods[i].label);
+        if (node_uptime(rack_no, chassis_no, since, now, &uptime)) {
+            append_uptime(text, &uptime);
+        } else {
+            g_string_append(text, "unavailable");
+        }
+        g_string_append(text, "\n");
+    }
 
-    struct sockaddr_in *addr_struct = data;
-    GSList **list = user_data;
+    g_string_append(text, "\nLatest changes:\n");
+    GList *changes = node_connection_history(rack_no, chassis_no, NODE_HISTORY_CHANGES);
+    if (NULL == changes) {
+        g_string_append(text, "none recorded\n");
+    }
+    for (const GList *item = g_list_last(changes); NULL != item; item = item->prev) { // newest first
+        const LivenessChange *change = item->data;
+        char time_str[64];
+        strftime(time_str, sizeof(time_str), "%c", localtime(&change->time));
+        g_string_append_printf(text, "%s  %s\n", time_str, change->up ? "up" : "down");
+    }
+    g_list_free_full(changes, g_free);
 
-    NodeIdentifier *list_data = parse_ip_address(&addr_struct->sin_addr);
-    assert(NULL != list_data);
+    GtkWidget *dialog = gtk_message_dialog_new(main_window, GTK_DIALOG_DESTROY_WITH_PARENT, GTK_MESSAGE_INFO,
+        GTK_BUTTONS_CLOSE, "Rack %u, Chassis %u", rack_no, chassis_no);
+    assert(NULL != dialog);
+    gtk_message_dialog_format_secondary_text(GTK_MESSAGE_DIALOG(dialog), "%s", text->str);
+    gtk_dialog_run(GTK_DIALOG(dialog));
+    gtk_widget_destroy(dialog);
 
-    *list = g_slist_prepend(*list, list_data);
+    g_string_free(text, TRUE);
 }
 
-static gint compare_nodeids(gconstpointer a, gconstpointer b) {
-    assert(NULL != a);
-    assert(NULL != b);
+static void node_history_activate(__attribute__((unused)) GSimpleAction *simple, GVariant *parameter) {
+    unsigned int rack_no = 0;
+    unsigned int chassis_no = 0;
+    node_parameter(parameter, &rack_no, &chassis_no);
 
-    const NodeIdentifier *A = a;
-    const NodeIdentifier *B = b;
+    show_node_history(rack_no, chassis_no);
+}
 
-    if ((A->chassis_no == B->chassis_no) && (A->rack_no == B->rack_no)) {
-        return 0;
-    } else {
-        return 1;
+// open one tab for several nodes
+static void show_node_set(GSList *node_ids) {
+    const char *text = node_set_text(node_ids);
+    if (NULL == text) {
+        return;
     }
+
+    Clickable search;
+    memset(&search, 0, sizeof(search));
+    search.type = NODE_SET;
+    search.time_range = time_range;
+    search.text = text;
+    edsac_error_notebook_show_page(notebook, &search);
 }
 
-static void complain_missing_nodes(gpointer data, gpointer user_data) {
-    assert(NULL != data);
+// handles the node_set action: choose several chassis to show in one tab
+static void node_set_activate(void) {
+    GtkWidget *dialog = gtk_dialog_new_with_buttons("Show Several Chassis", main_window, GTK_DIALOG_MODAL | GTK_DIALOG_DESTROY_WITH_PARENT,
+        "Cancel", GTK_RESPONSE_CANCEL, "Show", GTK_RESPONSE_ACCEPT, NULL);
+    assert(NULL != dialog);
+    gtk_window_set_default_size(GTK_WINDOW(dialog), 300, 400);
+
+    // a check button for each node
+    GtkBox *checks = GTK_BOX(gtk_box_new(GTK_ORIENTATION_VERTICAL, 0));
+    assert(NULL != checks);
+    GArray *nodes = topology_nodes();
+    for (guint i = 0; i < nodes->len; i++) {
+        const TopologyNode *node = &g_array_index(nodes, TopologyNode, i);
+
+        char label[32];
+        snprintf(label, sizeof(label), "Rack %u, Chassis %u", node->rack_no, node->chassis_no);
+        GtkWidget *check = gtk_check_button_new_with_label(label);
+        assert(NULL != check);
+        g_object_set_data(G_OBJECT(check), "rack_no", GUINT_TO_POINTER(node->rack_no));
+        g_object_set_data(G_OBJECT(check), "chassis_no", GUINT_TO_POINTER(node->chassis_no));
+        gtk_box_pack_start(checks, check, FALSE, FALSE, 0);
+    }
+    g_array_unref(nodes);
+
+    GtkWidget *scroll = gtk_scrolled_window_new(NULL, NULL);
+    assert(NULL != scroll);
+    gtk_widget_set_vexpand(scroll, TRUE);
+    gtk_container_add(GTK_CONTAINER(scroll), GTK_WIDGET(checks));
+
+    GtkContainer *content = GTK_CONTAINER(gtk_dialog_get_content_area(GTK_DIALOG(dialog)));
+    gtk_container_add(content, scroll);
+    gtk_widget_show_all(GTK_WIDGET(content));
+
+    if (GTK_RESPONSE_ACCEPT == gtk_dialog_run(GTK_DIALOG(dialog))) {
+        GSList *node_ids = NULL;
+        GList *children = gtk_container_get_children(GTK_CONTAINER(checks));
+        for (GList *child = children; NULL != child; child = child->next) {
+            if (!gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(child->data))) {
+                continue;
+            }
 
-    NodeIdentifier *db_id = data;
-    GSList *server_nodes = user_data;
+            NodeIdentifier *node_id = g_malloc(sizeof(NodeIdentifier));
+            assert(NULL != node_id);
+            node_id->rack_no = GPOINTER_TO_UINT(g_object_get_data(G_OBJECT(child->data), "rack_no"));
+            node_id->chassis_no = GPOINTER_TO_UINT(g_object_get_data(G_OBJECT(child->data), "chassis_no"));
+            node_ids = g_slist_prepend(node_ids, node_id);
+        }
+        g_list_free(children);
 
-    GSList *res = g_slist_find_custom(server_nodes, data, compare_nodeids);
-    if (NULL == res) {
-        // not found so make an error about it
-        assert(true == add_error_decoded(db_id->rack_no, db_id->chassis_no, -1, time(NULL), "Node not connected"));
+        show_node_set(node_ids);
+        g_slist_free_full(node_ids, g_free);
     }
+
+    gtk_widget_destroy(dialog);
 }
 
-static void check_connected_activate(void) {
-    GSList *ip_addr_structs = get_connected_list();
+// acts on the nodes selected in the node browser
+static void browser_action(const NodeBrowserAction action, GSList *nodes, __attribute__((unused)) gpointer unused) {
+    assert(NULL != nodes);
+    const NodeIdentifier *first = nodes->data;
 
-    // convert to NodeIdentifiers
-    GSList *ip_addrs_server = NULL;
-    g_slist_foreach(ip_addr_structs, convert_to_nodeidentifiers, &ip_addrs_server);
-    g_slist_free_full(ip_addr_structs, g_free);
+    if (database_read_only() && (NODE_BROWSER_SHOW != action) && (NODE_BROWSER_HISTORY != action)) {
+        return; // nothing can be changed
+    }
 
-    GSList *ip_addrs_db = list_nodes();    
-    g_slist_foreach(ip_addrs_db, complain_missing_nodes, ip_addrs_server);
+    switch (action) {
+        case NODE_BROWSER_HISTORY:
+            show_node_history(first->rack_no, first->chassis_no);
+            return;
+        case NODE_BROWSER_SHOW:
+            if (NULL == nodes->next) {
+                show_node(first->rack_no, first->chassis_no);
+            } else {
+                show_node_set(nodes);
+            }
+            return;
+        case NODE_BROWSER_ENABLE:
+        case NODE_BROWSER_DISABLE:
+            set_several_enabled(nodes, NODE_BROWSER_ENABLE == action);
+            break;
+        case NODE_BROWSER_DELETE: {
+            GtkWidget *dialog = gtk_message_dialog_new(main_window, GTK_DIALOG_MODAL | GTK_DIALOG_DESTROY_WITH_PARENT,
+                GTK_MESSAGE_QUESTION, GTK_BUTTONS_OK_CANCEL, "Delete %u node(s) and all of their errors?", g_slist_length(nodes));
+            assert(NULL != dialog);
+            const gint response = gtk_dialog_run(GTK_DIALOG(dialog));
+            gtk_widget_destroy(dialog);
+            if (GTK_RESPONSE_OK != response) {
+                return;
+            }
 
-    g_slist_free_full(ip_addrs_server, g_free);
-    g_slist_free_full(ip_addrs_db, g_free);
+            for (GSList *item = nodes; NULL != item; item = item->next) {
+                const NodeIdentifier *node = item->data;
+                delete_node(node->rack_no, node->chassis_no);
+            }
+            break;
+        }
+    }
 
     gui_update(NULL);
 }
 
+// handles the node_browser action: show or hide the node browser
+static void node_browser_change_state(GSimpleAction *simple, GVariant *value) {
+    assert(NULL != simple);
+    assert(NULL != value);
+
+    g_simple_action_set_state(simple, value);
+    gtk_widget_set_visible(node_browser, g_variant_get_boolean(value));
+}
+
+static void show_dashboard_activate(void) {
+    edsac_error_notebook_show_dashboard(notebook);
+}
+
+// poll the connections now rather than waiting for the next one (see liveness.h)
+static void check_connected_activate(void) {
+    GSList *connected = get_connected_list();
+    update_liveness(connected, time(NULL));
+    g_slist_free_full(connected, g_free);
+
+    gui_update(NULL);
+}
+
+// open a search tab for what was typed into the search entry
+static void search_activate(GtkEntry *entry, __attribute__((unused)) gpointer unused) {
+    assert(NULL != entry);
+
+    gchar *text = g_strstrip(g_strdup(gtk_entry_get_text(entry)));
+    assert(NULL != text);
+
+    if ('\0' != *text) {
+        Clickable search;
+        memset(&search, 0, sizeof(search));
+        search.type = SEARCH;
+        search.time_range = time_range;
+        search.text = g_intern_string(text); // so the tab can be found again. Never freed but there won't be many
+        edsac_error_notebook_show_page(notebook, &search);
+    }
+
+    g_free(text);
+}
+
+// open a tab for a filter expression
+static void show_filter(const char *expression) {
+    assert(NULL != expression);
+
+    Clickable search;
+    memset(&search, 0, sizeof(search));
+    search.type = FILTER;
+    search.time_range = time_range;
+    search.text = g_intern_string(expression); // so the tab can be found again and the compiled filter reused
+    edsac_error_notebook_show_page(notebook, &search);
+}
+
+// columns of the common messages list
+enum {
+    TEMPLATE_COUNT_COLUMN,
+    TEMPLATE_TEXT_COLUMN,
+    TEMPLATE_ID_COLUMN,
+    TEMPLATE_N_COLUMNS
+};
+
+#define COMMON_MESSAGES 100 // rows in the common messages list
+
+static void template_row_activated(__attribute__((unused)) GtkTreeView *view, __attribute__((unused)) GtkTreePath *path,
+        __attribute__((unused)) GtkTreeViewColumn *column, GtkDialog *dialog) {
+    gtk_dialog_response(dialog, GTK_RESPONSE_ACCEPT);
+}
+
+// list the commonest message templates over the current time range. The chosen one is shown as a filter
+static void templates_activate(void) {
+    Clickable everything;
+    memset(&everything, 0, sizeof(everything));
+    everything.type = ALL;
+    everything.time_range = time_range;
+    time_t since = 0;
+    time_t until = 0;
+    clickable_time_bounds(&everything, time(NULL), &since, &until);
+
+    GtkListStore *store = gtk_list_store_new(TEMPLATE_N_COLUMNS, G_TYPE_UINT, G_TYPE_STRING, G_TYPE_INT64);
+    assert(NULL != store);
+    GList *counts = count_templates(since, COMMON_MESSAGES);
+    for (const GList *item = counts; NULL != item; item = item->next) {
+        const TemplateCount *count = item->data;
+        GtkTreeIter iter;
+        gtk_list_store_append(store, &iter);
+        gtk_list_store_set(store, &iter, TEMPLATE_COUNT_COLUMN, count->count, TEMPLATE_TEXT_COLUMN, count->text,
+            TEMPLATE_ID_COLUMN, count->id, -1);
+    }
+    g_list_free_full(counts, free_template_count);
+
+    GtkWidget *dialog = gtk_dialog_new_with_buttons("Common Messages", main_window, GTK_DIALOG_MODAL | GTK_DIALOG_DESTROY_WITH_PARENT,
+        "Close", GTK_RESPONSE_CANCEL, "Show", GTK_RESPONSE_ACCEPT, NULL);
+    assert(NULL != dialog);
+    gtk_window_set_default_size(GTK_WINDOW(dialog), 600, 400);
+
+    GtkWidget *view = gtk_tree_view_new_with_model(GTK_TREE_MODEL(store));
+    assert(NULL != view);
+    g_object_unref(store); // the view holds a reference
+    gtk_tree_view_append_column(GTK_TREE_VIEW(view), gtk_tree_view_column_new_with_attributes("Errors",
+        gtk_cell_renderer_text_new(), "text", TEMPLATE_COUNT_COLUMN, NULL));
+    gtk_tree_view_append_column(GTK_TREE_VIEW(view), gtk_tree_view_column_new_with_attributes("Message (numbers as #)",
+        gtk_cell_renderer_text_new(), "text", TEMPLATE_TEXT_COLUMN, NULL));
+    g_signal_connect(G_OBJECT(view), "row-activated", G_CALLBACK(template_row_activated), dialog);
+
+    GtkWidget *scroll = gtk_scrolled_window_new(NULL, NULL);
+    assert(NULL != scroll);
+    gtk_widget_set_vexpand(scroll, TRUE);
+    gtk_container_add(GTK_CONTAINER(scroll), view);
+
+    GtkContainer *content = GTK_CONTAINER(gtk_dialog_get_content_area(GTK_DIALOG(dialog)));
+    gtk_container_add(content, scroll);
+    gtk_widget_show_all(GTK_WIDGET(content));
+
+    if (GTK_RESPONSE_ACCEPT == gtk_dialog_run(GTK_DIALOG(dialog))) {
+        GtkTreeModel *tree_model = NULL;
+        GtkTreeIter iter;
+        if (gtk_tree_selection_get_selected(gtk_tree_view_get_selection(GTK_TREE_VIEW(view)), &tree_model, &iter)) {
+            gint64 id = 0;
+            gtk_tree_model_get(tree_model, &iter, TEMPLATE_ID_COLUMN, &id, -1);
+            gchar *expression = g_strdup_printf("template=%" G_GINT64_FORMAT, id);
+            show_filter(expression);
+            g_free(expression);
+        }
+    }
+
+    gtk_widget_destroy(dialog);
+}
+
+static void filter_show_activate(__attribute__((unused)) GSimpleAction *simple, GVariant *parameter) {
+    assert(NULL != parameter);
+    show_filter(g_variant_get_string(parameter, NULL));
+}
+
+static void filter_delete_activate(__attribute__((unused)) GSimpleAction *simple, GVariant *parameter) {
+    assert(NULL != parameter);
+
+    char *path = filters_path();
+    if (!saved_filter_remove(path, g_variant_get_string(parameter, NULL))) {
+        push_status("job", "Unable to delete the filter", true);
+    }
+    g_free(path);
+
+    update_filters_menu();
+}
+
+// handles the filter_new action: ask for a name and an expression then save and show the filter
+static void filter_new_activate(void) {
+    GtkWidget *dialog = gtk_dialog_new_with_buttons("New Filter", main_window, GTK_DIALOG_MODAL | GTK_DIALOG_DESTROY_WITH_PARENT,
+        "Cancel", GTK_RESPONSE_CANCEL, "Save", GTK_RESPONSE_ACCEPT, NULL);
+    assert(NULL != dialog);
+    gtk_dialog_set_default_response(GTK_DIALOG(dialog), GTK_RESPONSE_ACCEPT);
+
+    GtkGrid *grid = GTK_GRID(gtk_grid_new());
+    assert(NULL != grid);
+    gtk_grid_set_column_spacing(grid, 5);
+    gtk_grid_set_row_spacing(grid, 5);
+    gtk_container_set_border_width(GTK_CONTAINER(grid), 10);
+
+    gtk_grid_attach(grid, gtk_label_new("Name"), 0, 0, 1, 1);
+    GtkWidget *name_entry = gtk_entry_new();
+    assert(NULL != name_entry);
+    gtk_grid_attach(grid, name_entry, 1, 0, 1, 1);
+
+    gtk_grid_attach(grid, gtk_label_new("Expression"), 0, 1, 1, 1);
+    GtkWidget *expression_entry = gtk_entry_new();
+    assert(NULL != expression_entry);
+    gtk_entry_set_placeholder_text(GTK_ENTRY(expression_entry), "rack=4-7 type=hardware valve=10-20 enabled");
+    gtk_entry_set_width_chars(GTK_ENTRY(expression_entry), 40);
+    gtk_entry_set_activates_default(GTK_ENTRY(expression_entry), TRUE);
+    gtk_widget_set_tooltip_text(expression_entry, "Terms separated by spaces. Every term must match: rack=SET, chassis=SET, "
+        "valve=SET, type=hardware,software,other and enabled. A SET is numbers and ranges like 1,3,10-12");
+    gtk_grid_attach(grid, expression_entry, 1, 1, 1, 1);
+
+    GtkLabel *error_label = GTK_LABEL(gtk_label_new(NULL));
+    assert(NULL != error_label);
+    gtk_grid_attach(grid, GTK_WIDGET(error_label), 0, 2, 2, 1);
+
+    GtkContainer *content = GTK_CONTAINER(gtk_dialog_get_content_area(GTK_DIALOG(dialog)));
+    gtk_container_add(content, GTK_WIDGET(grid));
+    gtk_widget_show_all(GTK_WIDGET(content));
+
+    // keep asking until the filter is saved or the user gives up
+    while (GTK_RESPONSE_ACCEPT == gtk_dialog_run(GTK_DIALOG(dialog))) {
+        gchar *name = g_strstrip(g_strdup(gtk_entry_get_text(GTK_ENTRY(name_entry))));
+        gchar *expression = g_strstrip(g_strdup(gtk_entry_get_text(GTK_ENTRY(expression_entry))));
+        assert((NULL != name) && (NULL != expression));
+
+        char *error_message = NULL;
+        Filter *filter = filter_parse(expression, &error_message);
+        filter_free(filter);
+
+        bool saved = false;
+        if (NULL != error_message) {
+            gtk_label_set_text(error_label, error_message);
+            g_free(error_message);
+        } else if ('\0' == *name) {
+            gtk_label_set_text(error_label, "The filter needs a name");
+        } else {
+            char *path = filters_path();
+            saved = saved_filter_store(path, name, expression);
+            g_free(path);
+            if (!saved) {
+                gtk_label_set_text(error_label, "Unable to save the filter. Names cannot contain =, [ or ]");
+            }
+        }
+
+        if (saved) {
+            update_filters_menu();
+            show_filter(expression);
+        }
+
+        g_free(name);
+        g_free(expression);
+        if (saved) {
+            break;
+        }
+    }
+
+    gtk_widget_destroy(dialog);
+}
+
 typedef void (*action_handler_t)(GSimpleAction *simple, GVariant *parameter, gpointer user_data);
 
 // activate handler for the application
 static void activate(GtkApplication *app, __attribute__((unused)) gpointer data) {
+    application = app;
     main_window = GTK_WINDOW(gtk_application_window_new(app));
     gtk_window_set_title(main_window, "EDSAC Status Monitor");
     //gtk_window_maximize(GTK_WINDOW(WINDOW));
@@ -589,14 +1636,40 @@ static void activate(GtkApplication *app, __attribute__((unused)) gpointer data)
         {"add_node", (action_handler_t) add_node_activate},
         {"quit", (action_handler_t) quit_activate},
         {"check_connected", (action_handler_t) check_connected_activate},
+        {"backup", (action_handler_t) start_backup},
+        {"archive", (action_handler_t) archive_activate},
+        {"import_archive", (action_handler_t) import_archive_activate},
+        {"show_dashboard", (action_handler_t) show_dashboard_activate},
+        {"templates", (action_handler_t) templates_activate},
         {"hide_disabled", NULL, "b", "true", (action_handler_t) hide_disabled_change_state},
+        {"hide_acked", NULL, "b", "true", (action_handler_t) hide_acked_change_state},
+        {"time_range", NULL, "s", "'day'", (action_handler_t) time_range_change_state},
+        {"node_browser", NULL, NULL, "true", (action_handler_t) node_browser_change_state},
         {"node_show", (action_handler_t) node_show_activate, "(tt)"},
         {"node_toggle_disabled", (action_handler_t) node_toggle_disabled_activate, "(tt)"},
-        {"node_delete", (action_handler_t) node_delete_activate, "(tt)"}
+        {"node_delete", (action_handler_t) node_delete_activate, "(tt)"},
+        {"rack_set_enabled", (action_handler_t) rack_set_enabled_activate, "(tb)"},
+        {"node_history", (action_handler_t) node_history_activate, "(tt)"},
+        {"node_set", (action_handler_t) node_set_activate},
+        {"filter_new", (action_handler_t) filter_new_activate},
+        {"filter_show", (action_handler_t) filter_show_activate, "s"},
+        {"filter_delete", (action_handler_t) filter_delete_activate, "s"}
     };
     #pragma GCC diagnostic pop
     g_action_map_add_action_entries(G_ACTION_MAP(app), actions, G_N_ELEMENTS(actions), NULL);
 
+    // a read-only window can only look
+    if (database_read_only()) {
+        static const char *changing_actions[] = {"add_node", "check_connected", "archive", "import_archive",
+            "node_toggle_disabled", "node_delete", "rack_set_enabled"};
+        for (gsize i = 0; i < G_N_ELEMENTS(changing_actions); i++) {
+            GAction *action = g_action_map_lookup_action(G_ACTION_MAP(app), changing_actions[i]);
+            assert(NULL != action);
+            g_simple_action_set_enabled(G_SIMPLE_ACTION(action), FALSE);
+        }
+        gtk_window_set_title(main_window, "EDSAC Status Monitor (read-only)");
+    }
+
     // File menu model 
     GMenu *file = g_menu_new();
     assert(NULL != file);
@@ -604,6 +1677,9 @@ static void activate(GtkApplication *app, __attribute__((unused)) gpointer data)
     const char *add_accels[] = {"<Control>N", NULL};
     gtk_application_set_accels_for_action(app, "app.add_node", add_accels);
     g_menu_append(file, "Check Connections", "app.check_connected");
+    g_menu_append(file, "Back Up Database", "app.backup");
+    g_menu_append(file, "Archive Old Errors", "app.archive");
+    g_menu_append(file, "Import Archive", "app.import_archive");
     g_menu_append(file, "Quit", "app.quit");
     const char *quit_accels[] = {"<Control>Q", NULL};
     gtk_application_set_accels_for_action(app, "app.quit", quit_accels);
@@ -616,6 +1692,29 @@ static void activate(GtkApplication *app, __attribute__((unused)) gpointer data)
     assert(NULL != hide_disabled);
     g_menu_item_set_action_and_target_value(hide_disabled, "app.hide_disabled", g_variant_new_boolean(TRUE));
     g_menu_append_item(view, hide_disabled);
+    g_object_unref(hide_disabled);
+    GMenuItem *hide_acked = g_menu_item_new("Hide Acknowledged", "app.hide_acked");
+    assert(NULL != hide_acked);
+    g_menu_item_set_action_and_target_value(hide_acked, "app.hide_acked", g_variant_new_boolean(TRUE));
+    g_menu_append_item(view, hide_acked);
+    g_object_unref(hide_acked);
+    g_menu_append(view, "Overview", "app.show_dashboard");
+    g_menu_append(view, "Node Browser", "app.node_browser");
+    const char *browser_accels[] = {"<Control>B", NULL};
+    gtk_application_set_accels_for_action(app, "app.node_browser", browser_accels);
+    g_menu_append(view, "Common Messages...", "app.templates");
+
+    GMenu *time_ranges = g_menu_new();
+    assert(NULL != time_ranges);
+    for (size_t i = 0; i < G_N_ELEMENTS(time_range_presets); i++) {
+        GMenuItem *item = g_menu_item_new(time_range_presets[i].label, NULL);
+        assert(NULL != item);
+        g_menu_item_set_action_and_target_value(item, "app.time_range", g_variant_new_string(time_range_presets[i].name));
+        g_menu_append_item(time_ranges, item);
+        g_object_unref(item);
+    }
+    g_menu_freeze(time_ranges);
+    g_menu_append_section(view, "Time Range", G_MENU_MODEL(time_ranges));
     g_menu_freeze(view);
 
     // Nodes menu model
@@ -627,17 +1726,43 @@ static void activate(GtkApplication *app, __attribute__((unused)) gpointer data)
     g_menu_append_submenu(model, "File", G_MENU_MODEL(file));
     g_menu_append_submenu(model, "View", G_MENU_MODEL(view));
     g_menu_append_submenu(model, "Nodes", G_MENU_MODEL(nodes));
+    g_menu_append_submenu(model, "Filters", G_MENU_MODEL(generate_filters_menu()));
     g_menu_freeze(model);
 
     // Menu bar widget
     GtkWidget *menu = gtk_menu_bar_new_from_model(G_MENU_MODEL(model));
     assert(NULL != menu);
-    gtk_box_pack_start(box, menu, FALSE, FALSE, 0);
+
+    // search entry on the right of the menu bar
+    GtkWidget *search = gtk_search_entry_new();
+    assert(NULL != search);
+    gtk_entry_set_placeholder_text(GTK_ENTRY(search), "Search errors");
+    gtk_widget_set_tooltip_text(search, "Every word must appear. End a word with * to match words starting with it");
+    gtk_widget_set_sensitive(search, search_index_available());
+    g_signal_connect(G_OBJECT(search), "activate", G_CALLBACK(search_activate), NULL);
+
+    GtkBox *menu_box = GTK_BOX(gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 0));
+    assert(NULL != menu_box);
+    gtk_box_pack_start(menu_box, menu, TRUE, TRUE, 0);
+    gtk_box_pack_start(menu_box, search, FALSE, FALSE, 0);
+    gtk_box_pack_start(box, GTK_WIDGET(menu_box), FALSE, FALSE, 0);
+
+    // alert banners between the menu bar and everything else
+    banners = gtk_box_new(GTK_ORIENTATION_VERTICAL, 0);
+    assert(NULL != banners);
+    gtk_box_pack_start(box, banners, FALSE, FALSE, 0);
 
     // make notebook
     notebook = edsac_error_notebook_new();
     g_signal_connect_after(G_OBJECT(notebook), "switch-page", G_CALLBACK(update_bar), NULL);
-    gtk_box_pack_start(box, GTK_WIDGET(notebook), TRUE, TRUE, 0);
+
+    // node browser on the left of the notebook
+    node_browser = node_browser_new(browser_action, NULL);
+    GtkWidget *panes = gtk_paned_new(GTK_ORIENTATION_HORIZONTAL);
+    assert(NULL != panes);
+    gtk_paned_pack1(GTK_PANED(panes), node_browser, FALSE, FALSE);
+    gtk_paned_pack2(GTK_PANED(panes), GTK_WIDGET(notebook), TRUE, FALSE);
+    gtk_box_pack_start(box, panes, TRUE, TRUE, 0);
 
     // make status bar
     bar = GTK_STATUSBAR(gtk_statusbar_new());
@@ -656,6 +1781,11 @@ static void shutdown_handler(__attribute__((unused)) GApplication *app, gpointer
         stop_timer(*timer_id);
     }
 
-    stop_server();
+    // a read-only window never started the server
+    if (!database_read_only()) {
+        stop_server();
+        ingest_drain(NULL, NULL, NULL); // anything left in the server's buffer
+        ingest_shutdown();
+    }
     close_database();
 }
\ No newline at end of file
@@ -0,0 +1,145 @@
+/*
+ * Copyright 2017
+ * GPL3 Licensed
+ * unacked.c
+ * Per node and per valve counts of unacknowledged errors, kept up to date as errors arrive and are acknowledged so
+ * that tabs never have to count them in the database
+ */
+
+// includes
+#include "config.h"
+#include "unacked.h"
+#include "clickable.h"
+#include <assert.h>
+
+// valves are never below -1
+#define VALVE_KEY(valve_no) GINT_TO_POINTER((valve_no) + 1)
+
+typedef struct {
+    unsigned int rack_no;
+    gint64 total;
+    GHashTable *valves; // VALVE_KEY -> gint64 *
+} UnackedNode;
+
+static GMutex unacked_lock; // protects everything below
+static GHashTable *nodes = NULL; // NODE_KEY -> UnackedNode
+static gint64 total = 0;
+
+// functions
+
+static void free_unacked_node(gpointer data) {
+    UnackedNode *node = data;
+    g_hash_table_destroy(node->valves);
+    g_free(node);
+}
+
+// call with unacked_lock held
+static GHashTable *get_nodes(void) {
+    if (NULL == nodes) {
+        nodes = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, free_unacked_node);
+        assert(NULL != nodes);
+    }
+    return nodes;
+}
+
+void unacked_clear(void) {
+    g_mutex_lock(&unacked_lock);
+    if (NULL != nodes) {
+        g_hash_table_destroy(nodes);
+        nodes = NULL;
+    }
+    total = 0;
+    g_mutex_unlock(&unacked_lock);
+}
+
+void unacked_add(const unsigned int rack_no, const unsigned int chassis_no, const int valve_no, const gint64 count) {
+    g_mutex_lock(&unacked_lock);
+
+    UnackedNode *node = g_hash_table_lookup(get_nodes(), NODE_KEY(rack_no, chassis_no));
+    if (NULL == node) {
+        node = g_malloc0(sizeof(UnackedNode));
+        assert(NULL != node);
+        node->rack_no = rack_no;
+        node->valves = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+        assert(NULL != node->valves);
+        g_hash_table_insert(nodes, NODE_KEY(rack_no, chassis_no), node);
+    }
+
+    gint64 *valve = g_hash_table_lookup(node->valves, VALVE_KEY(valve_no));
+    if (NULL == valve) {
+        valve = g_malloc0(sizeof(gint64));
+        assert(NULL != valve);
+        g_hash_table_insert(node->valves, VALVE_KEY(valve_no), valve);
+    }
+
+    *valve += count;
+    node->total += count;
+    total += count;
+
+    g_mutex_unlock(&unacked_lock);
+}
+
+void unacked_remove_node(const unsigned int rack_no, const unsigned int chassis_no) {
+    g_mutex_lock(&unacked_lock);
+
+    const UnackedNode *node = g_hash_table_lookup(get_nodes(), NODE_KEY(rack_no, chassis_no));
+    if (NULL != node) {
+        total -= node->total;
+        g_hash_table_remove(nodes, NODE_KEY(rack_no, chassis_no));
+    }
+
+    g_mutex_unlock(&unacked_lock);
+}
+
+// call with unacked_lock held
+static gint64 node_count(const unsigned int rack_no, const unsigned int chassis_no) {
+    const UnackedNode *node = g_hash_table_lookup(get_nodes(), NODE_KEY(rack_no, chassis_no));
+    return (NULL == node) ? 0 : node->total;
+}
+
+gint64 unacked_count(const Clickable *search) {
+    assert(NULL != search);
+
+    g_mutex_lock(&unacked_lock);
+
+    gint64 count = 0;
+    switch (search->type) {
+        case ALL:
+            count = total;
+            break;
+        case RACK: {
+            GHashTableIter iter;
+            gpointer value = NULL;
+            g_hash_table_iter_init(&iter, get_nodes());
+            while (g_hash_table_iter_next(&iter, NULL, &value)) {
+                const UnackedNode *node = value;
+                if (node->rack_no == search->rack_num) {
+                    count += node->total;
+                }
+            }
+            break;
+        }
+        case CHASSIS:
+            count = node_count(search->rack_num, search->chassis_num);
+            break;
+        case VALVE: {
+            const UnackedNode *node = g_hash_table_lookup(get_nodes(), NODE_KEY(search->rack_num, search->chassis_num));
+            const gint64 *valve = (NULL == node) ? NULL : g_hash_table_lookup(node->valves, VALVE_KEY(search->valve_num));
+            count = (NULL == valve) ? 0 : *valve;
+            break;
+        }
+        case NODE_SET: {
+            const GArray *members = node_set_members(search->text);
+            for (guint i = 0; (NULL != members) && (i < members->len); i++) {
+                const NodeIdentifier *member = &g_array_index(members, NodeIdentifier, i);
+                count += node_count(member->rack_no, member->chassis_no);
+            }
+            break;
+        }
+        default:
+            count = -1;
+    }
+
+    g_mutex_unlock(&unacked_lock);
+    return count;
+}